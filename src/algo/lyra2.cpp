@@ -49,6 +49,28 @@
  * @return 0 if the key is generated correctly; -1 if there is an error (usually due to lack of memory for allocation)
  */
 int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
+    //Tries to allocate enough space for the whole memory matrix
+    uint64_t *wholeMatrix = (uint64_t*) malloc(LYRA2_MATRIX_BYTES(nRows, nCols));
+    if (wholeMatrix == NULL) {
+      return -1;
+    }
+
+    int result = LYRA2_matrix(wholeMatrix, K, kLen, pwd, pwdlen, salt, saltlen, timeCost, nRows, nCols);
+
+    free(wholeMatrix);
+    return result;
+}
+
+/**
+ * Same as LYRA2, but works on a caller-provided memory matrix of at least
+ * LYRA2_MATRIX_BYTES(nRows, nCols) bytes instead of allocating one on every
+ * call, so that callers hashing in a loop can reuse a single buffer.
+ *
+ * @param wholeMatrix The memory matrix (R x C x b bits) to work in
+ *
+ * @return 0 if the key is generated correctly
+ */
+int LYRA2_matrix(uint64_t *wholeMatrix, void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
 
     //============================= Basic variables ============================//
     int64_t row = 2; //index of row to be processed
@@ -62,30 +84,13 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
     //==========================================================================/
 
     //========== Initializing the Memory Matrix and pointers to it =============//
-    //Tries to allocate enough space for the whole memory matrix
-
-
     const int64_t ROW_LEN_INT64 = BLOCK_LEN_INT64 * nCols;
-    const int64_t ROW_LEN_BYTES = ROW_LEN_INT64 * 8;
 
-    i = (int64_t) ((int64_t) nRows * (int64_t) ROW_LEN_BYTES);
-    uint64_t *wholeMatrix = (uint64_t*) malloc(i);
-    if (wholeMatrix == NULL) {
-      return -1;
-    }
-	memset(wholeMatrix, 0, i);
+    memset(wholeMatrix, 0, LYRA2_MATRIX_BYTES(nRows, nCols));
 
-    //Allocates pointers to each row of the matrix
-    uint64_t **memMatrix = (uint64_t**) malloc(nRows * sizeof (uint64_t*));
-    if (memMatrix == NULL) {
-      return -1;
-    }
-    //Places the pointers in the correct positions
-    uint64_t *ptrWord = wholeMatrix;
-    for (i = 0; i < (int64_t) nRows; i++) {
-      memMatrix[i] = ptrWord;
-      ptrWord += ROW_LEN_INT64;
-    }
+    //Rows are laid out contiguously, so M[i] is simply at offset i * ROW_LEN_INT64
+    #define memMatrix(i) (wholeMatrix + (i) * ROW_LEN_INT64)
+    uint64_t *ptrWord;
     //==========================================================================/
 
     //============= Getting the password + salt + basil padded with 10*1 ===============//
@@ -128,10 +133,7 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
 
     //======================= Initializing the Sponge State ====================//
     //Sponge state: 16 uint64_t, BLOCK_LEN_INT64 words of them for the bitrate (b) and the remainder for the capacity (c)
-    uint64_t *state = (uint64_t*) malloc(16 * sizeof (uint64_t));
-    if (state == NULL) {
-      return -1;
-    }
+    uint64_t state[16];
     initState(state);
     //==========================================================================/
 
@@ -144,12 +146,12 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
     }
 
     //Initializes M[0] and M[1]
-    reducedSqueezeRow0(state, memMatrix[0], nCols); //The locally copied password is most likely overwritten here
-    reducedDuplexRow1(state, memMatrix[0], memMatrix[1], nCols);
+    reducedSqueezeRow0(state, memMatrix(0), nCols); //The locally copied password is most likely overwritten here
+    reducedDuplexRow1(state, memMatrix(0), memMatrix(1), nCols);
 
     do {
       //M[row] = rand; //M[row*] = M[row*] XOR rotW(rand)
-      reducedDuplexRowSetup(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
+      reducedDuplexRowSetup(state, memMatrix(prev), memMatrix(rowa), memMatrix(row), nCols);
 
 
       //updates the value of row* (deterministically picked during Setup))
@@ -182,7 +184,7 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
   	    //------------------------------------------------------------------------------------------
 
   	    //Performs a reduced-round duplexing operation over M[row*] XOR M[prev], updating both M[row*] and M[row]
-  	    reducedDuplexRow(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
+  	    reducedDuplexRow(state, memMatrix(prev), memMatrix(rowa), memMatrix(row), nCols);
 
   	    //update prev: it now points to the last row ever computed
   	    prev = row;
@@ -199,19 +201,16 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
 
     //============================ Wrap-up Phase ===============================//
     //Absorbs the last block of the memory matrix
-    absorbBlock(state, memMatrix[rowa]);
+    absorbBlock(state, memMatrix(rowa));
 
     //Squeezes the key
     squeeze(state, (unsigned char*) K, kLen);
     //==========================================================================/
 
-    //========================= Freeing the memory =============================//
-    free(memMatrix);
-    free(wholeMatrix);
-
-    //Wiping out the sponge's internal state before freeing it
+    //========================= Wiping the state ==============================//
+    //Wiping out the sponge's internal state
     memset(state, 0, 16 * sizeof (uint64_t));
-    free(state);
+    #undef memMatrix
     //==========================================================================/
 
     return 0;
@@ -0,0 +1,276 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// This is an AES-NI implementation of ECHO-512 and SHAvite-3-512, the X16R
+// hash functions built from the AES round. Every AES round that the sph code
+// computes with table lookups is one AESENC instruction here.
+//
+// ECHO applies 16 independent AES rounds per step, which already keeps the
+// AES unit busy, so the four messages are hashed one after another. The
+// SHAvite rounds form a chain of dependent AES rounds, so the four messages
+// are interleaved round by round to hide the AESENC latency.
+
+#ifdef ENABLE_AESNI
+
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include <crypto/common.h>
+
+namespace x16r_aesni {
+namespace {
+
+/** 128-bit block counter of ECHO and SHAvite, as four 32-bit words in the sph code */
+struct Counter
+{
+    uint64_t lo{0};
+    uint64_t hi{0};
+
+    void Add(uint64_t n)
+    {
+        lo += n;
+        if (lo < n) hi++;
+    }
+
+    void Write(unsigned char* out) const
+    {
+        WriteLE64(out, lo);
+        WriteLE64(out + 8, hi);
+    }
+
+    uint32_t Word(int i) const { return (uint32_t)((i < 2 ? lo : hi) >> (32 * (i & 1))); }
+};
+
+inline __m128i Load(const unsigned char* in) { return _mm_loadu_si128((const __m128i*)in); }
+inline void Store(unsigned char* out, __m128i v) { _mm_storeu_si128((__m128i*)out, v); }
+inline __m128i Xor(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+
+/* ----------------------------------- ECHO-512 ----------------------------------- */
+
+/** Multiplication by 2 in GF(2^8) of every byte */
+inline __m128i Mul2(__m128i x)
+{
+    const __m128i mask = _mm_cmplt_epi8(x, _mm_setzero_si128());
+    return Xor(_mm_add_epi8(x, x), _mm_and_si128(mask, _mm_set1_epi8(0x1b)));
+}
+
+inline void EchoMixColumn(__m128i* w)
+{
+    const __m128i a = w[0], b = w[1], c = w[2], d = w[3];
+    const __m128i ab = Xor(a, b), bc = Xor(b, c), cd = Xor(c, d);
+    const __m128i abx = Mul2(ab), bcx = Mul2(bc), cdx = Mul2(cd);
+    w[0] = Xor(Xor(abx, bc), d);
+    w[1] = Xor(Xor(bcx, a), cd);
+    w[2] = Xor(Xor(cdx, ab), d);
+    w[3] = Xor(Xor(Xor(abx, bcx), Xor(cdx, ab)), c);
+}
+
+void EchoCompress(__m128i V[8], const unsigned char* block, Counter k)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i W[16];
+    for (int i = 0; i < 8; i++) {
+        W[i] = V[i];
+        W[i + 8] = Load(block + 16 * i);
+    }
+
+    for (int r = 0; r < 10; r++) {
+        // BIG.SubWords: two AES rounds per word, the first keyed with the counter
+        for (int i = 0; i < 16; i++) {
+            W[i] = _mm_aesenc_si128(_mm_aesenc_si128(W[i], _mm_set_epi64x(k.hi, k.lo)), zero);
+            k.Add(1);
+        }
+
+        // BIG.ShiftRows
+        __m128i t = W[1];
+        W[1] = W[5]; W[5] = W[9]; W[9] = W[13]; W[13] = t;
+        t = W[2]; W[2] = W[10]; W[10] = t;
+        t = W[6]; W[6] = W[14]; W[14] = t;
+        t = W[15];
+        W[15] = W[11]; W[11] = W[7]; W[7] = W[3]; W[3] = t;
+
+        // BIG.MixColumns
+        for (int i = 0; i < 16; i += 4) {
+            EchoMixColumn(&W[i]);
+        }
+    }
+
+    for (int i = 0; i < 8; i++) {
+        V[i] = Xor(V[i], Xor(Load(block + 16 * i), Xor(W[i], W[i + 8])));
+    }
+}
+
+void Echo512(unsigned char* out, const unsigned char* in, size_t len)
+{
+    __m128i V[8];
+    for (int i = 0; i < 8; i++) {
+        V[i] = _mm_set_epi64x(0, 512);
+    }
+
+    Counter count;
+    size_t pos = 0;
+    for (; len - pos >= 128; pos += 128) {
+        count.Add(1024);
+        EchoCompress(V, in + pos, count);
+    }
+
+    // The final block carries the message bit length, its counter only
+    // covers the message bits it contains
+    unsigned char buf[128];
+    size_t ptr = len - pos;
+    memcpy(buf, in + pos, ptr);
+    count.Add(ptr << 3);
+    unsigned char bitlen[16];
+    count.Write(bitlen);
+    if (ptr == 0) count = Counter();
+    buf[ptr++] = 0x80;
+    memset(buf + ptr, 0, sizeof(buf) - ptr);
+    if (ptr > sizeof(buf) - 18) {
+        EchoCompress(V, buf, count);
+        count = Counter();
+        memset(buf, 0, sizeof(buf));
+    }
+    WriteLE16(buf + 110, 512);
+    memcpy(buf + 112, bitlen, 16);
+    EchoCompress(V, buf, count);
+
+    for (int i = 0; i < 4; i++) {
+        Store(out + 16 * i, V[i]);
+    }
+}
+
+/* --------------------------------- SHAvite-3-512 --------------------------------- */
+
+const uint32_t SHAVITE512_IV[16] = {
+    0x72FCCDD8, 0x79CA4727, 0x128A077B, 0x40D55AEC, 0xD1901A06, 0x430AE307, 0xB29F5CD1, 0xDF07FBFC,
+    0x8E45D73D, 0x681AB538, 0xBDE86578, 0xDD577E47, 0xE275EADE, 0x502D9FCD, 0xB9357178, 0x022A4B9A
+};
+
+/** Number of 128-bit round keys of one compression */
+const int SHAVITE512_RK = 112;
+
+/** Expand a message block into the round keys, mixing in the counter like the sph code */
+void ShaviteKeySchedule(__m128i rk[SHAVITE512_RK], const unsigned char* block, const Counter& count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const uint32_t c0 = count.Word(0), c1 = count.Word(1), c2 = count.Word(2), c3 = count.Word(3);
+
+    for (int i = 0; i < 8; i++) {
+        rk[i] = Load(block + 16 * i);
+    }
+    for (int i = 8; i < SHAVITE512_RK; i++) {
+        if (((i - 8) / 8) % 2 == 0) {
+            // nonlinear step: an unkeyed AES round of the rotated key 8 back
+            rk[i] = Xor(_mm_aesenc_si128(_mm_shuffle_epi32(rk[i - 8], 0x39), zero), rk[i - 1]);
+            if (i == 8) {
+                rk[i] = Xor(rk[i], _mm_set_epi32(~c3, c2, c1, c0));
+            } else if (i == 41) {
+                rk[i] = Xor(rk[i], _mm_set_epi32(~c0, c1, c2, c3));
+            } else if (i == 79) {
+                rk[i] = Xor(rk[i], _mm_set_epi32(~c1, c0, c3, c2));
+            } else if (i == 110) {
+                rk[i] = Xor(rk[i], _mm_set_epi32(~c2, c3, c0, c1));
+            }
+        } else {
+            // linear step: the key 8 back and the 16 bytes 7 words back
+            rk[i] = Xor(rk[i - 8], _mm_alignr_epi8(rk[i - 1], rk[i - 2], 4));
+        }
+    }
+}
+
+void ShaviteCompress4(__m128i H[4][4], const unsigned char* const block[4], const Counter& count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i rk[4][SHAVITE512_RK];
+    __m128i P[4][4];
+    for (int l = 0; l < 4; l++) {
+        ShaviteKeySchedule(rk[l], block[l], count);
+        for (int i = 0; i < 4; i++) P[l][i] = H[l][i];
+    }
+
+    for (int r = 0; r < 14; r++) {
+        for (int half = 0; half < 2; half++) {
+            // four AES rounds of the right quarter, AESENC adds the key of the next one
+            const int j = 8 * r + 4 * half;
+            __m128i x[4];
+            for (int l = 0; l < 4; l++) x[l] = _mm_aesenc_si128(Xor(P[l][2 * half + 1], rk[l][j]), rk[l][j + 1]);
+            for (int l = 0; l < 4; l++) x[l] = _mm_aesenc_si128(x[l], rk[l][j + 2]);
+            for (int l = 0; l < 4; l++) x[l] = _mm_aesenc_si128(x[l], rk[l][j + 3]);
+            for (int l = 0; l < 4; l++) P[l][2 * half] = Xor(P[l][2 * half], _mm_aesenc_si128(x[l], zero));
+        }
+        for (int l = 0; l < 4; l++) {
+            const __m128i t = P[l][3];
+            P[l][3] = P[l][2];
+            P[l][2] = P[l][1];
+            P[l][1] = P[l][0];
+            P[l][0] = t;
+        }
+    }
+
+    for (int l = 0; l < 4; l++) {
+        for (int i = 0; i < 4; i++) H[l][i] = Xor(H[l][i], P[l][i]);
+    }
+}
+
+} // namespace
+
+void Echo512_4way(unsigned char* const out[4], const unsigned char* const in[4], size_t len)
+{
+    for (int i = 0; i < 4; i++) {
+        Echo512(out[i], in[i], len);
+    }
+}
+
+void Shavite512_4way(unsigned char* const out[4], const unsigned char* const in[4], size_t len)
+{
+    __m128i H[4][4];
+    for (int l = 0; l < 4; l++) {
+        for (int i = 0; i < 4; i++) {
+            H[l][i] = _mm_set_epi32(SHAVITE512_IV[4 * i + 3], SHAVITE512_IV[4 * i + 2], SHAVITE512_IV[4 * i + 1], SHAVITE512_IV[4 * i]);
+        }
+    }
+
+    Counter count;
+    size_t pos = 0;
+    for (; len - pos >= 128; pos += 128) {
+        count.Add(1024);
+        const unsigned char* block[4] = {in[0] + pos, in[1] + pos, in[2] + pos, in[3] + pos};
+        ShaviteCompress4(H, block, count);
+    }
+
+    // All lanes have the same length, so they share the padding layout and the counter
+    unsigned char buf[4][128];
+    const unsigned char* block[4] = {buf[0], buf[1], buf[2], buf[3]};
+    const size_t ptr = len - pos;
+    Counter bitlen = count;
+    bitlen.Add(ptr << 3);
+    count = bitlen;
+    for (int l = 0; l < 4; l++) {
+        memcpy(buf[l], in[l] + pos, ptr);
+        buf[l][ptr] = 0x80;
+    }
+    if (ptr == 0) {
+        count = Counter();
+    } else if (ptr >= 110) {
+        for (int l = 0; l < 4; l++) memset(buf[l] + ptr + 1, 0, 127 - ptr);
+        ShaviteCompress4(H, block, count);
+        count = Counter();
+        for (int l = 0; l < 4; l++) memset(buf[l], 0, 110);
+    }
+    for (int l = 0; l < 4; l++) {
+        if (ptr < 110) memset(buf[l] + ptr + 1, 0, 109 - ptr);
+        bitlen.Write(buf[l] + 110);
+        WriteLE16(buf[l] + 126, 512);
+    }
+    ShaviteCompress4(H, block, count);
+
+    for (int l = 0; l < 4; l++) {
+        for (int i = 0; i < 4; i++) Store(out[l] + 16 * i, H[l][i]);
+    }
+}
+
+} // namespace x16r_aesni
+
+#endif
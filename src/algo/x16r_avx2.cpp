@@ -0,0 +1,279 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// This is a 4-way multi-buffer implementation of BLAKE-512 and Keccak-512,
+// the X16R hash functions that map well onto AVX2: every 256-bit register
+// holds the same 64-bit state word of four independent messages.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include <crypto/common.h>
+
+namespace x16r_avx2 {
+namespace {
+
+inline __m256i Load4(const unsigned char* const in[4], size_t pos)
+{
+    return _mm256_set_epi64x(ReadLE64(in[3] + pos), ReadLE64(in[2] + pos), ReadLE64(in[1] + pos), ReadLE64(in[0] + pos));
+}
+
+inline __m256i Load4BE(const unsigned char* const in[4], size_t pos)
+{
+    return _mm256_set_epi64x(ReadBE64(in[3] + pos), ReadBE64(in[2] + pos), ReadBE64(in[1] + pos), ReadBE64(in[0] + pos));
+}
+
+inline void Store4(unsigned char* const out[4], size_t pos, __m256i v)
+{
+    alignas(32) uint64_t tmp[4];
+    _mm256_store_si256((__m256i*)tmp, v);
+    for (int i = 0; i < 4; i++) WriteLE64(out[i] + pos, tmp[i]);
+}
+
+inline void Store4BE(unsigned char* const out[4], size_t pos, __m256i v)
+{
+    alignas(32) uint64_t tmp[4];
+    _mm256_store_si256((__m256i*)tmp, v);
+    for (int i = 0; i < 4; i++) WriteBE64(out[i] + pos, tmp[i]);
+}
+
+inline __m256i Xor(__m256i a, __m256i b) { return _mm256_xor_si256(a, b); }
+inline __m256i Add(__m256i a, __m256i b) { return _mm256_add_epi64(a, b); }
+inline __m256i K(uint64_t x) { return _mm256_set1_epi64x(x); }
+
+template <int n>
+inline __m256i Rotl(__m256i x)
+{
+    return n == 0 ? x : _mm256_or_si256(_mm256_slli_epi64(x, n & 63), _mm256_srli_epi64(x, (64 - n) & 63));
+}
+
+template <int n>
+inline __m256i Rotr(__m256i x) { return Rotl<64 - n>(x); }
+
+/** Rotations by 32 and 16 bits are byte shuffles */
+inline __m256i Rotr32(__m256i x) { return _mm256_shuffle_epi32(x, 0xb1); }
+inline __m256i Rotr16(__m256i x)
+{
+    return _mm256_shuffle_epi8(x, _mm256_set_epi8(9, 8, 15, 14, 13, 12, 11, 10, 1, 0, 7, 6, 5, 4, 3, 2,
+                                                  9, 8, 15, 14, 13, 12, 11, 10, 1, 0, 7, 6, 5, 4, 3, 2));
+}
+
+/* ----------------------------------- BLAKE-512 ----------------------------------- */
+
+const uint64_t BLAKE512_IV[8] = {
+    0x6A09E667F3BCC908ull, 0xBB67AE8584CAA73Bull, 0x3C6EF372FE94F82Bull, 0xA54FF53A5F1D36F1ull,
+    0x510E527FADE682D1ull, 0x9B05688C2B3E6C1Full, 0x1F83D9ABFB41BD6Bull, 0x5BE0CD19137E2179ull
+};
+
+const uint64_t BLAKE512_C[16] = {
+    0x243F6A8885A308D3ull, 0x13198A2E03707344ull, 0xA4093822299F31D0ull, 0x082EFA98EC4E6C89ull,
+    0x452821E638D01377ull, 0xBE5466CF34E90C6Cull, 0xC0AC29B7C97C50DDull, 0x3F84D5B5B5470917ull,
+    0x9216D5D98979FB1Bull, 0xD1310BA698DFB5ACull, 0x2FFD72DBD01ADFB7ull, 0xB8E1AFED6A267E96ull,
+    0xBA7C9045F12C7F99ull, 0x24A19947B3916CF7ull, 0x0801F2E2858EFC16ull, 0x636920D871574E69ull
+};
+
+const uint8_t BLAKE_SIGMA[10][16] = {
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+    { 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+    {  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+    {  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+    {  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+    { 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+    { 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+    {  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+    { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 },
+};
+
+inline void BlakeG(const __m256i* m, const uint8_t* s, int i, __m256i& a, __m256i& b, __m256i& c, __m256i& d)
+{
+    a = Add(Add(a, b), Xor(m[s[2 * i]], K(BLAKE512_C[s[2 * i + 1]])));
+    d = Rotr32(Xor(d, a));
+    c = Add(c, d);
+    b = Rotr<25>(Xor(b, c));
+    a = Add(Add(a, b), Xor(m[s[2 * i + 1]], K(BLAKE512_C[s[2 * i]])));
+    d = Rotr16(Xor(d, a));
+    c = Add(c, d);
+    b = Rotr<11>(Xor(b, c));
+}
+
+/* ------------------------------------ Keccak ------------------------------------- */
+
+const uint64_t KECCAK_RC[24] = {
+    0x0000000000000001ull, 0x0000000000008082ull, 0x800000000000808Aull, 0x8000000080008000ull,
+    0x000000000000808Bull, 0x0000000080000001ull, 0x8000000080008081ull, 0x8000000000008009ull,
+    0x000000000000008Aull, 0x0000000000000088ull, 0x0000000080008009ull, 0x000000008000000Aull,
+    0x000000008000808Bull, 0x800000000000008Bull, 0x8000000000008089ull, 0x8000000000008003ull,
+    0x8000000000008002ull, 0x8000000000000080ull, 0x000000000000800Aull, 0x800000008000000Aull,
+    0x8000000080008081ull, 0x8000000000008080ull, 0x0000000080000001ull, 0x8000000080008008ull
+};
+
+/** Keccak-f[1600]. The 24 rounds are a loop, the steps within a round are
+ *  written out; the theta column parities are applied in the rho and pi step */
+void KeccakF(__m256i* a)
+{
+    __m256i b[25], c[5], d[5];
+    for (int round = 0; round < 24; round++) {
+        // theta
+        c[0] = Xor(Xor(Xor(a[0], a[5]), Xor(a[10], a[15])), a[20]);
+        c[1] = Xor(Xor(Xor(a[1], a[6]), Xor(a[11], a[16])), a[21]);
+        c[2] = Xor(Xor(Xor(a[2], a[7]), Xor(a[12], a[17])), a[22]);
+        c[3] = Xor(Xor(Xor(a[3], a[8]), Xor(a[13], a[18])), a[23]);
+        c[4] = Xor(Xor(Xor(a[4], a[9]), Xor(a[14], a[19])), a[24]);
+        d[0] = Xor(c[4], Rotl<1>(c[1]));
+        d[1] = Xor(c[0], Rotl<1>(c[2]));
+        d[2] = Xor(c[1], Rotl<1>(c[3]));
+        d[3] = Xor(c[2], Rotl<1>(c[4]));
+        d[4] = Xor(c[3], Rotl<1>(c[0]));
+        // rho and pi
+        b[0] = Rotl<0>(Xor(a[0], d[0]));
+        b[10] = Rotl<1>(Xor(a[1], d[1]));
+        b[20] = Rotl<62>(Xor(a[2], d[2]));
+        b[5] = Rotl<28>(Xor(a[3], d[3]));
+        b[15] = Rotl<27>(Xor(a[4], d[4]));
+        b[16] = Rotl<36>(Xor(a[5], d[0]));
+        b[1] = Rotl<44>(Xor(a[6], d[1]));
+        b[11] = Rotl<6>(Xor(a[7], d[2]));
+        b[21] = Rotl<55>(Xor(a[8], d[3]));
+        b[6] = Rotl<20>(Xor(a[9], d[4]));
+        b[7] = Rotl<3>(Xor(a[10], d[0]));
+        b[17] = Rotl<10>(Xor(a[11], d[1]));
+        b[2] = Rotl<43>(Xor(a[12], d[2]));
+        b[12] = Rotl<25>(Xor(a[13], d[3]));
+        b[22] = Rotl<39>(Xor(a[14], d[4]));
+        b[23] = Rotl<41>(Xor(a[15], d[0]));
+        b[8] = Rotl<45>(Xor(a[16], d[1]));
+        b[18] = Rotl<15>(Xor(a[17], d[2]));
+        b[3] = Rotl<21>(Xor(a[18], d[3]));
+        b[13] = Rotl<8>(Xor(a[19], d[4]));
+        b[14] = Rotl<18>(Xor(a[20], d[0]));
+        b[24] = Rotl<2>(Xor(a[21], d[1]));
+        b[9] = Rotl<61>(Xor(a[22], d[2]));
+        b[19] = Rotl<56>(Xor(a[23], d[3]));
+        b[4] = Rotl<14>(Xor(a[24], d[4]));
+        // chi
+        a[0] = Xor(b[0], _mm256_andnot_si256(b[1], b[2]));
+        a[1] = Xor(b[1], _mm256_andnot_si256(b[2], b[3]));
+        a[2] = Xor(b[2], _mm256_andnot_si256(b[3], b[4]));
+        a[3] = Xor(b[3], _mm256_andnot_si256(b[4], b[0]));
+        a[4] = Xor(b[4], _mm256_andnot_si256(b[0], b[1]));
+        a[5] = Xor(b[5], _mm256_andnot_si256(b[6], b[7]));
+        a[6] = Xor(b[6], _mm256_andnot_si256(b[7], b[8]));
+        a[7] = Xor(b[7], _mm256_andnot_si256(b[8], b[9]));
+        a[8] = Xor(b[8], _mm256_andnot_si256(b[9], b[5]));
+        a[9] = Xor(b[9], _mm256_andnot_si256(b[5], b[6]));
+        a[10] = Xor(b[10], _mm256_andnot_si256(b[11], b[12]));
+        a[11] = Xor(b[11], _mm256_andnot_si256(b[12], b[13]));
+        a[12] = Xor(b[12], _mm256_andnot_si256(b[13], b[14]));
+        a[13] = Xor(b[13], _mm256_andnot_si256(b[14], b[10]));
+        a[14] = Xor(b[14], _mm256_andnot_si256(b[10], b[11]));
+        a[15] = Xor(b[15], _mm256_andnot_si256(b[16], b[17]));
+        a[16] = Xor(b[16], _mm256_andnot_si256(b[17], b[18]));
+        a[17] = Xor(b[17], _mm256_andnot_si256(b[18], b[19]));
+        a[18] = Xor(b[18], _mm256_andnot_si256(b[19], b[15]));
+        a[19] = Xor(b[19], _mm256_andnot_si256(b[15], b[16]));
+        a[20] = Xor(b[20], _mm256_andnot_si256(b[21], b[22]));
+        a[21] = Xor(b[21], _mm256_andnot_si256(b[22], b[23]));
+        a[22] = Xor(b[22], _mm256_andnot_si256(b[23], b[24]));
+        a[23] = Xor(b[23], _mm256_andnot_si256(b[24], b[20]));
+        a[24] = Xor(b[24], _mm256_andnot_si256(b[20], b[21]));
+        // iota
+        a[0] = Xor(a[0], K(KECCAK_RC[round]));
+    }
+}
+
+} // namespace
+
+void Blake512_4way(unsigned char* const out[4], const unsigned char* const in[4], size_t len)
+{
+    // Single compression only: the message and its padding must fit in one block
+    alignas(32) unsigned char block[4][128];
+    const unsigned char* pblock[4];
+    for (int i = 0; i < 4; i++) {
+        memset(block[i], 0, 128);
+        memcpy(block[i], in[i], len);
+        block[i][len] = 0x80;
+        block[i][111] |= 1;
+        WriteBE64(block[i] + 120, (uint64_t)len << 3);
+        pblock[i] = block[i];
+    }
+
+    __m256i m[16];
+    for (int i = 0; i < 16; i++) {
+        m[i] = Load4BE(pblock, i * 8);
+    }
+
+    const uint64_t t0 = (uint64_t)len << 3;
+    __m256i v[16];
+    for (int i = 0; i < 8; i++) {
+        v[i] = K(BLAKE512_IV[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+        v[8 + i] = K(BLAKE512_C[i]);
+    }
+    v[12] = K(t0 ^ BLAKE512_C[4]);
+    v[13] = K(t0 ^ BLAKE512_C[5]);
+    v[14] = K(BLAKE512_C[6]);
+    v[15] = K(BLAKE512_C[7]);
+
+    for (int r = 0; r < 16; r++) {
+        const uint8_t* s = BLAKE_SIGMA[r % 10];
+        BlakeG(m, s, 0, v[0], v[4], v[8], v[12]);
+        BlakeG(m, s, 1, v[1], v[5], v[9], v[13]);
+        BlakeG(m, s, 2, v[2], v[6], v[10], v[14]);
+        BlakeG(m, s, 3, v[3], v[7], v[11], v[15]);
+        BlakeG(m, s, 4, v[0], v[5], v[10], v[15]);
+        BlakeG(m, s, 5, v[1], v[6], v[11], v[12]);
+        BlakeG(m, s, 6, v[2], v[7], v[8], v[13]);
+        BlakeG(m, s, 7, v[3], v[4], v[9], v[14]);
+    }
+
+    for (int i = 0; i < 8; i++) {
+        Store4BE(out, i * 8, Xor(K(BLAKE512_IV[i]), Xor(v[i], v[i + 8])));
+    }
+}
+
+void Keccak512_4way(unsigned char* const out[4], const unsigned char* const in[4], size_t len)
+{
+    static const size_t RATE = 72;
+
+    __m256i a[25];
+    for (int i = 0; i < 25; i++) {
+        a[i] = _mm256_setzero_si256();
+    }
+
+    size_t pos = 0;
+    for (; pos + RATE <= len; pos += RATE) {
+        for (size_t i = 0; i < RATE / 8; i++) {
+            a[i] = Xor(a[i], Load4(in, pos + i * 8));
+        }
+        KeccakF(a);
+    }
+
+    // Original Keccak padding (0x01 ... 0x80), as used by sph_keccak
+    alignas(32) unsigned char block[4][RATE];
+    const unsigned char* pblock[4];
+    for (int i = 0; i < 4; i++) {
+        memset(block[i], 0, RATE);
+        memcpy(block[i], in[i] + pos, len - pos);
+        block[i][len - pos] = 0x01;
+        block[i][RATE - 1] |= 0x80;
+        pblock[i] = block[i];
+    }
+    for (size_t i = 0; i < RATE / 8; i++) {
+        a[i] = Xor(a[i], Load4(pblock, i * 8));
+    }
+    KeccakF(a);
+
+    for (int i = 0; i < 8; i++) {
+        Store4(out, i * 8, a[i]);
+    }
+}
+
+} // namespace x16r_avx2
+
+#endif
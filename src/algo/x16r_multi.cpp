@@ -0,0 +1,198 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "x16r_multi.h"
+
+#include "sph_blake.h"
+#include "sph_echo.h"
+#include "sph_keccak.h"
+#include "sph_shavite.h"
+
+#include <crypto/common.h>
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+namespace x16r_avx2
+{
+void Blake512_4way(unsigned char* const out[4], const unsigned char* const in[4], size_t len);
+void Keccak512_4way(unsigned char* const out[4], const unsigned char* const in[4], size_t len);
+}
+
+namespace x16r_aesni
+{
+void Echo512_4way(unsigned char* const out[4], const unsigned char* const in[4], size_t len);
+void Shavite512_4way(unsigned char* const out[4], const unsigned char* const in[4], size_t len);
+}
+
+namespace
+{
+// Algorithm positions in the X16R list
+const int X16R_BLAKE = 0;
+const int X16R_KECCAK = 4;
+const int X16R_SHAVITE = 8;
+const int X16R_ECHO = 10;
+
+// The 4-way BLAKE-512 kernel only handles messages that fit in one block
+const size_t BLAKE512_MAX_SINGLE_BLOCK = 111;
+
+X16RKernelFn Blake512Multi = nullptr;
+X16RKernelFn Keccak512Multi = nullptr;
+X16RKernelFn Shavite512Multi = nullptr;
+X16RKernelFn Echo512Multi = nullptr;
+
+typedef void (*ScalarInitFn)(void*);
+typedef void (*ScalarUpdateFn)(void*, const void*, size_t);
+typedef void (*ScalarCloseFn)(void*, void*);
+
+/** Compare a kernel with the scalar sph code over a range of message lengths */
+bool SelfTestKernel(X16RKernelFn kernel, size_t maxLen, void* ctx, ScalarInitFn init, ScalarUpdateFn update, ScalarCloseFn close)
+{
+    unsigned char in[X16R_KERNEL_LANES][256];
+    unsigned char out[X16R_KERNEL_LANES][64];
+    const unsigned char* pin[X16R_KERNEL_LANES];
+    unsigned char* pout[X16R_KERNEL_LANES];
+
+    for (size_t i = 0; i < X16R_KERNEL_LANES; i++) {
+        for (size_t j = 0; j < sizeof(in[i]); j++) {
+            in[i][j] = (unsigned char)(i * 131 + j * 7 + 1);
+        }
+        pin[i] = in[i];
+        pout[i] = out[i];
+    }
+
+    static const size_t lengths[] = {0, 1, 63, 64, 71, 72, 80, 111, 144, 200};
+    for (size_t len : lengths) {
+        if (len > maxLen) continue;
+        kernel(pout, pin, len);
+        for (size_t i = 0; i < X16R_KERNEL_LANES; i++) {
+            unsigned char ref[64];
+            init(ctx);
+            update(ctx, in[i], len);
+            close(ctx, ref);
+            if (memcmp(ref, out[i], 64)) return false;
+        }
+    }
+    return true;
+}
+
+bool SelfTest()
+{
+    if (Blake512Multi) {
+        sph_blake512_context ctx;
+        if (!SelfTestKernel(Blake512Multi, BLAKE512_MAX_SINGLE_BLOCK, &ctx, sph_blake512_init, sph_blake512, sph_blake512_close)) return false;
+    }
+    if (Keccak512Multi) {
+        sph_keccak512_context ctx;
+        if (!SelfTestKernel(Keccak512Multi, 256, &ctx, sph_keccak512_init, sph_keccak512, sph_keccak512_close)) return false;
+    }
+    if (Shavite512Multi) {
+        sph_shavite512_context ctx;
+        if (!SelfTestKernel(Shavite512Multi, 256, &ctx, sph_shavite512_init, sph_shavite512, sph_shavite512_close)) return false;
+    }
+    if (Echo512Multi) {
+        sph_echo512_context ctx;
+        if (!SelfTestKernel(Echo512Multi, 256, &ctx, sph_echo512_init, sph_echo512, sph_echo512_close)) return false;
+    }
+    return true;
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+// We can't use cpuid.h's __get_cpuid as it does not support subleafs.
+void inline cpuid(uint32_t leaf, uint32_t subleaf, uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
+{
+#ifdef __GNUC__
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+#else
+  __asm__ ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "0"(leaf), "2"(subleaf));
+#endif
+}
+
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+} // namespace
+
+std::string X16RMultiAutoDetect()
+{
+    std::string ret = "standard";
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+    bool have_xsave = false;
+    bool have_avx = false;
+    bool have_avx2 = false;
+    bool enabled_avx = false;
+    bool have_ssse3 = false;
+    bool have_aesni = false;
+
+    (void)AVXEnabled;
+    (void)have_avx;
+    (void)have_avx2;
+    (void)enabled_avx;
+    (void)have_ssse3;
+    (void)have_aesni;
+
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, 0, eax, ebx, ecx, edx);
+    have_xsave = (ecx >> 27) & 1;
+    have_avx = (ecx >> 28) & 1;
+    have_ssse3 = (ecx >> 9) & 1;
+    have_aesni = (ecx >> 25) & 1;
+    if (have_xsave && have_avx) {
+        enabled_avx = AVXEnabled();
+    }
+    cpuid(0, 0, eax, ebx, ecx, edx);
+    if (eax >= 7) {
+        cpuid(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = (ebx >> 5) & 1;
+    }
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx2 && have_avx && enabled_avx) {
+        Blake512Multi = x16r_avx2::Blake512_4way;
+        Keccak512Multi = x16r_avx2::Keccak512_4way;
+        ret = "avx2(4way blake512,keccak512)";
+    }
+#endif
+
+#if defined(ENABLE_AESNI) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_aesni && have_ssse3) {
+        Shavite512Multi = x16r_aesni::Shavite512_4way;
+        Echo512Multi = x16r_aesni::Echo512_4way;
+        if (ret == "standard") {
+            ret = "aesni(shavite512,echo512)";
+        } else {
+            ret += ",aesni(shavite512,echo512)";
+        }
+    }
+#endif
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
+
+X16RKernelFn X16RGetKernel(int nAlgo, size_t len)
+{
+    switch (nAlgo) {
+        case X16R_BLAKE:
+            return len <= BLAKE512_MAX_SINGLE_BLOCK ? Blake512Multi : nullptr;
+        case X16R_KECCAK:
+            return Keccak512Multi;
+        case X16R_SHAVITE:
+            return Shavite512Multi;
+        case X16R_ECHO:
+            return Echo512Multi;
+        default:
+            return nullptr;
+    }
+}
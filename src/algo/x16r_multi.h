@@ -0,0 +1,27 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PIGEON_ALGO_X16R_MULTI_H
+#define PIGEON_ALGO_X16R_MULTI_H
+
+#include <stddef.h>
+#include <string>
+
+/** Number of independent messages processed by one multi-buffer kernel call */
+static const size_t X16R_KERNEL_LANES = 4;
+
+/** Hash X16R_KERNEL_LANES messages of len bytes each into 64-byte outputs */
+typedef void (*X16RKernelFn)(unsigned char* const out[X16R_KERNEL_LANES], const unsigned char* const in[X16R_KERNEL_LANES], size_t len);
+
+/** Autodetect the multi-buffer X16R kernels supported by this CPU.
+ *  Returns the names of the selected implementations.
+ */
+std::string X16RMultiAutoDetect();
+
+/** Returns the multi-buffer kernel for X16R algorithm nAlgo (0-15) at
+ *  message length len, or nullptr if only the scalar sph code applies.
+ */
+X16RKernelFn X16RGetKernel(int nAlgo, size_t len);
+
+#endif // PIGEON_ALGO_X16R_MULTI_H
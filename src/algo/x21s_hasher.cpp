@@ -0,0 +1,276 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "x21s_hasher.h"
+#include "x16r_multi.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+
+// The selection nibbles are the last 16 hex digits of the previous block hash
+#define X16_FIRST_SELECTION_NIBBLE 48
+
+CX21SHasher::CX21SHasher() : fOrderValid(false)
+{
+    memset(order, 0, sizeof(order));
+}
+
+void CX21SHasher::GetAlgoOrder(const uint256& hashPrevBlock, uint8_t orderOut[X16_ALGO_COUNT])
+{
+    for (int i = 0; i < X16_ALGO_COUNT; i++) {
+        orderOut[i] = i;
+    }
+
+    // X16S: for every selection nibble, move the algorithm at that position
+    // to the front of the list
+    for (int i = 0; i < X16_ALGO_COUNT; i++) {
+        int offset = hashPrevBlock.GetNibble(X16_FIRST_SELECTION_NIBBLE + i);
+        uint8_t algo = orderOut[offset];
+        memmove(orderOut + 1, orderOut, offset);
+        orderOut[0] = algo;
+    }
+}
+
+void CX21SHasher::UpdateAlgoOrder(const uint256& hashPrevBlock)
+{
+    if (fOrderValid && hashOrderPrevBlock == hashPrevBlock) {
+        return;
+    }
+    GetAlgoOrder(hashPrevBlock, order);
+    hashOrderPrevBlock = hashPrevBlock;
+    fOrderValid = true;
+}
+
+void CX21SHasher::HashAlgo(int nAlgo, const void* data, size_t len, void* out)
+{
+    switch (nAlgo) {
+        case 0:
+            sph_blake512_init(&ctx_blake);
+            sph_blake512(&ctx_blake, data, len);
+            sph_blake512_close(&ctx_blake, out);
+            break;
+        case 1:
+            sph_bmw512_init(&ctx_bmw);
+            sph_bmw512(&ctx_bmw, data, len);
+            sph_bmw512_close(&ctx_bmw, out);
+            break;
+        case 2:
+            sph_groestl512_init(&ctx_groestl);
+            sph_groestl512(&ctx_groestl, data, len);
+            sph_groestl512_close(&ctx_groestl, out);
+            break;
+        case 3:
+            sph_jh512_init(&ctx_jh);
+            sph_jh512(&ctx_jh, data, len);
+            sph_jh512_close(&ctx_jh, out);
+            break;
+        case 4:
+            sph_keccak512_init(&ctx_keccak);
+            sph_keccak512(&ctx_keccak, data, len);
+            sph_keccak512_close(&ctx_keccak, out);
+            break;
+        case 5:
+            sph_skein512_init(&ctx_skein);
+            sph_skein512(&ctx_skein, data, len);
+            sph_skein512_close(&ctx_skein, out);
+            break;
+        case 6:
+            sph_luffa512_init(&ctx_luffa);
+            sph_luffa512(&ctx_luffa, data, len);
+            sph_luffa512_close(&ctx_luffa, out);
+            break;
+        case 7:
+            sph_cubehash512_init(&ctx_cubehash);
+            sph_cubehash512(&ctx_cubehash, data, len);
+            sph_cubehash512_close(&ctx_cubehash, out);
+            break;
+        case 8:
+            sph_shavite512_init(&ctx_shavite);
+            sph_shavite512(&ctx_shavite, data, len);
+            sph_shavite512_close(&ctx_shavite, out);
+            break;
+        case 9:
+            sph_simd512_init(&ctx_simd);
+            sph_simd512(&ctx_simd, data, len);
+            sph_simd512_close(&ctx_simd, out);
+            break;
+        case 10:
+            sph_echo512_init(&ctx_echo);
+            sph_echo512(&ctx_echo, data, len);
+            sph_echo512_close(&ctx_echo, out);
+            break;
+        case 11:
+            sph_hamsi512_init(&ctx_hamsi);
+            sph_hamsi512(&ctx_hamsi, data, len);
+            sph_hamsi512_close(&ctx_hamsi, out);
+            break;
+        case 12:
+            sph_fugue512_init(&ctx_fugue);
+            sph_fugue512(&ctx_fugue, data, len);
+            sph_fugue512_close(&ctx_fugue, out);
+            break;
+        case 13:
+            sph_shabal512_init(&ctx_shabal);
+            sph_shabal512(&ctx_shabal, data, len);
+            sph_shabal512_close(&ctx_shabal, out);
+            break;
+        case 14:
+            sph_whirlpool_init(&ctx_whirlpool);
+            sph_whirlpool(&ctx_whirlpool, data, len);
+            sph_whirlpool_close(&ctx_whirlpool, out);
+            break;
+        case 15:
+            sph_sha512_init(&ctx_sha512);
+            sph_sha512(&ctx_sha512, data, len);
+            sph_sha512_close(&ctx_sha512, out);
+            break;
+    }
+}
+
+void CX21SHasher::HashChain(const void* data, size_t len, const uint256& hashPrevBlock, uint512& hashOut)
+{
+    static unsigned char pblank[1];
+    uint512 hash[2];
+
+    UpdateAlgoOrder(hashPrevBlock);
+
+    const void* toHash = len == 0 ? pblank : data;
+    size_t lenToHash = len;
+    for (int i = 0; i < X16_ALGO_COUNT; i++) {
+        // alternate between the two buffers, the last round lands in hash[1]
+        void* out = &hash[i & 1];
+        HashAlgo(order[i], toHash, lenToHash, out);
+        toHash = out;
+        lenToHash = 64;
+    }
+
+    hashOut = hash[(X16_ALGO_COUNT - 1) & 1];
+}
+
+uint256 CX21SHasher::HashX16R(const void* data, size_t len, const uint256& hashPrevBlock)
+{
+    uint512 hash;
+    HashChain(data, len, hashPrevBlock, hash);
+    return hash.trim256();
+}
+
+uint256 CX21SHasher::HashX21STail(uint512& hash)
+{
+    sph_haval256_5_init(&ctx_haval);
+    sph_haval256_5(&ctx_haval, static_cast<const void*>(&hash), 64);
+    sph_haval256_5_close(&ctx_haval, static_cast<void*>(&hash));
+
+    sph_tiger_init(&ctx_tiger);
+    sph_tiger(&ctx_tiger, static_cast<const void*>(&hash), 64);
+    sph_tiger_close(&ctx_tiger, static_cast<void*>(&hash));
+
+    LYRA2_matrix(lyra2Matrix, static_cast<void*>(&hash), 32, static_cast<const void*>(&hash), 32, static_cast<const void*>(&hash), 32, 1, LYRA2_ROWS, LYRA2_COLS);
+
+    sph_gost512_init(&ctx_gost);
+    sph_gost512(&ctx_gost, static_cast<const void*>(&hash), 64);
+    sph_gost512_close(&ctx_gost, static_cast<void*>(&hash));
+
+    sph_sha256_init(&ctx_sha);
+    sph_sha256(&ctx_sha, static_cast<const void*>(&hash), 64);
+    sph_sha256_close(&ctx_sha, static_cast<void*>(&hash));
+
+    return hash.trim256();
+}
+
+uint256 CX21SHasher::HashX21S(const void* data, size_t len, const uint256& hashPrevBlock)
+{
+    uint512 hash;
+    HashChain(data, len, hashPrevBlock, hash);
+    return HashX21STail(hash);
+}
+
+void CX21SHasher::HashChainMulti(const unsigned char* const data[], size_t len, const uint256 hashPrevBlock[], uint512 hashOut[], size_t nLanes)
+{
+    static unsigned char pblank[1];
+    uint8_t orders[X16R_MAX_LANES][X16_ALGO_COUNT];
+    uint512 hash[2][X16R_MAX_LANES];
+    const unsigned char* toHash[X16R_MAX_LANES];
+
+    assert(nLanes <= X16R_MAX_LANES);
+    for (size_t l = 0; l < nLanes; l++) {
+        UpdateAlgoOrder(hashPrevBlock[l]);
+        memcpy(orders[l], order, sizeof(order));
+        toHash[l] = len == 0 ? pblank : data[l];
+    }
+
+    size_t lenToHash = len;
+    for (int i = 0; i < X16_ALGO_COUNT; i++) {
+        unsigned char* out[X16R_MAX_LANES];
+        for (size_t l = 0; l < nLanes; l++) {
+            out[l] = hash[i & 1][l].begin();
+        }
+
+        // every lane runs its own algorithm at this step: batch the lanes
+        // that agree through the multi-buffer kernel, the rest run scalar
+        for (int nAlgo = 0; nAlgo < X16_ALGO_COUNT; nAlgo++) {
+            size_t group[X16R_MAX_LANES];
+            size_t nGroup = 0;
+            for (size_t l = 0; l < nLanes; l++) {
+                if (orders[l][i] == nAlgo) group[nGroup++] = l;
+            }
+
+            size_t g = 0;
+            X16RKernelFn kernel = X16RGetKernel(nAlgo, lenToHash);
+            if (kernel) {
+                for (; g + X16R_KERNEL_LANES <= nGroup; g += X16R_KERNEL_LANES) {
+                    const unsigned char* kin[X16R_KERNEL_LANES];
+                    unsigned char* kout[X16R_KERNEL_LANES];
+                    for (size_t k = 0; k < X16R_KERNEL_LANES; k++) {
+                        kin[k] = toHash[group[g + k]];
+                        kout[k] = out[group[g + k]];
+                    }
+                    kernel(kout, kin, lenToHash);
+                }
+            }
+            for (; g < nGroup; g++) {
+                HashAlgo(nAlgo, toHash[group[g]], lenToHash, out[group[g]]);
+            }
+        }
+
+        for (size_t l = 0; l < nLanes; l++) {
+            toHash[l] = out[l];
+        }
+        lenToHash = 64;
+    }
+
+    for (size_t l = 0; l < nLanes; l++) {
+        hashOut[l] = hash[(X16_ALGO_COUNT - 1) & 1][l];
+    }
+}
+
+void CX21SHasher::HashX16RMulti(const unsigned char* const data[], size_t len, const uint256 hashPrevBlock[], uint256 hashOut[], size_t nLanes)
+{
+    uint512 hash[X16R_MAX_LANES];
+    for (size_t first = 0; first < nLanes; first += X16R_MAX_LANES) {
+        size_t n = std::min(nLanes - first, X16R_MAX_LANES);
+        HashChainMulti(data + first, len, hashPrevBlock + first, hash, n);
+        for (size_t l = 0; l < n; l++) {
+            hashOut[first + l] = hash[l].trim256();
+        }
+    }
+}
+
+void CX21SHasher::HashX21SMulti(const unsigned char* const data[], size_t len, const uint256 hashPrevBlock[], uint256 hashOut[], size_t nLanes)
+{
+    uint512 hash[X16R_MAX_LANES];
+    for (size_t first = 0; first < nLanes; first += X16R_MAX_LANES) {
+        size_t n = std::min(nLanes - first, X16R_MAX_LANES);
+        HashChainMulti(data + first, len, hashPrevBlock + first, hash, n);
+        for (size_t l = 0; l < n; l++) {
+            hashOut[first + l] = HashX21STail(hash[l]);
+        }
+    }
+}
+
+CX21SHasher& GetThreadX21SHasher()
+{
+    static thread_local CX21SHasher hasher;
+    return hasher;
+}
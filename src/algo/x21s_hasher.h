@@ -0,0 +1,115 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PIGEON_ALGO_X21S_HASHER_H
+#define PIGEON_ALGO_X21S_HASHER_H
+
+#include <uint256.h>
+
+#include "sph_blake.h"
+#include "sph_bmw.h"
+#include "sph_groestl.h"
+#include "sph_jh.h"
+#include "sph_keccak.h"
+#include "sph_skein.h"
+#include "sph_luffa.h"
+#include "sph_cubehash.h"
+#include "sph_shavite.h"
+#include "sph_simd.h"
+#include "sph_echo.h"
+#include "sph_hamsi.h"
+#include "sph_fugue.h"
+#include "sph_shabal.h"
+#include "sph_whirlpool.h"
+#include "sph_sha2.h"
+#include "sph_haval.h"
+#include "sph_tiger.h"
+#include "gost_streebog.h"
+#include "lyra2.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Number of chained algorithms selected by the previous block hash */
+static const int X16_ALGO_COUNT = 16;
+
+/** Number of lanes hashed together by the multi-lane interface */
+static const size_t X16R_MAX_LANES = 8;
+
+/**
+ * Reusable X16R/X21S hashing engine.
+ *
+ * Produces exactly the same results as HashX16R() and HashX21S() from
+ * algo/hashx21s.h, but without any heap allocation or string handling:
+ * the X16S algorithm order is computed directly from the nibbles of the
+ * previous block hash (and memoized for the last one seen), the sph
+ * contexts are kept as members and LYRA2 runs on a preallocated matrix.
+ *
+ * An instance is not thread safe. Use GetThreadX21SHasher() to get one
+ * that is private to the calling thread.
+ */
+class CX21SHasher
+{
+public:
+    CX21SHasher();
+
+    /** Compute the X16S shuffled algorithm order from the last 16 nibbles of hashPrevBlock */
+    static void GetAlgoOrder(const uint256& hashPrevBlock, uint8_t orderOut[X16_ALGO_COUNT]);
+
+    uint256 HashX16R(const void* data, size_t len, const uint256& hashPrevBlock);
+    uint256 HashX21S(const void* data, size_t len, const uint256& hashPrevBlock);
+
+    /**
+     * Hash nLanes independent messages of len bytes each, lane i being
+     * chained by hashPrevBlock[i]. At every step the lanes that run the same
+     * algorithm go through the multi-buffer kernels selected by
+     * X16RMultiAutoDetect(). Only lanes with the same hashPrevBlock are sure
+     * to agree at every step, like the nonces of one block template.
+     */
+    void HashX16RMulti(const unsigned char* const data[], size_t len, const uint256 hashPrevBlock[], uint256 hashOut[], size_t nLanes);
+    void HashX21SMulti(const unsigned char* const data[], size_t len, const uint256 hashPrevBlock[], uint256 hashOut[], size_t nLanes);
+
+private:
+    static const uint64_t LYRA2_ROWS = 4;
+    static const uint64_t LYRA2_COLS = 4;
+
+    void UpdateAlgoOrder(const uint256& hashPrevBlock);
+    void HashAlgo(int nAlgo, const void* data, size_t len, void* out);
+    void HashChain(const void* data, size_t len, const uint256& hashPrevBlock, uint512& hashOut);
+    void HashChainMulti(const unsigned char* const data[], size_t len, const uint256 hashPrevBlock[], uint512 hashOut[], size_t nLanes);
+    uint256 HashX21STail(uint512& hash);
+
+    // last previous block hash seen and the order derived from it
+    uint256 hashOrderPrevBlock;
+    bool fOrderValid;
+    uint8_t order[X16_ALGO_COUNT];
+
+    sph_blake512_context      ctx_blake;
+    sph_bmw512_context        ctx_bmw;
+    sph_groestl512_context    ctx_groestl;
+    sph_jh512_context         ctx_jh;
+    sph_keccak512_context     ctx_keccak;
+    sph_skein512_context      ctx_skein;
+    sph_luffa512_context      ctx_luffa;
+    sph_cubehash512_context   ctx_cubehash;
+    sph_shavite512_context    ctx_shavite;
+    sph_simd512_context       ctx_simd;
+    sph_echo512_context       ctx_echo;
+    sph_hamsi512_context      ctx_hamsi;
+    sph_fugue512_context      ctx_fugue;
+    sph_shabal512_context     ctx_shabal;
+    sph_whirlpool_context     ctx_whirlpool;
+    sph_sha512_context        ctx_sha512;
+    sph_haval256_5_context    ctx_haval;
+    sph_tiger_context         ctx_tiger;
+    sph_gost512_context       ctx_gost;
+    sph_sha256_context        ctx_sha;
+
+    uint64_t lyra2Matrix[LYRA2_ROWS * LYRA2_COLS * BLOCK_LEN_INT64];
+};
+
+/** Returns the hasher instance owned by the calling thread */
+CX21SHasher& GetThreadX21SHasher();
+
+#endif // PIGEON_ALGO_X21S_HASHER_H
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <bench/bench.h>
+#include <algo/x16r_multi.h>
 
 #include <crypto/sha256.h>
 #include <key.h>
@@ -50,6 +51,7 @@ main(int argc, char** argv)
     }
 
     SHA256AutoDetect();
+    X16RMultiAutoDetect();
 
     RegisterPrettySignalHandlers();
     RegisterPrettyTerminateHander();
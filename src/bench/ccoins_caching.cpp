@@ -5,8 +5,11 @@
 #include <bench/bench.h>
 #include <coins.h>
 #include <policy/policy.h>
+#include <random.h>
 #include <wallet/crypter.h>
 
+#include <algorithm>
+#include <unordered_map>
 #include <vector>
 
 // FIXME: Dedup with SetupDummyInputs in test/transaction_tests.cpp.
@@ -85,3 +88,67 @@ static void CCoinsCaching(benchmark::State& state)
 }
 
 BENCHMARK(CCoinsCaching, 170 * 1000);
+
+// The node based map CCoinsMap was before it kept its entries in a pool
+typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> UnorderedCoinsMap;
+
+static const int COINS_MAP_ENTRIES = 100000;
+
+static std::vector<COutPoint> RandomOutpoints(int n)
+{
+    FastRandomContext rng(true);
+    std::vector<COutPoint> outpoints;
+    outpoints.reserve(n);
+    for (int i = 0; i < n; i++) {
+        outpoints.emplace_back(rng.rand256(), i % 4);
+    }
+    return outpoints;
+}
+
+template <typename Map>
+static void FillCoinsMap(Map& map, const std::vector<COutPoint>& outpoints)
+{
+    CScript script = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0) << OP_EQUALVERIFY << OP_CHECKSIG;
+    for (const COutPoint& outpoint : outpoints) {
+        CCoinsCacheEntry& entry = map.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::tuple<>()).first->second;
+        entry.coin = Coin(CTxOut(1, script), 1, false);
+        entry.flags = CCoinsCacheEntry::DIRTY;
+    }
+}
+
+// Fill a coins map
+template <typename Map>
+static void CoinsMapFill(benchmark::State& state)
+{
+    const std::vector<COutPoint> outpoints = RandomOutpoints(COINS_MAP_ENTRIES);
+    while (state.KeepRunning()) {
+        Map map;
+        FillCoinsMap(map, outpoints);
+    }
+}
+
+// Look up every coin of a filled coins map once
+template <typename Map>
+static void CoinsMapLookup(benchmark::State& state)
+{
+    std::vector<COutPoint> outpoints = RandomOutpoints(COINS_MAP_ENTRIES);
+    Map map;
+    FillCoinsMap(map, outpoints);
+    FastRandomContext rng(true);
+    std::random_shuffle(outpoints.begin(), outpoints.end(), [&rng](int n) { return rng.randrange(n); });
+    while (state.KeepRunning()) {
+        for (const COutPoint& outpoint : outpoints) {
+            assert(map.find(outpoint) != map.end());
+        }
+    }
+}
+
+static void CCoinsMapFill(benchmark::State& state) { CoinsMapFill<CCoinsMap>(state); }
+static void UnorderedCoinsMapFill(benchmark::State& state) { CoinsMapFill<UnorderedCoinsMap>(state); }
+static void CCoinsMapLookup(benchmark::State& state) { CoinsMapLookup<CCoinsMap>(state); }
+static void UnorderedCoinsMapLookup(benchmark::State& state) { CoinsMapLookup<UnorderedCoinsMap>(state); }
+
+BENCHMARK(CCoinsMapFill, 20);
+BENCHMARK(UnorderedCoinsMapFill, 20);
+BENCHMARK(CCoinsMapLookup, 50);
+BENCHMARK(UnorderedCoinsMapLookup, 50);
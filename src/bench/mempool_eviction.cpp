@@ -4,21 +4,27 @@
 
 #include <bench/bench.h>
 #include <policy/policy.h>
+#include <random.h>
 #include <txmempool.h>
 
 #include <list>
 #include <vector>
 
-static void AddTx(const CTransaction& tx, const CAmount& nFee, CTxMemPool& pool)
+static void AddTx(const CTransactionRef& tx, const CAmount& nFee, CTxMemPool& pool)
 {
     int64_t nTime = 0;
     unsigned int nHeight = 1;
     bool spendsCoinbase = false;
     unsigned int sigOpCost = 4;
     LockPoints lp;
-    pool.addUnchecked(tx.GetHash(), CTxMemPoolEntry(
-                                        MakeTransactionRef(tx), nFee, nTime, nHeight,
-                                        spendsCoinbase, sigOpCost, lp));
+    pool.addUnchecked(tx->GetHash(), CTxMemPoolEntry(
+                                         tx, nFee, nTime, nHeight,
+                                         spendsCoinbase, sigOpCost, lp));
+}
+
+static void AddTx(const CTransaction& tx, const CAmount& nFee, CTxMemPool& pool)
+{
+    AddTx(MakeTransactionRef(tx), nFee, pool);
 }
 
 // Right now this is only testing eviction performance in an extremely small
@@ -112,3 +118,78 @@ static void MempoolEviction(benchmark::State& state)
 }
 
 BENCHMARK(MempoolEviction, 41000);
+
+// Chains as deep as the default ancestor and descendant limits allow
+static const size_t MEMPOOL_CHAIN_DEPTH = 25;
+static const size_t MEMPOOL_BENCH_USAGE = 300 * 1000 * 1000;
+
+typedef std::vector<std::pair<CTransactionRef, CAmount>> TxChain;
+
+static TxChain CreateChain(FastRandomContext& rng)
+{
+    TxChain chain;
+    COutPoint prevout(rng.rand256(), 0);
+    for (size_t i = 0; i < MEMPOOL_CHAIN_DEPTH; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = prevout;
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = 10 * COIN;
+        chain.emplace_back(MakeTransactionRef(tx), 1000 + rng.randrange(10000));
+        prevout = COutPoint(chain.back().first->GetHash(), 0);
+    }
+    return chain;
+}
+
+// Keeps a mempool of 300MB of deep chains at its size limit. Each iteration
+// adds a chain, which makes the mempool evict the packages with the lowest
+// descendant feerate, and then confirms half of another chain in a block and
+// removes the rest of it.
+static void MempoolEvictionDeepChains(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    CTxMemPool pool;
+    std::vector<TxChain> chains;
+    while (pool.DynamicMemoryUsage() < MEMPOOL_BENCH_USAGE) {
+        chains.push_back(CreateChain(rng));
+        for (const auto& tx : chains.back()) {
+            AddTx(tx.first, tx.second, pool);
+        }
+    }
+    // Chains that are not in the mempool yet
+    const size_t nInitialChains = chains.size();
+    for (size_t i = 0; i < nInitialChains / 10; i++) {
+        chains.push_back(CreateChain(rng));
+    }
+
+    size_t nIteration = 0;
+    while (state.KeepRunning()) {
+        LOCK(pool.cs);
+        // Add what is missing of the chain, an evicted chain lost a suffix
+        const TxChain& added = chains[(nInitialChains + nIteration) % chains.size()];
+        for (const auto& tx : added) {
+            if (!pool.exists(tx.first->GetHash())) {
+                AddTx(tx.first, tx.second, pool);
+            }
+        }
+        pool.TrimToSize(MEMPOOL_BENCH_USAGE);
+
+        // removeForBlock needs the masternode list of a chain tip, so the
+        // block transactions are removed the way it does it
+        const TxChain& confirmed = chains[nIteration % chains.size()];
+        CTxMemPool::setEntries stage;
+        for (size_t i = 0; i < confirmed.size() / 2; i++) {
+            CTxMemPool::txiter it = pool.mapTx.find(confirmed[i].first->GetHash());
+            if (it != pool.mapTx.end()) {
+                stage.insert(it);
+            }
+        }
+        pool.RemoveStaged(stage, true, MemPoolRemovalReason::BLOCK);
+        pool.removeRecursive(*confirmed[confirmed.size() / 2].first);
+        nIteration++;
+    }
+}
+
+BENCHMARK(MempoolEvictionDeepChains, 2000);
@@ -0,0 +1,160 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <algo/hashx21s.h>
+#include <algo/x21s_hasher.h>
+#include <uint256.h>
+
+#include <vector>
+
+/**
+ * Previous block hashes taken from the chain parameters (genesis blocks,
+ * checkpoints, assumevalid). Their last 16 nibbles give different X16S
+ * algorithm orders, so the X16R/X21S benchmarks are not tied to the
+ * speed of one particular order.
+ */
+static const char* const PREV_BLOCK_HASHES[] = {
+    "000000f049bef9fec0179131874c54c76c0ff59f695db30a4f0da52072c99492",
+    "00000000002ccebf8a0c2a66ae6b4e03ba0e0247b467fbf68b6fd13d93ebf84e",
+    "000000000023d0c447406c5f05c4f51c70ec3faa5fe3943c1b3136785ebd7cc0",
+    "000008ebb1db2598e897d17275285767717c6acfeac4c73def49fbea1ddcbcb6",
+    "000007a41d0ce1278c041c41ccf4a23c7d95df64b3604935a536778265985338",
+    "000008ca1832a4baf228eb1553c03d3a2c8e02399550dd6ea8d65cec3ef23d2e",
+    "06c9571437ed1ebb274fd5eb4ebde0ea1ccef0b09ce87478a2b16238b65e38d1",
+    "2eb7cd376d538ed7f335b1d9c4ce29f3678afd94fbddc1263954ce39976bfba5",
+};
+
+static std::vector<uint256> GetPrevBlockHashes()
+{
+    std::vector<uint256> ret;
+    for (const char* hash : PREV_BLOCK_HASHES) {
+        ret.push_back(uint256S(hash));
+    }
+    return ret;
+}
+
+/* One sph primitive on a single message of len bytes */
+template <void (*Init)(void*), void (*Update)(void*, const void*, size_t), void (*Close)(void*, void*), typename Context>
+static void SphHash(benchmark::State& state, size_t len)
+{
+    Context ctx;
+    std::vector<uint8_t> in(len, 0);
+    uint8_t hash[64];
+    while (state.KeepRunning()) {
+        Init(&ctx);
+        Update(&ctx, in.data(), in.size());
+        Close(&ctx, hash);
+        in[0] = hash[0];
+    }
+}
+
+#define SPH_BENCHMARK(name, func, context, num_iters_for_one_second) \
+    static void HASH_##name##_0064b(benchmark::State& state) \
+    { \
+        SphHash<func##_init, func, func##_close, context>(state, 64); \
+    } \
+    static void HASH_##name##_0080b(benchmark::State& state) \
+    { \
+        SphHash<func##_init, func, func##_close, context>(state, 80); \
+    } \
+    BENCHMARK(HASH_##name##_0064b, num_iters_for_one_second); \
+    BENCHMARK(HASH_##name##_0080b, num_iters_for_one_second)
+
+SPH_BENCHMARK(BLAKE512, sph_blake512, sph_blake512_context, 1800 * 1000);
+SPH_BENCHMARK(BMW512, sph_bmw512, sph_bmw512_context, 1500 * 1000);
+SPH_BENCHMARK(GROESTL512, sph_groestl512, sph_groestl512_context, 230 * 1000);
+SPH_BENCHMARK(JH512, sph_jh512, sph_jh512_context, 190 * 1000);
+SPH_BENCHMARK(KECCAK512, sph_keccak512, sph_keccak512_context, 450 * 1000);
+SPH_BENCHMARK(SKEIN512, sph_skein512, sph_skein512_context, 1400 * 1000);
+SPH_BENCHMARK(LUFFA512, sph_luffa512, sph_luffa512_context, 300 * 1000);
+SPH_BENCHMARK(CUBEHASH512, sph_cubehash512, sph_cubehash512_context, 120 * 1000);
+SPH_BENCHMARK(SHAVITE512, sph_shavite512, sph_shavite512_context, 570 * 1000);
+SPH_BENCHMARK(SIMD512, sph_simd512, sph_simd512_context, 210 * 1000);
+SPH_BENCHMARK(ECHO512, sph_echo512, sph_echo512_context, 280 * 1000);
+SPH_BENCHMARK(HAMSI512, sph_hamsi512, sph_hamsi512_context, 130 * 1000);
+SPH_BENCHMARK(FUGUE512, sph_fugue512, sph_fugue512_context, 180 * 1000);
+SPH_BENCHMARK(SHABAL512, sph_shabal512, sph_shabal512_context, 880 * 1000);
+SPH_BENCHMARK(WHIRLPOOL, sph_whirlpool, sph_whirlpool_context, 690 * 1000);
+SPH_BENCHMARK(SPH_SHA512, sph_sha512, sph_sha512_context, 1800 * 1000);
+SPH_BENCHMARK(HAVAL256_5, sph_haval256_5, sph_haval256_5_context, 1700 * 1000);
+SPH_BENCHMARK(TIGER, sph_tiger, sph_tiger_context, 3000 * 1000);
+SPH_BENCHMARK(GOST512, sph_gost512, sph_gost512_context, 230 * 1000);
+SPH_BENCHMARK(SPH_SHA256, sph_sha256, sph_sha256_context, 860 * 1000);
+
+/* LYRA2 with the X21S parameters: 32 byte key, one iteration, 4x4 matrix */
+static void HASH_LYRA2_X21S(benchmark::State& state)
+{
+    std::vector<uint64_t> matrix(LYRA2_MATRIX_BYTES(4, 4) / sizeof(uint64_t));
+    uint8_t hash[32] = {};
+    while (state.KeepRunning()) {
+        LYRA2_matrix(matrix.data(), hash, 32, hash, 32, hash, 32, 1, 4, 4);
+    }
+}
+
+/* The reference implementations from algo/hashx21s.h */
+static void HASH_X16R_0080b(benchmark::State& state)
+{
+    const std::vector<uint256> prevHashes = GetPrevBlockHashes();
+    std::vector<uint8_t> in(80, 0);
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        const uint256 hash = HashX16R(in.data(), in.data() + in.size(), prevHashes[i++ % prevHashes.size()]);
+        in[0] = *hash.begin();
+    }
+}
+
+static void HASH_X21S_0080b(benchmark::State& state)
+{
+    const std::vector<uint256> prevHashes = GetPrevBlockHashes();
+    std::vector<uint8_t> in(80, 0);
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        const uint256 hash = HashX21S(in.data(), in.data() + in.size(), prevHashes[i++ % prevHashes.size()]);
+        in[0] = *hash.begin();
+    }
+}
+
+/* The allocation-free engine used by CBlockHeader::GetHash() */
+static void HASH_X21S_Hasher_0080b(benchmark::State& state)
+{
+    const std::vector<uint256> prevHashes = GetPrevBlockHashes();
+    CX21SHasher hasher;
+    std::vector<uint8_t> in(80, 0);
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        const uint256 hash = hasher.HashX21S(in.data(), in.size(), prevHashes[i++ % prevHashes.size()]);
+        in[0] = *hash.begin();
+    }
+}
+
+/* X16R_MAX_LANES headers sharing each previous block hash, as in a batch of sibling headers */
+static void HASH_X21S_Multi_0080b(benchmark::State& state)
+{
+    const std::vector<uint256> prevHashes = GetPrevBlockHashes();
+    CX21SHasher hasher;
+    std::vector<std::vector<uint8_t>> in(X16R_MAX_LANES, std::vector<uint8_t>(80, 0));
+    const unsigned char* pin[X16R_MAX_LANES];
+    uint256 hashPrevBlock[X16R_MAX_LANES];
+    uint256 hash[X16R_MAX_LANES];
+    for (size_t l = 0; l < X16R_MAX_LANES; l++) {
+        in[l][76] = l;
+        pin[l] = in[l].data();
+    }
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        for (size_t l = 0; l < X16R_MAX_LANES; l++) {
+            hashPrevBlock[l] = prevHashes[i % prevHashes.size()];
+        }
+        i++;
+        hasher.HashX21SMulti(pin, 80, hashPrevBlock, hash, X16R_MAX_LANES);
+        in[0][0] = *hash[0].begin();
+    }
+}
+
+BENCHMARK(HASH_LYRA2_X21S, 450 * 1000);
+BENCHMARK(HASH_X16R_0080b, 20 * 1000);
+BENCHMARK(HASH_X21S_0080b, 20 * 1000);
+BENCHMARK(HASH_X21S_Hasher_0080b, 25 * 1000);
+BENCHMARK(HASH_X21S_Multi_0080b, 3 * 1000);
@@ -224,6 +224,41 @@ static GCSFilter::ElementSet BasicFilterElements(const CBlock& block,
     return elements;
 }
 
+static const std::string BASIC_FILTER_NAME = "basic";
+
+const std::string& BlockFilterTypeName(BlockFilterType filter_type)
+{
+    static const std::string unknown_retval = "";
+    switch (filter_type) {
+    case BlockFilterType::BASIC_FILTER: return BASIC_FILTER_NAME;
+    default: return unknown_retval;
+    }
+}
+
+bool BlockFilterTypeByName(const std::string& name, BlockFilterType& filter_type)
+{
+    if (name == BASIC_FILTER_NAME) {
+        filter_type = BlockFilterType::BASIC_FILTER;
+        return true;
+    }
+    return false;
+}
+
+BlockFilter::BlockFilter(BlockFilterType filter_type, const uint256& block_hash,
+                         std::vector<unsigned char> filter)
+    : m_filter_type(filter_type), m_block_hash(block_hash)
+{
+    switch (m_filter_type) {
+    case BlockFilterType::BASIC_FILTER:
+        m_filter = GCSFilter(m_block_hash.GetUint64(0), m_block_hash.GetUint64(1),
+                             BASIC_FILTER_P, BASIC_FILTER_M, std::move(filter));
+        break;
+
+    default:
+        throw std::invalid_argument("unknown filter_type");
+    }
+}
+
 BlockFilter::BlockFilter(BlockFilterType filter_type, const CBlock& block, const CBlockUndo& block_undo)
     : m_filter_type(filter_type), m_block_hash(block.GetHash())
 {
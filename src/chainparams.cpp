@@ -112,6 +112,11 @@ void CChainParams::UpdateBudgetParameters(int nMasternodePaymentsStartBlock, int
     consensus.nSuperblockStartBlock = nSuperblockStartBlock;
 }
 
+void CChainParams::UpdateSnapshotData(const uint256& hashBlock, const SnapshotData& snapshotData)
+{
+    mapSnapshotData[hashBlock] = snapshotData;
+}
+
 void CChainParams::UpdateSubsidyAndDiffParams(int nMinimumDifficultyBlocks, int nHighSubsidyBlocks, int nHighSubsidyFactor)
 {
     consensus.nMinimumDifficultyBlocks = nMinimumDifficultyBlocks;
@@ -470,6 +475,11 @@ public:
                         //   (the tx=... number in the SetBestChain debug.log lines)
             0.3         // * estimated number of transactions per second after that timestamp
         };
+
+        // UTXO snapshots that loadtxoutset accepts, as reported by dumptxoutset:
+        // { block hash, { snapshot hash, nChainTx } }
+        mapSnapshotData = {
+        };
     }
 };
 
@@ -1000,6 +1010,10 @@ public:
             0
         };
 
+        // Regtest chains differ from run to run, tests add the snapshots of their chain with -snapshotdata
+        mapSnapshotData = {
+        };
+
         // Regtest Pigeon Addresses start with 'y'
         base58Prefixes[PUBKEY_ADDRESS] = std::vector<unsigned char>(1,140);
         // Regtest Pigeon script addresses start with '8' or '9'
@@ -1064,6 +1078,11 @@ void UpdateBudgetParameters(int nMasternodePaymentsStartBlock, int nBudgetPaymen
     globalChainParams->UpdateBudgetParameters(nMasternodePaymentsStartBlock, nBudgetPaymentsStartBlock, nSuperblockStartBlock);
 }
 
+void UpdateSnapshotData(const uint256& hashBlock, const SnapshotData& snapshotData)
+{
+    globalChainParams->UpdateSnapshotData(hashBlock, snapshotData);
+}
+
 void UpdateDevnetSubsidyAndDiffParams(int nMinimumDifficultyBlocks, int nHighSubsidyBlocks, int nHighSubsidyFactor)
 {
     globalChainParams->UpdateSubsidyAndDiffParams(nMinimumDifficultyBlocks, nHighSubsidyBlocks, nHighSubsidyFactor);
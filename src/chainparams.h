@@ -26,6 +26,18 @@ struct CCheckpointData {
     MapCheckpoints mapCheckpoints;
 };
 
+/**
+ * Commitment to a UTXO snapshot (see dumptxoutset) that loadtxoutset accepts
+ * for the block it is keyed by in MapSnapshotData.
+ */
+struct SnapshotData {
+    uint256 hashSnapshot;
+    //! Total number of transactions up to and including the snapshot block
+    unsigned int nChainTx;
+};
+
+typedef std::map<uint256, SnapshotData> MapSnapshotData;
+
 /**
  * Holds various statistics on transactions within a chain. Used to estimate
  * verification progress during chain sync.
@@ -91,9 +103,11 @@ public:
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData& Checkpoints() const { return checkpointData; }
     const ChainTxData& TxData() const { return chainTxData; }
+    const MapSnapshotData& Snapshots() const { return mapSnapshotData; }
     void UpdateVersionBitsParameters(Consensus::DeploymentPos d, int64_t nStartTime, int64_t nTimeout, int64_t nWindowSize, int64_t nThresholdStart, int64_t nThresholdMin, int64_t nFalloffCoeff);
     void UpdateDIP3Parameters(int nActivationHeight, int nEnforcementHeight);
     void UpdateBudgetParameters(int nMasternodePaymentsStartBlock, int nBudgetPaymentsStartBlock, int nSuperblockStartBlock);
+    void UpdateSnapshotData(const uint256& hashBlock, const SnapshotData& snapshotData);
     void UpdateSubsidyAndDiffParams(int nMinimumDifficultyBlocks, int nHighSubsidyBlocks, int nHighSubsidyFactor);
     void UpdateLLMQChainLocks(Consensus::LLMQType llmqType);
     void UpdateLLMQTestParams(int size, int threshold);
@@ -131,6 +145,7 @@ protected:
     int nLLMQConnectionRetryTimeout;
     CCheckpointData checkpointData;
     ChainTxData chainTxData;
+    MapSnapshotData mapSnapshotData;
     int nPoolMinParticipants;
     int nPoolNewMinParticipants;
     int nPoolMaxParticipants;
@@ -176,6 +191,11 @@ void UpdateDIP3Parameters(int nActivationHeight, int nEnforcementHeight);
  */
 void UpdateBudgetParameters(int nMasternodePaymentsStartBlock, int nBudgetPaymentsStartBlock, int nSuperblockStartBlock);
 
+/**
+ * Allows adding a regtest UTXO snapshot commitment.
+ */
+void UpdateSnapshotData(const uint256& hashBlock, const SnapshotData& snapshotData);
+
 /**
  * Allows modifying the subsidy and difficulty devnet parameters.
  */
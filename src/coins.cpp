@@ -29,6 +29,98 @@ bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock)
 CCoinsViewCursor *CCoinsViewBacked::Cursor() const { return base->Cursor(); }
 size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
+CCoinsViewPrefetch::CCoinsViewPrefetch(CCoinsView *viewIn, size_t nMaxCoinsIn) : CCoinsViewBacked(viewIn), nMaxCoins(nMaxCoinsIn) { }
+
+bool CCoinsViewPrefetch::GetCoin(const COutPoint &outpoint, Coin &coin) const
+{
+    {
+        LOCK(cs);
+        CCoinsMap::iterator it = cacheCoins.find(outpoint);
+        if (it != cacheCoins.end()) {
+            coin = std::move(it->second.coin);
+            cacheCoins.erase(it);
+            stats.nHits++;
+            return true;
+        }
+        stats.nMisses++;
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewPrefetch::HaveCoin(const COutPoint &outpoint) const
+{
+    {
+        LOCK(cs);
+        if (cacheCoins.count(outpoint)) {
+            return true;
+        }
+    }
+    return base->HaveCoin(outpoint);
+}
+
+bool CCoinsViewPrefetch::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock)
+{
+    {
+        LOCK(cs);
+        Clear();
+    }
+    bool fOk = base->BatchWrite(mapCoins, hashBlock);
+    {
+        LOCK(cs);
+        Clear();
+    }
+    return fOk;
+}
+
+void CCoinsViewPrefetch::Prefetch(const COutPoint &outpoint)
+{
+    uint64_t nGenerationStart;
+    {
+        LOCK(cs);
+        if (cacheCoins.count(outpoint)) {
+            return;
+        }
+        nGenerationStart = nGeneration;
+    }
+
+    Coin coin;
+    if (!base->GetCoin(outpoint, coin) || coin.IsSpent()) {
+        return;
+    }
+
+    LOCK(cs);
+    if (nGeneration != nGenerationStart) {
+        return;
+    }
+    if (cacheCoins.size() >= nMaxCoins) {
+        // coins that were already cached on top are never asked for, start over
+        Clear();
+    }
+    cacheCoins[outpoint].coin = std::move(coin);
+    stats.nPrefetched++;
+}
+
+uint64_t CCoinsViewPrefetch::GetGeneration() const
+{
+    LOCK(cs);
+    return nGeneration;
+}
+
+CCoinsViewPrefetch::Stats CCoinsViewPrefetch::GetStats() const
+{
+    LOCK(cs);
+    Stats ret = stats;
+    ret.nSize = cacheCoins.size();
+    return ret;
+}
+
+void CCoinsViewPrefetch::Clear()
+{
+    nGeneration++;
+    stats.nDropped += cacheCoins.size();
+    cacheCoins.clear();
+}
+
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
 CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
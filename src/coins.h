@@ -11,7 +11,9 @@
 #include <core_memusage.h>
 #include <hash.h>
 #include <memusage.h>
+#include <pooled_unordered_map.h>
 #include <serialize.h>
+#include <sync.h>
 #include <uint256.h>
 
 #include <assert.h>
@@ -119,7 +121,7 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+typedef pooled_unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -197,6 +199,49 @@ public:
 };
 
 
+/**
+ * CCoinsView that serves coins which other threads read from its backend
+ * ahead of time. Prefetch() may be called from any thread; a prefetched coin
+ * is handed out once and then left to the cache on top. BatchWrite() drops
+ * all prefetched coins, so no coin read before a write is ever returned.
+ */
+class CCoinsViewPrefetch : public CCoinsViewBacked
+{
+public:
+    struct Stats {
+        uint64_t nHits{0};
+        uint64_t nMisses{0};
+        uint64_t nPrefetched{0};
+        uint64_t nDropped{0};
+        size_t nSize{0};
+    };
+
+    CCoinsViewPrefetch(CCoinsView *viewIn, size_t nMaxCoinsIn);
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+
+    //! Read outpoint from the backend so that a later GetCoin() does not have to
+    void Prefetch(const COutPoint &outpoint);
+
+    //! Changes whenever prefetched coins are dropped
+    uint64_t GetGeneration() const;
+
+    Stats GetStats() const;
+
+private:
+    void Clear() EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    mutable CCriticalSection cs;
+    mutable CCoinsMap cacheCoins GUARDED_BY(cs);
+    //! Bumped whenever the coins are dropped, prefetches that started before are discarded
+    uint64_t nGeneration GUARDED_BY(cs){0};
+    const size_t nMaxCoins;
+    mutable Stats stats GUARDED_BY(cs);
+};
+
+
 /** CCoinsView that adds a memory cache for transactions to another CCoinsView */
 class CCoinsViewCache : public CCoinsViewBacked
 {
@@ -192,6 +192,14 @@ public:
         return piter->value().size();
     }
 
+    /** Return the de-obfuscated value bytes, so they can be deserialized later (e.g. on another thread) */
+    CDataStream GetValue() {
+        leveldb::Slice slValue = piter->value();
+        CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+        ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+        return ssValue;
+    }
+
 };
 
 class CDBWrapper
@@ -73,7 +73,7 @@ void FounderPayment::FillFounderPayment(CMutableTransaction& txNew, int nBlockHe
     txNew.vout[0].nValue -= founderPayment;
     txoutFounderRet = CTxOut(founderPayment, GetFounderPayeeScript(nBlockHeight));
     txNew.vout.push_back(txoutFounderRet);
-    LogPrintf("FounderPayment::FillFounderPayment -- Founder payment %lld to %s\n", founderPayment,
+    LogPrint(BCLog::MNPAYMENTS, "FounderPayment::FillFounderPayment -- Founder payment %lld to %s\n", founderPayment,
     		GetFounderPayeeAddr(nBlockHeight));
 }
 
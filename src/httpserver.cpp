@@ -578,10 +578,37 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     if (ShutdownRequested()) {
         WriteHeader("Connection", "close");
     }
-    // Send event to main http thread to send reply message
     struct evbuffer* evb = evhttp_request_get_output_buffer(req);
     assert(evb);
     evbuffer_add(evb, strReply.data(), strReply.size());
+    SendReply(nStatus);
+}
+
+static void ReleaseReplyOwner(const void* data, size_t datalen, void* extra)
+{
+    delete static_cast<std::shared_ptr<const void>*>(extra);
+}
+
+void HTTPRequest::WriteReply(int nStatus, std::shared_ptr<const void> owner, const unsigned char* data, size_t nSize)
+{
+    assert(!replySent && req);
+    if (ShutdownRequested()) {
+        WriteHeader("Connection", "close");
+    }
+    struct evbuffer* evb = evhttp_request_get_output_buffer(req);
+    assert(evb);
+    // The evbuffer references the data and releases the owner once it has been sent
+    std::shared_ptr<const void>* powner = new std::shared_ptr<const void>(std::move(owner));
+    if (evbuffer_add_reference(evb, data, nSize, ReleaseReplyOwner, powner) != 0) {
+        delete powner;
+        evbuffer_add(evb, data, nSize);
+    }
+    SendReply(nStatus);
+}
+
+void HTTPRequest::SendReply(int nStatus)
+{
+    // Send event to main http thread to send reply message
     auto req_copy = req;
     HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
         evhttp_send_reply(req_copy, nStatus, nullptr, nullptr);
@@ -8,6 +8,7 @@
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <memory>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
@@ -114,6 +115,16 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Write HTTP reply with a body that is sent without copying it.
+     * owner keeps the nSize bytes at data alive until they are sent.
+     */
+    void WriteReply(int nStatus, std::shared_ptr<const void> owner, const unsigned char* data, size_t nSize);
+
+private:
+    /** Hand the request back to the main thread to send the reply */
+    void SendReply(int nStatus);
 };
 
 /** Event handler closure.
@@ -0,0 +1,121 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <hash.h>
+#include <index/addressindex.h>
+#include <script/script.h>
+#include <spentindex.h>
+#include <txdb.h>
+#include <undo.h>
+#include <validation.h>
+
+std::unique_ptr<AddressIndex> g_addressindex;
+
+bool GetIndexAddress(const CScript& script, int& addressType, uint160& hashBytes)
+{
+    if (script.IsPayToScriptHash()) {
+        hashBytes = uint160(std::vector<unsigned char>(script.begin() + 2, script.begin() + 22));
+        addressType = 2;
+    } else if (script.IsPayToPublicKeyHash()) {
+        hashBytes = uint160(std::vector<unsigned char>(script.begin() + 3, script.begin() + 23));
+        addressType = 1;
+    } else if (script.IsPayToPublicKey()) {
+        hashBytes = Hash160(script.begin() + 1, script.end() - 1);
+        addressType = 1;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool AddressIndex::WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        const uint256 txhash = tx.GetHash();
+        int addressType;
+        uint160 hashBytes;
+
+        if (i > 0) {
+            const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+                const CTxOut& prevout = txundo.vprevout[j].out;
+                if (!GetIndexAddress(prevout.scriptPubKey, addressType, hashBytes)) {
+                    continue;
+                }
+
+                // record spending activity
+                addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, j, true), prevout.nValue * -1));
+
+                // remove address from unspent index
+                addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, hashBytes, tx.vin[j].prevout.hash, tx.vin[j].prevout.n), CAddressUnspentValue()));
+            }
+        }
+
+        for (size_t k = 0; k < tx.vout.size(); k++) {
+            const CTxOut& out = tx.vout[k];
+            if (!GetIndexAddress(out.scriptPubKey, addressType, hashBytes)) {
+                continue;
+            }
+
+            // record receiving activity
+            addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, k, false), out.nValue));
+
+            // record unspent output
+            addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, hashBytes, txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
+        }
+    }
+
+    return pblocktree->WriteAddressIndex(addressIndex) && pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex);
+}
+
+bool AddressIndex::EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+
+    // undo transactions in reverse order
+    for (size_t i = block.vtx.size(); i-- > 0;) {
+        const CTransaction& tx = *block.vtx[i];
+        const uint256 txhash = tx.GetHash();
+        int addressType;
+        uint160 hashBytes;
+
+        for (size_t k = tx.vout.size(); k-- > 0;) {
+            const CTxOut& out = tx.vout[k];
+            if (!GetIndexAddress(out.scriptPubKey, addressType, hashBytes)) {
+                continue;
+            }
+
+            // undo receiving activity
+            addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, k, false), out.nValue));
+
+            // undo unspent index
+            addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, hashBytes, txhash, k), CAddressUnspentValue()));
+        }
+
+        if (i > 0) {
+            const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+            for (size_t j = tx.vin.size(); j-- > 0;) {
+                const Coin& coin = txundo.vprevout[j];
+                const CTxOut& prevout = coin.out;
+                if (!GetIndexAddress(prevout.scriptPubKey, addressType, hashBytes)) {
+                    continue;
+                }
+
+                // undo spending activity
+                addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, j, true), prevout.nValue * -1));
+
+                // restore unspent index
+                addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, hashBytes, tx.vin[j].prevout.hash, tx.vin[j].prevout.n), CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, coin.nHeight)));
+            }
+        }
+    }
+
+    return pblocktree->EraseAddressIndex(addressIndex) && pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex);
+}
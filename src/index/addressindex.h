@@ -0,0 +1,35 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_ADDRESSINDEX_H
+#define BITCOIN_INDEX_ADDRESSINDEX_H
+
+#include <index/base.h>
+
+#include <memory>
+
+class CScript;
+class uint160;
+
+/** Get the address type and hash that the address and spent indexes use for a script */
+bool GetIndexAddress(const CScript& script, int& addressType, uint160& hashBytes);
+
+/**
+ * AddressIndex maintains the -addressindex entries: the activity and the unspent
+ * outputs of every P2PKH, P2SH and P2PK address.
+ */
+class AddressIndex final : public BaseIndex
+{
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+
+    bool EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+
+    const char* GetName() const override { return "addressindex"; }
+};
+
+/// The global address index, used in GetAddressIndex and GetAddressUnspent. May be null.
+extern std::unique_ptr<AddressIndex> g_addressindex;
+
+#endif // BITCOIN_INDEX_ADDRESSINDEX_H
@@ -0,0 +1,318 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <index/base.h>
+#include <init.h>
+#include <tinyformat.h>
+#include <txdb.h>
+#include <ui_interface.h>
+#include <undo.h>
+#include <util.h>
+#include <validation.h>
+#include <warnings.h>
+
+constexpr int64_t SYNC_LOG_INTERVAL = 30; // seconds
+constexpr int64_t SYNC_LOCATOR_WRITE_INTERVAL = 30; // seconds
+
+template<typename... Args>
+static void FatalError(const char* fmt, const Args&... args)
+{
+    std::string strMessage = tfm::format(fmt, args...);
+    SetMiscWarning(strMessage);
+    LogPrintf("*** %s\n", strMessage);
+    uiInterface.ThreadSafeMessageBox(
+        "Error: A fatal internal error occurred, see debug.log for details",
+        "", CClientUIInterface::MSG_ERROR);
+    StartShutdown();
+}
+
+bool UpgradeLegacyIndexFlag(const std::string& name)
+{
+    CBlockLocator locator;
+    bool fLegacy = false;
+    if (pblocktree->ReadIndexBestBlock(name, locator) || !pblocktree->ReadFlag(name, fLegacy) || !fLegacy) {
+        return true;
+    }
+
+    LOCK(cs_main);
+    LogPrintf("%s: %s was built while connecting blocks, continuing from height %d\n", __func__, name, chainActive.Height());
+    return pblocktree->WriteIndexBestBlock(name, chainActive.GetLocator()) && pblocktree->WriteFlag(name, false);
+}
+
+BaseIndex::~BaseIndex()
+{
+    Interrupt();
+    Stop();
+}
+
+bool BaseIndex::Init()
+{
+    CBlockLocator locator;
+    ReadLocator(locator);
+
+    LOCK(cs_main);
+    if (locator.IsNull()) {
+        m_best_block_index = nullptr;
+    } else {
+        // The best block may be on a fork that is not known to the active chain, ThreadSync rewinds it
+        BlockMap::const_iterator it = mapBlockIndex.find(locator.vHave[0]);
+        m_best_block_index = it != mapBlockIndex.end() ? it->second : FindForkInGlobalIndex(chainActive, locator);
+    }
+    m_synced = m_best_block_index.load() == chainActive.Tip();
+    return true;
+}
+
+bool BaseIndex::ReadLocator(CBlockLocator& locator) const
+{
+    return pblocktree->ReadIndexBestBlock(GetName(), locator);
+}
+
+bool BaseIndex::WriteLocator(const CBlockLocator& locator)
+{
+    return pblocktree->WriteIndexBestBlock(GetName(), locator);
+}
+
+static const CBlockIndex* NextSyncBlock(const CBlockIndex* pindex_prev) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+
+    if (!pindex_prev) {
+        return chainActive.Genesis();
+    }
+
+    const CBlockIndex* pindex = chainActive.Next(pindex_prev);
+    if (pindex) {
+        return pindex;
+    }
+
+    return chainActive.Next(chainActive.FindFork(pindex_prev));
+}
+
+void BaseIndex::ThreadSync()
+{
+    const CBlockIndex* pindex = m_best_block_index.load();
+    if (!m_synced) {
+        auto& consensus_params = Params().GetConsensus();
+
+        int64_t last_log_time = 0;
+        int64_t last_locator_write_time = 0;
+        while (true) {
+            if (m_interrupt) {
+                m_best_block_index = pindex;
+                WriteBestBlock(pindex);
+                return;
+            }
+
+            {
+                LOCK(cs_main);
+                const CBlockIndex* pindex_next = NextSyncBlock(pindex);
+                if (!pindex_next) {
+                    // Blocks may have been disconnected without a longer branch replacing them
+                    const CBlockIndex* pindex_fork = pindex ? chainActive.FindFork(pindex) : nullptr;
+                    if (pindex_fork != pindex) {
+                        if (!Rewind(pindex, pindex_fork)) {
+                            FatalError("%s: Failed to rewind index %s to a previous chain tip",
+                                       __func__, GetName());
+                            return;
+                        }
+                        pindex = pindex_fork;
+                    }
+                    m_best_block_index = pindex;
+                    m_synced = true;
+                    WriteBestBlock(pindex);
+                    break;
+                }
+                if (pindex_next->pprev != pindex && !Rewind(pindex, pindex_next->pprev)) {
+                    FatalError("%s: Failed to rewind index %s to a previous chain tip",
+                               __func__, GetName());
+                    return;
+                }
+                pindex = pindex_next;
+            }
+
+            int64_t current_time = GetTime();
+            if (last_log_time + SYNC_LOG_INTERVAL < current_time) {
+                LogPrintf("Syncing %s with block chain from height %d\n",
+                          GetName(), pindex->nHeight);
+                last_log_time = current_time;
+            }
+
+            CBlock block;
+            if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
+                FatalError("%s: Failed to read block %s from disk",
+                           __func__, pindex->GetBlockHash().ToString());
+                return;
+            }
+            if (!IndexBlock(block, pindex)) {
+                FatalError("%s: Failed to write block %s to index %s",
+                           __func__, pindex->GetBlockHash().ToString(), GetName());
+                return;
+            }
+            m_best_block_index = pindex;
+
+            if (last_locator_write_time + SYNC_LOCATOR_WRITE_INTERVAL < current_time) {
+                WriteBestBlock(pindex);
+                last_locator_write_time = current_time;
+            }
+        }
+    }
+
+    if (pindex) {
+        LogPrintf("%s is enabled at height %d\n", GetName(), pindex->nHeight);
+    } else {
+        LogPrintf("%s is enabled\n", GetName());
+    }
+}
+
+bool BaseIndex::IndexBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    CBlockUndo blockundo;
+    if (RequiresUndo() && pindex->pprev) {
+        if (!UndoReadFromDisk(blockundo, pindex) || blockundo.vtxundo.size() + 1 != block.vtx.size()) {
+            return error("%s: Failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+        }
+    }
+    return WriteBlock(block, blockundo, pindex);
+}
+
+bool BaseIndex::UnindexBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    CBlockUndo blockundo;
+    if (RequiresUndo() && pindex->pprev) {
+        if (!UndoReadFromDisk(blockundo, pindex) || blockundo.vtxundo.size() + 1 != block.vtx.size()) {
+            return error("%s: Failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+        }
+    }
+    return EraseBlock(block, blockundo, pindex);
+}
+
+bool BaseIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus()) || !UnindexBlock(block, pindex)) {
+            return error("%s: Failed to unindex block %s from %s", __func__, pindex->GetBlockHash().ToString(), GetName());
+        }
+    }
+
+    m_best_block_index = new_tip;
+    return WriteBestBlock(new_tip);
+}
+
+bool BaseIndex::WriteBestBlock(const CBlockIndex* pindex)
+{
+    CBlockLocator locator;
+    if (pindex) {
+        LOCK(cs_main);
+        locator = chainActive.GetLocator(pindex);
+    }
+    if (!WriteLocator(locator)) {
+        return error("%s: Failed to write locator of %s to disk", __func__, GetName());
+    }
+    return true;
+}
+
+void BaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex,
+                               const std::vector<CTransactionRef>& txn_conflicted)
+{
+    if (!m_synced) {
+        return;
+    }
+
+    const CBlockIndex* best_block_index = m_best_block_index.load();
+    if (best_block_index != pindex->pprev) {
+        // Notifications that were queued before the sync thread caught up refer to blocks
+        // it has already indexed or to blocks of a branch it has already rewound.
+        if (!best_block_index || best_block_index->GetAncestor(pindex->nHeight) != pindex) {
+            LogPrintf("%s: WARNING: Block %s does not connect to the best block of %s (tip=%s); not updating index\n",
+                      __func__, pindex->GetBlockHash().ToString(), GetName(),
+                      best_block_index ? best_block_index->GetBlockHash().ToString() : "null");
+        }
+        return;
+    }
+
+    if (!IndexBlock(*block, pindex)) {
+        FatalError("%s: Failed to write block %s to index %s",
+                   __func__, pindex->GetBlockHash().ToString(), GetName());
+        return;
+    }
+    m_best_block_index = pindex;
+    WriteBestBlock(pindex);
+}
+
+void BaseIndex::BlockDisconnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex)
+{
+    if (!m_synced) {
+        return;
+    }
+
+    const CBlockIndex* best_block_index = m_best_block_index.load();
+    if (best_block_index != pindex) {
+        // The block was never indexed or the sync thread rewound it already
+        return;
+    }
+
+    if (!UnindexBlock(*block, pindex)) {
+        FatalError("%s: Failed to unindex block %s from %s",
+                   __func__, pindex->GetBlockHash().ToString(), GetName());
+        return;
+    }
+    m_best_block_index = pindex->pprev;
+    WriteBestBlock(pindex->pprev);
+}
+
+bool BaseIndex::BlockUntilSyncedToCurrentChain()
+{
+    AssertLockNotHeld(cs_main);
+
+    if (!m_synced) {
+        return false;
+    }
+
+    {
+        // Skip the queue-draining stuff if we know we're caught up with
+        // chainActive.Tip(). An index ahead of the tip still has to unindex
+        // the disconnected blocks, so it is not caught up.
+        LOCK(cs_main);
+        const CBlockIndex* chain_tip = chainActive.Tip();
+        if (!chain_tip || m_best_block_index.load() == chain_tip) {
+            return true;
+        }
+    }
+
+    LogPrintf("%s: %s is catching up on block notifications\n", __func__, GetName());
+    SyncWithValidationInterfaceQueue();
+    return true;
+}
+
+void BaseIndex::Interrupt()
+{
+    m_interrupt();
+}
+
+void BaseIndex::Start()
+{
+    // Need to register this ValidationInterface before running Init(), so that
+    // callbacks are not missed if Init sets m_synced to true.
+    RegisterValidationInterface(this);
+    if (!Init()) {
+        FatalError("%s: %s failed to initialize", __func__, GetName());
+        return;
+    }
+
+    m_thread_sync = std::thread(&TraceThread<std::function<void()>>, GetName(),
+                                std::bind(&BaseIndex::ThreadSync, this));
+}
+
+void BaseIndex::Stop()
+{
+    UnregisterValidationInterface(this);
+
+    if (m_thread_sync.joinable()) {
+        m_thread_sync.join();
+    }
+}
@@ -0,0 +1,116 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_BASE_H
+#define BITCOIN_INDEX_BASE_H
+
+#include <primitives/block.h>
+#include <threadinterrupt.h>
+#include <validationinterface.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+class CBlockIndex;
+class CBlockUndo;
+
+/**
+ * Base class for indexes that are built from the active chain in the background.
+ *
+ * A sync thread indexes blocks from the index's best block up to the chain tip. After
+ * that, blocks are indexed from BlockConnected/BlockDisconnected notifications, so
+ * connecting a block never waits for index writes. The best block of each index is
+ * stored in the block tree database under the index name. A restarted or newly enabled
+ * index continues from there and first rewinds any blocks that were reorged away.
+ */
+class BaseIndex : public CValidationInterface
+{
+private:
+    /// Whether the index is in sync with the main chain. The flag is flipped
+    /// from false to true once, after which notifications are processed.
+    std::atomic<bool> m_synced{false};
+
+    /// The last block in the chain that the index is in sync with.
+    std::atomic<const CBlockIndex*> m_best_block_index{nullptr};
+
+    std::thread m_thread_sync;
+    CThreadInterrupt m_interrupt;
+
+    /// Sync the index with the block index starting from the current best block.
+    /// Intended to be run in its own thread, m_thread_sync, and can be
+    /// interrupted with m_interrupt. Once the index gets in sync, the m_synced
+    /// flag is set and the BlockConnected ValidationInterface callback takes
+    /// over and the sync thread exits.
+    void ThreadSync();
+
+    /// Index or unindex a single block, reading its undo data if the index needs it.
+    bool IndexBlock(const CBlock& block, const CBlockIndex* pindex);
+    bool UnindexBlock(const CBlock& block, const CBlockIndex* pindex);
+
+    /// Unindex the blocks from current_tip back to new_tip, which must be an ancestor of it.
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip);
+
+    /// Write the locator of pindex as the best block of the index.
+    bool WriteBestBlock(const CBlockIndex* pindex);
+
+protected:
+    void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex,
+                        const std::vector<CTransactionRef>& txn_conflicted) override;
+
+    void BlockDisconnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex) override;
+
+    /// Read the best block of the index and set up the sync state.
+    virtual bool Init();
+
+    /// Read and write the locator of the best block. It is stored in the block
+    /// tree database under the index name unless the index has its own database.
+    virtual bool ReadLocator(CBlockLocator& locator) const;
+    virtual bool WriteLocator(const CBlockLocator& locator);
+
+    /// Whether WriteBlock and EraseBlock need the undo data of the block.
+    virtual bool RequiresUndo() const { return true; }
+
+    /// Write the index entries of a newly connected block. blockundo is empty
+    /// for the genesis block and for indexes that do not require undo data.
+    virtual bool WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) = 0;
+
+    /// Erase the index entries of a block that was disconnected.
+    virtual bool EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) = 0;
+
+    /// Get the name of the index, used for its thread, logging and as the database key of its best block.
+    virtual const char* GetName() const = 0;
+
+public:
+    /// Destructor interrupts sync thread if running and blocks until it exits.
+    virtual ~BaseIndex();
+
+    /// Blocks the current thread until the index is caught up to the current
+    /// state of the block chain. This only blocks if the index has gotten in
+    /// sync once and only needs to process blocks in the ValidationInterface
+    /// queue. If the index is catching up from far behind, this method does
+    /// not block and immediately returns false. Must not be called with cs_main held.
+    bool BlockUntilSyncedToCurrentChain();
+
+    bool IsSynced() const { return m_synced; }
+
+    void Interrupt();
+
+    /// Start initializes the sync state and registers the instance as a
+    /// ValidationInterface so that it stays in sync with blockchain updates.
+    void Start();
+
+    /// Stops the instance from staying in sync with blockchain updates.
+    void Stop();
+};
+
+/**
+ * Earlier versions wrote the address, spent and timestamp indexes while connecting
+ * blocks and only kept a flag named after the index in the block tree database. Turn
+ * such a flag into a best block at the current tip, whether the index is still enabled
+ * or not, so that a later start continues from where the data actually ends.
+ */
+bool UpgradeLegacyIndexFlag(const std::string& name);
+
+#endif // BITCOIN_INDEX_BASE_H
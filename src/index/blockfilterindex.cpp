@@ -0,0 +1,154 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <index/blockfilterindex.h>
+#include <util.h>
+#include <utilmemory.h>
+
+/* The index database stores three items for each block: the encoded filter,
+ * its hash and the filter header. Filters are stored separately from the
+ * hashes and headers so that getcfheaders and getcfcheckpt do not have to
+ * read the filters themselves. All entries are keyed by block hash, so lookups
+ * of blocks on stale branches and reorgs need no extra bookkeeping.
+ */
+static const char DB_FILTER = 'f';
+static const char DB_FILTER_HASH = 'h';
+static const char DB_BEST_BLOCK = 'B';
+
+namespace {
+
+struct DBHashes {
+    uint256 hash;
+    uint256 header;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(hash);
+        READWRITE(header);
+    }
+};
+
+} // namespace
+
+std::unique_ptr<BlockFilterIndex> g_basic_filter_index;
+
+BlockFilterIndex* GetBlockFilterIndex(BlockFilterType filter_type)
+{
+    switch (filter_type) {
+    case BlockFilterType::BASIC_FILTER: return g_basic_filter_index.get();
+    default: return nullptr;
+    }
+}
+
+BlockFilterIndex::BlockFilterIndex(BlockFilterType filter_type,
+                                   size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_filter_type(filter_type)
+{
+    const std::string& filter_name = BlockFilterTypeName(filter_type);
+    if (filter_name.empty()) throw std::invalid_argument("unknown filter_type");
+
+    m_name = filter_name + " block filter index";
+    m_db = MakeUnique<CDBWrapper>(GetDataDir() / "indexes" / "blockfilter" / filter_name,
+                                  n_cache_size, f_memory, f_wipe);
+}
+
+bool BlockFilterIndex::ReadLocator(CBlockLocator& locator) const
+{
+    return m_db->Read(DB_BEST_BLOCK, locator);
+}
+
+bool BlockFilterIndex::WriteLocator(const CBlockLocator& locator)
+{
+    return m_db->Write(DB_BEST_BLOCK, locator);
+}
+
+bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    uint256 prev_header;
+    if (pindex->pprev) {
+        DBHashes prev_hashes;
+        if (!m_db->Read(std::make_pair(DB_FILTER_HASH, pindex->pprev->GetBlockHash()), prev_hashes)) {
+            return error("%s: Failed to read header of block %s from %s",
+                         __func__, pindex->pprev->GetBlockHash().ToString(), GetName());
+        }
+        prev_header = prev_hashes.header;
+    }
+
+    BlockFilter filter(m_filter_type, block, blockundo);
+
+    DBHashes hashes;
+    hashes.hash = filter.GetHash();
+    hashes.header = filter.ComputeHeader(prev_header);
+
+    CDBBatch batch(*m_db);
+    batch.Write(std::make_pair(DB_FILTER, pindex->GetBlockHash()), filter.GetEncodedFilter());
+    batch.Write(std::make_pair(DB_FILTER_HASH, pindex->GetBlockHash()), hashes);
+    return m_db->WriteBatch(batch);
+}
+
+bool BlockFilterIndex::EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    // Entries are keyed by block hash and remain correct for the disconnected block
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilter(const CBlockIndex* block_index, BlockFilter& filter_out) const
+{
+    std::vector<unsigned char> encoded_filter;
+    if (!m_db->Read(std::make_pair(DB_FILTER, block_index->GetBlockHash()), encoded_filter)) {
+        return false;
+    }
+
+    filter_out = BlockFilter(m_filter_type, block_index->GetBlockHash(), std::move(encoded_filter));
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilterHeader(const CBlockIndex* block_index, uint256& header_out) const
+{
+    DBHashes hashes;
+    if (!m_db->Read(std::make_pair(DB_FILTER_HASH, block_index->GetBlockHash()), hashes)) {
+        return false;
+    }
+
+    header_out = hashes.header;
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilterRange(int start_height, const CBlockIndex* stop_index,
+                                         std::vector<BlockFilter>& filters_out) const
+{
+    if (start_height < 0 || !stop_index || start_height > stop_index->nHeight) {
+        return false;
+    }
+
+    filters_out.resize(stop_index->nHeight - start_height + 1);
+    for (const CBlockIndex* pindex = stop_index; pindex && pindex->nHeight >= start_height; pindex = pindex->pprev) {
+        if (!LookupFilter(pindex, filters_out[pindex->nHeight - start_height])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilterHashRange(int start_height, const CBlockIndex* stop_index,
+                                             std::vector<uint256>& hashes_out) const
+{
+    if (start_height < 0 || !stop_index || start_height > stop_index->nHeight) {
+        return false;
+    }
+
+    hashes_out.resize(stop_index->nHeight - start_height + 1);
+    for (const CBlockIndex* pindex = stop_index; pindex && pindex->nHeight >= start_height; pindex = pindex->pprev) {
+        DBHashes hashes;
+        if (!m_db->Read(std::make_pair(DB_FILTER_HASH, pindex->GetBlockHash()), hashes)) {
+            return false;
+        }
+        hashes_out[pindex->nHeight - start_height] = hashes.hash;
+    }
+    return true;
+}
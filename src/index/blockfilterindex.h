@@ -0,0 +1,72 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_BLOCKFILTERINDEX_H
+#define BITCOIN_INDEX_BLOCKFILTERINDEX_H
+
+#include <blockfilter.h>
+#include <dbwrapper.h>
+#include <index/base.h>
+
+#include <memory>
+
+/** Default for -blockfilterindex */
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+/** Default for -peerblockfilters */
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
+/** Interval between compact filter checkpoints, see BIP 157 */
+static const int CFCHECKPT_INTERVAL = 1000;
+
+/**
+ * BlockFilterIndex maintains the BIP 157 filters and filter headers of a single
+ * filter type. It uses its own database in indexes/blockfilter/<type>, in which
+ * every entry is keyed by block hash. Entries of blocks that were reorged away
+ * stay valid for those blocks, so disconnecting a block does not erase anything.
+ */
+class BlockFilterIndex final : public BaseIndex
+{
+private:
+    BlockFilterType m_filter_type;
+    std::string m_name;
+    std::unique_ptr<CDBWrapper> m_db;
+
+protected:
+    bool ReadLocator(CBlockLocator& locator) const override;
+    bool WriteLocator(const CBlockLocator& locator) override;
+
+    bool WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+
+    bool EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+
+    const char* GetName() const override { return m_name.c_str(); }
+
+public:
+    /** Constructs the index, which becomes available to be queried. */
+    explicit BlockFilterIndex(BlockFilterType filter_type,
+                              size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    BlockFilterType GetFilterType() const { return m_filter_type; }
+
+    /** Get a single filter by block. */
+    bool LookupFilter(const CBlockIndex* block_index, BlockFilter& filter_out) const;
+
+    /** Get a single filter header by block. */
+    bool LookupFilterHeader(const CBlockIndex* block_index, uint256& header_out) const;
+
+    /** Get a range of filters between two heights on a chain. */
+    bool LookupFilterRange(int start_height, const CBlockIndex* stop_index,
+                           std::vector<BlockFilter>& filters_out) const;
+
+    /** Get a range of filter hashes between two heights on a chain. */
+    bool LookupFilterHashRange(int start_height, const CBlockIndex* stop_index,
+                               std::vector<uint256>& hashes_out) const;
+};
+
+/// The basic block filter index, used by getblockfilter and the getcf* P2P messages. May be null.
+extern std::unique_ptr<BlockFilterIndex> g_basic_filter_index;
+
+/** Get the block filter index for a filter type, or nullptr if it is not enabled. */
+BlockFilterIndex* GetBlockFilterIndex(BlockFilterType filter_type);
+
+#endif // BITCOIN_INDEX_BLOCKFILTERINDEX_H
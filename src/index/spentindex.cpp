@@ -0,0 +1,54 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <index/addressindex.h>
+#include <index/spentindex.h>
+#include <spentindex.h>
+#include <txdb.h>
+#include <undo.h>
+#include <validation.h>
+
+std::unique_ptr<SpentIndex> g_spentindex;
+
+bool SpentIndex::WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        const uint256 txhash = tx.GetHash();
+        const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+
+        for (size_t j = 0; j < tx.vin.size(); j++) {
+            const CTxOut& prevout = txundo.vprevout[j].out;
+            int addressType = 0;
+            uint160 hashBytes;
+            if (!GetIndexAddress(prevout.scriptPubKey, addressType, hashBytes)) {
+                addressType = 0;
+                hashBytes.SetNull();
+            }
+
+            // add the spent index to determine the txid and input that spent an output
+            // and to find the amount and address from an input
+            spentIndex.push_back(std::make_pair(CSpentIndexKey(tx.vin[j].prevout.hash, tx.vin[j].prevout.n), CSpentIndexValue(txhash, j, pindex->nHeight, prevout.nValue, addressType, hashBytes)));
+        }
+    }
+
+    return pblocktree->UpdateSpentIndex(spentIndex);
+}
+
+bool SpentIndex::EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        for (const CTxIn& input : block.vtx[i]->vin) {
+            // undo and delete the spent index
+            spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue()));
+        }
+    }
+
+    return pblocktree->UpdateSpentIndex(spentIndex);
+}
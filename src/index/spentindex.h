@@ -0,0 +1,29 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_SPENTINDEX_H
+#define BITCOIN_INDEX_SPENTINDEX_H
+
+#include <index/base.h>
+
+#include <memory>
+
+/**
+ * SpentIndex maintains the -spentindex entries: the transaction input that spent
+ * an output, together with the amount and address of that output.
+ */
+class SpentIndex final : public BaseIndex
+{
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+
+    bool EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+
+    const char* GetName() const override { return "spentindex"; }
+};
+
+/// The global spent index, used in GetSpentIndex. May be null.
+extern std::unique_ptr<SpentIndex> g_spentindex;
+
+#endif // BITCOIN_INDEX_SPENTINDEX_H
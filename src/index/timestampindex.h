@@ -0,0 +1,31 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_TIMESTAMPINDEX_H
+#define BITCOIN_INDEX_TIMESTAMPINDEX_H
+
+#include <index/base.h>
+
+#include <memory>
+
+/**
+ * TimestampIndex maintains the -timestampindex entries, the hashes of the blocks in
+ * the active chain ordered by their timestamp.
+ */
+class TimestampIndex final : public BaseIndex
+{
+protected:
+    bool RequiresUndo() const override { return false; }
+
+    bool WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+
+    bool EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+
+    const char* GetName() const override { return "timestampindex"; }
+};
+
+/// The global timestamp index, used in GetTimestampIndex. May be null.
+extern std::unique_ptr<TimestampIndex> g_timestampindex;
+
+#endif // BITCOIN_INDEX_TIMESTAMPINDEX_H
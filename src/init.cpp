@@ -11,6 +11,7 @@
 #include <init.h>
 
 #include <addrman.h>
+#include <algo/x16r_multi.h>
 #include <amount.h>
 #include <base58.h>
 #include <chain.h>
@@ -21,6 +22,10 @@
 #include <fs.h>
 #include <httpserver.h>
 #include <httprpc.h>
+#include <index/addressindex.h>
+#include <index/blockfilterindex.h>
+#include <index/spentindex.h>
+#include <index/timestampindex.h>
 #include <key.h>
 #include <validation.h>
 #include <miner.h>
@@ -37,12 +42,14 @@
 #include <script/standard.h>
 #include <script/sigcache.h>
 #include <scheduler.h>
+#include <stratum.h>
 #include <timedata.h>
 #include <txdb.h>
 #include <txmempool.h>
 #include <torcontrol.h>
 #include <ui_interface.h>
 #include <util.h>
+#include <utilmemory.h>
 #include <utilmoneystr.h>
 #include <validationinterface.h>
 
@@ -219,7 +226,12 @@ void Interrupt()
     InterruptRPC();
     InterruptREST();
     InterruptTorControl();
+    InterruptStratumServer();
     llmq::InterruptLLMQSystem();
+    if (g_addressindex) g_addressindex->Interrupt();
+    if (g_spentindex) g_spentindex->Interrupt();
+    if (g_timestampindex) g_timestampindex->Interrupt();
+    if (g_basic_filter_index) g_basic_filter_index->Interrupt();
     if (g_connman)
         g_connman->Interrupt();
 }
@@ -255,14 +267,22 @@ void PrepareShutdown()
 
     // Because these depend on each-other, we make sure that neither can be
     // using the other before destroying them.
+    StopTxAdmission();
+    StopMessageShards();
     if (peerLogic) UnregisterValidationInterface(peerLogic.get());
     if (g_connman) g_connman->Stop();
+    if (g_addressindex) g_addressindex->Stop();
+    if (g_spentindex) g_spentindex->Stop();
+    if (g_timestampindex) g_timestampindex->Stop();
+    if (g_basic_filter_index) g_basic_filter_index->Stop();
     // if (g_txindex) g_txindex->Stop(); //TODO watch out when backporting bitcoin#13033 (don't accidently put the reset here, as we've already backported bitcoin#13894)
 
     // After everything has been shut down, but before things get flushed, stop the
     // CScheduler/checkqueue threadGroup
     threadGroup.interrupt_all();
     threadGroup.join_all();
+    StopStratumServer();
+    StopCoinsPrefetch();
 
     // After there are no more peers/RPC left to give us new data which may generate
     // CValidationInterface callbacks, flush them...
@@ -286,6 +306,10 @@ void PrepareShutdown()
     // destruct and reset all to nullptr.
     peerLogic.reset();
     g_connman.reset();
+    g_addressindex.reset();
+    g_spentindex.reset();
+    g_timestampindex.reset();
+    g_basic_filter_index.reset();
     //g_txindex.reset(); //TODO watch out when backporting bitcoin#13033 (re-enable this, was backported via bitcoin#13894)
 
     if (fDumpMempoolLater && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
@@ -321,6 +345,7 @@ void PrepareShutdown()
             FlushStateToDisk();
         }
         pcoinsTip.reset();
+        pcoinsPrefetch.reset();
         pcoinscatcher.reset();
         pcoinsdbview.reset();
         pblocktree.reset();
@@ -343,6 +368,7 @@ void PrepareShutdown()
         delete pdsNotificationInterface;
         pdsNotificationInterface = nullptr;
     }
+    UnregisterValidationInterface(&blockTemplateManager);
     if (fMasternodeMode) {
         UnregisterValidationInterface(activeMasternodeManager);
     }
@@ -471,6 +497,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-daemon", _("Run in the background as a daemon and accept commands"));
 #endif
     }
+    strUsage += HelpMessageOpt("-coinswritebehind", strprintf(_("Write the coins cache to disk in the background while blocks are connected. Uses up to twice the coins cache size while a write is in progress (default: %u)"), DEFAULT_COINS_WRITE_BEHIND));
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     if (showDebug) {
         strUsage += HelpMessageOpt("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize));
@@ -487,8 +514,10 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-persistmempool", strprintf(_("Whether to save the mempool on shutdown and load on restart (default: %u)"), DEFAULT_PERSIST_MEMPOOL));
     strUsage += HelpMessageOpt("-syncmempool", strprintf(_("Sync mempool from other nodes on start (default: %u)"), DEFAULT_SYNC_MEMPOOL));
     strUsage += HelpMessageOpt("-blockreconstructionextratxn=<n>", strprintf(_("Extra transactions to keep in memory for compact block reconstructions (default: %u)"), DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN));
-    strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
+    strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script and header verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
+    strUsage += HelpMessageOpt("-prefetchthreads=<n>", strprintf(_("Set the number of threads reading the inputs of blocks about to be connected (0 to %d, 0 = off, default: %d)"),
+        MAX_PREFETCH_THREADS, DEFAULT_PREFETCH_THREADS));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)"), BITCOIN_PID_FILENAME));
 #endif
@@ -497,10 +526,17 @@ std::string HelpMessage(HelpMessageMode mode)
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >%u = automatically prune block files to stay under the specified target size in MiB)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
     strUsage += HelpMessageOpt("-reindex-chainstate", _("Rebuild chain state from the currently indexed blocks"));
     strUsage += HelpMessageOpt("-reindex", _("Rebuild chain state and block index from the blk*.dat files on disk"));
+    strUsage += HelpMessageOpt("-reindexthreads=<n>", strprintf(_("Set the number of threads reading and hashing blk*.dat files ahead of the loader during -reindex (0 to %d, 0 = off, default: %d). "
+        "The files read ahead, up to %u MiB of them, are held deserialized in memory in addition to -dbcache"),
+        MAX_REINDEX_THREADS, DEFAULT_REINDEX_THREADS, MAX_REINDEX_READAHEAD >> 20));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
+    strUsage += HelpMessageOpt("-txadmissionthreads=<n>", strprintf(_("Set the number of threads validating transactions received from peers, which verify scripts without holding the chainstate lock (0 to %d, 0 = off, default: %d)"),
+        MAX_TX_ADMISSION_THREADS, DEFAULT_TX_ADMISSION_THREADS));
+    strUsage += HelpMessageOpt("-trustsnapshot", strprintf(_("Allow loading a UTXO snapshot with loadtxoutset and running on the chainstate of one. The blocks before the snapshot are never validated, the snapshot is trusted to match the hash committed to in the chain parameters (default: %u)"), DEFAULT_TRUST_SNAPSHOT));
     strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), DEFAULT_TXINDEX));
+    strUsage += HelpMessageOpt("-blockfilterindex", strprintf(_("Maintain an index of BIP 158 basic compact block filters, used by the getblockfilter rpc call (default: %u)"), DEFAULT_BLOCKFILTERINDEX));
 
     strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)"), DEFAULT_ADDRESSINDEX));
     strUsage += HelpMessageOpt("-timestampindex", strprintf(_("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps (default: %u)"), DEFAULT_TIMESTAMPINDEX));
@@ -525,10 +561,13 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXRECEIVEBUFFER));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXSENDBUFFER));
     strUsage += HelpMessageOpt("-maxtimeadjustment", strprintf(_("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)"), DEFAULT_MAX_TIME_ADJUSTMENT));
+    strUsage += HelpMessageOpt("-msgshardthreads=<n>", strprintf(_("Set the number of threads processing governance, LLMQ signing and InstantSend messages besides the message handler thread (0 to %d, 0 = off, default: %d)"),
+        MAX_MESSAGE_SHARD_THREADS, DEFAULT_MESSAGE_SHARD_THREADS));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), DEFAULT_PERMIT_BAREMULTISIG));
     strUsage += HelpMessageOpt("-peerbloomfilters", strprintf(_("Support filtering of blocks and transaction with bloom filters (default: %u)"), DEFAULT_PEERBLOOMFILTERS));
+    strUsage += HelpMessageOpt("-peerblockfilters", strprintf(_("Serve compact block filters to peers per BIP 157, requires -blockfilterindex (default: %u)"), DEFAULT_PEERBLOCKFILTERS));
     strUsage += HelpMessageOpt("-port=<port>", strprintf(_("Listen for connections on <port> (default: %u or testnet: %u)"), defaultChainParams->GetDefaultPort(), testnetChainParams->GetDefaultPort()));
     strUsage += HelpMessageOpt("-proxy=<ip:port>", _("Connect through SOCKS5 proxy"));
     strUsage += HelpMessageOpt("-proxyrandomize", strprintf(_("Randomize credentials for every proxy connection. This enables Tor stream isolation (default: %u)"), DEFAULT_PROXYRANDOMIZE));
@@ -588,6 +627,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-limitancestorsize=<n>", strprintf("Do not accept transactions whose size with all in-mempool ancestors exceeds <n> kilobytes (default: %u)", DEFAULT_ANCESTOR_SIZE_LIMIT));
         strUsage += HelpMessageOpt("-limitdescendantcount=<n>", strprintf("Do not accept transactions if any ancestor would have <n> or more in-mempool descendants (default: %u)", DEFAULT_DESCENDANT_LIMIT));
         strUsage += HelpMessageOpt("-limitdescendantsize=<n>", strprintf("Do not accept transactions if any ancestor would have more than <n> kilobytes of in-mempool descendants (default: %u).", DEFAULT_DESCENDANT_SIZE_LIMIT));
+        strUsage += HelpMessageOpt("-limitclustercount=<n>", strprintf("Do not accept transactions that would connect more than <n> in-mempool transactions (default: %u)", DEFAULT_CLUSTER_LIMIT));
         strUsage += HelpMessageOpt("-vbparams=<deployment>:<start>:<end>(:<window>:<threshold>)", "Use given start/end times for specified version bits deployment (regtest-only). Specifying window and threshold is optional.");
         strUsage += HelpMessageOpt("-watchquorums=<n>", strprintf("Watch and validate quorum communication (default: %u)", llmq::DEFAULT_WATCH_QUORUMS));
         strUsage += HelpMessageOpt("-addrmantest", "Allows to test address relay on localhost");
@@ -646,6 +686,14 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-blockmintxfee=<amt>", strprintf(_("Set lowest fee rate (in %s/kB) for transactions to be included in block creation. (default: %s)"), CURRENCY_UNIT, FormatMoney(DEFAULT_BLOCK_MIN_TX_FEE)));
     if (showDebug)
         strUsage += HelpMessageOpt("-blockversion=<n>", "Override block version to test forking scenarios");
+    strUsage += HelpMessageOpt("-minerthreads=<n>", strprintf(_("Set the number of nonce search threads used by generate and generatetoaddress, 0 = one per core (default: %d, maximum: %d)"), DEFAULT_MINER_THREADS, MAX_MINER_THREADS));
+
+    strUsage += HelpMessageGroup(_("Stratum server options:"));
+    strUsage += HelpMessageOpt("-stratum", strprintf(_("Serve mining work to local miners over the stratum protocol (default: %u)"), DEFAULT_STRATUM_ENABLE));
+    strUsage += HelpMessageOpt("-stratumaddress=<addr>", _("Address that receives the block rewards of blocks found through the stratum server"));
+    strUsage += HelpMessageOpt("-stratumbind=<addr>", strprintf(_("Bind the stratum server to the given address (default: %s)"), DEFAULT_STRATUM_BIND));
+    strUsage += HelpMessageOpt("-stratumport=<port>", strprintf(_("Listen for stratum connections on <port> (default: %u)"), DEFAULT_STRATUM_PORT));
+    strUsage += HelpMessageOpt("-stratumdifficulty=<n>", strprintf(_("Share difficulty sent to stratum miners (default: %s)"), DEFAULT_STRATUM_DIFFICULTY));
 
     strUsage += HelpMessageGroup(_("RPC server options:"));
     strUsage += HelpMessageOpt("-server", _("Accept command line and JSON-RPC commands"));
@@ -780,18 +828,8 @@ void ThreadImport(std::vector<fs::path> vImportFiles)
 
     // -reindex
     if (fReindex) {
-        int nFile = 0;
-        while (true) {
-            CDiskBlockPos pos(nFile, 0);
-            if (!fs::exists(GetBlockPosFilename(pos, "blk")))
-                break; // No block files left to reindex
-            FILE *file = OpenBlockFile(pos, true);
-            if (!file)
-                break; // This error is logged in OpenBlockFile
-            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
-            LoadExternalBlockFile(chainparams, file, &pos);
-            nFile++;
-        }
+        int nReindexThreads = std::max(0, std::min<int>(gArgs.GetArg("-reindexthreads", DEFAULT_REINDEX_THREADS), MAX_REINDEX_THREADS));
+        ReindexBlockFiles(chainparams, nReindexThreads);
         pblocktree->WriteReindexing(false);
         fReindex = false;
         LogPrintf("Reindexing finished\n");
@@ -998,18 +1036,6 @@ void InitParameterInteraction()
         }
     }
 
-    // Make sure additional indexes are recalculated correctly in VerifyDB
-    // (we must reconnect blocks whenever we disconnect them for these indexes to work)
-    bool fAdditionalIndexes =
-        gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) ||
-        gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) ||
-        gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
-
-    if (fAdditionalIndexes && gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL) < 4) {
-        gArgs.ForceSetArg("-checklevel", "4");
-        LogPrintf("%s: parameter interaction: additional indexes -> setting -checklevel=4\n", __func__);
-    }
-
     // Warn if network-specific options (-addnode, -connect, etc) are
     // specified in default section of config file, but not overridden
     // on the command line or in this network's section of the config file.
@@ -1117,6 +1143,10 @@ bool AppInitParameterInteraction()
     if (gArgs.GetArg("-prune", 0)) {
         if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex."));
+        if (gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) || gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) || gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX))
+            return InitError(_("Prune mode is incompatible with -addressindex, -spentindex and -timestampindex."));
+        if (gArgs.GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX))
+            return InitError(_("Prune mode is incompatible with -blockfilterindex."));
         if (!gArgs.GetBoolArg("-disablegovernance", false)) {
             return InitError(_("Prune mode is incompatible with -disablegovernance=false."));
         }
@@ -1339,6 +1369,14 @@ bool AppInitParameterInteraction()
     if (gArgs.GetBoolArg("-peerbloomfilters", DEFAULT_PEERBLOOMFILTERS))
         nLocalServices = ServiceFlags(nLocalServices | NODE_BLOOM);
 
+    // Signal NODE_COMPACT_FILTERS if peerblockfilters and basic filters index are both enabled.
+    if (gArgs.GetBoolArg("-peerblockfilters", DEFAULT_PEERBLOCKFILTERS)) {
+        if (!gArgs.GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX)) {
+            return InitError(_("Cannot set -peerblockfilters without -blockfilterindex."));
+        }
+        nLocalServices = ServiceFlags(nLocalServices | NODE_COMPACT_FILTERS);
+    }
+
     g_enable_bip61 = gArgs.GetBoolArg("-enablebip61", DEFAULT_ENABLE_BIP61);
 
     nMaxTipAge = gArgs.GetArg("-maxtipage", DEFAULT_MAX_TIP_AGE);
@@ -1440,6 +1478,29 @@ bool AppInitParameterInteraction()
         UpdateBudgetParameters(nMasternodePaymentsStartBlock, nBudgetPaymentsStartBlock, nSuperblockStartBlock);
     }
 
+    for (const std::string& strSnapshotData : gArgs.GetArgs("-snapshotdata")) {
+        // Allow committing to UTXO snapshots of test chains
+        if (!chainparams.MineBlocksOnDemand()) {
+            return InitError("UTXO snapshots may only be added on regtest.");
+        }
+        std::vector<std::string> vSnapshotData;
+        boost::split(vSnapshotData, strSnapshotData, boost::is_any_of(":"));
+        if (vSnapshotData.size() != 3) {
+            return InitError("UTXO snapshot data malformed, expecting blockHash:snapshotHash:nChainTx");
+        }
+        if (!IsHex(vSnapshotData[0]) || vSnapshotData[0].size() != 64) {
+            return InitError(strprintf("Invalid blockHash (%s)", vSnapshotData[0]));
+        }
+        if (!IsHex(vSnapshotData[1]) || vSnapshotData[1].size() != 64) {
+            return InitError(strprintf("Invalid snapshotHash (%s)", vSnapshotData[1]));
+        }
+        int nChainTx;
+        if (!ParseInt32(vSnapshotData[2], &nChainTx) || nChainTx <= 0) {
+            return InitError(strprintf("Invalid nChainTx (%s)", vSnapshotData[2]));
+        }
+        UpdateSnapshotData(uint256S(vSnapshotData[0]), SnapshotData{uint256S(vSnapshotData[1]), (unsigned int)nChainTx});
+    }
+
     if (chainparams.NetworkIDString() == CBaseChainParams::DEVNET) {
         int nMinimumDifficultyBlocks = gArgs.GetArg("-minimumdifficultyblocks", chainparams.GetConsensus().nMinimumDifficultyBlocks);
         int nHighSubsidyBlocks = gArgs.GetArg("-highsubsidyblocks", chainparams.GetConsensus().nHighSubsidyBlocks);
@@ -1557,6 +1618,8 @@ bool AppInitSanityChecks()
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string x16r_algo = X16RMultiAutoDetect();
+    LogPrintf("Using the '%s' X16R multi-buffer implementation\n", x16r_algo);
     RandomInit();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1621,10 +1684,12 @@ bool AppInitMain()
     InitSignatureCache();
     InitScriptExecutionCache();
 
-    LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
+    LogPrintf("Using %u threads for script and header verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
-        for (int i=0; i<nScriptCheckThreads-1; i++)
+        for (int i=0; i<nScriptCheckThreads-1; i++) {
             threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(&ThreadHeaderCheck);
+        }
     }
 
     std::vector<std::string> vSporkAddresses;
@@ -1798,6 +1863,7 @@ bool AppInitMain()
 
     pdsNotificationInterface = new CDSNotificationInterface(connman);
     RegisterValidationInterface(pdsNotificationInterface);
+    RegisterValidationInterface(&blockTemplateManager);
 
     uint64_t nMaxOutboundLimit = 0; //unlimited unless -maxuploadtarget is set
     uint64_t nMaxOutboundTimeframe = MAX_UPLOAD_TIMEFRAME;
@@ -1826,6 +1892,11 @@ bool AppInitMain()
     int64_t nBlockTreeDBCache = nTotalCache / 8;
     nBlockTreeDBCache = std::min(nBlockTreeDBCache, (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxBlockDBAndTxIndexCache : nMaxBlockDBCache) << 20);
     nTotalCache -= nBlockTreeDBCache;
+    int64_t nBlockFilterIndexCache = 0;
+    if (gArgs.GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX)) {
+        nBlockFilterIndexCache = std::min(nTotalCache / 8, nMaxBlockFilterIndexCache << 20);
+        nTotalCache -= nBlockFilterIndexCache;
+    }
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
@@ -1834,6 +1905,9 @@ bool AppInitMain()
     int64_t nEvoDbCache = 1024 * 1024 * 16; // TODO
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
+    if (nBlockFilterIndexCache > 0) {
+        LogPrintf("* Using %.1fMiB for block filter index database\n", nBlockFilterIndexCache * (1.0 / 1024 / 1024));
+    }
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
@@ -1851,6 +1925,7 @@ bool AppInitMain()
             try {
                 UnloadBlockIndex();
                 pcoinsTip.reset();
+                pcoinsPrefetch.reset();
                 pcoinsdbview.reset();
                 pcoinscatcher.reset();
                 // new CBlockTreeDB tries to delete the existing file, which
@@ -1904,24 +1979,6 @@ bool AppInitMain()
                     break;
                 }
 
-                // Check for changed -addressindex state
-                if (fAddressIndex != gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex to change -addressindex");
-                    break;
-                }
-
-                // Check for changed -timestampindex state
-                if (fTimestampIndex != gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex to change -timestampindex");
-                    break;
-                }
-
-                // Check for changed -spentindex state
-                if (fSpentIndex != gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex to change -spentindex");
-                    break;
-                }
-
                 // Check for changed -prune state.  What we are concerned about is a user who has pruned blocks
                 // in the past, but is now trying to run unpruned.
                 if (fHavePruned && !fPruneMode) {
@@ -1958,7 +2015,8 @@ bool AppInitMain()
                 }
 
                 // The on-disk coinsdb is now in a good state, create the cache
-                pcoinsTip.reset(new CCoinsViewCache(pcoinscatcher.get()));
+                pcoinsPrefetch.reset(new CCoinsViewPrefetch(pcoinscatcher.get(), MAX_PREFETCH_COINS));
+                pcoinsTip.reset(new CCoinsViewCache(pcoinsPrefetch.get()));
 
                 // flush evodb
                 if (!evoDb->CommitRootTransaction()) {
@@ -2047,6 +2105,43 @@ bool AppInitMain()
         LogPrintf(" block index %15dms\n", GetTimeMillis() - nStart);
     }
 
+    if (gArgs.GetBoolArg("-coinswritebehind", DEFAULT_COINS_WRITE_BEHIND)) {
+        LogPrintf("Writing the coins cache in the background\n");
+        pcoinsdbview->StartWriteBehind();
+    }
+
+    int nPrefetchThreads = std::max(0, std::min<int>(gArgs.GetArg("-prefetchthreads", DEFAULT_PREFETCH_THREADS), MAX_PREFETCH_THREADS));
+    LogPrintf("Using %u threads for coins prefetch\n", nPrefetchThreads);
+    StartCoinsPrefetch(nPrefetchThreads);
+
+    // ********************************************************* Step 7c: start indexers
+
+    fAddressIndex = gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+    fSpentIndex = gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
+    fTimestampIndex = gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
+    LogPrintf("addressindex %s, spentindex %s, timestampindex %s\n",
+              fAddressIndex ? "enabled" : "disabled", fSpentIndex ? "enabled" : "disabled", fTimestampIndex ? "enabled" : "disabled");
+
+    if (!UpgradeLegacyIndexFlag("addressindex") || !UpgradeLegacyIndexFlag("spentindex") || !UpgradeLegacyIndexFlag("timestampindex")) {
+        return InitError(_("Failed to upgrade the address, spent and timestamp index state"));
+    }
+    if (fAddressIndex) {
+        g_addressindex = MakeUnique<AddressIndex>();
+        g_addressindex->Start();
+    }
+    if (fSpentIndex) {
+        g_spentindex = MakeUnique<SpentIndex>();
+        g_spentindex->Start();
+    }
+    if (fTimestampIndex) {
+        g_timestampindex = MakeUnique<TimestampIndex>();
+        g_timestampindex->Start();
+    }
+    if (gArgs.GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX)) {
+        g_basic_filter_index = MakeUnique<BlockFilterIndex>(BlockFilterType::BASIC_FILTER, nBlockFilterIndexCache, false, fReindex);
+        g_basic_filter_index->Start();
+    }
+
     fs::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
     CAutoFile est_filein(fsbridge::fopen(est_path, "rb"), SER_DISK, CLIENT_VERSION);
     // Allowed to fail as this file IS missing on first startup.
@@ -2078,6 +2173,17 @@ bool AppInitMain()
         }
     }
 
+    // The blocks before the base of a UTXO snapshot are missing as well
+    if (fLoadedSnapshot) {
+        // Nothing checks the snapshot against the blocks it was taken from
+        if (!gArgs.GetBoolArg("-trustsnapshot", DEFAULT_TRUST_SNAPSHOT)) {
+            return InitError(_("The chainstate was loaded from a UTXO snapshot that was not validated against the block chain. Restart with -trustsnapshot to keep using it, or with -reindex to validate all blocks."));
+        }
+        InitWarning(_("The chainstate was loaded from a UTXO snapshot. The blocks before it were not validated, the snapshot is trusted."));
+        LogPrintf("Unsetting NODE_NETWORK, the chainstate was loaded from a UTXO snapshot\n");
+        nLocalServices = ServiceFlags(nLocalServices & ~NODE_NETWORK);
+    }
+
     // As PruneAndFlush can take several minutes, it's possible the user
     // requested to kill the GUI during the last operation. If so, exit.
     if (fRequestShutdown)
@@ -2184,6 +2290,7 @@ bool AppInitMain()
     scheduler.scheduleEvery(boost::bind(&CNetFulfilledRequestManager::DoMaintenance, boost::ref(netfulfilledman)), 60 * 1000);
     scheduler.scheduleEvery(boost::bind(&CMasternodeSync::DoMaintenance, boost::ref(masternodeSync), boost::ref(*g_connman)), 1 * 1000);
     scheduler.scheduleEvery(boost::bind(&CMasternodeUtils::DoMaintenance, boost::ref(*g_connman)), 1 * 1000);
+    scheduler.scheduleEvery(boost::bind(&CBlockTemplateManager::DoMaintenance, boost::ref(blockTemplateManager)), 1 * 1000);
 
     if (!fDisableGovernance) {
         scheduler.scheduleEvery(boost::bind(&CGovernanceManager::DoMaintenance, boost::ref(governance), boost::ref(*g_connman)), 60 * 5 * 1000);
@@ -2251,6 +2358,9 @@ bool AppInitMain()
     if (gArgs.GetBoolArg("-listenonion", DEFAULT_LISTEN_ONION))
         StartTorControl(threadGroup, scheduler);
 
+    if (gArgs.GetBoolArg("-stratum", DEFAULT_STRATUM_ENABLE) && !StartStratumServer(scheduler))
+        return InitError(_("Unable to start stratum server. See debug log for details."));
+
     Discover(threadGroup);
 
     // Map ports with UPnP
@@ -2324,6 +2434,9 @@ bool AppInitMain()
         return InitError(strprintf(_("Invalid -socketevents ('%s') specified. Only these modes are supported: %s"), strSocketEventsMode, GetSupportedSocketEventsStr()));
     }
 
+    StartTxAdmission(std::max(0, std::min<int>(gArgs.GetArg("-txadmissionthreads", DEFAULT_TX_ADMISSION_THREADS), MAX_TX_ADMISSION_THREADS)));
+    StartMessageShards(std::max(0, std::min<int>(gArgs.GetArg("-msgshardthreads", DEFAULT_MESSAGE_SHARD_THREADS), MAX_MESSAGE_SHARD_THREADS)));
+
     if (!connman.Start(scheduler, connOptions)) {
         return false;
     }
@@ -140,6 +140,7 @@ const CLogCategoryDesc LogCategories[] =
     {BCLog::PRIVATESEND, "privatesend"},
     {BCLog::SPORK, "spork"},
     {BCLog::NETCONN, "netconn"},
+    {BCLog::STRATUM, "stratum"},
     //End Pigeon
 };
 
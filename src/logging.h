@@ -75,6 +75,7 @@ namespace BCLog {
         PRIVATESEND = ((uint64_t)1 << 41),
         SPORK       = ((uint64_t)1 << 42),
         NETCONN     = ((uint64_t)1 << 43),
+        STRATUM     = ((uint64_t)1 << 44),
         //End Pigeon
 
         NET_NETCONN = NET | NETCONN, // use this to have something logged in NET and NETCONN as well
@@ -0,0 +1,79 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <mappedfile.h>
+
+#include <limits>
+
+#ifdef WIN32
+#ifdef _WIN32_WINNT
+#undef _WIN32_WINNT
+#endif
+#define _WIN32_WINNT 0x0501
+#define WIN32_LEAN_AND_MEAN 1
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::shared_ptr<const CMappedFile> CMappedFile::Open(const fs::path& path)
+{
+#ifdef WIN32
+    HANDLE hFile = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    LARGE_INTEGER nFileSize;
+    if (!GetFileSizeEx(hFile, &nFileSize) || nFileSize.QuadPart <= 0 ||
+        (uint64_t)nFileSize.QuadPart > std::numeric_limits<size_t>::max()) {
+        CloseHandle(hFile);
+        return nullptr;
+    }
+    HANDLE hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    // The view keeps the file mapping object and the file open
+    CloseHandle(hFile);
+    if (hMapping == nullptr) {
+        return nullptr;
+    }
+    void* pdata = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(hMapping);
+    if (pdata == nullptr) {
+        return nullptr;
+    }
+    return std::shared_ptr<const CMappedFile>(new CMappedFile((const unsigned char*)pdata, (size_t)nFileSize.QuadPart));
+#else
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || (uint64_t)st.st_size > std::numeric_limits<size_t>::max()) {
+        close(fd);
+        return nullptr;
+    }
+    void* pdata = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps a reference to the file
+    close(fd);
+    if (pdata == MAP_FAILED) {
+        return nullptr;
+    }
+    return std::shared_ptr<const CMappedFile>(new CMappedFile((const unsigned char*)pdata, (size_t)st.st_size));
+#endif
+}
+
+CMappedFile::~CMappedFile()
+{
+#ifdef WIN32
+    UnmapViewOfFile(m_data);
+#else
+    munmap((void*)m_data, m_size);
+#endif
+}
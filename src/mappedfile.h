@@ -0,0 +1,42 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_MAPPEDFILE_H
+#define BITCOIN_MAPPEDFILE_H
+
+#include <fs.h>
+
+#include <memory>
+#include <stddef.h>
+
+/**
+ * A read-only memory mapping of a whole file.
+ *
+ * The mapping stays valid after the file is unlinked, until the last reference
+ * to it is released. Reading beyond the end of a file that was truncated after
+ * it was mapped faults, so only map files that are appended to or truncated
+ * behind the data that is read, like the block files.
+ */
+class CMappedFile
+{
+public:
+    /** Map the file at path. Returns nullptr if the file can not be mapped, e.g. if it is empty. */
+    static std::shared_ptr<const CMappedFile> Open(const fs::path& path);
+
+    ~CMappedFile();
+
+    CMappedFile(const CMappedFile&) = delete;
+    CMappedFile& operator=(const CMappedFile&) = delete;
+
+    const unsigned char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    CMappedFile(const unsigned char* data, size_t size) : m_data(data), m_size(size) {}
+
+    const unsigned char* m_data;
+    size_t m_size;
+};
+
+#endif // BITCOIN_MAPPEDFILE_H
@@ -6,6 +6,7 @@
 
 #include <miner.h>
 
+#include <algo/x21s_hasher.h>
 #include <amount.h>
 #include <chain.h>
 #include <chainparams.h>
@@ -15,6 +16,7 @@
 #include <consensus/merkle.h>
 #include <consensus/validation.h>
 #include <hash.h>
+#include <init.h>
 #include <net.h>
 #include <policy/feerate.h>
 #include <policy/policy.h>
@@ -38,7 +40,9 @@
 #include <llmq/quorums_chainlocks.h>
 
 #include <algorithm>
+#include <atomic>
 #include <queue>
+#include <thread>
 #include <utility>
 
 // Unconfirmed transactions in the memory pool often depend on other
@@ -67,11 +71,13 @@ int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParam
 BlockAssembler::Options::Options() {
     blockMinFeeRate = CFeeRate(DEFAULT_BLOCK_MIN_TX_FEE);
     nBlockMaxSize = DEFAULT_BLOCK_MAX_SIZE;
+    fTestBlockValidity = true;
 }
 
 BlockAssembler::BlockAssembler(const CChainParams& params, const Options& options) : chainparams(params)
 {
     blockMinFeeRate = options.blockMinFeeRate;
+    fTestBlockValidity = options.fTestBlockValidity;
     // Limit size to between 1K and MaxBlockSize()-1K for sanity:
     nBlockMaxSize = std::max((unsigned int)1000, std::min((unsigned int)(MaxBlockSize(fDIP0001ActiveAtTip) - 1000), (unsigned int)options.nBlockMaxSize));
 }
@@ -109,6 +115,79 @@ void BlockAssembler::resetBlock()
     nFees = 0;
 }
 
+/**
+ * Create the coinbase of a block template whose other transactions pay nFees. The CbTx
+ * merkle roots are calculated from the block's transactions, unless fCalcMerkleRoots is
+ * false, then those of the current coinbase are kept.
+ */
+static void CreateCoinbase(CBlockTemplate& blocktemplate, const CBlockIndex* pindexPrev, CAmount nFees, const CScript& scriptPubKeyIn, const CChainParams& chainparams, bool fCalcMerkleRoots)
+{
+    CBlock* pblock = &blocktemplate.block;
+    const int nHeight = pindexPrev->nHeight + 1;
+    bool fDIP0003Active_context = nHeight >= chainparams.GetConsensus().DIP0003Height;
+    bool fDIP0008Active_context = VersionBitsState(pindexPrev, chainparams.GetConsensus(), Consensus::DEPLOYMENT_DIP0008, versionbitscache) == THRESHOLD_ACTIVE;
+
+    // Create coinbase transaction.
+    CMutableTransaction coinbaseTx;
+    coinbaseTx.vin.resize(1);
+    coinbaseTx.vin[0].prevout.SetNull();
+    coinbaseTx.vout.resize(1);
+    coinbaseTx.vout[0].scriptPubKey = scriptPubKeyIn;
+
+    CAmount blockReward = nFees + GetBlockSubsidy(nHeight, chainparams.GetConsensus());
+
+    // Compute regular coinbase transaction.
+    coinbaseTx.vout[0].nValue = blockReward;
+
+    if (!fDIP0003Active_context) {
+        coinbaseTx.vin[0].scriptSig = CScript() << nHeight << OP_0;
+    } else {
+        coinbaseTx.vin[0].scriptSig = CScript() << OP_RETURN;
+
+        coinbaseTx.nVersion = 3;
+        coinbaseTx.nType = TRANSACTION_COINBASE;
+
+        if (!fCalcMerkleRoots) {
+            coinbaseTx.vExtraPayload = pblock->vtx[0]->vExtraPayload;
+        } else {
+            CCbTx cbTx;
+
+            if (fDIP0008Active_context) {
+                cbTx.nVersion = 2;
+            } else {
+                cbTx.nVersion = 1;
+            }
+
+            cbTx.nHeight = nHeight;
+
+            CValidationState state;
+            if (!CalcCbTxMerkleRootMNList(*pblock, pindexPrev, cbTx.merkleRootMNList, state)) {
+                throw std::runtime_error(strprintf("%s: CalcCbTxMerkleRootMNList failed: %s", __func__, FormatStateMessage(state)));
+            }
+            if (fDIP0008Active_context) {
+                if (!CalcCbTxMerkleRootQuorums(*pblock, pindexPrev, cbTx.merkleRootQuorums, state)) {
+                    throw std::runtime_error(strprintf("%s: CalcCbTxMerkleRootQuorums failed: %s", __func__, FormatStateMessage(state)));
+                }
+            }
+
+            SetTxPayload(coinbaseTx, cbTx);
+        }
+    }
+
+    // Update coinbase transaction with additional info about masternode and governance payments,
+    // get some info back to pass to getblocktemplate
+    blocktemplate.voutMasternodePayments.clear();
+    blocktemplate.voutSuperblockPayments.clear();
+    if(nHeight > chainparams.GetConsensus().nMasternodePaymentsStartBlock)
+        FillBlockPayments(coinbaseTx, nHeight, blockReward, blocktemplate.voutMasternodePayments, blocktemplate.voutSuperblockPayments);
+    //Fill founder payment
+    FounderPayment founderPayment = chainparams.GetConsensus().nFounderPayment;
+    founderPayment.FillFounderPayment(coinbaseTx, nHeight, blockReward, pblock->txoutFounder);
+    pblock->vtx[0] = MakeTransactionRef(std::move(coinbaseTx));
+    blocktemplate.vTxFees[0] = -nFees;
+    blocktemplate.vTxSigOps[0] = GetLegacySigOpCount(*pblock->vtx[0]);
+}
+
 std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn)
 {
     int64_t nTimeStart = GetTimeMicros();
@@ -133,7 +212,6 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     nHeight = pindexPrev->nHeight + 1;
 
     bool fDIP0003Active_context = nHeight >= chainparams.GetConsensus().DIP0003Height;
-    bool fDIP0008Active_context = VersionBitsState(chainActive.Tip(), chainparams.GetConsensus(), Consensus::DEPLOYMENT_DIP0008, versionbitscache) == THRESHOLD_ACTIVE;
     pblock->nVersion = ComputeBlockVersion(pindexPrev, chainparams.GetConsensus(), chainparams.BIP9CheckMasternodesUpgraded());
     // -regtest only: allow overriding block.nVersion with
     // -blockversion=N to test forking scenarios
@@ -170,58 +248,7 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     nLastBlockSize = nBlockSize;
     LogPrintf("CreateNewBlock(): total size %u txs: %u fees: %ld sigops %d\n", nBlockSize, nBlockTx, nFees, nBlockSigOps);
 
-    // Create coinbase transaction.
-    CMutableTransaction coinbaseTx;
-    coinbaseTx.vin.resize(1);
-    coinbaseTx.vin[0].prevout.SetNull();
-    coinbaseTx.vout.resize(1);
-    coinbaseTx.vout[0].scriptPubKey = scriptPubKeyIn;
-
-    CAmount blockReward = nFees + GetBlockSubsidy(nHeight, Params().GetConsensus());
-
-    // Compute regular coinbase transaction.
-    coinbaseTx.vout[0].nValue = blockReward;
-
-    if (!fDIP0003Active_context) {
-        coinbaseTx.vin[0].scriptSig = CScript() << nHeight << OP_0;
-    } else {
-        coinbaseTx.vin[0].scriptSig = CScript() << OP_RETURN;
-
-        coinbaseTx.nVersion = 3;
-        coinbaseTx.nType = TRANSACTION_COINBASE;
-
-        CCbTx cbTx;
-
-        if (fDIP0008Active_context) {
-            cbTx.nVersion = 2;
-        } else {
-            cbTx.nVersion = 1;
-        }
-
-        cbTx.nHeight = nHeight;
-
-        CValidationState state;
-        if (!CalcCbTxMerkleRootMNList(*pblock, pindexPrev, cbTx.merkleRootMNList, state)) {
-            throw std::runtime_error(strprintf("%s: CalcCbTxMerkleRootMNList failed: %s", __func__, FormatStateMessage(state)));
-        }
-        if (fDIP0008Active_context) {
-            if (!CalcCbTxMerkleRootQuorums(*pblock, pindexPrev, cbTx.merkleRootQuorums, state)) {
-                throw std::runtime_error(strprintf("%s: CalcCbTxMerkleRootQuorums failed: %s", __func__, FormatStateMessage(state)));
-            }
-        }
-
-        SetTxPayload(coinbaseTx, cbTx);
-    }
-
-    // Update coinbase transaction with additional info about masternode and governance payments,
-    // get some info back to pass to getblocktemplate
-    if(nHeight > chainparams.GetConsensus().nMasternodePaymentsStartBlock)
-        FillBlockPayments(coinbaseTx, nHeight, blockReward, pblocktemplate->voutMasternodePayments, pblocktemplate->voutSuperblockPayments);
-    //Fill founder payment
-    FounderPayment founderPayment = Params().GetConsensus().nFounderPayment;
-    founderPayment.FillFounderPayment(coinbaseTx, nHeight, blockReward, pblock->txoutFounder);
-    pblock->vtx[0] = MakeTransactionRef(std::move(coinbaseTx));
-    pblocktemplate->vTxFees[0] = -nFees;
+    CreateCoinbase(*pblocktemplate, pindexPrev, nFees, scriptPubKeyIn, chainparams, true);
 
     // Fill in header
     pblock->hashPrevBlock  = pindexPrev->GetBlockHash();
@@ -229,10 +256,9 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     pblock->nBits          = GetNextWorkRequired(pindexPrev, pblock, chainparams.GetConsensus());
     pblock->nNonce         = 0;
     pblocktemplate->nPrevBits = pindexPrev->nBits;
-    pblocktemplate->vTxSigOps[0] = GetLegacySigOpCount(*pblock->vtx[0]);
 
     CValidationState state;
-    if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
+    if (fTestBlockValidity && !TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
         throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
     }
     int64_t nTime2 = GetTimeMicros();
@@ -500,11 +526,536 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
         hashPrevBlock = pblock->hashPrevBlock;
     }
     ++nExtraNonce;
+    SetCoinbaseExtraNonce(pblock, pindexPrev, CScriptNum(nExtraNonce).getvch());
+}
+
+void SetCoinbaseExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, const std::vector<unsigned char>& vchExtraNonce)
+{
     unsigned int nHeight = pindexPrev->nHeight+1; // Height first in coinbase required for block.version=2
     CMutableTransaction txCoinbase(*pblock->vtx[0]);
-    txCoinbase.vin[0].scriptSig = (CScript() << nHeight << CScriptNum(nExtraNonce)) + COINBASE_FLAGS;
+    txCoinbase.vin[0].scriptSig = (CScript() << nHeight << vchExtraNonce) + COINBASE_FLAGS;
     assert(txCoinbase.vin[0].scriptSig.size() <= 100);
 
     pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
     pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
 }
+
+int GetMinerThreads()
+{
+    int nThreads = gArgs.GetArg("-minerthreads", DEFAULT_MINER_THREADS);
+    if (nThreads <= 0) {
+        nThreads = GetNumCores();
+    }
+    return std::max(1, std::min(nThreads, MAX_MINER_THREADS));
+}
+
+/** Nonces handed to a nonce search thread at a time */
+static const uint64_t NONCE_SEARCH_CHUNK = 0x400;
+
+static std::atomic<uint64_t> nMinerLastHashes(0);
+static std::atomic<int64_t> nMinerLastMicros(0);
+
+bool ScanBlockNonces(CBlockHeader* pblock, uint32_t nNonceEnd, uint64_t& nMaxTries, int nThreads, const Consensus::Params& consensusParams)
+{
+    const uint64_t nNonceBegin = pblock->nNonce;
+    const int64_t nTimeStart = GetTimeMicros();
+
+    std::atomic<uint64_t> nNextChunk(0);
+    std::atomic<uint64_t> nTries(0);
+    // lowest nonce found so far, or nNonceEnd if none
+    std::atomic<uint64_t> nFound(nNonceEnd);
+
+    auto worker = [&]() {
+        // consecutive nonces share the algorithm order, so every step of the
+        // chain runs all lanes through the same multi-buffer kernel
+        std::vector<CBlockHeader> vHeaders(X16R_MAX_LANES, *pblock);
+        const CBlockHeader* headers[X16R_MAX_LANES];
+        uint256 hashes[X16R_MAX_LANES];
+        for (size_t i = 0; i < X16R_MAX_LANES; i++) {
+            headers[i] = &vHeaders[i];
+        }
+        while (true) {
+            const uint64_t nBegin = nNonceBegin + nNextChunk.fetch_add(1) * NONCE_SEARCH_CHUNK;
+            const uint64_t nEnd = std::min(nBegin + NONCE_SEARCH_CHUNK, (uint64_t)nNonceEnd);
+            if (nBegin >= nFound.load()) {
+                return;
+            }
+            for (uint64_t nNonce = nBegin; nNonce < nEnd; nNonce += X16R_MAX_LANES) {
+                if (nNonce >= nFound.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                uint64_t nLanes = std::min<uint64_t>(X16R_MAX_LANES, nEnd - nNonce);
+                const uint64_t nTriesBefore = nTries.fetch_add(nLanes, std::memory_order_relaxed);
+                if (nTriesBefore >= nMaxTries) {
+                    return;
+                }
+                nLanes = std::min(nLanes, nMaxTries - nTriesBefore);
+                for (uint64_t i = 0; i < nLanes; i++) {
+                    vHeaders[i].nNonce = nNonce + i;
+                }
+                CBlockHeader::GetHashes(headers, hashes, nLanes);
+                for (uint64_t i = 0; i < nLanes; i++) {
+                    if (CheckProofOfWork(hashes[i], vHeaders[i].nBits, consensusParams)) {
+                        const uint64_t nSolution = nNonce + i;
+                        uint64_t nPrev = nFound.load();
+                        while (nSolution < nPrev && !nFound.compare_exchange_weak(nPrev, nSolution)) {}
+                        return;
+                    }
+                }
+            }
+        }
+    };
+
+    if (nThreads <= 1 || nNonceEnd - nNonceBegin <= NONCE_SEARCH_CHUNK) {
+        worker();
+    } else {
+        std::vector<std::thread> threads;
+        threads.reserve(nThreads);
+        for (int i = 0; i < nThreads; i++) {
+            threads.emplace_back(worker);
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    // workers overshoot the budget by at most one batch each
+    const uint64_t nHashes = std::min(nTries.load(), nMaxTries);
+    nMaxTries -= nHashes;
+    nMinerLastHashes = nHashes;
+    nMinerLastMicros = std::max<int64_t>(1, GetTimeMicros() - nTimeStart);
+
+    if (nFound.load() < nNonceEnd) {
+        pblock->nNonce = nFound.load();
+        return true;
+    }
+    pblock->nNonce = nNonceEnd;
+    return false;
+}
+
+double GetMinerHashesPerSec()
+{
+    return nMinerLastHashes.load() * 1000000.0 / std::max<int64_t>(1, nMinerLastMicros.load());
+}
+
+CBlockTemplateManager blockTemplateManager;
+
+void CBlockTemplateManager::Rebuild(bool fRequest)
+{
+    AssertLockHeld(cs_main);
+
+    const int64_t nTimeStart = GetTimeMicros();
+    const CBlockIndex* pindexPrevNew = chainActive.Tip();
+    const unsigned int nTransactionsUpdatedNew = mempool.GetTransactionsUpdated();
+
+    // a requested template is handed out right away, background builds are only checked when they are
+    BlockAssembler::Options options = DefaultOptions(Params());
+    options.fTestBlockValidity = fRequest;
+    BlockAssembler assembler(Params(), options);
+    CScript scriptDummy = CScript() << OP_TRUE;
+    std::shared_ptr<const CBlockTemplate> pblocktemplateNew = assembler.CreateNewBlock(scriptDummy);
+    if (!pblocktemplateNew) {
+        return;
+    }
+
+    // Remember the selection to apply mempool changes to it. The quorum commitments
+    // are not mempool transactions and stay in the template until the next tip.
+    mapTemplateTx.clear();
+    nBlockSize = 1000;
+    nBlockSigOps = 100;
+    nFees = 0;
+    nHeight = assembler.GetHeight();
+    nLockTimeCutoff = assembler.GetLockTimeCutoff();
+    nBlockMaxSize = assembler.GetBlockMaxSize();
+    blockMinFeeRate = assembler.GetBlockMinFeeRate();
+    {
+        LOCK(mempool.cs);
+        const std::vector<CTransactionRef>& vtx = pblocktemplateNew->block.vtx;
+        for (size_t i = 1; i < vtx.size(); i++) {
+            CTxMemPool::txiter it = mempool.mapTx.find(vtx[i]->GetHash());
+            if (it == mempool.mapTx.end()) {
+                nBlockSize += vtx[i]->GetTotalSize();
+                continue;
+            }
+            for (const CTxIn& txin : vtx[i]->vin) {
+                auto parent = mapTemplateTx.find(txin.prevout.hash);
+                if (parent != mapTemplateTx.end()) {
+                    parent->second.nChildren++;
+                }
+            }
+            mapTemplateTx.emplace(vtx[i]->GetHash(), TemplateTx{vtx[i], it->GetModifiedFee(), (unsigned int)it->GetTxSize(), it->GetSigOpCount(), 0});
+            nBlockSize += it->GetTxSize();
+            nBlockSigOps += it->GetSigOpCount();
+            nFees += it->GetFee();
+        }
+    }
+    const int64_t nBuildMicros = GetTimeMicros() - nTimeStart;
+
+    LOCK(cs);
+    pblocktemplate = pblocktemplateNew;
+    pindexPrev = pindexPrevNew;
+    nTransactionsUpdated = nTransactionsUpdatedNew;
+    fValidated = fRequest;
+    stats.nTimeCreated = GetTime();
+    stats.nTimeUpdated = stats.nTimeCreated;
+    stats.nLastBuildMicros = nBuildMicros;
+    stats.nTotalBuildMicros += nBuildMicros;
+    stats.nBuilds++;
+    if (fRequest) {
+        stats.nRequestBuilds++;
+    }
+    stats.nTx = pblocktemplate->block.vtx.size() - 1;
+    LogPrint(BCLog::BENCHMARK, "%s: template for height %d built in %.2fms (%u txs)\n", __func__, pindexPrev->nHeight + 1, 0.001 * nBuildMicros, stats.nTx);
+}
+
+void CBlockTemplateManager::Update(const CTransactionRef& ptx, bool fAdded)
+{
+    {
+        LOCK(cs);
+        if (!pblocktemplate) {
+            return;
+        }
+    }
+    if (ShutdownRequested()) {
+        return;
+    }
+
+    try {
+        LOCK(cs_main);
+        const int64_t nTimeStart = GetTimeMicros();
+
+        std::unique_ptr<CBlockTemplate> pblocktemplateNew;
+        {
+            LOCK(cs);
+            // a template of another tip is rebuilt by the new tip
+            if (!pblocktemplate || pindexPrev != chainActive.Tip()) {
+                return;
+            }
+            pblocktemplateNew.reset(new CBlockTemplate(*pblocktemplate));
+        }
+
+        bool fChanged = false;
+        bool fSpecialTxs = false;
+        unsigned int nTransactionsUpdatedNew;
+        {
+            LOCK(mempool.cs);
+            const uint256& hash = ptx->GetHash();
+            if (fAdded) {
+                CTxMemPool::txiter it = mempool.mapTx.find(hash);
+                if (!mapTemplateTx.count(hash) && it != mempool.mapTx.end()) {
+                    fChanged = AddPackage(*pblocktemplateNew, it, true, fSpecialTxs);
+                }
+            } else if (mapTemplateTx.count(hash)) {
+                RemoveTxs(*pblocktemplateNew, {hash}, fSpecialTxs);
+                Refill(*pblocktemplateNew, fSpecialTxs);
+                fChanged = true;
+            }
+            nTransactionsUpdatedNew = mempool.GetTransactionsUpdated();
+        }
+
+        // the CbTx merkle root of the masternode list only depends on the special transactions
+        if (fChanged) {
+            const CScript scriptPubKey = pblocktemplateNew->block.vtx[0]->vout[0].scriptPubKey;
+            CreateCoinbase(*pblocktemplateNew, chainActive.Tip(), nFees, scriptPubKey, Params(), fSpecialTxs);
+        }
+        const int64_t nUpdateMicros = GetTimeMicros() - nTimeStart;
+
+        LOCK(cs);
+        nTransactionsUpdated = nTransactionsUpdatedNew;
+        if (!fChanged) {
+            return;
+        }
+        pblocktemplate = std::move(pblocktemplateNew);
+        fValidated = false;
+        stats.nTimeUpdated = GetTime();
+        stats.nLastUpdateMicros = nUpdateMicros;
+        stats.nTotalUpdateMicros += nUpdateMicros;
+        stats.nUpdates++;
+        stats.nTx = pblocktemplate->block.vtx.size() - 1;
+    } catch (const std::exception& e) {
+        LogPrintf("%s: failed to update block template: %s\n", __func__, e.what());
+        // the selection state no longer matches the template, the next request builds a new one
+        LOCK(cs);
+        pblocktemplate.reset();
+        pindexPrev = nullptr;
+    }
+}
+
+bool CBlockTemplateManager::AddPackage(CBlockTemplate& blocktemplate, CTxMemPool::txiter iter, bool fEvict, bool& fSpecialTxs)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(mempool.cs);
+
+    CTxMemPool::setEntries ancestors;
+    uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+    std::string dummy;
+    mempool.CalculateMemPoolAncestors(*iter, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
+
+    // the ancestors already in the template must stay, the others join the package
+    std::set<uint256> setInBlock;
+    CTxMemPool::setEntries package;
+    for (CTxMemPool::txiter it : ancestors) {
+        if (mapTemplateTx.count(it->GetTx().GetHash())) {
+            setInBlock.insert(it->GetTx().GetHash());
+        } else {
+            package.insert(it);
+        }
+    }
+    package.insert(iter);
+
+    uint64_t nPackageSize = 0;
+    CAmount nPackageFees = 0;
+    unsigned int nPackageSigOps = 0;
+    for (CTxMemPool::txiter it : package) {
+        nPackageSize += it->GetTxSize();
+        nPackageFees += it->GetModifiedFee();
+        nPackageSigOps += it->GetSigOpCount();
+    }
+    if (nPackageFees < blockMinFeeRate.GetFee(nPackageSize)) {
+        return false;
+    }
+    for (CTxMemPool::txiter it : package) {
+        if (!IsFinalTx(it->GetTx(), nHeight, nLockTimeCutoff) || !llmq::chainLocksHandler->IsTxSafeForMining(it->GetTx().GetHash())) {
+            return false;
+        }
+    }
+
+    uint64_t nFreedSize = 0;
+    unsigned int nFreedSigOps = 0;
+    auto fits = [&]() {
+        return nBlockSize - nFreedSize + nPackageSize < nBlockMaxSize &&
+               nBlockSigOps - nFreedSigOps + nPackageSigOps < MaxBlockSigOps(fDIP0001ActiveAtTip);
+    };
+    if (!fits()) {
+        if (!fEvict) {
+            return false;
+        }
+
+        // Evict the transactions of the lowest fee rate that nothing in the template
+        // spends, as long as they pay a lower fee rate than the package
+        auto cmp = [this](const uint256& a, const uint256& b) {
+            const TemplateTx& txa = mapTemplateTx.at(a);
+            const TemplateTx& txb = mapTemplateTx.at(b);
+            return txa.nModFee * (int64_t)txb.nSize > txb.nModFee * (int64_t)txa.nSize;
+        };
+        std::priority_queue<uint256, std::vector<uint256>, decltype(cmp)> leaves(cmp);
+        for (const auto& entry : mapTemplateTx) {
+            if (entry.second.nChildren == 0 && !setInBlock.count(entry.first)) {
+                leaves.push(entry.first);
+            }
+        }
+        std::set<uint256> setEvict;
+        std::map<uint256, unsigned int> mapEvictedChildren;
+        while (!fits()) {
+            if (leaves.empty()) {
+                return false;
+            }
+            const uint256 hash = leaves.top();
+            leaves.pop();
+            const TemplateTx& entry = mapTemplateTx.at(hash);
+            if (entry.nModFee * (int64_t)nPackageSize >= nPackageFees * (int64_t)entry.nSize) {
+                return false;
+            }
+            setEvict.insert(hash);
+            nFreedSize += entry.nSize;
+            nFreedSigOps += entry.nSigOps;
+            // a parent whose spenders are all evicted can go as well
+            for (const CTxIn& txin : entry.tx->vin) {
+                auto parent = mapTemplateTx.find(txin.prevout.hash);
+                if (parent != mapTemplateTx.end() && ++mapEvictedChildren[parent->first] == parent->second.nChildren &&
+                        !setInBlock.count(parent->first)) {
+                    leaves.push(parent->first);
+                }
+            }
+        }
+        RemoveTxs(blocktemplate, setEvict, fSpecialTxs);
+    }
+
+    // Append the package in a valid order, everything it spends from the template comes before it
+    std::vector<CTxMemPool::txiter> sortedEntries(package.begin(), package.end());
+    std::sort(sortedEntries.begin(), sortedEntries.end(), CompareTxIterByAncestorCount());
+    for (CTxMemPool::txiter it : sortedEntries) {
+        const CTransaction& tx = it->GetTx();
+        blocktemplate.block.vtx.emplace_back(it->GetSharedTx());
+        blocktemplate.vTxFees.push_back(it->GetFee());
+        blocktemplate.vTxSigOps.push_back(it->GetSigOpCount());
+        for (const CTxIn& txin : tx.vin) {
+            auto parent = mapTemplateTx.find(txin.prevout.hash);
+            if (parent != mapTemplateTx.end()) {
+                parent->second.nChildren++;
+            }
+        }
+        mapTemplateTx.emplace(tx.GetHash(), TemplateTx{it->GetSharedTx(), it->GetModifiedFee(), (unsigned int)it->GetTxSize(), it->GetSigOpCount(), 0});
+        nBlockSize += it->GetTxSize();
+        nBlockSigOps += it->GetSigOpCount();
+        nFees += it->GetFee();
+        if (tx.nVersion == 3 && tx.nType != TRANSACTION_NORMAL) {
+            fSpecialTxs = true;
+        }
+    }
+    return true;
+}
+
+void CBlockTemplateManager::RemoveTxs(CBlockTemplate& blocktemplate, std::set<uint256> setRemove, bool& fSpecialTxs)
+{
+    AssertLockHeld(cs_main);
+
+    // the transactions spending removed ones come after them in the block
+    std::vector<CTransactionRef>& vtx = blocktemplate.block.vtx;
+    size_t nKept = 1;
+    for (size_t i = 1; i < vtx.size(); i++) {
+        const CTransaction& tx = *vtx[i];
+        auto it = mapTemplateTx.find(tx.GetHash());
+        bool fRemove = it != mapTemplateTx.end() && setRemove.count(tx.GetHash());
+        for (size_t j = 0; !fRemove && it != mapTemplateTx.end() && j < tx.vin.size(); j++) {
+            fRemove = setRemove.count(tx.vin[j].prevout.hash);
+        }
+        if (!fRemove) {
+            vtx[nKept] = vtx[i];
+            blocktemplate.vTxFees[nKept] = blocktemplate.vTxFees[i];
+            blocktemplate.vTxSigOps[nKept] = blocktemplate.vTxSigOps[i];
+            nKept++;
+            continue;
+        }
+
+        setRemove.insert(tx.GetHash());
+        for (const CTxIn& txin : tx.vin) {
+            auto parent = mapTemplateTx.find(txin.prevout.hash);
+            if (parent != mapTemplateTx.end()) {
+                parent->second.nChildren--;
+            }
+        }
+        nBlockSize -= it->second.nSize;
+        nBlockSigOps -= it->second.nSigOps;
+        nFees -= blocktemplate.vTxFees[i];
+        if (tx.nVersion == 3 && tx.nType != TRANSACTION_NORMAL) {
+            fSpecialTxs = true;
+        }
+        mapTemplateTx.erase(it);
+    }
+    vtx.resize(nKept);
+    blocktemplate.vTxFees.resize(nKept);
+    blocktemplate.vTxSigOps.resize(nKept);
+}
+
+void CBlockTemplateManager::Refill(CBlockTemplate& blocktemplate, bool& fSpecialTxs)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(mempool.cs);
+
+    // everything in the mempool is in the template already
+    if (mapTemplateTx.size() >= mempool.mapTx.size()) {
+        return;
+    }
+
+    // Walk the mempool by ancestor fee rate like addPackageTxs. Transactions with
+    // ancestors in the template have a stale ancestor fee rate there, so the order
+    // only approximates the one of CreateNewBlock.
+    const int64_t MAX_CONSECUTIVE_FAILURES = 1000;
+    int64_t nConsecutiveFailed = 0;
+    for (auto mi = mempool.mapTx.get<ancestor_score>().begin(); mi != mempool.mapTx.get<ancestor_score>().end(); ++mi) {
+        if (mapTemplateTx.count(mi->GetTx().GetHash())) {
+            continue;
+        }
+        if (mi->GetModFeesWithAncestors() < blockMinFeeRate.GetFee(mi->GetSizeWithAncestors())) {
+            break;
+        }
+        if (AddPackage(blocktemplate, mempool.mapTx.project<0>(mi), false, fSpecialTxs)) {
+            nConsecutiveFailed = 0;
+        } else if (++nConsecutiveFailed > MAX_CONSECUTIVE_FAILURES && nBlockSize > nBlockMaxSize - 1000) {
+            break;
+        }
+    }
+}
+
+std::unique_ptr<CBlockTemplate> CBlockTemplateManager::GetBlockTemplate(const CBlockIndex* pindexPrevIn, unsigned int& nTransactionsUpdatedRet)
+{
+    AssertLockHeld(cs_main);
+    nTimeLastRequest = GetTime();
+
+    bool fRebuild;
+    {
+        LOCK(cs);
+        stats.nRequests++;
+        fRebuild = !pblocktemplate || pindexPrev != pindexPrevIn;
+    }
+    if (fRebuild) {
+        Rebuild(true);
+    }
+
+    LOCK(cs);
+    if (!pblocktemplate || pindexPrev != pindexPrevIn || pindexPrev != chainActive.Tip()) {
+        return nullptr;
+    }
+    if (!fValidated) {
+        CValidationState state;
+        if (!TestBlockValidity(state, Params(), pblocktemplate->block, chainActive.Tip(), false, false)) {
+            throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
+        }
+        fValidated = true;
+    }
+    nTransactionsUpdatedRet = nTransactionsUpdated;
+    // the caller updates the header, so hand out a copy; the transactions are shared
+    return std::unique_ptr<CBlockTemplate>(new CBlockTemplate(*pblocktemplate));
+}
+
+bool CBlockTemplateManager::IsActive() const
+{
+    const int64_t nTime = nTimeLastRequest;
+    return nTime != 0 && GetTime() - nTime < BLOCK_TEMPLATE_IDLE_TIMEOUT;
+}
+
+void CBlockTemplateManager::DoMaintenance()
+{
+    if (IsActive()) {
+        return;
+    }
+    {
+        LOCK(cs);
+        if (!pblocktemplate) {
+            return;
+        }
+    }
+
+    LOCK2(cs_main, cs);
+    if (!pblocktemplate || IsActive()) {
+        return;
+    }
+    LogPrint(BCLog::BENCHMARK, "%s: no template requests for %d seconds, dropping the template\n", __func__, BLOCK_TEMPLATE_IDLE_TIMEOUT);
+    pblocktemplate.reset();
+    pindexPrev = nullptr;
+    mapTemplateTx.clear();
+}
+
+CBlockTemplateManager::Stats CBlockTemplateManager::GetStats() const
+{
+    LOCK(cs);
+    return stats;
+}
+
+void CBlockTemplateManager::TransactionAddedToMempool(const CTransactionRef& ptx, int64_t nAcceptTime)
+{
+    Update(ptx, true);
+}
+
+void CBlockTemplateManager::TransactionRemovedFromMempool(const CTransactionRef& ptx)
+{
+    Update(ptx, false);
+}
+
+void CBlockTemplateManager::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+{
+    if (!IsActive() || fInitialDownload || ShutdownRequested()) {
+        return;
+    }
+
+    // have the template for the new tip ready before miners ask for it, it is checked when it is handed out
+    try {
+        LOCK(cs_main);
+        if (chainActive.Tip() == pindexNew) {
+            Rebuild(false);
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("%s: failed to build block template: %s\n", __func__, e.what());
+    }
+}
@@ -7,11 +7,16 @@
 #define BITCOIN_MINER_H
 
 #include <primitives/block.h>
+#include <sync.h>
 #include <txmempool.h>
 #include <validation.h>
+#include <validationinterface.h>
 
 #include <stdint.h>
+#include <atomic>
+#include <map>
 #include <memory>
+#include <set>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 
@@ -23,6 +28,14 @@ class CScript;
 namespace Consensus { struct Params; };
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+/** Default for -minerthreads, 0 means one thread per core */
+static const int DEFAULT_MINER_THREADS = 0;
+/** Maximum number of nonce search threads */
+static const int MAX_MINER_THREADS = 64;
+/** Seconds a stratum job may lag behind the mempool */
+static const int64_t BLOCK_TEMPLATE_MAX_AGE = 5;
+/** Seconds without a template request after which the template is no longer maintained */
+static const int64_t BLOCK_TEMPLATE_IDLE_TIMEOUT = 60;
 
 struct CBlockTemplate
 {
@@ -135,6 +148,7 @@ private:
     // Configuration parameters for the block size
     unsigned int nBlockMaxSize;
     CFeeRate blockMinFeeRate;
+    bool fTestBlockValidity;
 
     // Information on the current status of the block
     uint64_t nBlockSize;
@@ -153,6 +167,8 @@ public:
         Options();
         size_t nBlockMaxSize;
         CFeeRate blockMinFeeRate;
+        // Check the block with TestBlockValidity before returning it
+        bool fTestBlockValidity;
     };
 
     explicit BlockAssembler(const CChainParams& params);
@@ -161,6 +177,12 @@ public:
     /** Construct a new block template with coinbase to scriptPubKeyIn */
     std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn);
 
+    /** Limits and chain context of the last block created, to update its template later */
+    uint64_t GetBlockMaxSize() const { return nBlockMaxSize; }
+    CFeeRate GetBlockMinFeeRate() const { return blockMinFeeRate; }
+    int GetHeight() const { return nHeight; }
+    int64_t GetLockTimeCutoff() const { return nLockTimeCutoff; }
+
 private:
     // utility functions
     /** Clear the block's state and prepare for assembling a new block */
@@ -195,8 +217,133 @@ private:
     int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
 };
 
+/**
+ * Maintains the getblocktemplate candidate block in the background.
+ *
+ * The template is built from scratch when it is first requested and on every
+ * new tip. In between it follows the mempool: the package of a transaction
+ * added to the mempool is appended to the template if it pays the minimum fee
+ * rate, evicting transactions of a lower fee rate that nothing else in the
+ * template spends if the block is full. A transaction removed from the
+ * mempool is dropped together with the transactions of the template spending
+ * it, and the space is refilled with the best packages of the mempool. The
+ * result approximates the selection of CreateNewBlock until the next tip.
+ *
+ * Templates are not checked with TestBlockValidity until they are handed out.
+ * After BLOCK_TEMPLATE_IDLE_TIMEOUT seconds without requests the template is
+ * dropped and nothing is maintained until the next request.
+ */
+class CBlockTemplateManager : public CValidationInterface
+{
+public:
+    struct Stats {
+        int64_t nTimeCreated{0};
+        int64_t nTimeUpdated{0};
+        int64_t nLastBuildMicros{0};
+        int64_t nTotalBuildMicros{0};
+        uint64_t nBuilds{0};
+        uint64_t nRequests{0};
+        uint64_t nRequestBuilds{0};
+        int64_t nLastUpdateMicros{0};
+        int64_t nTotalUpdateMicros{0};
+        uint64_t nUpdates{0};
+        size_t nTx{0};
+    };
+
+    /**
+     * Returns a template on top of pindexPrev, building one if there is none
+     * for it. nTransactionsUpdatedRet is set to the mempool update counter as
+     * of the last mempool change applied to the template.
+     */
+    std::unique_ptr<CBlockTemplate> GetBlockTemplate(const CBlockIndex* pindexPrev, unsigned int& nTransactionsUpdatedRet) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /** Drop the template if nobody asked for one within BLOCK_TEMPLATE_IDLE_TIMEOUT seconds */
+    void DoMaintenance();
+
+    Stats GetStats() const;
+
+    /** Whether a template was requested within the last BLOCK_TEMPLATE_IDLE_TIMEOUT seconds */
+    bool IsActive() const;
+
+protected:
+    void TransactionAddedToMempool(const CTransactionRef& ptx, int64_t nAcceptTime) override;
+    void TransactionRemovedFromMempool(const CTransactionRef& ptx) override;
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override;
+
+private:
+    /** A mempool transaction of the current template */
+    struct TemplateTx {
+        CTransactionRef tx;
+        CAmount nModFee;
+        unsigned int nSize;
+        unsigned int nSigOps;
+        /** Number of inputs of other template transactions spending this one */
+        unsigned int nChildren;
+    };
+
+    void Rebuild(bool fRequest) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    /** Apply a mempool change to a copy of the current template and publish it */
+    void Update(const CTransactionRef& ptx, bool fAdded);
+    /**
+     * Append the package of iter to the template if it pays the minimum fee rate and is
+     * final. If it does not fit and fEvict is set, transactions of a lower fee rate that
+     * are not spent within the template are evicted to make room.
+     */
+    bool AddPackage(CBlockTemplate& blocktemplate, CTxMemPool::txiter iter, bool fEvict, bool& fSpecialTxs) EXCLUSIVE_LOCKS_REQUIRED(cs_main, mempool.cs);
+    /** Remove the transactions of setRemove and those of the template spending them */
+    void RemoveTxs(CBlockTemplate& blocktemplate, std::set<uint256> setRemove, bool& fSpecialTxs) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    /** Fill the space left in the template with the best packages of the mempool */
+    void Refill(CBlockTemplate& blocktemplate, bool& fSpecialTxs) EXCLUSIVE_LOCKS_REQUIRED(cs_main, mempool.cs);
+
+    mutable CCriticalSection cs;
+    std::shared_ptr<const CBlockTemplate> pblocktemplate GUARDED_BY(cs);
+    const CBlockIndex* pindexPrev GUARDED_BY(cs){nullptr};
+    unsigned int nTransactionsUpdated GUARDED_BY(cs){0};
+    // passed TestBlockValidity, which background builds and updates skip
+    bool fValidated GUARDED_BY(cs){false};
+    Stats stats GUARDED_BY(cs);
+
+    // selection state of the current template, only changed with cs_main held
+    std::map<uint256, TemplateTx> mapTemplateTx GUARDED_BY(cs_main);
+    uint64_t nBlockSize GUARDED_BY(cs_main){0};
+    unsigned int nBlockSigOps GUARDED_BY(cs_main){0};
+    CAmount nFees GUARDED_BY(cs_main){0};
+    // chain context and limits of the last full build
+    int nHeight GUARDED_BY(cs_main){0};
+    int64_t nLockTimeCutoff GUARDED_BY(cs_main){0};
+    uint64_t nBlockMaxSize GUARDED_BY(cs_main){0};
+    CFeeRate blockMinFeeRate GUARDED_BY(cs_main);
+
+    // only maintained while somebody asks for templates
+    std::atomic<int64_t> nTimeLastRequest{0};
+
+    friend struct BlockTemplateManagerTest;
+};
+
+extern CBlockTemplateManager blockTemplateManager;
+
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
+/** Push vchExtraNonce after the height in the coinbase scriptSig and update the merkle root */
+void SetCoinbaseExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, const std::vector<unsigned char>& vchExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
 
+/** Number of nonce search threads, from -minerthreads */
+int GetMinerThreads();
+
+/**
+ * Search the nonces from pblock->nNonce up to (excluding) nNonceEnd for one
+ * that satisfies the proof of work, on nThreads worker threads. Every
+ * hash counts against nMaxTries, which is decreased accordingly.
+ *
+ * The nonce range is handed out in chunks and the workers stop as soon as
+ * a solution below their position is known, so the lowest valid nonce is
+ * returned, as a serial search would. Returns true with pblock->nNonce set
+ * to the solution; otherwise pblock->nNonce is left at nNonceEnd.
+ */
+bool ScanBlockNonces(CBlockHeader* pblock, uint32_t nNonceEnd, uint64_t& nMaxTries, int nThreads, const Consensus::Params& consensusParams);
+
+/** Hash rate of the most recent nonce search, in hashes per second */
+double GetMinerHashesPerSec();
+
 #endif // BITCOIN_MINER_H
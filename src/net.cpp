@@ -33,6 +33,7 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <sys/uio.h>
 #endif
 
 #ifdef USE_POLL
@@ -60,6 +61,17 @@
 // We add a random period time (0 to 1 seconds) to feeler connections to prevent synchronization.
 #define FEELER_SLEEP_WINDOW 1
 
+#ifndef WIN32
+// Maximum number of queued buffers that SocketSendData passes to a single sendmsg() call
+static const int MAX_SEND_IOVECS = 64;
+#endif
+
+// Unsent bytes up to which ScheduleSendMsgs fixes the order of queued messages. A larger
+// message is only scheduled once everything before it was sent.
+static const size_t SEND_SCHEDULE_BYTES = 64 * 1024;
+// Bytes that each send priority class may send per deficit round robin round
+static const std::array<size_t, SEND_PRIORITY_COUNT> SEND_PRIORITY_QUANTUM = {64 * 1024, 32 * 1024, 16 * 1024};
+
 #if !defined(HAVE_MSG_NOSIGNAL)
 #define MSG_NOSIGNAL 0
 #endif
@@ -781,6 +793,15 @@ void CNode::copyStats(CNodeStats &stats)
         LOCK(cs_vSend);
         X(mapSendBytesPerMsgCmd);
         X(nSendBytes);
+        for (int i = 0; i < SEND_PRIORITY_COUNT; i++) {
+            const CSendQueue& queue = vSendQueues[i];
+            CNodeStats::SendQueueStats& queueStats = stats.vSendQueueStats[i];
+            queueStats.nQueued = queue.msgs.size();
+            queueStats.nQueuedBytes = queue.nBytes;
+            queueStats.nSent = queue.nSent;
+            queueStats.dAvgWait = queue.nSent ? queue.nWaitUsecTotal * 0.000001 / queue.nSent : 0;
+            queueStats.dMaxWait = queue.nWaitUsecMax * 0.000001;
+        }
     }
     {
         LOCK(cs_vRecv);
@@ -817,7 +838,7 @@ void CNode::copyStats(CNodeStats &stats)
 }
 #undef X
 
-bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete)
+bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete, CNetMessagePool& pool)
 {
     complete = false;
     int64_t nTimeMicros = GetTimeMicros();
@@ -829,7 +850,7 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
         // get current incomplete message, or create a new one
         if (vRecvMsg.empty() ||
             vRecvMsg.back().complete())
-            vRecvMsg.push_back(CNetMessage(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION));
+            pool.Get(vRecvMsg, Params().MessageStart());
 
         CNetMessage& msg = vRecvMsg.back();
 
@@ -837,6 +858,9 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
         int handled;
         if (!msg.in_data) {
             handled = msg.readHeader(pch, nBytes);
+            if (msg.in_data) {
+                pool.ReserveData(msg);
+            }
         } else {
             handled = msg.readData(pch, nBytes);
         }
@@ -935,7 +959,11 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
 
     if (vRecv.size() < nDataPos + nCopy) {
         // Allocate up to 256 KiB ahead, but never more than the total message size.
-        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024));
+        const unsigned int nSize = std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024);
+        if (nSize > vRecv.capacity()) {
+            nDataAllocs++;
+        }
+        vRecv.resize(nSize);
     }
 
     hasher.Write((const unsigned char*)pch, nCopy);
@@ -953,33 +981,293 @@ const uint256& CNetMessage::GetMessageHash() const
     return data_hash;
 }
 
+void CNetMessage::Reset(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nVersionIn)
+{
+    hasher.Reset();
+    data_hash.SetNull();
+    in_data = false;
+    // reading the header emptied the buffer, this does not allocate again
+    hdrbuf.clear();
+    hdrbuf.resize(24);
+    hdr = CMessageHeader(pchMessageStartIn);
+    nHdrPos = 0;
+    vRecv.clear();
+    nDataPos = 0;
+    nTime = 0;
+    SetVersion(nVersionIn);
+}
+
+/** Upper bounds of the payload buffer capacity per size class of CNetMessagePool */
+static const std::array<size_t, CNetMessagePool::SIZE_CLASS_COUNT> NET_MESSAGE_POOL_CLASS_SIZE = {4 * 1024, 64 * 1024, 1024 * 1024, MAX_PROTOCOL_MESSAGE_LENGTH};
+/** Number of messages that CNetMessagePool keeps per size class, about 20 MB in total */
+static const std::array<size_t, CNetMessagePool::SIZE_CLASS_COUNT> NET_MESSAGE_POOL_CLASS_MAX = {512, 64, 8, 2};
+
+CNetMessagePool::CNetMessagePool()
+{
+    nLastSampleTime = GetTimeMicros();
+}
+
+size_t CNetMessagePool::GetSizeClass(size_t nCapacity)
+{
+    size_t nClass = 0;
+    while (nClass < SIZE_CLASS_COUNT && nCapacity > NET_MESSAGE_POOL_CLASS_SIZE[nClass]) {
+        nClass++;
+    }
+    return nClass;
+}
+
+void CNetMessagePool::Get(std::list<CNetMessage>& msgs, const CMessageHeader::MessageStartChars& pchMessageStart)
+{
+    {
+        LOCK(cs);
+        // prefer small buffers, the large ones are swapped into the messages that need them
+        for (auto& cached : vCached) {
+            if (!cached.empty()) {
+                nCachedBytes -= cached.back().vRecv.capacity();
+                msgs.splice(msgs.end(), cached, std::prev(cached.end()));
+                nReused++;
+                msgs.back().Reset(pchMessageStart, INIT_PROTO_VERSION);
+                return;
+            }
+        }
+    }
+    msgs.emplace_back(pchMessageStart, SER_NETWORK, INIT_PROTO_VERSION);
+    nAllocated++;
+}
+
+void CNetMessagePool::ReserveData(CNetMessage& msg)
+{
+    const size_t nSize = msg.hdr.nMessageSize;
+    if (msg.vRecv.capacity() >= nSize) {
+        return;
+    }
+
+    LOCK(cs);
+    for (size_t nClass = GetSizeClass(nSize); nClass < SIZE_CLASS_COUNT; nClass++) {
+        auto& cached = vCached[nClass];
+        if (cached.empty() || cached.back().vRecv.capacity() < nSize) {
+            continue;
+        }
+        auto it = std::prev(cached.end());
+        nCachedBytes -= it->vRecv.capacity();
+        std::swap(msg.vRecv, it->vRecv);
+        nReused++;
+
+        // the cached message now holds the smaller buffer of msg
+        const size_t nNewClass = GetSizeClass(it->vRecv.capacity());
+        if (vCached[nNewClass].size() >= NET_MESSAGE_POOL_CLASS_MAX[nNewClass]) {
+            cached.erase(it);
+        } else {
+            nCachedBytes += it->vRecv.capacity();
+            vCached[nNewClass].splice(vCached[nNewClass].end(), cached, it);
+        }
+        return;
+    }
+}
+
+void CNetMessagePool::Put(std::list<CNetMessage>& msgs)
+{
+    if (msgs.empty()) {
+        return;
+    }
+
+    // freed after releasing the lock
+    std::list<CNetMessage> vFree;
+
+    LOCK(cs);
+    while (!msgs.empty()) {
+        CNetMessage& msg = msgs.front();
+        nAllocated += msg.nDataAllocs;
+        msg.nDataAllocs = 0;
+        msg.vRecv.clear();
+
+        const size_t nCapacity = msg.vRecv.capacity();
+        const size_t nClass = GetSizeClass(nCapacity);
+        if (nClass == SIZE_CLASS_COUNT || vCached[nClass].size() >= NET_MESSAGE_POOL_CLASS_MAX[nClass]) {
+            vFree.splice(vFree.end(), msgs, msgs.begin());
+        } else {
+            nCachedBytes += nCapacity;
+            vCached[nClass].splice(vCached[nClass].end(), msgs, msgs.begin());
+        }
+    }
+}
+
+CNetMessagePool::Stats CNetMessagePool::GetStats()
+{
+    LOCK(cs);
+    Stats stats;
+    stats.nCached = 0;
+    for (const auto& cached : vCached) {
+        stats.nCached += cached.size();
+    }
+    stats.nCachedBytes = nCachedBytes;
+    stats.nAllocated = nAllocated;
+    stats.nReused = nReused;
+
+    const int64_t nNow = GetTimeMicros();
+    if (nNow - nLastSampleTime >= 1000000) {
+        const double dInterval = (nNow - nLastSampleTime) / 1000000.0;
+        dAllocatedPerSec = (stats.nAllocated - nLastSampleAllocated) / dInterval;
+        dReusedPerSec = (stats.nReused - nLastSampleReused) / dInterval;
+        nLastSampleTime = nNow;
+        nLastSampleAllocated = stats.nAllocated;
+        nLastSampleReused = stats.nReused;
+    }
+    stats.dAllocatedPerSec = dAllocatedPerSec;
+    stats.dReusedPerSec = dReusedPerSec;
+    return stats;
+}
+
+SendPriority GetSendPriority(const std::string& command)
+{
+    static const std::set<std::string> setHighPriority = {
+        NetMsgType::CLSIG,
+        NetMsgType::ISLOCK,
+        NetMsgType::QSIGSESANN,
+        NetMsgType::QSIGSHARESINV,
+        NetMsgType::QGETSIGSHARES,
+        NetMsgType::QBSIGSHARES,
+        NetMsgType::QSIGSHARE,
+        NetMsgType::QSIGREC,
+        NetMsgType::HEADERS,
+        NetMsgType::CMPCTBLOCK,
+        NetMsgType::GETBLOCKTXN,
+        NetMsgType::BLOCKTXN,
+    };
+    static const std::set<std::string> setBulkPriority = {
+        NetMsgType::BLOCK,
+        NetMsgType::MNGOVERNANCEOBJECT,
+        NetMsgType::MNGOVERNANCEOBJECTVOTE,
+        NetMsgType::MNLISTDIFF,
+    };
+    if (setHighPriority.count(command)) {
+        return SEND_PRIORITY_HIGH;
+    }
+    if (setBulkPriority.count(command)) {
+        return SEND_PRIORITY_BULK;
+    }
+    return SEND_PRIORITY_NORMAL;
+}
+
+const char* GetSendPriorityName(int priority)
+{
+    static const char* const names[SEND_PRIORITY_COUNT] = {"high", "normal", "bulk"};
+    assert(priority >= 0 && priority < SEND_PRIORITY_COUNT);
+    return names[priority];
+}
+
+void CNode::ScheduleSendMsgs()
+{
+    AssertLockHeld(cs_vSend);
+
+    size_t nScheduled = 0;
+    for (const auto& data : vSendMsg) {
+        nScheduled += data->size();
+    }
+    nScheduled -= nSendOffset;
+
+    const int64_t nNow = GetTimeMicros();
+    // classes in a row that are empty or whose next message does not fit
+    int nBlocked = 0;
+    while (nSendQueuedMsgs > 0 && nScheduled < SEND_SCHEDULE_BYTES && nBlocked < SEND_PRIORITY_COUNT) {
+        CSendQueue& queue = vSendQueues[nSendQueueNext];
+        if (!queue.msgs.empty() && queue.msgs.front().size() <= queue.nDeficit &&
+            nScheduled > 0 && nScheduled + queue.msgs.front().size() > SEND_SCHEDULE_BYTES) {
+            // Messages can't be interleaved on the wire, so once a large message is scheduled
+            // everything has to wait for all of it. Keep it queued while other data is still
+            // unsent, higher classes may still go first until then. It keeps its deficit.
+            nBlocked++;
+        } else if (!queue.msgs.empty() && queue.msgs.front().size() <= queue.nDeficit) {
+            const CQueuedSendMsg& msg = queue.msgs.front();
+            const size_t nSize = msg.size();
+            vSendMsg.push_back(msg.header);
+            if (!msg.data->empty()) {
+                vSendMsg.push_back(msg.data);
+            }
+            const int64_t nWait = nNow - msg.nTimeQueued;
+            queue.nWaitUsecTotal += nWait;
+            queue.nWaitUsecMax = std::max(queue.nWaitUsecMax, nWait);
+            queue.nSent++;
+            queue.nDeficit -= nSize;
+            queue.nBytes -= nSize;
+            queue.msgs.pop_front();
+            nSendQueuedMsgs--;
+            nScheduled += nSize;
+            nBlocked = 0;
+            continue;
+        } else if (queue.msgs.empty()) {
+            // an idle class does not save up for later
+            queue.nDeficit = 0;
+            nBlocked++;
+        } else {
+            nBlocked = 0;
+        }
+        nSendQueueNext = (nSendQueueNext + 1) % SEND_PRIORITY_COUNT;
+        CSendQueue& next = vSendQueues[nSendQueueNext];
+        if (!next.msgs.empty() && next.msgs.front().size() > next.nDeficit) {
+            next.nDeficit += SEND_PRIORITY_QUANTUM[nSendQueueNext];
+        }
+    }
+}
+
 size_t CConnman::SocketSendData(CNode *pnode) EXCLUSIVE_LOCKS_REQUIRED(pnode->cs_vSend)
 {
-    auto it = pnode->vSendMsg.begin();
     size_t nSentSize = 0;
 
-    while (it != pnode->vSendMsg.end()) {
-        const auto &data = *it;
-        assert(data.size() > pnode->nSendOffset);
+    while (true) {
+        pnode->ScheduleSendMsgs();
+        if (pnode->vSendMsg.empty())
+            break;
+        assert(pnode->vSendMsg.front()->size() > pnode->nSendOffset);
+        size_t nRequested = 0;
         int nBytes = 0;
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET)
                 break;
-            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+#ifdef WIN32
+            const auto& data = *pnode->vSendMsg.front();
+            nRequested = data.size() - pnode->nSendOffset;
+            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, nRequested, MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+            // Hand the unsent part of the first buffer and the following ones to the kernel at once
+            struct iovec vecs[MAX_SEND_IOVECS];
+            int nVecs = 0;
+            size_t nOffset = pnode->nSendOffset;
+            for (auto it = pnode->vSendMsg.begin(); it != pnode->vSendMsg.end() && nVecs < MAX_SEND_IOVECS; ++it, ++nVecs) {
+                const auto& data = **it;
+                vecs[nVecs].iov_base = const_cast<unsigned char*>(data.data()) + nOffset;
+                vecs[nVecs].iov_len = data.size() - nOffset;
+                nRequested += vecs[nVecs].iov_len;
+                nOffset = 0;
+            }
+            struct msghdr msg = {};
+            msg.msg_iov = vecs;
+            msg.msg_iovlen = nVecs;
+            nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
         }
         if (nBytes > 0) {
             pnode->nLastSend = GetSystemTimeInSeconds();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             nSentSize += nBytes;
-            if (pnode->nSendOffset == data.size()) {
+            // Drop the buffers that were sent completely
+            size_t nLeft = nBytes;
+            while (nLeft > 0) {
+                const size_t nBufferSize = pnode->vSendMsg.front()->size();
+                const size_t nUnsent = nBufferSize - pnode->nSendOffset;
+                if (nLeft < nUnsent) {
+                    pnode->nSendOffset += nLeft;
+                    break;
+                }
+                nLeft -= nUnsent;
                 pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
-                pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
-                it++;
-            } else {
-                // could not send full message; stop sending more
+                pnode->nSendSize -= nBufferSize;
+                pnode->vSendMsg.pop_front();
+            }
+            pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
+            if ((size_t)nBytes < nRequested) {
+                // could not send everything; stop sending more
                 pnode->fCanSendData = false;
                 break;
             }
@@ -999,12 +1287,11 @@ size_t CConnman::SocketSendData(CNode *pnode) EXCLUSIVE_LOCKS_REQUIRED(pnode->cs
         }
     }
 
-    if (it == pnode->vSendMsg.end()) {
+    if (pnode->vSendMsg.empty() && pnode->nSendQueuedMsgs == 0) {
         assert(pnode->nSendOffset == 0);
         assert(pnode->nSendSize == 0);
     }
-    pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
-    pnode->nSendMsgSize = pnode->vSendMsg.size();
+    pnode->nSendMsgSize = pnode->vSendMsg.size() + pnode->nSendQueuedMsgs;
     return nSentSize;
 }
 
@@ -1357,7 +1644,6 @@ void CConnman::DisconnectNodes()
     }
     {
         // Delete disconnected nodes
-        std::list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
         for (auto it = vNodesDisconnected.begin(); it != vNodesDisconnected.end(); )
         {
             CNode* pnode = *it;
@@ -1656,9 +1942,15 @@ void CConnman::SocketHandler()
     {
         // check if we have work to do and thus should avoid waiting for events
         LOCK2(cs_vNodes, cs_mapNodesWithDataToSend);
-        if (!mapReceivableNodes.empty()) {
-            fOnlyPoll = true;
-        } else if (!mapSendableNodes.empty() && !mapNodesWithDataToSend.empty()) {
+        for (auto& p : mapReceivableNodes) {
+            // nodes that are paused or wait for their send buffers to drain are skipped below, waiting for them
+            // would keep the network thread busy with polling until the message handler catches up
+            if (!p.second->fPauseRecv && p.second->nSendMsgSize == 0 && !p.second->fDisconnect) {
+                fOnlyPoll = true;
+                break;
+            }
+        }
+        if (!fOnlyPoll && !mapSendableNodes.empty() && !mapNodesWithDataToSend.empty()) {
             // we must check if at least one of the nodes with pending messages is also sendable, as otherwise a single
             // node would be able to make the network thread busy with polling
             for (auto& p : mapNodesWithDataToSend) {
@@ -1854,7 +2146,7 @@ size_t CConnman::SocketRecvData(CNode *pnode)
     if (nBytes > 0)
     {
         bool notify = false;
-        if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify)) {
+        if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify, *netMessagePool)) {
             LOCK(cs_vNodes);
             pnode->CloseSocketDisconnect(this);
         }
@@ -1871,7 +2163,7 @@ size_t CConnman::SocketRecvData(CNode *pnode)
                 LOCK(pnode->cs_vProcessMsg);
                 pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
                 pnode->nProcessQueueSize += nSizeAdded;
-                pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
+                UpdatePauseRecv(pnode);
             }
             WakeMessageHandler();
         }
@@ -1934,6 +2226,16 @@ void CConnman::WakeMessageHandler()
     condMsgProc.notify_one();
 }
 
+void CConnman::UpdatePauseRecv(CNode* pnode)
+{
+    AssertLockHeld(pnode->cs_vProcessMsg);
+    const bool fPause = pnode->nProcessQueueSize > nReceiveFloodSize;
+    if (pnode->fPauseRecv.exchange(fPause) && !fPause) {
+        // The socket was skipped while paused and epoll will not report it as readable again
+        WakeSelect();
+    }
+}
+
 void CConnman::WakeSelect()
 {
 #ifdef USE_WAKEUP_PIPE
@@ -2911,6 +3213,7 @@ CConnman::CConnman(uint64_t nSeed0In, uint64_t nSeed1In) :
     nPrevNodeCount = 0;
     nSendBufferMaxSize = 0;
     nReceiveFloodSize = 0;
+    netMessagePool = MakeUnique<CNetMessagePool>();
     flagInterruptMsgProc = false;
     SetTryNewOutboundPeer(false);
 
@@ -3630,6 +3933,11 @@ ServiceFlags CConnman::GetLocalServices() const
     return nLocalServices;
 }
 
+void CConnman::RemoveLocalServices(ServiceFlags nServices)
+{
+    nLocalServices = ServiceFlags(nLocalServices & ~nServices);
+}
+
 void CConnman::SetBestHeight(int height)
 {
     nBestHeight.store(height, std::memory_order_release);
@@ -3730,24 +4038,39 @@ bool CConnman::NodeFullyConnected(const CNode* pnode)
     return pnode && pnode->fSuccessfullyConnected && !pnode->fDisconnect;
 }
 
-void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
+CSharedNetMsg CConnman::PrepareMessage(CSerializedNetMsg&& msg)
 {
-    size_t nMessageSize = msg.data.size();
-    size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
-    LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->GetId());
-
-    std::vector<unsigned char> serializedHeader;
-    serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
+    const size_t nMessageSize = msg.data.size();
+    auto serializedHeader = std::make_shared<std::vector<unsigned char>>();
+    serializedHeader->reserve(CMessageHeader::HEADER_SIZE);
     uint256 hash = Hash(msg.data.data(), msg.data.data() + nMessageSize);
     CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), nMessageSize);
     memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
 
-    CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, serializedHeader, 0, hdr};
+    CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, *serializedHeader, 0, hdr};
+
+    CSharedNetMsg shared;
+    shared.header = std::move(serializedHeader);
+    shared.data = std::make_shared<const std::vector<unsigned char>>(std::move(msg.data));
+    shared.command = std::move(msg.command);
+    return shared;
+}
+
+void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
+{
+    PushMessage(pnode, PrepareMessage(std::move(msg)));
+}
+
+void CConnman::PushMessage(CNode* pnode, const CSharedNetMsg& msg)
+{
+    size_t nMessageSize = msg.data->size();
+    size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
+    LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->GetId());
 
     size_t nBytesSent = 0;
     {
         LOCK(pnode->cs_vSend);
-        bool hasPendingData = !pnode->vSendMsg.empty();
+        bool hasPendingData = !pnode->vSendMsg.empty() || pnode->nSendQueuedMsgs > 0;
 
         //log total amount of bytes per command
         pnode->mapSendBytesPerMsgCmd[msg.command] += nTotalSize;
@@ -3755,10 +4078,17 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 
         if (pnode->nSendSize > nSendBufferMaxSize)
             pnode->fPauseSend = true;
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
-        if (nMessageSize)
-            pnode->vSendMsg.push_back(std::move(msg.data));
-        pnode->nSendMsgSize = pnode->vSendMsg.size();
+
+        // Once everything queued before the handshake completed was sent, messages may overtake each other
+        if (!pnode->fSendPriorities && pnode->fSuccessfullyConnected && !hasPendingData)
+            pnode->fSendPriorities = true;
+        const SendPriority priority = pnode->fSendPriorities ? GetSendPriority(msg.command) : SEND_PRIORITY_NORMAL;
+        CNode::CSendQueue& queue = pnode->vSendQueues[priority];
+        queue.msgs.push_back(CNode::CQueuedSendMsg{msg.header, msg.data, GetTimeMicros()});
+        queue.nBytes += nTotalSize;
+        pnode->nSendQueuedMsgs++;
+        pnode->ScheduleSendMsgs();
+        pnode->nSendMsgSize = pnode->vSendMsg.size() + pnode->nSendQueuedMsgs;
 
         {
             LOCK(cs_mapNodesWithDataToSend);
@@ -25,6 +25,7 @@
 #include <threadinterrupt.h>
 #include <consensus/params.h>
 
+#include <array>
 #include <atomic>
 #include <deque>
 #include <stdint.h>
@@ -45,6 +46,7 @@
 
 class CScheduler;
 class CNode;
+class CNetMessagePool;
 
 namespace boost {
     class thread_group;
@@ -132,6 +134,34 @@ struct CSerializedNetMsg
     std::string command;
 };
 
+/**
+ * A message with its serialized header, ready to be queued for any number of peers.
+ * The buffers are immutable and shared by the send queues of all peers the message is
+ * pushed to, so a message relayed to many peers is serialized and hashed only once.
+ */
+struct CSharedNetMsg
+{
+    std::shared_ptr<const std::vector<unsigned char>> header;
+    std::shared_ptr<const std::vector<unsigned char>> data;
+    std::string command;
+};
+
+/**
+ * Priority classes of outbound messages. Each peer has a send queue per class and
+ * SocketSendData takes messages from them with deficit round robin, so that latency
+ * critical messages don't wait behind the queued part of a sync or of block responses
+ * and no class starves. A message that is already being sent is never interrupted.
+ */
+enum SendPriority : int {
+    SEND_PRIORITY_HIGH = 0, // ChainLocks, InstantSend locks, LLMQ signing, headers and compact blocks
+    SEND_PRIORITY_NORMAL,
+    SEND_PRIORITY_BULK, // blocks, governance objects and votes, masternode list diffs
+    SEND_PRIORITY_COUNT
+};
+
+SendPriority GetSendPriority(const std::string& command);
+const char* GetSendPriorityName(int priority);
+
 class NetEventsInterface;
 class CConnman
 {
@@ -249,6 +279,9 @@ public:
     bool IsMasternodeOrDisconnectRequested(const CService& addr);
 
     void PushMessage(CNode* pnode, CSerializedNetMsg&& msg);
+    void PushMessage(CNode* pnode, const CSharedNetMsg& msg);
+    /** Serialize the header of msg and take over its payload, for pushing it to several peers */
+    static CSharedNetMsg PrepareMessage(CSerializedNetMsg&& msg);
 
     template<typename Condition, typename Callable>
     bool ForEachNodeContinueIf(const Condition& cond, Callable&& func)
@@ -425,6 +458,8 @@ public:
     bool DisconnectNode(NodeId id);
 
     ServiceFlags GetLocalServices() const;
+    //! Stop offering nServices to peers that connect from now on
+    void RemoveLocalServices(ServiceFlags nServices);
 
     //!set the max outbound target in bytes
     void SetMaxOutboundTarget(uint64_t limit);
@@ -457,6 +492,14 @@ public:
     CSipHasher GetDeterministicRandomizer(uint64_t id) const;
 
     unsigned int GetReceiveFloodSize() const;
+    /**
+     * Pause or resume receiving from pnode after the size of its process queue changed.
+     * Wakes the socket handler when receiving resumes, as it only waits for new events.
+     */
+    void UpdatePauseRecv(CNode* pnode);
+
+    /** The pool that received messages are taken from and returned to after processing */
+    CNetMessagePool& GetNetMessagePool() { return *netMessagePool; }
 
     void WakeMessageHandler();
     void WakeSelect();
@@ -557,6 +600,8 @@ private:
     unsigned int nSendBufferMaxSize;
     unsigned int nReceiveFloodSize;
 
+    std::unique_ptr<CNetMessagePool> netMessagePool;
+
     std::vector<ListenSocket> vhListenSocket;
     std::atomic<bool> fNetworkActive;
     banmap_t setBanned GUARDED_BY(cs_setBanned);
@@ -580,7 +625,7 @@ private:
     unsigned int nPrevNodeCount;
 
     /** Services this instance offers */
-    ServiceFlags nLocalServices;
+    std::atomic<ServiceFlags> nLocalServices;
 
     std::unique_ptr<CSemaphore> semOutbound;
     std::unique_ptr<CSemaphore> semAddnode;
@@ -747,6 +792,15 @@ public:
     // In case this is a verified MN, this value is the proTx of the MN
     uint256 verifiedProRegTxHash;
     bool fMasternode;
+
+    struct SendQueueStats {
+        size_t nQueued;
+        size_t nQueuedBytes;
+        uint64_t nSent;
+        double dAvgWait;
+        double dMaxWait;
+    };
+    std::array<SendQueueStats, SEND_PRIORITY_COUNT> vSendQueueStats;
 };
 
 
@@ -768,14 +822,20 @@ public:
 
     int64_t nTime;                  // time (in microseconds) of message receipt.
 
+    unsigned int nDataAllocs;       // allocations of the vRecv buffer, counted by CNetMessagePool
+
     CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
         hdrbuf.resize(24);
         in_data = false;
         nHdrPos = 0;
         nDataPos = 0;
         nTime = 0;
+        nDataAllocs = 0;
     }
 
+    /** Prepare the message for receiving another one, keeping its buffers */
+    void Reset(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nVersionIn);
+
     bool complete() const
     {
         if (!in_data)
@@ -795,6 +855,79 @@ public:
     int readData(const char *pch, unsigned int nBytes);
 };
 
+/**
+ * Cache of received messages and their payload buffers. The socket handler
+ * takes a message from here for every message it starts to receive instead
+ * of allocating it, its header buffer and its payload buffer, and the message
+ * handler returns processed messages. Cached messages are kept in size classes
+ * by the capacity of their payload buffers, and a message whose header shows
+ * that it needs more swaps in a buffer of the matching class. Messages move
+ * between the pool and the queues of peers by splicing list nodes, so passing
+ * a message from the socket handler to the message handler does not allocate.
+ */
+class CNetMessagePool
+{
+public:
+    static const size_t SIZE_CLASS_COUNT = 4;
+
+    struct Stats
+    {
+        size_t nCached;
+        size_t nCachedBytes;
+        uint64_t nAllocated;
+        uint64_t nReused;
+        double dAllocatedPerSec;
+        double dReusedPerSec;
+    };
+
+    CNetMessagePool();
+
+    /** Append an empty message to msgs, reusing a cached one if there is any */
+    void Get(std::list<CNetMessage>& msgs, const CMessageHeader::MessageStartChars& pchMessageStart);
+
+    /** Swap in a cached payload buffer that fits a message whose header was just read */
+    void ReserveData(CNetMessage& msg);
+
+    /** Take back all messages of msgs, freeing those that do not fit into the cache */
+    void Put(std::list<CNetMessage>& msgs);
+
+    /**
+     * Get the cache size and the number of messages and payload buffers that were
+     * allocated or reused. The rates are averaged since the previous call that
+     * was at least a second earlier.
+     */
+    Stats GetStats();
+
+private:
+    static size_t GetSizeClass(size_t nCapacity);
+
+    CCriticalSection cs;
+    std::array<std::list<CNetMessage>, SIZE_CLASS_COUNT> vCached GUARDED_BY(cs);
+    size_t nCachedBytes GUARDED_BY(cs){0};
+
+    std::atomic<uint64_t> nAllocated{0};
+    std::atomic<uint64_t> nReused{0};
+
+    int64_t nLastSampleTime GUARDED_BY(cs);
+    uint64_t nLastSampleAllocated GUARDED_BY(cs){0};
+    uint64_t nLastSampleReused GUARDED_BY(cs){0};
+    double dAllocatedPerSec GUARDED_BY(cs){0};
+    double dReusedPerSec GUARDED_BY(cs){0};
+};
+
+/** A list of messages that is returned to a CNetMessagePool when it goes out of scope */
+class CPooledNetMessages
+{
+public:
+    explicit CPooledNetMessages(CNetMessagePool& poolIn) : pool(poolIn) {}
+    ~CPooledNetMessages() { pool.Put(msgs); }
+
+    std::list<CNetMessage> msgs;
+
+private:
+    CNetMessagePool& pool;
+};
+
 
 /** Information about a peer */
 class CNode
@@ -807,10 +940,33 @@ public:
     size_t nSendSize; // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes GUARDED_BY(cs_vSend);
-    std::list<std::vector<unsigned char>> vSendMsg GUARDED_BY(cs_vSend);
-    std::atomic<size_t> nSendMsgSize;
+    // buffers in the order they go out on the wire, filled from vSendQueues by ScheduleSendMsgs
+    std::list<std::shared_ptr<const std::vector<unsigned char>>> vSendMsg GUARDED_BY(cs_vSend);
+    std::atomic<size_t> nSendMsgSize; // number of vSendMsg entries and messages in vSendQueues
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
+
+    /** A message waiting in one of the send queues */
+    struct CQueuedSendMsg {
+        std::shared_ptr<const std::vector<unsigned char>> header;
+        std::shared_ptr<const std::vector<unsigned char>> data;
+        int64_t nTimeQueued;
+
+        size_t size() const { return header->size() + data->size(); }
+    };
+    struct CSendQueue {
+        std::deque<CQueuedSendMsg> msgs;
+        size_t nBytes{0};
+        size_t nDeficit{0};
+        uint64_t nSent{0};
+        int64_t nWaitUsecTotal{0};
+        int64_t nWaitUsecMax{0};
+    };
+    std::array<CSendQueue, SEND_PRIORITY_COUNT> vSendQueues GUARDED_BY(cs_vSend);
+    size_t nSendQueuedMsgs GUARDED_BY(cs_vSend){0};
+    int nSendQueueNext GUARDED_BY(cs_vSend){0};
+    // Messages keep the order they were pushed in until the handshake messages were sent
+    bool fSendPriorities GUARDED_BY(cs_vSend){false};
     CCriticalSection cs_vRecv;
 
     CCriticalSection cs_vProcessMsg;
@@ -946,8 +1102,12 @@ public:
     // If true, we will send him all quorum related messages, even if he is not a member of our quorums
     std::atomic<bool> qwatch{false};
 
+    // Guarded by g_cs_orphans in net_processing.cpp
     std::set<uint256> orphan_work_set;
 
+    // Messages of this peer that wait for or are in processing on the message shard threads
+    std::atomic<int> nShardedMessages{0};
+
     CNode(NodeId id, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn, SOCKET hSocketIn, const CAddress &addrIn, uint64_t nKeyedNetGroupIn, uint64_t nLocalHostNonceIn, const CAddress &addrBindIn, const std::string &addrNameIn = "", bool fInboundIn = false);
     ~CNode();
     CNode(const CNode&) = delete;
@@ -988,7 +1148,7 @@ public:
         return nRefCount;
     }
 
-    bool ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete);
+    bool ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete, CNetMessagePool& pool);
 
     void SetRecvVersion(int nVersionIn)
     {
@@ -1082,6 +1242,15 @@ public:
 
     void CloseSocketDisconnect(CConnman* connman);
 
+    /**
+     * Move queued messages to vSendMsg until it holds SEND_SCHEDULE_BYTES that were not sent
+     * yet. Messages that are still queued can be overtaken by later ones of a higher class.
+     * A message that does not fit is only moved once vSendMsg is empty, so a high priority
+     * message waits for at most SEND_SCHEDULE_BYTES plus the rest of one message in flight,
+     * which can be up to MAX_PROTOCOL_MESSAGE_LENGTH.
+     */
+    void ScheduleSendMsgs() EXCLUSIVE_LOCKS_REQUIRED(cs_vSend);
+
     void copyStats(CNodeStats &stats);
 
     ServiceFlags GetLocalServices() const
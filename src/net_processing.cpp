@@ -10,7 +10,9 @@
 #include <blockencodings.h>
 #include <chainparams.h>
 #include <consensus/validation.h>
+#include <ctpl.h>
 #include <hash.h>
+#include <index/blockfilterindex.h>
 #include <init.h>
 #include <validation.h>
 #include <merkleblock.h>
@@ -31,6 +33,7 @@
 #include <utilmoneystr.h>
 #include <utilstrencodings.h>
 
+#include <array>
 #include <memory>
 
 #include <spork.h>
@@ -104,12 +107,39 @@ void EraseOrphansFor(NodeId peer);
 static size_t vExtraTxnForCompactIt GUARDED_BY(g_cs_orphans) = 0;
 static std::vector<std::pair<uint256, CTransactionRef>> vExtraTxnForCompact GUARDED_BY(g_cs_orphans);
 
+/** Maximum number of transactions waiting for the admission threads, beyond that they are validated by the message handler again */
+static const size_t MAX_TX_ADMISSION_QUEUE = 5000;
+/** Number of seconds over which the rate of admitted transactions is averaged */
+static const int64_t TX_ADMISSION_RATE_WINDOW = 60;
+
+static ctpl::thread_pool txAdmissionPool;
+static std::atomic<bool> fTxAdmissionRunning(false);
+static CCriticalSection cs_txadmission;
+// transactions from peers that wait for or are in validation on txAdmissionPool
+static std::set<uint256> setTxAdmissionInFlight GUARDED_BY(cs_txadmission);
+static uint64_t nTxAdmitted GUARDED_BY(cs_txadmission) = 0;
+static uint64_t nTxRejected GUARDED_BY(cs_txadmission) = 0;
+// (second, number of transactions admitted in it) for the last TX_ADMISSION_RATE_WINDOW seconds
+static std::array<std::pair<int64_t, uint32_t>, TX_ADMISSION_RATE_WINDOW> vTxAdmittedPerSecond GUARDED_BY(cs_txadmission);
+
+static std::atomic<bool> fMessageShardsRunning(false);
+static CCriticalSection cs_messageshards;
+// one single threaded pool per shard, so that the messages of a peer are processed in order
+static std::vector<std::unique_ptr<ctpl::thread_pool>> vMessageShards GUARDED_BY(cs_messageshards);
+static std::atomic<size_t> nShardedMessagesQueued(0);
+static std::atomic<uint64_t> nShardedMessagesProcessed(0);
+
 static const uint64_t RANDOMIZER_ID_ADDRESS_RELAY = 0x3cac0035b5866b90ULL; // SHA256("main address relay")[0:8]
 
 /// Age after which a stale block will no longer be served if requested as
 /// protection against fingerprinting. Set to one month, denominated in seconds.
 static const int STALE_RELAY_AGE_LIMIT = 30 * 24 * 60 * 60;
 
+/// Maximum number of compact filters that may be requested with one getcfilters. See BIP 157.
+static constexpr uint32_t MAX_GETCFILTERS_SIZE = 1000;
+/// Maximum number of cf hashes that may be requested with one getcfheaders. See BIP 157.
+static constexpr uint32_t MAX_GETCFHEADERS_SIZE = 2000;
+
 /// Age after which a block is considered historical for purposes of rate
 /// limiting block relay. Set to one week, denominated in seconds.
 static const int HISTORICAL_BLOCK_AGE = 7 * 24 * 60 * 60;
@@ -1141,10 +1171,28 @@ static CCriticalSection cs_most_recent_block;
 static std::shared_ptr<const CBlock> most_recent_block;
 static std::shared_ptr<const CBlockHeaderAndShortTxIDs> most_recent_compact_block;
 static uint256 most_recent_block_hash;
+// The messages of the most recent block, serialized once and shared by all peers they are sent to.
+// The compact block message is prepared along with the block, the block message on the first request.
+static std::shared_ptr<const CSharedNetMsg> most_recent_compact_block_msg;
+static std::shared_ptr<const CSharedNetMsg> most_recent_block_msg;
+
+/** Get the BLOCK message of the most recent block if it is the block with the given hash */
+static std::shared_ptr<const CSharedNetMsg> GetMostRecentBlockMessage(const uint256& hash)
+{
+    LOCK(cs_most_recent_block);
+    if (!most_recent_block || most_recent_block_hash != hash) {
+        return nullptr;
+    }
+    if (!most_recent_block_msg) {
+        most_recent_block_msg = std::make_shared<const CSharedNetMsg>(CConnman::PrepareMessage(CNetMsgMaker(PROTOCOL_VERSION).Make(NetMsgType::BLOCK, *most_recent_block)));
+    }
+    return most_recent_block_msg;
+}
 
 void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) {
     std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs> (*pblock);
     const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+    std::shared_ptr<const CSharedNetMsg> pcmpctblockmsg = std::make_shared<const CSharedNetMsg>(CConnman::PrepareMessage(msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock)));
 
     LOCK(cs_main);
 
@@ -1160,10 +1208,11 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
         most_recent_block_hash = hashBlock;
         most_recent_block = pblock;
         most_recent_compact_block = pcmpctblock;
+        most_recent_compact_block_msg = pcmpctblockmsg;
+        most_recent_block_msg = nullptr;
     }
 
-    connman->ForEachNode([this, &pcmpctblock, pindex, &msgMaker, &hashBlock](CNode* pnode) {
-        // TODO: Avoid the repeated-serialization here
+    connman->ForEachNode([this, &pcmpctblockmsg, pindex, &hashBlock](CNode* pnode) {
         if (pnode->fDisconnect)
             return;
         ProcessBlockAvailability(pnode->GetId());
@@ -1175,7 +1224,7 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
 
             LogPrint(BCLog::NET, "%s sending header-and-ids %s to peer=%d\n", "PeerLogicValidation::NewPoWValidBlock",
                     hashBlock.ToString(), pnode->GetId());
-            connman->PushMessage(pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+            connman->PushMessage(pnode, *pcmpctblockmsg);
             state.pindexBestHeaderSent = pindex;
         }
     });
@@ -1277,6 +1326,11 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
                 if (mapOrphanTransactions.count(inv.hash)) return true;
             }
 
+            {
+                LOCK(cs_txadmission);
+                if (setTxAdmissionInFlight.count(inv.hash)) return true;
+            }
+
             // When we receive an islock for a previously rejected transaction, we have to
             // drop the first-seen tx (which such a locked transaction was conflicting with)
             // and re-request the locked transaction (which did not make it into the mempool
@@ -1382,11 +1436,13 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
     bool send = false;
     std::shared_ptr<const CBlock> a_recent_block;
     std::shared_ptr<const CBlockHeaderAndShortTxIDs> a_recent_compact_block;
+    std::shared_ptr<const CSharedNetMsg> a_recent_compact_block_msg;
     const Consensus::Params& consensusParams = chainparams.GetConsensus();
     {
         LOCK(cs_most_recent_block);
         a_recent_block = most_recent_block;
         a_recent_compact_block = most_recent_compact_block;
+        a_recent_compact_block_msg = most_recent_compact_block_msg;
     }
 
     bool need_activate_chain = false;
@@ -1447,6 +1503,12 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
         std::shared_ptr<const CBlock> pblock;
         if (a_recent_block && a_recent_block->GetHash() == (*mi).second->GetBlockHash()) {
             pblock = a_recent_block;
+        } else if (inv.type == MSG_BLOCK) {
+            // Send the block as stored on disk, without deserializing and reserializing it
+            CRawBlock rawBlock;
+            if (!ReadRawBlockFromDisk(rawBlock, (*mi).second, chainparams.MessageStart()))
+                assert(!"cannot load block from disk");
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, rawBlock));
         } else {
             // Send block from disk
             std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
@@ -1455,9 +1517,14 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
             pblock = pblockRead;
         }
         if (pblock) {
-            if (inv.type == MSG_BLOCK)
-                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
-            else if (inv.type == MSG_FILTERED_BLOCK) {
+            if (inv.type == MSG_BLOCK) {
+                std::shared_ptr<const CSharedNetMsg> pblockmsg;
+                if (pblock == a_recent_block && (pblockmsg = GetMostRecentBlockMessage(pblock->GetHash()))) {
+                    connman->PushMessage(pfrom, *pblockmsg);
+                } else {
+                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
+                }
+            } else if (inv.type == MSG_FILTERED_BLOCK) {
                 bool sendMerkleBlock = false;
                 CMerkleBlock merkleBlock;
                 {
@@ -1490,7 +1557,7 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
                     mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
                     if (a_recent_compact_block &&
                         a_recent_compact_block->header.GetHash() == mi->second->GetBlockHash()) {
-                        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
+                        connman->PushMessage(pfrom, *a_recent_compact_block_msg);
                     } else {
                         CBlockHeaderAndShortTxIDs cmpctblock(*pblock);
                         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CMPCTBLOCK, cmpctblock));
@@ -1721,6 +1788,204 @@ inline void static SendBlockTransactions(const CBlock& block, const BlockTransac
     connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCKTXN, resp));
 }
 
+/**
+ * Validation logic for compact filters request handling.
+ *
+ * May disconnect from the peer in the case of a bad request.
+ *
+ * @param[in]   pfrom           The peer that we received the request from
+ * @param[in]   chain_params    Chain parameters
+ * @param[in]   filter_type     The filter type the request is for. Must be basic filters.
+ * @param[in]   start_height    The start height for the request
+ * @param[in]   stop_hash       The stop_hash for the request
+ * @param[in]   max_height_diff The maximum number of items permitted to request, as specified in BIP 157
+ * @param[out]  stop_index      The CBlockIndex for the stop_hash block, if the request can be serviced.
+ * @param[out]  filter_index    The filter index, if the request can be serviced.
+ * @return                      True if the request can be serviced.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, const CChainParams& chain_params,
+                                      BlockFilterType filter_type, uint32_t start_height,
+                                      const uint256& stop_hash, uint32_t max_height_diff,
+                                      const CBlockIndex*& stop_index,
+                                      BlockFilterIndex*& filter_index)
+{
+    const bool supported_filter_type =
+        (filter_type == BlockFilterType::BASIC_FILTER &&
+         (pfrom->GetLocalServices() & NODE_COMPACT_FILTERS));
+    if (!supported_filter_type) {
+        LogPrint(BCLog::NET, "peer %d requested unsupported block filter type: %d\n",
+                 pfrom->GetId(), static_cast<uint8_t>(filter_type));
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(stop_hash);
+        stop_index = it != mapBlockIndex.end() ? it->second : nullptr;
+
+        // Check that the stop block exists and the peer would be allowed to fetch it.
+        if (!stop_index || !BlockRequestAllowed(stop_index, chain_params.GetConsensus())) {
+            LogPrint(BCLog::NET, "peer %d requested invalid block hash: %s\n",
+                     pfrom->GetId(), stop_hash.ToString());
+            pfrom->fDisconnect = true;
+            return false;
+        }
+    }
+
+    uint32_t stop_height = stop_index->nHeight;
+    if (start_height > stop_height) {
+        LogPrint(BCLog::NET, "peer %d sent invalid getcfilters/getcfheaders with " /* Continued */
+                 "start height %d and stop height %d\n",
+                 pfrom->GetId(), start_height, stop_height);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    if (stop_height - start_height >= max_height_diff) {
+        LogPrint(BCLog::NET, "peer %d requested too many cfilters/cfheaders: %d / %d\n",
+                 pfrom->GetId(), stop_height - start_height + 1, max_height_diff);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    filter_index = GetBlockFilterIndex(filter_type);
+    if (!filter_index) {
+        LogPrint(BCLog::NET, "Filter index for supported type %s not found\n", BlockFilterTypeName(filter_type));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Handle a cfilters request.
+ *
+ * May disconnect from the peer in the case of a bad request.
+ */
+static void ProcessGetCFilters(CNode* pfrom, CDataStream& vRecv, const CChainParams& chain_params,
+                               CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint32_t start_height;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> start_height >> stop_hash;
+
+    const BlockFilterType filter_type = static_cast<BlockFilterType>(filter_type_ser);
+
+    const CBlockIndex* stop_index;
+    BlockFilterIndex* filter_index;
+    if (!PrepareBlockFilterRequest(pfrom, chain_params, filter_type, start_height, stop_hash,
+                                   MAX_GETCFILTERS_SIZE, stop_index, filter_index)) {
+        return;
+    }
+
+    std::vector<BlockFilter> filters;
+    if (!filter_index->LookupFilterRange(start_height, stop_index, filters)) {
+        LogPrint(BCLog::NET, "Failed to find block filter in index: filter_type=%s, start_height=%d, stop_hash=%s\n",
+                 BlockFilterTypeName(filter_type), start_height, stop_hash.ToString());
+        return;
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    for (const BlockFilter& filter : filters) {
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFILTER, filter));
+    }
+}
+
+/**
+ * Handle a cfheaders request.
+ *
+ * May disconnect from the peer in the case of a bad request.
+ */
+static void ProcessGetCFHeaders(CNode* pfrom, CDataStream& vRecv, const CChainParams& chain_params,
+                                CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint32_t start_height;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> start_height >> stop_hash;
+
+    const BlockFilterType filter_type = static_cast<BlockFilterType>(filter_type_ser);
+
+    const CBlockIndex* stop_index;
+    BlockFilterIndex* filter_index;
+    if (!PrepareBlockFilterRequest(pfrom, chain_params, filter_type, start_height, stop_hash,
+                                   MAX_GETCFHEADERS_SIZE, stop_index, filter_index)) {
+        return;
+    }
+
+    uint256 prev_header;
+    if (start_height > 0) {
+        const CBlockIndex* const prev_block = stop_index->GetAncestor(static_cast<int>(start_height - 1));
+        if (!filter_index->LookupFilterHeader(prev_block, prev_header)) {
+            LogPrint(BCLog::NET, "Failed to find block filter header in index: filter_type=%s, block_hash=%s\n",
+                     BlockFilterTypeName(filter_type), prev_block->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    std::vector<uint256> filter_hashes;
+    if (!filter_index->LookupFilterHashRange(start_height, stop_index, filter_hashes)) {
+        LogPrint(BCLog::NET, "Failed to find block filter hashes in index: filter_type=%s, start_height=%d, stop_hash=%s\n",
+                 BlockFilterTypeName(filter_type), start_height, stop_hash.ToString());
+        return;
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFHEADERS,
+                                              filter_type_ser,
+                                              stop_index->GetBlockHash(),
+                                              prev_header,
+                                              filter_hashes));
+}
+
+/**
+ * Handle a getcfcheckpt request.
+ *
+ * May disconnect from the peer in the case of a bad request.
+ */
+static void ProcessGetCFCheckPt(CNode* pfrom, CDataStream& vRecv, const CChainParams& chain_params,
+                                CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> stop_hash;
+
+    const BlockFilterType filter_type = static_cast<BlockFilterType>(filter_type_ser);
+
+    const CBlockIndex* stop_index;
+    BlockFilterIndex* filter_index;
+    if (!PrepareBlockFilterRequest(pfrom, chain_params, filter_type, /*start_height=*/0, stop_hash,
+                                   /*max_height_diff=*/std::numeric_limits<uint32_t>::max(),
+                                   stop_index, filter_index)) {
+        return;
+    }
+
+    std::vector<uint256> headers(stop_index->nHeight / CFCHECKPT_INTERVAL);
+
+    // Populate headers.
+    const CBlockIndex* block_index = stop_index;
+    for (int i = headers.size() - 1; i >= 0; i--) {
+        int height = (i + 1) * CFCHECKPT_INTERVAL;
+        block_index = block_index->GetAncestor(height);
+
+        if (!filter_index->LookupFilterHeader(block_index, headers[i])) {
+            LogPrint(BCLog::NET, "Failed to find block filter header in index: filter_type=%s, block_hash=%s\n",
+                     BlockFilterTypeName(filter_type), block_index->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFCHECKPT,
+                                              filter_type_ser,
+                                              stop_index->GetBlockHash(),
+                                              headers));
+}
+
 bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::vector<CBlockHeader>& headers, const CChainParams& chainparams, bool punish_duplicate_invalid)
 {
     const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
@@ -1999,6 +2264,436 @@ void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_se
     }
 }
 
+static bool HasOrphanWork(CNode* pnode)
+{
+    LOCK(g_cs_orphans);
+    return !pnode->orphan_work_set.empty();
+}
+
+/**
+ * Relay, orphan or reject a transaction received from pfrom after AcceptToMemoryPool.
+ * Orphans that spend the outputs of an accepted transaction are added to the
+ * orphan_work_set of pfrom.
+ */
+static void ProcessTxAdmissionResult(CNode* pfrom, CConnman* connman, const std::string& strCommand, const CTransactionRef& ptx,
+                                     bool fAccepted, bool fMissingInputs, const CValidationState& state) EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_cs_orphans)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(g_cs_orphans);
+    const CTransaction& tx = *ptx;
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+
+    if (fAccepted) {
+        mempool.check(pcoinsTip.get());
+        connman->RelayTransaction(tx);
+
+        for (unsigned int i = 0; i < tx.vout.size(); i++) {
+            auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(tx.GetHash(), i));
+            if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
+                for (const auto& elem : it_by_prev->second) {
+                    pfrom->orphan_work_set.insert(elem->first);
+                }
+            }
+        }
+
+        pfrom->nLastTXTime = GetTime();
+
+        LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPool: peer=%d: accepted %s (poolsz %u txn, %u kB)\n",
+                 pfrom->GetId(),
+                 tx.GetHash().ToString(),
+                 mempool.size(), mempool.DynamicMemoryUsage() / 1000);
+    }
+    else if (fMissingInputs)
+    {
+        bool fRejectedParents = false; // It may be the case that the orphans parents have all been rejected
+        for (const CTxIn& txin : tx.vin) {
+            if (recentRejects->contains(txin.prevout.hash)) {
+                fRejectedParents = true;
+                break;
+            }
+        }
+        if (!fRejectedParents) {
+            const auto current_time = GetTime<std::chrono::microseconds>();
+
+            for (const CTxIn& txin : tx.vin) {
+                CInv _inv(MSG_TX, txin.prevout.hash);
+                pfrom->AddInventoryKnown(_inv);
+                if (!AlreadyHave(_inv)) RequestObject(State(pfrom->GetId()), _inv, current_time);
+                // We don't know if the previous tx was a regular or a mixing one, try both
+                CInv _inv2(MSG_DSTX, txin.prevout.hash);
+                pfrom->AddInventoryKnown(_inv2);
+                if (!AlreadyHave(_inv2)) RequestObject(State(pfrom->GetId()), _inv2, current_time);
+            }
+            AddOrphanTx(ptx, pfrom->GetId());
+
+            // A parent validated on another admission thread may have been accepted after
+            // this transaction missed it, but before the orphan was added
+            for (const CTxIn& txin : tx.vin) {
+                if (fTxAdmissionRunning && mempool.exists(txin.prevout.hash)) {
+                    pfrom->orphan_work_set.insert(tx.GetHash());
+                    break;
+                }
+            }
+
+            // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
+            unsigned int nMaxOrphanTxSize = (unsigned int)std::max((int64_t)0, gArgs.GetArg("-maxorphantxsize", DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE)) * 1000000;
+            unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTxSize);
+            if (nEvicted > 0) {
+                LogPrint(BCLog::MEMPOOL, "mapOrphan overflow, removed %u tx\n", nEvicted);
+            }
+        } else {
+            LogPrint(BCLog::MEMPOOL, "not keeping orphan with rejected parents %s\n",tx.GetHash().ToString());
+            // We will continue to reject this tx since it has rejected
+            // parents so avoid re-requesting it from other peers.
+            recentRejects->insert(tx.GetHash());
+        }
+    } else {
+        if (!state.CorruptionPossible()) {
+            assert(recentRejects);
+            recentRejects->insert(tx.GetHash());
+            if (RecursiveDynamicUsage(*ptx) < 100000) {
+                AddToCompactExtraTransactions(ptx);
+            }
+        }
+
+        if (pfrom->fWhitelisted && gArgs.GetBoolArg("-whitelistforcerelay", DEFAULT_WHITELISTFORCERELAY)) {
+            // Always relay transactions received from whitelisted peers, even
+            // if they were already in the mempool or rejected from it due
+            // to policy, allowing the node to function as a gateway for
+            // nodes hidden behind it.
+            //
+            // Never relay transactions that we would assign a non-zero DoS
+            // score for, as we expect peers to do the same with us in that
+            // case.
+            int nDoS = 0;
+            if (!state.IsInvalid(nDoS) || nDoS == 0) {
+                LogPrintf("Force relaying tx %s from whitelisted peer=%d\n", tx.GetHash().ToString(), pfrom->GetId());
+                connman->RelayTransaction(tx);
+            } else {
+                LogPrintf("Not relaying invalid transaction %s from whitelisted peer=%d (%s)\n", tx.GetHash().ToString(), pfrom->GetId(), FormatStateMessage(state));
+            }
+        }
+    }
+
+    int nDoS = 0;
+    if (state.IsInvalid(nDoS))
+    {
+        LogPrint(BCLog::MEMPOOLREJ, "%s from peer=%d was not accepted: %s\n", tx.GetHash().ToString(),
+            pfrom->GetId(),
+            FormatStateMessage(state));
+        if (g_enable_bip61 && state.GetRejectCode() > 0 && state.GetRejectCode() < REJECT_INTERNAL) { // Never send AcceptToMemoryPool's internal codes over P2P
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::REJECT, strCommand, (unsigned char)state.GetRejectCode(),
+                               state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), tx.GetHash()));
+        }
+        if (nDoS > 0) {
+            Misbehaving(pfrom->GetId(), nDoS);
+        }
+    }
+
+    LOCK(cs_txadmission);
+    if (fAccepted) {
+        const int64_t nNow = GetTime();
+        auto& second = vTxAdmittedPerSecond[nNow % TX_ADMISSION_RATE_WINDOW];
+        if (second.first != nNow) {
+            second = std::make_pair(nNow, 0);
+        }
+        second.second++;
+        nTxAdmitted++;
+    } else if (!fMissingInputs) {
+        nTxRejected++;
+    }
+}
+
+namespace {
+/** A transaction received from a peer that waits for or is in validation on txAdmissionPool */
+struct CTxAdmissionJob
+{
+    CTxAdmissionJob(CNode* pfromIn, const std::string& strCommandIn, const CTransactionRef& ptxIn) :
+        pfrom(pfromIn->AddRef()), strCommand(strCommandIn), ptx(ptxIn) {}
+
+    ~CTxAdmissionJob()
+    {
+        // Also runs for the jobs that StopTxAdmission drops from the queue
+        {
+            LOCK(cs_txadmission);
+            setTxAdmissionInFlight.erase(ptx->GetHash());
+        }
+        pfrom->Release();
+    }
+
+    CNode* const pfrom;
+    const std::string strCommand;
+    const CTransactionRef ptx;
+};
+} // namespace
+
+static void ProcessQueuedTx(CConnman* connman, const CTxAdmissionJob& job)
+{
+    bool fMissingInputs = false;
+    CValidationState state;
+    bool fAccepted = AcceptToMemoryPoolConcurrent(mempool, state, job.ptx, &fMissingInputs /* pfMissingInputs */,
+            false /* bypass_limits */, 0 /* nAbsurdFee */);
+
+    LOCK2(cs_main, g_cs_orphans);
+    {
+        // From here on AlreadyHave answers from the mempool and recentRejects
+        LOCK(cs_txadmission);
+        setTxAdmissionInFlight.erase(job.ptx->GetHash());
+    }
+    ProcessTxAdmissionResult(job.pfrom, connman, job.strCommand, job.ptx, fAccepted, fMissingInputs, state);
+    if (!job.pfrom->orphan_work_set.empty()) {
+        // Orphans are reconsidered by the message handler thread
+        connman->WakeMessageHandler();
+    }
+}
+
+/**
+ * Hand a transaction received from pfrom to txAdmissionPool. Returns false if it
+ * has to be processed inline instead, because the pool is not running or full, or
+ * because the transaction is already known.
+ */
+static bool QueueTxAdmission(CNode* pfrom, CConnman* connman, const std::string& strCommand, const CTransactionRef& ptx)
+{
+    if (!fTxAdmissionRunning) {
+        return false;
+    }
+
+    {
+        LOCK(cs_main);
+        if (AlreadyHave(CInv(MSG_TX, ptx->GetHash()))) {
+            return false;
+        }
+    }
+
+    LOCK(cs_txadmission);
+    if (!fTxAdmissionRunning || setTxAdmissionInFlight.size() >= MAX_TX_ADMISSION_QUEUE) {
+        return false;
+    }
+    setTxAdmissionInFlight.insert(ptx->GetHash());
+    auto job = std::make_shared<CTxAdmissionJob>(pfrom, strCommand, ptx);
+    txAdmissionPool.push([connman, job](int) {
+        ProcessQueuedTx(connman, *job);
+    });
+    return true;
+}
+
+void StartTxAdmission(int nThreads)
+{
+    if (nThreads <= 0) {
+        return;
+    }
+    txAdmissionPool.resize(nThreads);
+    RenameThreadPool(txAdmissionPool, "pigeon-txadmit");
+    fTxAdmissionRunning = true;
+    LogPrintf("Using %d threads to validate transactions from peers\n", nThreads);
+}
+
+void StopTxAdmission()
+{
+    {
+        LOCK(cs_txadmission);
+        if (!fTxAdmissionRunning.exchange(false)) {
+            return;
+        }
+    }
+    txAdmissionPool.clear_queue();
+    txAdmissionPool.stop(true);
+}
+
+TxAdmissionStats GetTxAdmissionStats()
+{
+    TxAdmissionStats stats;
+    stats.nThreads = fTxAdmissionRunning ? txAdmissionPool.size() : 0;
+
+    LOCK(cs_txadmission);
+    stats.nQueued = setTxAdmissionInFlight.size();
+    stats.nAdmitted = nTxAdmitted;
+    stats.nRejected = nTxRejected;
+    const int64_t nNow = GetTime();
+    uint64_t nRecent = 0;
+    for (const auto& second : vTxAdmittedPerSecond) {
+        if (second.first > nNow - TX_ADMISSION_RATE_WINDOW) {
+            nRecent += second.second;
+        }
+    }
+    stats.dAdmittedPerSecond = (double)nRecent / TX_ADMISSION_RATE_WINDOW;
+    return stats;
+}
+
+/** Pass a message to the managers of the masternode, governance, PrivateSend and LLMQ extensions */
+static void ProcessExtensionMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
+{
+#ifdef ENABLE_WALLET
+    privateSendClient.ProcessMessage(pfrom, strCommand, vRecv, connman);
+#endif // ENABLE_WALLET
+    privateSendServer.ProcessMessage(pfrom, strCommand, vRecv, connman);
+    sporkManager.ProcessSpork(pfrom, strCommand, vRecv, connman);
+    masternodeSync.ProcessMessage(pfrom, strCommand, vRecv);
+    governance.ProcessMessage(pfrom, strCommand, vRecv, connman);
+    CMNAuth::ProcessMessage(pfrom, strCommand, vRecv, connman);
+    llmq::quorumBlockProcessor->ProcessMessage(pfrom, strCommand, vRecv, connman);
+    llmq::quorumDKGSessionManager->ProcessMessage(pfrom, strCommand, vRecv, connman);
+    llmq::quorumSigSharesManager->ProcessMessage(pfrom, strCommand, vRecv, connman);
+    llmq::quorumSigningManager->ProcessMessage(pfrom, strCommand, vRecv, connman);
+    llmq::chainLocksHandler->ProcessMessage(pfrom, strCommand, vRecv, connman);
+    llmq::quorumInstantSendManager->ProcessMessage(pfrom, strCommand, vRecv, connman);
+}
+
+/**
+ * Messages that are processed on the message shard threads if they are running. Their
+ * handlers lock the state of their manager and may run concurrently for different peers.
+ * They take cs_main for punishing peers and for short lookups. A governance object also
+ * takes it to look up its collateral transaction, which reads it from disk with -txindex.
+ * MNLISTDIFF is not among them: we never request it and punish the peer under cs_main,
+ * while GETMNLISTDIFF builds the diff under cs_main. Neither is DSQUEUE: the PrivateSend
+ * handlers check for known queues and add new ones under separate locks and give up on
+ * a contended lock, which is only safe on a single thread.
+ */
+static bool IsShardedMessage(const std::string& strCommand)
+{
+    static const std::set<std::string> setShardedMessages = {
+        NetMsgType::MNGOVERNANCEOBJECT,
+        NetMsgType::MNGOVERNANCEOBJECTVOTE,
+        NetMsgType::QSIGSESANN,
+        NetMsgType::QSIGSHARESINV,
+        NetMsgType::QGETSIGSHARES,
+        NetMsgType::QBSIGSHARES,
+        NetMsgType::QSIGSHARE,
+        NetMsgType::QSIGREC,
+        NetMsgType::ISLOCK,
+    };
+    return setShardedMessages.count(strCommand) != 0;
+}
+
+static bool SendRejectsAndCheckIfBanned(CNode* pnode, CConnman* connman);
+
+namespace {
+/** A message received from a peer that waits for or is processed on a message shard thread */
+struct CShardedMessage
+{
+    CShardedMessage(CNode* pfromIn, CConnman* connmanIn, const std::string& strCommandIn, CDataStream&& vRecvIn) :
+        pfrom(pfromIn->AddRef()), connman(connmanIn), strCommand(strCommandIn), vRecv(std::move(vRecvIn)),
+        nSize(vRecv.size() + CMessageHeader::HEADER_SIZE)
+    {
+        pfrom->nShardedMessages++;
+        nShardedMessagesQueued++;
+        // The message counts against the receive flood size of the peer until it is processed
+        LOCK(pfrom->cs_vProcessMsg);
+        pfrom->nProcessQueueSize += nSize;
+        connman->UpdatePauseRecv(pfrom);
+    }
+
+    ~CShardedMessage()
+    {
+        // Also runs for the messages that StopMessageShards drops from the queues
+        {
+            LOCK(pfrom->cs_vProcessMsg);
+            pfrom->nProcessQueueSize -= nSize;
+            connman->UpdatePauseRecv(pfrom);
+        }
+        nShardedMessagesQueued--;
+        if (--pfrom->nShardedMessages == 0) {
+            // ProcessMessages holds back the other messages of the peer until now
+            connman->WakeMessageHandler();
+        }
+        pfrom->Release();
+    }
+
+    CNode* const pfrom;
+    CConnman* const connman;
+    const std::string strCommand;
+    CDataStream vRecv;
+    const size_t nSize;
+};
+} // namespace
+
+static void ProcessShardedMessage(CShardedMessage& msg)
+{
+    CNode* pfrom = msg.pfrom;
+    if (pfrom->fDisconnect) {
+        return;
+    }
+
+    try {
+        ProcessExtensionMessage(pfrom, msg.strCommand, msg.vRecv, *msg.connman);
+    } catch (const std::ios_base::failure& e) {
+        if (g_enable_bip61) {
+            msg.connman->PushMessage(pfrom, CNetMsgMaker(INIT_PROTO_VERSION).Make(NetMsgType::REJECT, msg.strCommand, REJECT_MALFORMED, std::string("error parsing message")));
+        }
+        LogPrint(BCLog::NET, "%s(%s, %u bytes): Exception '%s' caught\n", __func__, SanitizeString(msg.strCommand), msg.nSize - CMessageHeader::HEADER_SIZE, e.what());
+    } catch (...) {
+        PrintExceptionContinue(std::current_exception(), "ProcessShardedMessage()");
+    }
+    nShardedMessagesProcessed++;
+
+    LOCK(cs_main);
+    SendRejectsAndCheckIfBanned(pfrom, msg.connman);
+}
+
+/**
+ * Hand a message received from pfrom to the shard of the peer. Returns false if it has
+ * to be processed inline instead, because the shards are not running or because it is
+ * not one of the sharded messages. vRecv is moved into the queued message.
+ */
+static bool QueueShardedMessage(CNode* pfrom, CConnman* connman, const std::string& strCommand, CDataStream& vRecv)
+{
+    if (!fMessageShardsRunning || !IsShardedMessage(strCommand)) {
+        return false;
+    }
+
+    LOCK(cs_messageshards);
+    if (!fMessageShardsRunning) {
+        return false;
+    }
+    auto msg = std::make_shared<CShardedMessage>(pfrom, connman, strCommand, std::move(vRecv));
+    vMessageShards[pfrom->GetId() % vMessageShards.size()]->push([msg](int) {
+        ProcessShardedMessage(*msg);
+    });
+    return true;
+}
+
+void StartMessageShards(int nThreads)
+{
+    if (nThreads <= 0) {
+        return;
+    }
+    LOCK(cs_messageshards);
+    for (int i = 0; i < nThreads; i++) {
+        vMessageShards.emplace_back(new ctpl::thread_pool(1));
+        RenameThreadPool(*vMessageShards.back(), strprintf("pigeon-shard%d", i).c_str());
+    }
+    fMessageShardsRunning = true;
+    LogPrintf("Using %d threads to process governance, LLMQ signing and InstantSend messages\n", nThreads);
+}
+
+void StopMessageShards()
+{
+    std::vector<std::unique_ptr<ctpl::thread_pool>> vShards;
+    {
+        LOCK(cs_messageshards);
+        if (!fMessageShardsRunning.exchange(false)) {
+            return;
+        }
+        vShards.swap(vMessageShards);
+    }
+    for (auto& shard : vShards) {
+        shard->clear_queue();
+        shard->stop(true);
+    }
+}
+
+MessageShardStats GetMessageShardStats()
+{
+    MessageShardStats stats;
+    {
+        LOCK(cs_messageshards);
+        stats.nThreads = (int)vMessageShards.size();
+    }
+    stats.nQueued = nShardedMessagesQueued;
+    stats.nProcessed = nShardedMessagesProcessed;
+    return stats;
+}
+
 bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc)
 {
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->GetId());
@@ -2644,6 +3339,21 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         return true;
     }
 
+    if (strCommand == NetMsgType::GETCFILTERS) {
+        ProcessGetCFilters(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
+    if (strCommand == NetMsgType::GETCFHEADERS) {
+        ProcessGetCFHeaders(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
+    if (strCommand == NetMsgType::GETCFCHECKPT) {
+        ProcessGetCFCheckPt(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
     if (strCommand == NetMsgType::GETHEADERS) {
         CBlockLocator locator;
         uint256 hashStop;
@@ -2786,119 +3496,29 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             mmetaman.DisallowMixing(dmn->proTxHash);
         }
 
+        if (nInvType == MSG_TX && QueueTxAdmission(pfrom, connman, strCommand, ptx)) {
+            return true;
+        }
+
         LOCK2(cs_main, g_cs_orphans);
 
         bool fMissingInputs = false;
         CValidationState state;
 
-        if (!AlreadyHave(inv) && AcceptToMemoryPool(mempool, state, ptx, &fMissingInputs /* pfMissingInputs */,
-                false /* bypass_limits */, 0 /* nAbsurdFee */)) {
-            // Process custom txes, this changes AlreadyHave to "true"
-            if (nInvType == MSG_DSTX) {
-                LogPrint(BCLog::PRIVATESEND, "DSTX -- Masternode transaction accepted, txid=%s, peer=%d\n",
-                         tx.GetHash().ToString(), pfrom->GetId());
-                CPrivateSend::AddDSTX(dstx);
-            }
-
-            mempool.check(pcoinsTip.get());
-            connman->RelayTransaction(tx);
-
-            for (unsigned int i = 0; i < tx.vout.size(); i++) {
-                auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(inv.hash, i));
-                if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
-                    for (const auto& elem : it_by_prev->second) {
-                        pfrom->orphan_work_set.insert(elem->first);
-                    }
-                }
-            }
-
-            pfrom->nLastTXTime = GetTime();
-
-            LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPool: peer=%d: accepted %s (poolsz %u txn, %u kB)\n",
-                     pfrom->GetId(),
-                     tx.GetHash().ToString(),
-                     mempool.size(), mempool.DynamicMemoryUsage() / 1000);
+        bool fAccepted = !AlreadyHave(inv) && AcceptToMemoryPool(mempool, state, ptx, &fMissingInputs /* pfMissingInputs */,
+                false /* bypass_limits */, 0 /* nAbsurdFee */);
+        // Process custom txes, this changes AlreadyHave to "true"
+        if (fAccepted && nInvType == MSG_DSTX) {
+            LogPrint(BCLog::PRIVATESEND, "DSTX -- Masternode transaction accepted, txid=%s, peer=%d\n",
+                     tx.GetHash().ToString(), pfrom->GetId());
+            CPrivateSend::AddDSTX(dstx);
+        }
 
+        ProcessTxAdmissionResult(pfrom, connman, strCommand, ptx, fAccepted, fMissingInputs, state);
+        if (fAccepted) {
             // Recursively process any orphan transactions that depended on this one
             ProcessOrphanTx(connman, pfrom->orphan_work_set);
         }
-        else if (fMissingInputs)
-        {
-            bool fRejectedParents = false; // It may be the case that the orphans parents have all been rejected
-            for (const CTxIn& txin : tx.vin) {
-                if (recentRejects->contains(txin.prevout.hash)) {
-                    fRejectedParents = true;
-                    break;
-                }
-            }
-            if (!fRejectedParents) {
-                const auto current_time = GetTime<std::chrono::microseconds>();
-
-                for (const CTxIn& txin : tx.vin) {
-                    CInv _inv(MSG_TX, txin.prevout.hash);
-                    pfrom->AddInventoryKnown(_inv);
-                    if (!AlreadyHave(_inv)) RequestObject(State(pfrom->GetId()), _inv, current_time);
-                    // We don't know if the previous tx was a regular or a mixing one, try both
-                    CInv _inv2(MSG_DSTX, txin.prevout.hash);
-                    pfrom->AddInventoryKnown(_inv2);
-                    if (!AlreadyHave(_inv2)) RequestObject(State(pfrom->GetId()), _inv2, current_time);
-                }
-                AddOrphanTx(ptx, pfrom->GetId());
-
-                // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
-                unsigned int nMaxOrphanTxSize = (unsigned int)std::max((int64_t)0, gArgs.GetArg("-maxorphantxsize", DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE)) * 1000000;
-                unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTxSize);
-                if (nEvicted > 0) {
-                    LogPrint(BCLog::MEMPOOL, "mapOrphan overflow, removed %u tx\n", nEvicted);
-                }
-            } else {
-                LogPrint(BCLog::MEMPOOL, "not keeping orphan with rejected parents %s\n",tx.GetHash().ToString());
-                // We will continue to reject this tx since it has rejected
-                // parents so avoid re-requesting it from other peers.
-                recentRejects->insert(tx.GetHash());
-            }
-        } else {
-            if (!state.CorruptionPossible()) {
-                assert(recentRejects);
-                recentRejects->insert(tx.GetHash());
-                if (RecursiveDynamicUsage(*ptx) < 100000) {
-                    AddToCompactExtraTransactions(ptx);
-                }
-            }
-
-            if (pfrom->fWhitelisted && gArgs.GetBoolArg("-whitelistforcerelay", DEFAULT_WHITELISTFORCERELAY)) {
-                // Always relay transactions received from whitelisted peers, even
-                // if they were already in the mempool or rejected from it due
-                // to policy, allowing the node to function as a gateway for
-                // nodes hidden behind it.
-                //
-                // Never relay transactions that we would assign a non-zero DoS
-                // score for, as we expect peers to do the same with us in that
-                // case.
-                int nDoS = 0;
-                if (!state.IsInvalid(nDoS) || nDoS == 0) {
-                    LogPrintf("Force relaying tx %s from whitelisted peer=%d\n", tx.GetHash().ToString(), pfrom->GetId());
-                    connman->RelayTransaction(tx);
-                } else {
-                    LogPrintf("Not relaying invalid transaction %s from whitelisted peer=%d (%s)\n", tx.GetHash().ToString(), pfrom->GetId(), FormatStateMessage(state));
-                }
-            }
-        }
-
-        int nDoS = 0;
-        if (state.IsInvalid(nDoS))
-        {
-            LogPrint(BCLog::MEMPOOLREJ, "%s from peer=%d was not accepted: %s\n", tx.GetHash().ToString(),
-                pfrom->GetId(),
-                FormatStateMessage(state));
-            if (g_enable_bip61 && state.GetRejectCode() > 0 && state.GetRejectCode() < REJECT_INTERNAL) { // Never send AcceptToMemoryPool's internal codes over P2P
-                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::REJECT, strCommand, (unsigned char)state.GetRejectCode(),
-                                   state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash));
-            }
-            if (nDoS > 0) {
-                Misbehaving(pfrom->GetId(), nDoS);
-            }
-        }
         return true;
     }
 
@@ -3487,20 +4107,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     if (found)
     {
         //probably one the extensions
-#ifdef ENABLE_WALLET
-        privateSendClient.ProcessMessage(pfrom, strCommand, vRecv, *connman);
-#endif // ENABLE_WALLET
-        privateSendServer.ProcessMessage(pfrom, strCommand, vRecv, *connman);
-        sporkManager.ProcessSpork(pfrom, strCommand, vRecv, *connman);
-        masternodeSync.ProcessMessage(pfrom, strCommand, vRecv);
-        governance.ProcessMessage(pfrom, strCommand, vRecv, *connman);
-        CMNAuth::ProcessMessage(pfrom, strCommand, vRecv, *connman);
-        llmq::quorumBlockProcessor->ProcessMessage(pfrom, strCommand, vRecv, *connman);
-        llmq::quorumDKGSessionManager->ProcessMessage(pfrom, strCommand, vRecv, *connman);
-        llmq::quorumSigSharesManager->ProcessMessage(pfrom, strCommand, vRecv, *connman);
-        llmq::quorumSigningManager->ProcessMessage(pfrom, strCommand, vRecv, *connman);
-        llmq::chainLocksHandler->ProcessMessage(pfrom, strCommand, vRecv, *connman);
-        llmq::quorumInstantSendManager->ProcessMessage(pfrom, strCommand, vRecv, *connman);
+        if (!QueueShardedMessage(pfrom, connman, strCommand, vRecv)) {
+            ProcessExtensionMessage(pfrom, strCommand, vRecv, *connman);
+        }
         return true;
     }
 
@@ -3558,7 +4167,7 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     if (!pfrom->vRecvGetData.empty())
         ProcessGetData(pfrom, chainparams, connman, interruptMsgProc);
 
-    if (!pfrom->orphan_work_set.empty()) {
+    if (HasOrphanWork(pfrom)) {
         LOCK2(cs_main, g_cs_orphans);
         ProcessOrphanTx(connman, pfrom->orphan_work_set);
     }
@@ -3568,21 +4177,27 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
 
     // this maintains the order of responses
     if (!pfrom->vRecvGetData.empty()) return true;
-    if (!pfrom->orphan_work_set.empty()) return true;
+    if (HasOrphanWork(pfrom)) return true;
 
     // Don't bother if send buffer is too full to respond anyway
     if (pfrom->fPauseSend)
         return false;
 
-    std::list<CNetMessage> msgs;
+    // The message and its buffers are reused once it is processed, whichever way this returns
+    CPooledNetMessages pooled(connman->GetNetMessagePool());
+    std::list<CNetMessage>& msgs = pooled.msgs;
     {
         LOCK(pfrom->cs_vProcessMsg);
         if (pfrom->vProcessMsg.empty())
             return false;
+        // Messages that the shard threads don't process must not overtake those of the
+        // peer that they still have. The last of those wakes us again.
+        if (pfrom->nShardedMessages > 0 && !IsShardedMessage(pfrom->vProcessMsg.front().hdr.GetCommand()))
+            return false;
         // Just take one message
         msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin());
         pfrom->nProcessQueueSize -= msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
-        pfrom->fPauseRecv = pfrom->nProcessQueueSize > connman->GetReceiveFloodSize();
+        connman->UpdatePauseRecv(pfrom);
         fMoreWork = !pfrom->vProcessMsg.empty();
     }
     CNetMessage& msg(msgs.front());
@@ -4029,7 +4644,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
                     {
                         LOCK(cs_most_recent_block);
                         if (most_recent_block_hash == pBestIndex->GetBlockHash()) {
-                            connman->PushMessage(pto, msgMaker.Make(NetMsgType::CMPCTBLOCK, *most_recent_compact_block));
+                            connman->PushMessage(pto, *most_recent_compact_block_msg);
                             fGotBlockFromCache = true;
                         }
                     }
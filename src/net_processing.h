@@ -37,6 +37,15 @@ static constexpr int64_t EXTRA_PEER_CHECK_INTERVAL = 45;
 /** Minimum time an outbound-peer-eviction candidate must be connected for, in order to evict, in seconds */
 static constexpr int64_t MINIMUM_CONNECT_TIME = 30;
 
+/** Maximum number of threads validating transactions received from peers */
+static const int MAX_TX_ADMISSION_THREADS = 16;
+/** Default for -txadmissionthreads, 0 validates transactions on the message handler thread */
+static const int DEFAULT_TX_ADMISSION_THREADS = 0;
+/** Maximum number of threads processing governance, LLMQ signing and InstantSend messages */
+static const int MAX_MESSAGE_SHARD_THREADS = 16;
+/** Default for -msgshardthreads, 0 processes all messages on the message handler thread */
+static const int DEFAULT_MESSAGE_SHARD_THREADS = 0;
+
 /** Default for BIP61 (sending reject messages) */
 static constexpr bool DEFAULT_ENABLE_BIP61 = true;
 /** Enable BIP61 (sending reject messages) */
@@ -89,6 +98,43 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
 void Misbehaving(NodeId nodeid, int howmuch, const std::string& message="");
 bool IsBanned(NodeId nodeid);
 
+struct TxAdmissionStats {
+    int nThreads;
+    size_t nQueued;
+    uint64_t nAdmitted;
+    uint64_t nRejected;
+    double dAdmittedPerSecond;
+};
+
+/**
+ * Validate transactions received from peers on nThreads threads, which only hold
+ * cs_main for the checks that need it and verify scripts without it. Transactions
+ * are still validated on the message handler thread with nThreads <= 0.
+ */
+void StartTxAdmission(int nThreads);
+/** Wait for the transactions that are in validation and drop the queued ones */
+void StopTxAdmission();
+/** Get the number of queued transactions and of those accepted from and rejected for peers */
+TxAdmissionStats GetTxAdmissionStats();
+
+struct MessageShardStats {
+    int nThreads;
+    size_t nQueued;
+    uint64_t nProcessed;
+};
+
+/**
+ * Process the governance, LLMQ signing and InstantSend lock messages
+ * of peers on nThreads shard threads besides the message handler thread. The messages of
+ * a peer always go to the same shard and the message handler holds back the peer's other
+ * messages while the shard has some, so each peer's messages are processed in order.
+ */
+void StartMessageShards(int nThreads);
+/** Wait for the messages in processing and drop the queued ones */
+void StopMessageShards();
+/** Get the number of shard threads and of queued and processed messages */
+MessageShardStats GetMessageShardStats();
+
 void EraseObjectRequest(NodeId nodeId, const CInv& inv);
 void RequestObject(NodeId nodeId, const CInv& inv, std::chrono::microseconds current_time, bool fForce=false);
 size_t GetRequestedObjectCount(NodeId nodeId);
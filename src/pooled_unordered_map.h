@@ -0,0 +1,364 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_POOLED_UNORDERED_MAP_H
+#define BITCOIN_POOLED_UNORDERED_MAP_H
+
+#include <crypto/common.h>
+#include <memusage.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdint.h>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Hash map with a subset of the std::unordered_map interface that keeps its
+ * entries in a pool instead of allocating a node per entry.
+ *
+ * Entries live in chunks that grow geometrically up to MAX_CHUNK_SIZE entries
+ * and never move, so iterators and references stay valid until the entry is
+ * erased (unlike std::unordered_map, also across insertions). Erased entries
+ * are reused by later insertions. The index is an open-addressing table with
+ * linear probing. Each slot holds 32 bits of the hash next to the position of
+ * the entry, so probing rarely touches an entry that does not match and the
+ * table can grow without hashing the keys again.
+ *
+ * Iteration follows the pool, not the hash order. Erasing entries while
+ * iterating is fine, inserting may or may not visit the new entries.
+ * Memory is only returned by clear() and the destructor.
+ */
+template <typename K, typename T, typename Hash = std::hash<K>>
+class pooled_unordered_map
+{
+public:
+    typedef K key_type;
+    typedef T mapped_type;
+    typedef std::pair<const K, T> value_type;
+    typedef size_t size_type;
+    typedef Hash hasher;
+
+private:
+    static const uint32_t NPOS = ~uint32_t(0);
+    static const unsigned int FIRST_CHUNK_BITS = 4;
+    static const unsigned int MAX_CHUNK_BITS = 10;
+
+    struct node {
+        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type data;
+    };
+
+    Hash m_hash;
+    //! Chunk k holds 2^FIRST_CHUNK_BITS entries for k = 0, then twice as many as chunk k - 1 up to 2^MAX_CHUNK_BITS
+    std::vector<std::unique_ptr<node[]>> m_chunks;
+    //! One bit per entry of the pool, set if the entry is in use
+    std::vector<uint64_t> m_used;
+    //! Unused entries below m_next_node
+    std::vector<uint32_t> m_free;
+    //! Open-addressing index, a slot is (32 bits of hash << 32) | (entry position + 1), or 0 if empty
+    std::vector<uint64_t> m_slots;
+    uint32_t m_next_node{0};
+    uint32_t m_node_capacity{0};
+    size_t m_size{0};
+    //! Memory usage of the chunks
+    size_t m_chunk_usage{0};
+
+    static size_t chunk_size(size_t k)
+    {
+        return size_t{1} << std::min<size_t>(k == 0 ? FIRST_CHUNK_BITS : FIRST_CHUNK_BITS + k - 1, MAX_CHUNK_BITS);
+    }
+
+    value_type* value_at(uint32_t pos) const
+    {
+        size_t k, offset;
+        if (pos < (1U << FIRST_CHUNK_BITS)) {
+            k = 0;
+            offset = pos;
+        } else if (pos < (1U << MAX_CHUNK_BITS)) {
+            const unsigned int bits = CountBits(pos) - 1;
+            k = bits - FIRST_CHUNK_BITS + 1;
+            offset = pos - (1U << bits);
+        } else {
+            k = MAX_CHUNK_BITS - FIRST_CHUNK_BITS + (pos >> MAX_CHUNK_BITS);
+            offset = pos & ((1U << MAX_CHUNK_BITS) - 1);
+        }
+        return reinterpret_cast<value_type*>(&m_chunks[k][offset].data);
+    }
+
+    //! Position of the first entry in use at or after pos, or NPOS
+    uint32_t next_used(uint32_t pos) const
+    {
+        size_t word = pos >> 6;
+        if (pos >= m_next_node) {
+            return NPOS;
+        }
+        uint64_t bits = m_used[word] & (~uint64_t{0} << (pos & 63));
+        while (bits == 0) {
+            if (++word == m_used.size()) {
+                return NPOS;
+            }
+            bits = m_used[word];
+        }
+        return (word << 6) + CountBits(bits & (~bits + 1)) - 1;
+    }
+
+    uint32_t hash32(const K& key) const
+    {
+        const uint64_t hash = m_hash(key);
+        return (uint32_t)(hash ^ (hash >> 32));
+    }
+
+    uint32_t find_pos(const K& key, uint32_t hash) const
+    {
+        if (m_slots.empty()) {
+            return NPOS;
+        }
+        const size_t mask = m_slots.size() - 1;
+        for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+            const uint64_t slot = m_slots[i];
+            if (slot == 0) {
+                return NPOS;
+            }
+            if ((uint32_t)(slot >> 32) == hash && value_at((uint32_t)slot - 1)->first == key) {
+                return (uint32_t)slot - 1;
+            }
+        }
+    }
+
+    static void insert_slot(std::vector<uint64_t>& slots, uint64_t slot)
+    {
+        const size_t mask = slots.size() - 1;
+        size_t i = (slot >> 32) & mask;
+        while (slots[i] != 0) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = slot;
+    }
+
+    void grow_slots()
+    {
+        std::vector<uint64_t> slots(std::max<size_t>(m_slots.size() * 2, size_t{1} << FIRST_CHUNK_BITS), 0);
+        for (uint64_t slot : m_slots) {
+            if (slot != 0) {
+                insert_slot(slots, slot);
+            }
+        }
+        m_slots.swap(slots);
+    }
+
+    //! Remove the slot of the entry at pos, shifting back the slots after it so no lookup stops early
+    void erase_slot(uint32_t pos, uint32_t hash)
+    {
+        const size_t mask = m_slots.size() - 1;
+        size_t i = hash & mask;
+        while ((uint32_t)m_slots[i] != pos + 1) {
+            i = (i + 1) & mask;
+        }
+        for (size_t j = (i + 1) & mask; m_slots[j] != 0; j = (j + 1) & mask) {
+            const size_t home = (m_slots[j] >> 32) & mask;
+            // Move slot j into the hole at i unless its home lies cyclically in (i, j]
+            if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+                m_slots[i] = m_slots[j];
+                i = j;
+            }
+        }
+        m_slots[i] = 0;
+    }
+
+    uint32_t allocate_node()
+    {
+        if (!m_free.empty()) {
+            const uint32_t pos = m_free.back();
+            m_free.pop_back();
+            return pos;
+        }
+        if (m_next_node == m_node_capacity) {
+            const size_t n = chunk_size(m_chunks.size());
+            assert(m_node_capacity + n < NPOS);
+            m_chunks.emplace_back(new node[n]);
+            m_chunk_usage += memusage::MallocUsage(sizeof(node) * n);
+            m_node_capacity += n;
+            m_used.resize((m_node_capacity + 63) / 64, 0);
+        }
+        return m_next_node++;
+    }
+
+    void release_node(uint32_t pos)
+    {
+        m_used[pos >> 6] &= ~(uint64_t{1} << (pos & 63));
+        m_free.push_back(pos);
+    }
+
+    template <bool Const>
+    class iterator_base
+    {
+        friend class pooled_unordered_map;
+        template <bool> friend class iterator_base;
+        typedef typename std::conditional<Const, const pooled_unordered_map*, pooled_unordered_map*>::type map_pointer;
+
+        map_pointer m_map{nullptr};
+        uint32_t m_pos{NPOS};
+
+        iterator_base(map_pointer map, uint32_t pos) : m_map(map), m_pos(pos) {}
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename pooled_unordered_map::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef typename std::conditional<Const, const value_type*, value_type*>::type pointer;
+        typedef typename std::conditional<Const, const value_type&, value_type&>::type reference;
+
+        iterator_base() {}
+        template <bool OtherConst, typename = typename std::enable_if<Const && !OtherConst>::type>
+        iterator_base(const iterator_base<OtherConst>& other) : m_map(other.m_map), m_pos(other.m_pos) {}
+
+        reference operator*() const { return *m_map->value_at(m_pos); }
+        pointer operator->() const { return m_map->value_at(m_pos); }
+        iterator_base& operator++() { m_pos = m_map->next_used(m_pos + 1); return *this; }
+        iterator_base operator++(int) { iterator_base copy = *this; ++*this; return copy; }
+        template <bool OtherConst>
+        bool operator==(const iterator_base<OtherConst>& other) const { return m_pos == other.m_pos; }
+        template <bool OtherConst>
+        bool operator!=(const iterator_base<OtherConst>& other) const { return m_pos != other.m_pos; }
+    };
+
+public:
+    typedef iterator_base<false> iterator;
+    typedef iterator_base<true> const_iterator;
+
+    pooled_unordered_map() {}
+    pooled_unordered_map(pooled_unordered_map&& other) :
+        m_hash(other.m_hash), m_chunks(std::move(other.m_chunks)), m_used(std::move(other.m_used)),
+        m_free(std::move(other.m_free)), m_slots(std::move(other.m_slots)),
+        m_next_node(other.m_next_node), m_node_capacity(other.m_node_capacity), m_size(other.m_size),
+        m_chunk_usage(other.m_chunk_usage)
+    {
+        other.m_next_node = 0;
+        other.clear();
+    }
+    pooled_unordered_map(const pooled_unordered_map&) = delete;
+    pooled_unordered_map& operator=(const pooled_unordered_map&) = delete;
+    ~pooled_unordered_map() { clear(); }
+
+    iterator begin() { return iterator(this, next_used(0)); }
+    const_iterator begin() const { return const_iterator(this, next_used(0)); }
+    iterator end() { return iterator(this, NPOS); }
+    const_iterator end() const { return const_iterator(this, NPOS); }
+
+    size_type size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    size_type bucket_count() const { return m_slots.size(); }
+
+    iterator find(const K& key) { return iterator(this, find_pos(key, hash32(key))); }
+    const_iterator find(const K& key) const { return const_iterator(this, find_pos(key, hash32(key))); }
+    size_type count(const K& key) const { return find_pos(key, hash32(key)) != NPOS ? 1 : 0; }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args)
+    {
+        const uint32_t pos = allocate_node();
+        value_type* value;
+        try {
+            value = new (value_at(pos)) value_type(std::forward<Args>(args)...);
+        } catch (...) {
+            m_free.push_back(pos);
+            throw;
+        }
+
+        const uint32_t hash = hash32(value->first);
+        const uint32_t existing = find_pos(value->first, hash);
+        if (existing != NPOS) {
+            value->~value_type();
+            m_free.push_back(pos);
+            return std::make_pair(iterator(this, existing), false);
+        }
+
+        if ((m_size + 1) * 4 > m_slots.size() * 3) {
+            try {
+                grow_slots();
+            } catch (...) {
+                value->~value_type();
+                m_free.push_back(pos);
+                throw;
+            }
+        }
+        // only mark the node used once nothing can throw anymore
+        m_used[pos >> 6] |= uint64_t{1} << (pos & 63);
+        insert_slot(m_slots, ((uint64_t)hash << 32) | (pos + 1));
+        m_size++;
+        return std::make_pair(iterator(this, pos), true);
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value) { return emplace(value); }
+    std::pair<iterator, bool> insert(value_type&& value) { return emplace(std::move(value)); }
+
+    T& operator[](const K& key)
+    {
+        const uint32_t pos = find_pos(key, hash32(key));
+        if (pos != NPOS) {
+            return value_at(pos)->second;
+        }
+        return emplace(std::piecewise_construct, std::forward_as_tuple(key), std::tuple<>()).first->second;
+    }
+
+    iterator erase(const_iterator it)
+    {
+        const uint32_t pos = it.m_pos;
+        value_type* value = value_at(pos);
+        erase_slot(pos, hash32(value->first));
+        value->~value_type();
+        release_node(pos);
+        m_size--;
+        return iterator(this, next_used(pos + 1));
+    }
+
+    size_type erase(const K& key)
+    {
+        const uint32_t pos = find_pos(key, hash32(key));
+        if (pos == NPOS) {
+            return 0;
+        }
+        erase(const_iterator(this, pos));
+        return 1;
+    }
+
+    //! Destroy all entries and release the pool and the index
+    void clear()
+    {
+        for (uint32_t pos = next_used(0); pos != NPOS; pos = next_used(pos + 1)) {
+            value_at(pos)->~value_type();
+        }
+        std::vector<std::unique_ptr<node[]>>().swap(m_chunks);
+        std::vector<uint64_t>().swap(m_used);
+        std::vector<uint32_t>().swap(m_free);
+        std::vector<uint64_t>().swap(m_slots);
+        m_next_node = 0;
+        m_node_capacity = 0;
+        m_size = 0;
+        m_chunk_usage = 0;
+    }
+
+    size_t DynamicMemoryUsage() const
+    {
+        return m_chunk_usage + memusage::DynamicUsage(m_chunks) + memusage::DynamicUsage(m_used) +
+               memusage::DynamicUsage(m_free) + memusage::DynamicUsage(m_slots);
+    }
+};
+
+namespace memusage
+{
+template <typename K, typename T, typename Hash>
+static inline size_t DynamicUsage(const pooled_unordered_map<K, T, Hash>& m)
+{
+    return m.DynamicMemoryUsage();
+}
+}
+
+#endif // BITCOIN_POOLED_UNORDERED_MAP_H
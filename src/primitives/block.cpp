@@ -4,13 +4,18 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <primitives/block.h>
-#include "algo/hashx21s.h"
+#include <algo/x21s_hasher.h>
 
 #include <hash.h>
 #include <streams.h>
 #include <tinyformat.h>
 #include <utilstrencodings.h>
 #include <crypto/common.h>
+
+#include <algorithm>
+
+#include <string.h>
+
 static const uint32_t MAINNET_X21SACTIVATIONTIME = 1571097600;//10-15-2019 00:00:00GMT
 static const uint32_t TESTNET_X21SACTIVATIONTIME = 1568851200;//09-19-2019 00:00:00GMT
 static const uint32_t REGTEST_X21SACTIVATIONTIME = 1568951200;
@@ -31,18 +36,121 @@ void BlockNetwork::SetNetwork(const std::string& net)
         fOnRegtest = true;
     }
 }
+CBlockHeader& CBlockHeader::operator=(const CBlockHeader& other)
+{
+    if (this == &other) {
+        return *this;
+    }
+
+    nVersion       = other.nVersion;
+    hashPrevBlock  = other.hashPrevBlock;
+    hashMerkleRoot = other.hashMerkleRoot;
+    nTime          = other.nTime;
+    nBits          = other.nBits;
+    nNonce         = other.nNonce;
+
+    std::lock_guard<std::mutex> lock(other.cs_hashCache);
+    fHashCached = other.fHashCached;
+    memcpy(vchHashedHeader, other.vchHashedHeader, sizeof(vchHashedHeader));
+    hashCached = other.hashCached;
+    return *this;
+}
+
+bool CBlockHeader::IsX21S() const
+{
+    uint32_t nTimeToUse = MAINNET_X21SACTIVATIONTIME;
+    if (bNetwork.fOnTestnet) {
+        nTimeToUse = TESTNET_X21SACTIVATIONTIME;
+    } else if (bNetwork.fOnRegtest) {
+        nTimeToUse = REGTEST_X21SACTIVATIONTIME;
+    }
+    return nTime >= nTimeToUse;
+}
+
+uint256 CBlockHeader::ComputeHash() const
+{
+    if (IsX21S()) {
+        return GetThreadX21SHasher().HashX21S(BEGIN(nVersion), END(nNonce) - BEGIN(nVersion), hashPrevBlock);
+    }
+    return GetThreadX21SHasher().HashX16R(BEGIN(nVersion), END(nNonce) - BEGIN(nVersion), hashPrevBlock);
+}
+
+bool CBlockHeader::GetCachedHash(const unsigned char* vchHeader, uint256& hash) const
+{
+    std::lock_guard<std::mutex> lock(cs_hashCache);
+    if (fHashCached && memcmp(vchHashedHeader, vchHeader, HEADER_HASH_SIZE) == 0) {
+        hash = hashCached;
+        return true;
+    }
+    return false;
+}
+
+void CBlockHeader::SetCachedHash(const unsigned char* vchHeader, const uint256& hash) const
+{
+    std::lock_guard<std::mutex> lock(cs_hashCache);
+    memcpy(vchHashedHeader, vchHeader, HEADER_HASH_SIZE);
+    hashCached = hash;
+    fHashCached = true;
+}
+
 uint256 CBlockHeader::GetHash() const
 {
-	 uint32_t nTimeToUse = MAINNET_X21SACTIVATIONTIME;
-	if (bNetwork.fOnTestnet) {
-		nTimeToUse = TESTNET_X21SACTIVATIONTIME;
-	} else if (bNetwork.fOnRegtest) {
-		nTimeToUse = REGTEST_X21SACTIVATIONTIME;
-	}
-	if (nTime >= nTimeToUse) {
-		return HashX21S(BEGIN(nVersion), END(nNonce), hashPrevBlock);
-	}
-    return HashX16R(BEGIN(nVersion), END(nNonce), hashPrevBlock);
+    // The header fields are public and get mutated in place (e.g. by miners
+    // bumping nNonce), so the cache is keyed on the raw header bytes instead
+    // of relying on explicit invalidation.
+    unsigned char vchHeader[HEADER_HASH_SIZE];
+    assert(END(nNonce) - BEGIN(nVersion) == HEADER_HASH_SIZE);
+    memcpy(vchHeader, BEGIN(nVersion), HEADER_HASH_SIZE);
+
+    uint256 hash;
+    if (!GetCachedHash(vchHeader, hash)) {
+        hash = ComputeHash();
+        SetCachedHash(vchHeader, hash);
+    }
+    return hash;
+}
+
+void CBlockHeader::GetHashes(const CBlockHeader* const headers[], uint256 hashOut[], size_t n)
+{
+    // the lanes of a batch are split by algorithm, the header bytes are
+    // copied so that the cache is keyed on exactly what was hashed
+    unsigned char vchHeaders[X16R_MAX_LANES][HEADER_HASH_SIZE];
+    const unsigned char* data[2][X16R_MAX_LANES];
+    uint256 hashPrevBlock[2][X16R_MAX_LANES];
+    size_t lanes[2][X16R_MAX_LANES];
+    uint256 hashes[X16R_MAX_LANES];
+
+    for (size_t first = 0; first < n; first += X16R_MAX_LANES) {
+        const size_t nBatch = std::min(n - first, X16R_MAX_LANES);
+        size_t nLanes[2] = {0, 0};
+        for (size_t i = 0; i < nBatch; i++) {
+            const CBlockHeader& header = *headers[first + i];
+            memcpy(vchHeaders[i], BEGIN(header.nVersion), HEADER_HASH_SIZE);
+            if (header.GetCachedHash(vchHeaders[i], hashOut[first + i])) {
+                continue;
+            }
+            const int nAlgo = header.IsX21S() ? 1 : 0;
+            data[nAlgo][nLanes[nAlgo]] = vchHeaders[i];
+            hashPrevBlock[nAlgo][nLanes[nAlgo]] = header.hashPrevBlock;
+            lanes[nAlgo][nLanes[nAlgo]++] = i;
+        }
+
+        for (int nAlgo = 0; nAlgo < 2; nAlgo++) {
+            if (nLanes[nAlgo] == 0) {
+                continue;
+            }
+            if (nAlgo == 1) {
+                GetThreadX21SHasher().HashX21SMulti(data[nAlgo], HEADER_HASH_SIZE, hashPrevBlock[nAlgo], hashes, nLanes[nAlgo]);
+            } else {
+                GetThreadX21SHasher().HashX16RMulti(data[nAlgo], HEADER_HASH_SIZE, hashPrevBlock[nAlgo], hashes, nLanes[nAlgo]);
+            }
+            for (size_t l = 0; l < nLanes[nAlgo]; l++) {
+                const size_t i = lanes[nAlgo][l];
+                headers[first + i]->SetCachedHash(vchHeaders[i], hashes[l]);
+                hashOut[first + i] = hashes[l];
+            }
+        }
+    }
 }
 
 std::string CBlock::ToString() const
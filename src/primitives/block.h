@@ -10,6 +10,8 @@
 #include <serialize.h>
 #include <uint256.h>
 
+#include <mutex>
+
 class BlockNetwork
 {
 public:
@@ -44,6 +46,13 @@ public:
         SetNull();
     }
 
+    CBlockHeader(const CBlockHeader& other)
+    {
+        *this = other;
+    }
+
+    CBlockHeader& operator=(const CBlockHeader& other);
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -71,12 +80,35 @@ public:
         return (nBits == 0);
     }
 
+    /** Returns the PoW hash of this header. The result is memoized and only
+     * recomputed when one of the header fields above has changed since the
+     * last call, so repeated calls on the same header are cheap. */
     uint256 GetHash() const;
 
+    /** Compute the PoW hashes of n headers on the multi-lane X16R/X21S kernels
+     * and memoize them in the headers, as GetHash() would one by one. The
+     * kernels only pay off for headers that share hashPrevBlock. */
+    static void GetHashes(const CBlockHeader* const headers[], uint256 hashOut[], size_t n);
+
     int64_t GetBlockTime() const
     {
         return (int64_t)nTime;
     }
+
+private:
+    static const size_t HEADER_HASH_SIZE = 80;
+
+    uint256 ComputeHash() const;
+    /** Whether this header is hashed with X21S rather than X16R */
+    bool IsX21S() const;
+    bool GetCachedHash(const unsigned char* vchHeader, uint256& hash) const;
+    void SetCachedHash(const unsigned char* vchHeader, const uint256& hash) const;
+
+    // memory only
+    mutable std::mutex cs_hashCache;
+    mutable bool fHashCached{false};
+    mutable unsigned char vchHashedHeader[HEADER_HASH_SIZE];
+    mutable uint256 hashCached;
 };
 
 
@@ -119,14 +151,8 @@ public:
 
     CBlockHeader GetBlockHeader() const
     {
-        CBlockHeader block;
-        block.nVersion       = nVersion;
-        block.hashPrevBlock  = hashPrevBlock;
-        block.hashMerkleRoot = hashMerkleRoot;
-        block.nTime          = nTime;
-        block.nBits          = nBits;
-        block.nNonce         = nNonce;
-        return block;
+        // slicing copy, which also carries over the cached header hash
+        return CBlockHeader(*this);
     }
 
     std::string ToString() const;
@@ -26,7 +26,12 @@
 #include <txmempool.h>
 #include <util.h>
 #include <utilstrencodings.h>
+#include <utxosnapshot.h>
+#include <validationstats.h>
 #include <hash.h>
+#include <index/blockfilterindex.h>
+#include <index/timestampindex.h>
+#include <net_processing.h>
 #include <warnings.h>
 
 #include <evo/specialtx.h>
@@ -411,6 +416,9 @@ std::string EntryDescriptionString()
            "    \"ancestorcount\" : n,        (numeric) number of in-mempool ancestor transactions (including this one)\n"
            "    \"ancestorsize\" : n,         (numeric) size of in-mempool ancestors (including this one)\n"
            "    \"ancestorfees\" : n,         (numeric) modified fees (see above) of in-mempool ancestors (including this one)\n"
+           "    \"clustercount\" : n,         (numeric) number of in-mempool transactions connected to this one (including this one)\n"
+           "    \"clustersize\" : n,          (numeric) size of the connected in-mempool transactions (including this one)\n"
+           "    \"clusterfees\" : n,          (numeric) modified fees (see above) of the connected in-mempool transactions (including this one)\n"
            "    \"depends\" : [               (array) unconfirmed transactions used as inputs for this transaction\n"
            "        \"transactionid\",        (string) parent transaction id\n"
            "       ... ],\n"
@@ -432,6 +440,9 @@ void entryToJSON(UniValue &info, const CTxMemPoolEntry &e)
     info.push_back(Pair("ancestorcount", e.GetCountWithAncestors()));
     info.push_back(Pair("ancestorsize", e.GetSizeWithAncestors()));
     info.push_back(Pair("ancestorfees", e.GetModFeesWithAncestors()));
+    info.push_back(Pair("clustercount", e.GetCountWithCluster()));
+    info.push_back(Pair("clustersize", e.GetSizeWithCluster()));
+    info.push_back(Pair("clusterfees", e.GetModFeesWithCluster()));
     const CTransaction& tx = e.GetTx();
     std::set<std::string> setDepends;
     for (const CTxIn& txin : tx.vin)
@@ -671,6 +682,16 @@ UniValue getmempoolentry(const JSONRPCRequest& request)
     return info;
 }
 
+void EnsureIndexSynced(BaseIndex* index, const std::string& strName)
+{
+    if (!index) {
+        throw JSONRPCError(RPC_MISC_ERROR, strName + " is not enabled");
+    }
+    if (!index->BlockUntilSyncedToCurrentChain()) {
+        throw JSONRPCError(RPC_MISC_ERROR, strName + " is still in the process of being built, try again later");
+    }
+}
+
 UniValue getblockhashes(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 2)
@@ -691,6 +712,9 @@ UniValue getblockhashes(const JSONRPCRequest& request)
 
     unsigned int high = request.params[0].get_int();
     unsigned int low = request.params[1].get_int();
+
+    EnsureIndexSynced(g_timestampindex.get(), "Timestamp index");
+
     std::vector<uint256> blockHashes;
 
     if (!GetTimestampIndex(high, low, blockHashes)) {
@@ -1448,6 +1472,13 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
             "        }\n"
             "     }\n"
             "  }\n"
+            "  \"coinsprefetch\": {            (object) inputs of blocks read ahead of ConnectBlock\n"
+            "     \"hits\": xx,                (numeric) coin lookups served from prefetched coins\n"
+            "     \"misses\": xx,              (numeric) coin lookups that had to read the database\n"
+            "     \"prefetched\": xx,          (numeric) coins read ahead\n"
+            "     \"dropped\": xx,             (numeric) prefetched coins dropped unused by cache flushes\n"
+            "     \"size\": xx                 (numeric) prefetched coins waiting to be used\n"
+            "  }\n"
             "  \"warnings\" : \"...\",           (string) any network and blockchain warnings.\n"
             "}\n"
             "\nExamples:\n"
@@ -1500,6 +1531,17 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
     obj.push_back(Pair("softforks",             softforks));
     obj.push_back(Pair("bip9_softforks", bip9_softforks));
 
+    if (pcoinsPrefetch) {
+        const CCoinsViewPrefetch::Stats prefetchStats = pcoinsPrefetch->GetStats();
+        UniValue prefetch(UniValue::VOBJ);
+        prefetch.push_back(Pair("hits",       prefetchStats.nHits));
+        prefetch.push_back(Pair("misses",     prefetchStats.nMisses));
+        prefetch.push_back(Pair("prefetched", prefetchStats.nPrefetched));
+        prefetch.push_back(Pair("dropped",    prefetchStats.nDropped));
+        prefetch.push_back(Pair("size",       (uint64_t)prefetchStats.nSize));
+        obj.push_back(Pair("coinsprefetch", prefetch));
+    }
+
     obj.push_back(Pair("warnings", GetWarnings("statusbar")));
     return obj;
 }
@@ -1659,6 +1701,15 @@ UniValue mempoolInfoToJSON()
     ret.push_back(Pair("minrelaytxfee", ValueFromAmount(::minRelayTxFee.GetFeePerK())));
     ret.push_back(Pair("instantsendlocks", (int64_t)llmq::quorumInstantSendManager->GetInstantSendLockCount()));
 
+    const TxAdmissionStats admissionStats = GetTxAdmissionStats();
+    UniValue admission(UniValue::VOBJ);
+    admission.push_back(Pair("threads", admissionStats.nThreads));
+    admission.push_back(Pair("queued", (int64_t)admissionStats.nQueued));
+    admission.push_back(Pair("admitted", (int64_t)admissionStats.nAdmitted));
+    admission.push_back(Pair("rejected", (int64_t)admissionStats.nRejected));
+    admission.push_back(Pair("admittedpersec", admissionStats.dAdmittedPerSecond));
+    ret.push_back(Pair("admission", admission));
+
     return ret;
 }
 
@@ -1677,6 +1728,13 @@ UniValue getmempoolinfo(const JSONRPCRequest& request)
             "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee rate in " + CURRENCY_UNIT + "/kB for tx to be accepted. Is the maximum of minrelaytxfee and minimum mempool fee\n"
             "  \"minrelaytxfee\": xxxxx       (numeric) Current minimum relay fee for transactions\n"
             "  \"instantsendlocks\": xxxxx,   (numeric) Number of unconfirmed instant send locks\n"
+            "  \"admission\": {               (json object) Transactions received from peers\n"
+            "    \"threads\": xxxxx,          (numeric) Threads validating them, 0 if they are validated by the message handler (see -txadmissionthreads)\n"
+            "    \"queued\": xxxxx,           (numeric) Number waiting for or in validation on those threads\n"
+            "    \"admitted\": xxxxx,         (numeric) Number accepted to the mempool since startup\n"
+            "    \"rejected\": xxxxx,         (numeric) Number rejected since startup, not counting orphans\n"
+            "    \"admittedpersec\": x.xxx    (numeric) Average number accepted per second over the last minute\n"
+            "  }\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getmempoolinfo", "")
@@ -2251,11 +2309,249 @@ UniValue savemempool(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrite the UTXO set and the evo database at the current tip to a snapshot file.\n"
+            "Nodes loading the snapshot trust it without validating the blocks before its tip, only\n"
+            "commit to the hash of a snapshot of a chain you validated.\n"
+            "\nArguments:\n"
+            "1. \"path\"           (string, required) path to the snapshot file, relative to the data directory\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,     (numeric) the number of coins written\n"
+            "  \"evodb_entries\": n,     (numeric) the number of evo database entries written\n"
+            "  \"base_hash\": \"hash\",   (string) the hash of the block the snapshot is taken at\n"
+            "  \"base_height\": n,       (numeric) the height of that block\n"
+            "  \"snapshot_hash\": \"hash\", (string) the hash to commit to in chainparams\n"
+            "  \"path\": \"path\"         (string) the absolute path of the snapshot file\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+    }
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    if (fs::exists(path)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+    }
+
+    SnapshotMetadata metadata;
+    uint256 hashSnapshot;
+    std::string strError;
+    if (!DumpUTXOSnapshot(path, metadata, hashSnapshot, strError)) {
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("coins_written", (int64_t)metadata.nCoins));
+    ret.push_back(Pair("evodb_entries", (int64_t)metadata.nEvoEntries));
+    ret.push_back(Pair("base_hash", metadata.hashBaseBlock.GetHex()));
+    ret.push_back(Pair("base_height", metadata.nBaseHeight));
+    ret.push_back(Pair("snapshot_hash", hashSnapshot.GetHex()));
+    ret.push_back(Pair("path", path.string()));
+    return ret;
+}
+
+UniValue loadtxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            "loadtxoutset \"path\"\n"
+            "\nLoad a UTXO snapshot written by dumptxoutset and make its block the chain tip.\n"
+            "Only works on a node that has not connected any blocks yet, after the headers up to the\n"
+            "snapshot block are synced. The snapshot must match the hash committed to for its block.\n"
+            "Blocks before the snapshot block are not downloaded.\n"
+            "\nThe snapshot is trusted: neither the blocks before it nor its coins are validated against the\n"
+            "block chain, only its hash is compared to the one committed to. Requires -trustsnapshot.\n"
+            "\nArguments:\n"
+            "1. \"path\"           (string, required) path to the snapshot file, relative to the data directory\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_loaded\": n,      (numeric) the number of coins loaded\n"
+            "  \"evodb_entries\": n,     (numeric) the number of evo database entries loaded\n"
+            "  \"base_hash\": \"hash\",   (string) the hash of the new chain tip\n"
+            "  \"base_height\": n        (numeric) the height of the new chain tip\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("loadtxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("loadtxoutset", "\"utxo.dat\"")
+        );
+    }
+
+    if (!gArgs.GetBoolArg("-trustsnapshot", DEFAULT_TRUST_SNAPSHOT)) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Loading an unvalidated UTXO snapshot requires -trustsnapshot");
+    }
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+
+    SnapshotMetadata metadata;
+    std::string strError;
+    if (!LoadUTXOSnapshot(path, Params(), metadata, strError)) {
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    }
+
+    // The blocks before the snapshot are missing, peers should not ask us for them
+    if (g_connman) {
+        g_connman->RemoveLocalServices(NODE_NETWORK);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("coins_loaded", (int64_t)metadata.nCoins));
+    ret.push_back(Pair("evodb_entries", (int64_t)metadata.nEvoEntries));
+    ret.push_back(Pair("base_hash", metadata.hashBaseBlock.GetHex()));
+    ret.push_back(Pair("base_height", metadata.nBaseHeight));
+    return ret;
+}
+
+UniValue getblockfilter(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "getblockfilter \"blockhash\" ( \"filtertype\" )\n"
+            "\nRetrieve a BIP 157 content filter for a particular block.\n"
+            "\nArguments:\n"
+            "1. \"blockhash\"     (string, required) The hash of the block\n"
+            "2. \"filtertype\"    (string, optional, default=basic) The type name of the filter\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"filter\" : \"hex\",   (string) the hex-encoded filter data\n"
+            "  \"header\" : \"hash\",  (string) the hex-encoded filter header\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\" \"basic\"")
+            + HelpExampleRpc("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\", \"basic\"")
+        );
+
+    uint256 block_hash = ParseHashV(request.params[0], "blockhash");
+    std::string filtertype_name = "basic";
+    if (!request.params[1].isNull()) {
+        filtertype_name = request.params[1].get_str();
+    }
+
+    BlockFilterType filtertype;
+    if (!BlockFilterTypeByName(filtertype_name, filtertype)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+    }
+
+    BlockFilterIndex* index = GetBlockFilterIndex(filtertype);
+    if (!index) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Index is not enabled for filtertype " + filtertype_name);
+    }
+
+    const CBlockIndex* block_index;
+    bool block_was_connected;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(block_hash);
+        if (it == mapBlockIndex.end()) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        block_index = it->second;
+        block_was_connected = block_index->IsValid(BLOCK_VALID_SCRIPTS);
+    }
+
+    bool index_ready = index->BlockUntilSyncedToCurrentChain();
+
+    BlockFilter filter;
+    uint256 filter_header;
+    if (!index->LookupFilter(block_index, filter) ||
+        !index->LookupFilterHeader(block_index, filter_header)) {
+        int err_code;
+        std::string errmsg = "Filter not found.";
+
+        if (!block_was_connected) {
+            err_code = RPC_INVALID_ADDRESS_OR_KEY;
+            errmsg += " Block was not connected to active chain.";
+        } else if (!index_ready) {
+            err_code = RPC_MISC_ERROR;
+            errmsg += " Block filters are still in the process of being indexed.";
+        } else {
+            err_code = RPC_INTERNAL_ERROR;
+            errmsg += " This error is unexpected and indicates index corruption.";
+        }
+
+        throw JSONRPCError(err_code, errmsg);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("filter", HexStr(filter.GetEncodedFilter())));
+    ret.push_back(Pair("header", filter_header.GetHex()));
+    return ret;
+}
+
+static UniValue LatencySummaryToJSON(const CLatencyHistogram::Summary& summary)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("count", (uint64_t)summary.nCount));
+    ret.push_back(Pair("total_ms", summary.nTotal * 0.001));
+    ret.push_back(Pair("window", (uint64_t)summary.nWindow));
+    ret.push_back(Pair("p50_ms", summary.nP50 * 0.001));
+    ret.push_back(Pair("p90_ms", summary.nP90 * 0.001));
+    ret.push_back(Pair("p99_ms", summary.nP99 * 0.001));
+    ret.push_back(Pair("max_ms", summary.nMax * 0.001));
+    return ret;
+}
+
+UniValue getvalidationstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getvalidationstats\n"
+            "\nReturns latency statistics of the stages of block connection and of coins cache flushes.\n"
+            "Percentiles are computed over the last " + std::to_string(CLatencyHistogram::DEFAULT_WINDOW) + " samples of each stage,\n"
+            "count and total cover all samples since startup. Stages match the BENCHMARK debug log category.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"connectblock\": {        (json object) stages of ConnectBlock, also run by block template validation\n"
+            "    \"stage\": {             (json object) one entry per stage (check, forks, connect_txs, verify, ...)\n"
+            "      \"count\": n,          (numeric) number of samples since startup\n"
+            "      \"total_ms\": x.xxx,   (numeric) total time spent in the stage since startup\n"
+            "      \"window\": n,         (numeric) number of samples the percentiles are computed from\n"
+            "      \"p50_ms\": x.xxx,     (numeric) median latency\n"
+            "      \"p90_ms\": x.xxx,     (numeric) 90th percentile latency\n"
+            "      \"p99_ms\": x.xxx,     (numeric) 99th percentile latency\n"
+            "      \"max_ms\": x.xxx      (numeric) maximum latency\n"
+            "    },\n"
+            "    ...\n"
+            "  },\n"
+            "  \"connecttip\": {          (json object) stages of ConnectTip (read_from_disk, connect_total, flush, ...),\n"
+            "    ...                      in the same format. \"total\" is the full time to connect a tip\n"
+            "  },\n"
+            "  \"flushstatetodisk\": {    (json object) in the same format, \"coins_flush\" is the time block processing\n"
+            "    ...                      waits for the coins cache to be written or, with -coinswritebehind, handed over\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getvalidationstats", "")
+            + HelpExampleRpc("getvalidationstats", "")
+        );
+
+    UniValue ret(UniValue::VOBJ);
+    UniValue group(UniValue::VOBJ);
+    std::string strGroup = GetValidationStageGroup((ValidationStage)0);
+    for (int i = 0; i < (int)ValidationStage::COUNT; i++) {
+        const ValidationStage stage = (ValidationStage)i;
+        if (strGroup != GetValidationStageGroup(stage)) {
+            ret.push_back(Pair(strGroup, group));
+            group = UniValue(UniValue::VOBJ);
+            strGroup = GetValidationStageGroup(stage);
+        }
+        group.push_back(Pair(GetValidationStageName(stage), LatencySummaryToJSON(GetValidationStageSummary(stage))));
+    }
+    ret.push_back(Pair(strGroup, group));
+    return ret;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
     { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      {} },
     { "blockchain",         "getchaintxstats",        &getchaintxstats,        {"nblocks", "blockhash"} },
+    { "blockchain",         "getvalidationstats",     &getvalidationstats,     {} },
     { "blockchain",         "getblockstats",          &getblockstats,          {"hash_or_height", "stats"} },
     { "blockchain",         "getbestblockhash",       &getbestblockhash,       {} },
     { "blockchain",         "getbestchainlock",       &getbestchainlock,       {} },
@@ -2265,6 +2561,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getblockhash",           &getblockhash,           {"height"} },
     { "blockchain",         "getblockheader",         &getblockheader,         {"blockhash","verbose"} },
     { "blockchain",         "getblockheaders",        &getblockheaders,        {"blockhash","count","verbose"} },
+    { "blockchain",         "getblockfilter",         &getblockfilter,         {"blockhash", "filtertype"} },
     { "blockchain",         "getmerkleblocks",        &getmerkleblocks,        {"filter","blockhash","count"} },
     { "blockchain",         "getchaintips",           &getchaintips,           {"count","branchlen"} },
     { "blockchain",         "getdifficulty",          &getdifficulty,          {} },
@@ -2278,6 +2575,8 @@ static const CRPCCommand commands[] =
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           {"path"} },
+    { "blockchain",         "loadtxoutset",           &loadtxoutset,           {"path"} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
 
     { "blockchain",         "preciousblock",          &preciousblock,          {"blockhash"} },
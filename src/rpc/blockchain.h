@@ -5,6 +5,9 @@
 #ifndef BITCOIN_RPC_BLOCKCHAIN_H
 #define BITCOIN_RPC_BLOCKCHAIN_H
 
+#include <string>
+
+class BaseIndex;
 class CBlock;
 class CBlockIndex;
 class UniValue;
@@ -33,5 +36,12 @@ UniValue mempoolToJSON(bool fVerbose = false);
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* blockindex);
 
+/**
+ * Wait until index has processed the queued block notifications, so that a query
+ * reflects the current tip. Throws an RPC error if the index is not enabled or is
+ * still catching up with the chain. Must not be called with cs_main held.
+ */
+void EnsureIndexSynced(BaseIndex* index, const std::string& strName);
+
 #endif
 
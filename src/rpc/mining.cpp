@@ -126,6 +126,7 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
         nHeightEnd = nHeight+nGenerate;
     }
     unsigned int nExtraNonce = 0;
+    const int nThreads = GetMinerThreads();
     UniValue blockHashes(UniValue::VARR);
     while (nHeight < nHeightEnd)
     {
@@ -137,14 +138,10 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
             LOCK(cs_main);
             IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce);
         }
-        while (nMaxTries > 0 && pblock->nNonce < nInnerLoopCount && !CheckProofOfWork(pblock->GetHash(), pblock->nBits, Params().GetConsensus())) {
-            ++pblock->nNonce;
-            --nMaxTries;
-        }
-        if (nMaxTries == 0) {
-            break;
-        }
-        if (pblock->nNonce == nInnerLoopCount) {
+        if (!ScanBlockNonces(pblock, nInnerLoopCount, nMaxTries, nThreads, Params().GetConsensus())) {
+            if (nMaxTries == 0) {
+                break;
+            }
             continue;
         }
         std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(*pblock);
@@ -211,6 +208,21 @@ UniValue getmininginfo(const JSONRPCRequest& request)
             "  \"difficulty\": xxx.xxxxx    (numeric) The current difficulty\n"
             "  \"networkhashps\": nnn,      (numeric) The network hashes per second\n"
             "  \"pooledtx\": n              (numeric) The size of the mempool\n"
+            "  \"hashespersec\": nnn,       (numeric) The hash rate of the last nonce search of generate/generatetoaddress\n"
+            "  \"minerthreads\": n,         (numeric) The number of nonce search threads (-minerthreads)\n"
+            "  \"blocktemplate\": {         (json object) The getblocktemplate template maintained in the background\n"
+            "     \"age\": n,               (numeric) Seconds since the current template was built, -1 if there is none\n"
+            "     \"lastupdate\": n,        (numeric) Seconds since the current template last changed, -1 if there is none\n"
+            "     \"txs\": n,               (numeric) Number of transactions in the current template\n"
+            "     \"lastbuildtime\": n,     (numeric) Milliseconds spent on the last full template build\n"
+            "     \"avgbuildtime\": n,      (numeric) Average milliseconds spent per full template build\n"
+            "     \"builds\": n,            (numeric) Number of templates built from scratch, for a new tip or a request\n"
+            "     \"requestbuilds\": n,     (numeric) Number of templates built while a getblocktemplate call waited\n"
+            "     \"lastupdatetime\": n,    (numeric) Milliseconds spent on the last update from a mempool change\n"
+            "     \"avgupdatetime\": n,     (numeric) Average milliseconds spent per update from a mempool change\n"
+            "     \"updates\": n,           (numeric) Number of mempool changes applied to the templates\n"
+            "     \"requests\": n           (numeric) Number of templates requested by getblocktemplate\n"
+            "  }\n"
             "  \"chain\": \"xxxx\",           (string) current network name as defined in BIP70 (main, test, regtest)\n"
             "  \"warnings\": \"...\"          (string) any network and blockchain warnings\n"
             "  \"errors\": \"...\"            (string) DEPRECATED. Same as warnings. Only shown when pigeond is started with -deprecatedrpc=getmininginfo\n"
@@ -230,6 +242,23 @@ UniValue getmininginfo(const JSONRPCRequest& request)
     obj.push_back(Pair("difficulty",       (double)GetDifficulty()));
     obj.push_back(Pair("networkhashps",    getnetworkhashps(request)));
     obj.push_back(Pair("pooledtx",         (uint64_t)mempool.size()));
+    obj.push_back(Pair("hashespersec",     GetMinerHashesPerSec()));
+    obj.push_back(Pair("minerthreads",     GetMinerThreads()));
+
+    const CBlockTemplateManager::Stats templateStats = blockTemplateManager.GetStats();
+    UniValue templateObj(UniValue::VOBJ);
+    templateObj.push_back(Pair("age",           templateStats.nBuilds ? GetTime() - templateStats.nTimeCreated : -1));
+    templateObj.push_back(Pair("lastupdate",    templateStats.nBuilds ? GetTime() - templateStats.nTimeUpdated : -1));
+    templateObj.push_back(Pair("txs",           (uint64_t)templateStats.nTx));
+    templateObj.push_back(Pair("lastbuildtime", 0.001 * templateStats.nLastBuildMicros));
+    templateObj.push_back(Pair("avgbuildtime",  templateStats.nBuilds ? 0.001 * templateStats.nTotalBuildMicros / templateStats.nBuilds : 0.0));
+    templateObj.push_back(Pair("builds",        templateStats.nBuilds));
+    templateObj.push_back(Pair("requestbuilds", templateStats.nRequestBuilds));
+    templateObj.push_back(Pair("lastupdatetime", 0.001 * templateStats.nLastUpdateMicros));
+    templateObj.push_back(Pair("avgupdatetime", templateStats.nUpdates ? 0.001 * templateStats.nTotalUpdateMicros / templateStats.nUpdates : 0.0));
+    templateObj.push_back(Pair("updates",       templateStats.nUpdates));
+    templateObj.push_back(Pair("requests",      templateStats.nRequests));
+    obj.push_back(Pair("blocktemplate",    templateObj));
     obj.push_back(Pair("chain",            Params().NetworkIDString()));
     if (IsDeprecatedRPCEnabled("getmininginfo")) {
         obj.push_back(Pair("errors",       GetWarnings("statusbar")));
@@ -394,6 +423,9 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
             + HelpExampleRpc("getblocktemplate", "")
          );
 
+    // let the template catch up with the mempool changes queued so far
+    SyncWithValidationInterfaceQueue();
+
     LOCK(cs_main);
 
     std::string strMode = "template";
@@ -523,6 +555,7 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
                 }
             }
         }
+        SyncWithValidationInterfaceQueue();
         ENTER_CRITICAL_SECTION(cs_main);
 
         if (!IsRPCRunning())
@@ -531,29 +564,10 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
     }
 
     // Update block
-    static CBlockIndex* pindexPrev;
-    static int64_t nStart;
-    static std::unique_ptr<CBlockTemplate> pblocktemplate;
-    if (pindexPrev != chainActive.Tip() ||
-        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5))
-    {
-        // Clear pindexPrev so future calls make a new block, despite any failures from here on
-        pindexPrev = nullptr;
-
-        // Store the chainActive.Tip() used before CreateNewBlock, to avoid races
-        nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
-        CBlockIndex* pindexPrevNew = chainActive.Tip();
-        nStart = GetTime();
-
-        // Create new block
-        CScript scriptDummy = CScript() << OP_TRUE;
-        pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptDummy);
-        if (!pblocktemplate)
-            throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
-
-        // Need to update only after we know CreateNewBlock succeeded
-        pindexPrev = pindexPrevNew;
-    }
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    std::unique_ptr<CBlockTemplate> pblocktemplate = blockTemplateManager.GetBlockTemplate(pindexPrev, nTransactionsUpdatedLast);
+    if (!pblocktemplate)
+        throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
     CBlock* pblock = &pblocktemplate->block; // pointer for convenience
     const Consensus::Params& consensusParams = Params().GetConsensus();
 
@@ -10,6 +10,8 @@
 #include <core_io.h>
 #include <init.h>
 #include <httpserver.h>
+#include <index/addressindex.h>
+#include <index/spentindex.h>
 #include <net.h>
 #include <netbase.h>
 #include <rpc/blockchain.h>
@@ -691,6 +693,8 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    EnsureIndexSynced(g_addressindex.get(), "Address index");
+
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
 
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
@@ -775,6 +779,8 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    EnsureIndexSynced(g_addressindex.get(), "Address index");
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
@@ -840,6 +846,8 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    EnsureIndexSynced(g_addressindex.get(), "Address index");
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
@@ -898,6 +906,8 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    EnsureIndexSynced(g_addressindex.get(), "Address index");
+
     int start = 0;
     int end = 0;
     if (request.params[0].isObject()) {
@@ -981,6 +991,8 @@ UniValue getspentinfo(const JSONRPCRequest& request)
     uint256 txid = ParseHashV(txidValue, "txid");
     int outputIndex = indexValue.get_int();
 
+    EnsureIndexSynced(g_spentindex.get(), "Spent index");
+
     CSpentIndexKey key(txid, outputIndex);
     CSpentIndexValue value;
 
@@ -114,6 +114,16 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
             "    \"bytesrecv_per_msg\": {\n"
             "       \"addr\": n,              (numeric) The total bytes received aggregated by message type\n"
             "       ...\n"
+            "    },\n"
+            "    \"sendqueues\": {            (json object) The send queues of the priority classes high, normal and bulk\n"
+            "       \"high\": {\n"
+            "         \"queued\": n,          (numeric) The number of messages waiting in the queue\n"
+            "         \"queuedbytes\": n,     (numeric) The size of the messages waiting in the queue\n"
+            "         \"sent\": n,            (numeric) The number of messages taken from the queue for sending\n"
+            "         \"avgwait\": n,         (numeric) The average time in seconds messages waited in the queue\n"
+            "         \"maxwait\": n          (numeric) The longest time in seconds a message waited in the queue\n"
+            "       },\n"
+            "       ...\n"
             "    }\n"
             "  }\n"
             "  ,...\n"
@@ -193,6 +203,19 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
         }
         obj.pushKV("bytesrecv_per_msg", recvPerMsgCmd);
 
+        UniValue sendQueues(UniValue::VOBJ);
+        for (int i = 0; i < SEND_PRIORITY_COUNT; i++) {
+            const CNodeStats::SendQueueStats& queueStats = stats.vSendQueueStats[i];
+            UniValue queue(UniValue::VOBJ);
+            queue.pushKV("queued", (uint64_t)queueStats.nQueued);
+            queue.pushKV("queuedbytes", (uint64_t)queueStats.nQueuedBytes);
+            queue.pushKV("sent", queueStats.nSent);
+            queue.pushKV("avgwait", queueStats.dAvgWait);
+            queue.pushKV("maxwait", queueStats.dMaxWait);
+            sendQueues.pushKV(GetSendPriorityName(i), queue);
+        }
+        obj.pushKV("sendqueues", sendQueues);
+
         ret.push_back(obj);
     }
 
@@ -440,6 +463,19 @@ UniValue getnetworkinfo(const JSONRPCRequest& request)
             "  \"connections\": xxxxx,                  (numeric) the number of connections\n"
             "  \"networkactive\": true|false,           (bool) whether p2p networking is enabled\n"
             "  \"socketevents\": \"xxx/\",              (string) the socket events mode, either epoll, poll or select\n"
+            "  \"messageshards\": {                   (json object) the threads processing governance, LLMQ signing and InstantSend messages\n"
+            "    \"threads\": xxxxx,                    (numeric) the number of shard threads, 0 if these messages are processed by the message handler thread\n"
+            "    \"queued\": xxxxx,                     (numeric) the number of messages waiting for or in processing\n"
+            "    \"processed\": xxxxx                   (numeric) the number of messages processed since startup\n"
+            "  },\n"
+            "  \"messagepool\": {                     (json object) the cache of received messages and their buffers\n"
+            "    \"cached\": xxxxx,                    (numeric) the number of cached messages\n"
+            "    \"cachedbytes\": xxxxx,               (numeric) the capacity of their payload buffers in bytes\n"
+            "    \"allocated\": xxxxx,                 (numeric) the number of messages and payload buffers allocated since startup\n"
+            "    \"reused\": xxxxx,                    (numeric) the number of messages and payload buffers taken from the cache since startup\n"
+            "    \"allocatedpersec\": x.xxx,           (numeric) allocations per second since the previous call at least a second ago\n"
+            "    \"reusedpersec\": x.xxx               (numeric) reuses per second since the previous call at least a second ago\n"
+            "  },\n"
             "  \"networks\": [                          (array) information per network\n"
             "  {\n"
             "    \"name\": \"xxx\",                     (string) network (ipv4, ipv6 or onion)\n"
@@ -495,6 +531,23 @@ UniValue getnetworkinfo(const JSONRPCRequest& request)
         }
         obj.pushKV("socketevents", strSocketEvents);
     }
+    const MessageShardStats shardStats = GetMessageShardStats();
+    UniValue shards(UniValue::VOBJ);
+    shards.pushKV("threads", shardStats.nThreads);
+    shards.pushKV("queued", (int64_t)shardStats.nQueued);
+    shards.pushKV("processed", (int64_t)shardStats.nProcessed);
+    obj.pushKV("messageshards", shards);
+    if (g_connman) {
+        const CNetMessagePool::Stats poolStats = g_connman->GetNetMessagePool().GetStats();
+        UniValue pool(UniValue::VOBJ);
+        pool.pushKV("cached", (int64_t)poolStats.nCached);
+        pool.pushKV("cachedbytes", (int64_t)poolStats.nCachedBytes);
+        pool.pushKV("allocated", (int64_t)poolStats.nAllocated);
+        pool.pushKV("reused", (int64_t)poolStats.nReused);
+        pool.pushKV("allocatedpersec", poolStats.dAllocatedPerSec);
+        pool.pushKV("reusedpersec", poolStats.dReusedPerSec);
+        obj.pushKV("messagepool", pool);
+    }
     obj.pushKV("networks",      GetNetworksInfo());
     obj.pushKV("relayfee",      ValueFromAmount(::minRelayTxFee.GetFeePerK()));
     obj.pushKV("incrementalfee", ValueFromAmount(::incrementalRelayFee.GetFeePerK()));
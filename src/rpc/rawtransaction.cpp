@@ -9,6 +9,7 @@
 #include <coins.h>
 #include <consensus/validation.h>
 #include <core_io.h>
+#include <index/spentindex.h>
 #include <init.h>
 #include <keystore.h>
 #include <validation.h>
@@ -184,6 +185,11 @@ UniValue getrawtransaction(const JSONRPCRequest& request)
             + HelpExampleCli("getrawtransaction", "\"mytxid\" true \"myblockhash\"")
         );
 
+    // The spent info of verbose results should reflect the current tip
+    if (g_spentindex) {
+        g_spentindex->BlockUntilSyncedToCurrentChain();
+    }
+
     LOCK(cs_main);
 
     bool in_active_chain = true;
@@ -0,0 +1,655 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <stratum.h>
+
+#include <arith_uint256.h>
+#include <base58.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+#include <hash.h>
+#include <miner.h>
+#include <netaddress.h>
+#include <netbase.h>
+#include <pow.h>
+#include <random.h>
+#include <script/standard.h>
+#include <streams.h>
+#include <sync.h>
+#include <timedata.h>
+#include <util.h>
+#include <utilstrencodings.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <univalue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <limits>
+#include <map>
+#include <memory>
+#include <set>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/event.h>
+#include <event2/listener.h>
+#include <event2/thread.h>
+#include <event2/util.h>
+
+const std::string DEFAULT_STRATUM_BIND = "127.0.0.1";
+
+/** Extranonce bytes assigned by the server to each connection */
+static const size_t STRATUM_EXTRANONCE1_SIZE = 4;
+/** Extranonce bytes rolled by the miner */
+static const size_t STRATUM_EXTRANONCE2_SIZE = 4;
+/** Number of jobs of the current tip that still accept shares */
+static const size_t MAX_STRATUM_JOBS = 16;
+/** Maximum number of miner connections */
+static const size_t MAX_STRATUM_CLIENTS = 128;
+/** Maximum length of a request line, protects against memory exhaustion */
+static const size_t MAX_STRATUM_LINE_LENGTH = 16 * 1024;
+/** Maximum size of the unsent replies of a client, protects against miners that do not read */
+static const size_t MAX_STRATUM_SEND_BUFFER = 1024 * 1024;
+
+/** Error codes as used by common stratum pools */
+enum StratumErrorCode
+{
+    STRATUM_ERROR_OTHER = 20,
+    STRATUM_ERROR_JOB_NOT_FOUND = 21,
+    STRATUM_ERROR_DUPLICATE_SHARE = 22,
+    STRATUM_ERROR_LOW_DIFFICULTY = 23,
+    STRATUM_ERROR_UNAUTHORIZED = 24,
+    STRATUM_ERROR_NOT_SUBSCRIBED = 25,
+};
+
+std::vector<uint256> GetCoinbaseMerkleBranch(const CBlock& block)
+{
+    std::vector<uint256> vMerkleBranch;
+    std::vector<uint256> hashes(block.vtx.size());
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        hashes[i] = block.vtx[i]->GetHash();
+    }
+    // the left-most node of every level depends on the coinbase, its sibling is part of the branch
+    while (hashes.size() > 1) {
+        vMerkleBranch.push_back(hashes[1]);
+        if (hashes.size() & 1) {
+            hashes.push_back(hashes.back());
+        }
+        SHA256D64(hashes[0].begin(), hashes[0].begin(), hashes.size() / 2);
+        hashes.resize(hashes.size() / 2);
+    }
+    return vMerkleBranch;
+}
+
+uint256 GetMerkleRootFromBranch(const uint256& hashLeaf, const std::vector<uint256>& vMerkleBranch)
+{
+    uint256 hash = hashLeaf;
+    for (const uint256& hashSibling : vMerkleBranch) {
+        hash = Hash(hash.begin(), hash.end(), hashSibling.begin(), hashSibling.end());
+    }
+    return hash;
+}
+
+/** prevhash as sent in mining.notify: the header bytes with every 32 bit word reversed */
+static std::string StratumPrevHash(const uint256& hash)
+{
+    std::vector<unsigned char> vch(hash.begin(), hash.end());
+    for (size_t i = 0; i < vch.size(); i += 4) {
+        std::reverse(vch.begin() + i, vch.begin() + i + 4);
+    }
+    return HexStr(vch);
+}
+
+static bool ParseStratumUInt32(const std::string& str, uint32_t& nRet)
+{
+    if (str.size() != 8 || !IsHex(str)) {
+        return false;
+    }
+    const std::vector<unsigned char> vch = ParseHex(str);
+    nRet = ReadBE32(vch.data());
+    return true;
+}
+
+static arith_uint256 GetStratumShareTarget(double dDifficulty)
+{
+    arith_uint256 target;
+    target.SetCompact(0x1d00ffff);
+    target *= 65536;
+    target /= arith_uint256(std::max<uint64_t>(1, (uint64_t)(dDifficulty * 65536)));
+    return target;
+}
+
+static UniValue StratumError(int nCode, const std::string& strMessage)
+{
+    UniValue error(UniValue::VARR);
+    error.push_back(nCode);
+    error.push_back(strMessage);
+    error.push_back(NullUniValue);
+    return error;
+}
+
+CStratumServer::CStratumServer(struct event_base* _base, const CScript& _scriptPayout, double _dDifficulty):
+    base(_base), scriptPayout(_scriptPayout), dDifficulty(_dDifficulty), shareTarget(GetStratumShareTarget(_dDifficulty)),
+    nNextExtraNonce1(GetRand(std::numeric_limits<uint32_t>::max()))
+{
+    notify_ev = event_new(base, -1, 0, notify_cb, this);
+}
+
+CStratumServer::~CStratumServer()
+{
+    for (const auto& pair : mapClients) {
+        bufferevent_free(pair.first);
+    }
+    mapClients.clear();
+    if (listener) {
+        evconnlistener_free(listener);
+    }
+    if (notify_ev) {
+        event_free(notify_ev);
+    }
+}
+
+bool CStratumServer::Bind(const CService& addrBind)
+{
+    struct sockaddr_storage sockaddr;
+    socklen_t len = sizeof(sockaddr);
+    if (!notify_ev || !addrBind.GetSockAddr((struct sockaddr*)&sockaddr, &len)) {
+        return false;
+    }
+    listener = evconnlistener_new_bind(base, accept_cb, this, LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE, -1, (struct sockaddr*)&sockaddr, len);
+    return listener != nullptr;
+}
+
+void CStratumServer::UpdateJob()
+{
+    fDirty = false;
+    fNewTip = false;
+
+    std::shared_ptr<StratumJob> job = std::make_shared<StratumJob>();
+    try {
+        LOCK(cs_main);
+        if (IsInitialBlockDownload() && !Params().MineBlocksOnDemand()) {
+            return;
+        }
+        std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptPayout);
+        if (!pblocktemplate) {
+            return;
+        }
+        job->pindexPrev = chainActive.Tip();
+        job->block = pblocktemplate->block;
+    } catch (const std::exception& e) {
+        LogPrintf("stratum: Failed to build block template: %s\n", e.what());
+        return;
+    }
+
+    const std::vector<unsigned char> vchExtraNonce(STRATUM_EXTRANONCE1_SIZE + STRATUM_EXTRANONCE2_SIZE);
+    SetCoinbaseExtraNonce(&job->block, job->pindexPrev, vchExtraNonce);
+    job->vMerkleBranch = GetCoinbaseMerkleBranch(job->block);
+
+    // split the coinbase around the extranonce push, which follows the height push
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << *job->block.vtx[0];
+    const CScript& scriptSig = job->block.vtx[0]->vin[0].scriptSig;
+    const size_t nScriptSigPos = sizeof(int32_t) + GetSizeOfCompactSize(1) +
+        ::GetSerializeSize(job->block.vtx[0]->vin[0].prevout, SER_NETWORK, PROTOCOL_VERSION) + GetSizeOfCompactSize(scriptSig.size());
+    const size_t nExtraNoncePos = nScriptSigPos + (CScript() << (job->pindexPrev->nHeight + 1)).size() + 1;
+    assert(std::equal(scriptSig.begin(), scriptSig.end(), ss.begin() + nScriptSigPos));
+    job->vchCoinbase1.assign(ss.begin(), ss.begin() + nExtraNoncePos);
+    job->vchCoinbase2.assign(ss.begin() + nExtraNoncePos + vchExtraNonce.size(), ss.end());
+
+    {
+        LOCK(cs);
+        const bool fClean = jobs.empty() || jobs.back()->pindexPrev != job->pindexPrev;
+        if (fClean) {
+            jobs.clear();
+            setShares.clear();
+        }
+        job->strId = strprintf("%x", ++nJobCounter);
+        jobs.push_back(job);
+        while (jobs.size() > MAX_STRATUM_JOBS) {
+            jobs.pop_front();
+        }
+        fNotifyClean |= fClean;
+    }
+    nTimeJob = GetTime();
+    LogPrint(BCLog::STRATUM, "stratum: New job %s for height %d (%u txs)\n", job->strId, job->pindexPrev->nHeight + 1, job->block.vtx.size() - 1);
+
+    event_active(notify_ev, 0, 0);
+}
+
+void CStratumServer::DoMaintenance()
+{
+    if (!fDirty || nSubscribed == 0) {
+        return;
+    }
+    // mempool changes are batched, a new tip is never held back
+    if (!fNewTip && GetTime() - nTimeJob < BLOCK_TEMPLATE_MAX_AGE) {
+        return;
+    }
+    UpdateJob();
+}
+
+void CStratumServer::TransactionAddedToMempool(const CTransactionRef& ptx, int64_t nAcceptTime)
+{
+    fDirty = true;
+}
+
+void CStratumServer::TransactionRemovedFromMempool(const CTransactionRef& ptx)
+{
+    fDirty = true;
+}
+
+void CStratumServer::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+{
+    if (fInitialDownload) {
+        return;
+    }
+    if (nSubscribed > 0) {
+        UpdateJob();
+    } else {
+        // built by DoMaintenance once a miner subscribes
+        fDirty = true;
+        fNewTip = true;
+    }
+}
+
+std::shared_ptr<const StratumJob> CStratumServer::FindJob(const std::string& strId)
+{
+    LOCK(cs);
+    for (const auto& job : jobs) {
+        if (job->strId == strId) {
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void CStratumServer::accept_cb(struct evconnlistener* listener, evutil_socket_t fd, struct sockaddr* addr, int socklen, void* ctx)
+{
+    CStratumServer* self = (CStratumServer*)ctx;
+    CService service;
+    service.SetSockAddr(addr);
+    if (self->mapClients.size() >= MAX_STRATUM_CLIENTS) {
+        LogPrint(BCLog::STRATUM, "stratum: Too many connections, dropping %s\n", service.ToString());
+        evutil_closesocket(fd);
+        return;
+    }
+    struct bufferevent* bev = bufferevent_socket_new(self->base, fd, BEV_OPT_CLOSE_ON_FREE);
+    if (!bev) {
+        evutil_closesocket(fd);
+        return;
+    }
+
+    StratumClient& client = self->mapClients[bev];
+    client.bev = bev;
+    client.strAddress = service.ToString();
+    client.vchExtraNonce1.resize(STRATUM_EXTRANONCE1_SIZE);
+    WriteBE32(client.vchExtraNonce1.data(), self->nNextExtraNonce1++);
+    LogPrint(BCLog::STRATUM, "stratum: Accepted connection from %s\n", client.strAddress);
+
+    bufferevent_setcb(bev, read_cb, nullptr, event_cb, self);
+    bufferevent_enable(bev, EV_READ | EV_WRITE);
+}
+
+void CStratumServer::read_cb(struct bufferevent* bev, void* ctx)
+{
+    CStratumServer* self = (CStratumServer*)ctx;
+    auto it = self->mapClients.find(bev);
+    if (it == self->mapClients.end()) {
+        return;
+    }
+    struct evbuffer* input = bufferevent_get_input(bev);
+    size_t n_read_out = 0;
+    char* line;
+    while ((line = evbuffer_readln(input, &n_read_out, EVBUFFER_EOL_CRLF)) != nullptr) {
+        std::string s(line, n_read_out);
+        free(line);
+        if (!self->HandleLine(it->second, s)) {
+            LogPrint(BCLog::STRATUM, "stratum: Disconnecting %s after malformed request\n", it->second.strAddress);
+            self->Disconnect(bev);
+            return;
+        }
+        if (it->second.fDisconnect) {
+            self->Disconnect(bev);
+            return;
+        }
+    }
+    // Everything left is an incomplete line
+    if (evbuffer_get_length(input) > MAX_STRATUM_LINE_LENGTH) {
+        LogPrint(BCLog::STRATUM, "stratum: Disconnecting %s because MAX_STRATUM_LINE_LENGTH exceeded\n", it->second.strAddress);
+        self->Disconnect(bev);
+    }
+}
+
+void CStratumServer::event_cb(struct bufferevent* bev, short what, void* ctx)
+{
+    CStratumServer* self = (CStratumServer*)ctx;
+    if (what & (BEV_EVENT_EOF | BEV_EVENT_ERROR)) {
+        self->Disconnect(bev);
+    }
+}
+
+void CStratumServer::notify_cb(evutil_socket_t fd, short what, void* ctx)
+{
+    CStratumServer* self = (CStratumServer*)ctx;
+    std::shared_ptr<const StratumJob> job;
+    bool fClean;
+    {
+        LOCK(self->cs);
+        if (self->jobs.empty()) {
+            return;
+        }
+        job = self->jobs.back();
+        fClean = self->fNotifyClean;
+        self->fNotifyClean = false;
+    }
+    for (auto it = self->mapClients.begin(); it != self->mapClients.end(); ) {
+        StratumClient& client = (it++)->second;
+        if (client.fSubscribed) {
+            self->SendJob(client, *job, fClean);
+        }
+        if (client.fDisconnect) {
+            self->Disconnect(client.bev);
+        }
+    }
+}
+
+void CStratumServer::Disconnect(struct bufferevent* bev)
+{
+    auto it = mapClients.find(bev);
+    if (it != mapClients.end()) {
+        LogPrint(BCLog::STRATUM, "stratum: Closing connection to %s\n", it->second.strAddress);
+        if (it->second.fSubscribed) {
+            nSubscribed--;
+        }
+        mapClients.erase(it);
+    }
+    bufferevent_free(bev);
+}
+
+void CStratumServer::Send(StratumClient& client, const UniValue& message)
+{
+    if (client.fDisconnect) {
+        return;
+    }
+    const std::string strMessage = message.write() + "\n";
+    bufferevent_write(client.bev, strMessage.data(), strMessage.size());
+    if (evbuffer_get_length(bufferevent_get_output(client.bev)) > MAX_STRATUM_SEND_BUFFER) {
+        LogPrint(BCLog::STRATUM, "stratum: Disconnecting %s because MAX_STRATUM_SEND_BUFFER exceeded\n", client.strAddress);
+        client.fDisconnect = true;
+    }
+}
+
+void CStratumServer::SendJob(StratumClient& client, const StratumJob& job, bool fClean)
+{
+    UniValue branch(UniValue::VARR);
+    for (const uint256& hash : job.vMerkleBranch) {
+        branch.push_back(HexStr(hash.begin(), hash.end()));
+    }
+
+    UniValue params(UniValue::VARR);
+    params.push_back(job.strId);
+    params.push_back(StratumPrevHash(job.block.hashPrevBlock));
+    params.push_back(HexStr(job.vchCoinbase1));
+    params.push_back(HexStr(job.vchCoinbase2));
+    params.push_back(branch);
+    params.push_back(strprintf("%08x", job.block.nVersion));
+    params.push_back(strprintf("%08x", job.block.nBits));
+    params.push_back(strprintf("%08x", job.block.nTime));
+    params.push_back(fClean);
+
+    UniValue notification(UniValue::VOBJ);
+    notification.push_back(Pair("id", NullUniValue));
+    notification.push_back(Pair("method", "mining.notify"));
+    notification.push_back(Pair("params", params));
+    Send(client, notification);
+}
+
+bool CStratumServer::HandleLine(StratumClient& client, const std::string& strLine)
+{
+    if (strLine.empty()) {
+        return true;
+    }
+    UniValue request;
+    if (!request.read(strLine) || !request.isObject()) {
+        return false;
+    }
+    const UniValue& id = find_value(request, "id");
+    const UniValue& method = find_value(request, "method");
+    const UniValue& params = find_value(request, "params");
+    if (!method.isStr()) {
+        return false;
+    }
+
+    UniValue result(UniValue::VNULL);
+    UniValue error(UniValue::VNULL);
+    bool fSubscribed = false;
+    try {
+        if (method.get_str() == "mining.subscribe") {
+            UniValue subscription(UniValue::VARR);
+            subscription.push_back("mining.notify");
+            subscription.push_back(HexStr(client.vchExtraNonce1));
+            UniValue subscriptions(UniValue::VARR);
+            subscriptions.push_back(subscription);
+            result.setArray();
+            result.push_back(subscriptions);
+            result.push_back(HexStr(client.vchExtraNonce1));
+            result.push_back((uint64_t)STRATUM_EXTRANONCE2_SIZE);
+            fSubscribed = !client.fSubscribed;
+            client.fSubscribed = true;
+            if (fSubscribed && nSubscribed++ == 0) {
+                // the job may be from before the first miner subscribed
+                fDirty = true;
+            }
+        } else if (method.get_str() == "mining.authorize") {
+            // the server is meant for local miners, any worker name is accepted
+            client.strWorker = params.isArray() && params.size() > 0 ? params[0].get_str() : "";
+            client.fAuthorized = true;
+            result = true;
+        } else if (method.get_str() == "mining.submit") {
+            error = HandleSubmit(client, params);
+            result = error.isNull();
+        } else {
+            error = StratumError(STRATUM_ERROR_OTHER, "Method not found");
+        }
+    } catch (const std::exception& e) {
+        error = StratumError(STRATUM_ERROR_OTHER, "Invalid parameters");
+    }
+
+    UniValue reply(UniValue::VOBJ);
+    reply.push_back(Pair("id", id));
+    reply.push_back(Pair("result", result));
+    reply.push_back(Pair("error", error));
+    Send(client, reply);
+
+    if (fSubscribed) {
+        UniValue difficulty(UniValue::VARR);
+        difficulty.push_back(dDifficulty);
+        UniValue notification(UniValue::VOBJ);
+        notification.push_back(Pair("id", NullUniValue));
+        notification.push_back(Pair("method", "mining.set_difficulty"));
+        notification.push_back(Pair("params", difficulty));
+        Send(client, notification);
+
+        std::shared_ptr<const StratumJob> job;
+        {
+            LOCK(cs);
+            if (!jobs.empty()) {
+                job = jobs.back();
+            }
+        }
+        if (job) {
+            SendJob(client, *job, true);
+        }
+    }
+    return true;
+}
+
+UniValue CStratumServer::HandleSubmit(StratumClient& client, const UniValue& params)
+{
+    if (!client.fSubscribed) {
+        return StratumError(STRATUM_ERROR_NOT_SUBSCRIBED, "Not subscribed");
+    }
+    if (!client.fAuthorized) {
+        return StratumError(STRATUM_ERROR_UNAUTHORIZED, "Unauthorized worker");
+    }
+    if (!params.isArray() || params.size() < 5) {
+        return StratumError(STRATUM_ERROR_OTHER, "Invalid parameters");
+    }
+
+    // worker, job id, extranonce2, ntime, nonce
+    std::shared_ptr<const StratumJob> job = FindJob(params[1].get_str());
+    if (!job) {
+        return StratumError(STRATUM_ERROR_JOB_NOT_FOUND, "Job not found");
+    }
+    const std::string& strExtraNonce2 = params[2].get_str();
+    uint32_t nTime, nNonce;
+    if (strExtraNonce2.size() != 2 * STRATUM_EXTRANONCE2_SIZE || !IsHex(strExtraNonce2) ||
+        !ParseStratumUInt32(params[3].get_str(), nTime) || !ParseStratumUInt32(params[4].get_str(), nNonce)) {
+        return StratumError(STRATUM_ERROR_OTHER, "Invalid parameters");
+    }
+    if (nTime < job->block.nTime || nTime > GetAdjustedTime() + MAX_FUTURE_BLOCK_TIME) {
+        return StratumError(STRATUM_ERROR_OTHER, "ntime out of range");
+    }
+
+    std::vector<unsigned char> vchExtraNonce(client.vchExtraNonce1);
+    const std::vector<unsigned char> vchExtraNonce2 = ParseHex(strExtraNonce2);
+    vchExtraNonce.insert(vchExtraNonce.end(), vchExtraNonce2.begin(), vchExtraNonce2.end());
+
+    CHash256 hasher;
+    hasher.Write(job->vchCoinbase1.data(), job->vchCoinbase1.size());
+    hasher.Write(vchExtraNonce.data(), vchExtraNonce.size());
+    hasher.Write(job->vchCoinbase2.data(), job->vchCoinbase2.size());
+    uint256 hashCoinbase;
+    hasher.Finalize(hashCoinbase.begin());
+
+    CBlockHeader header = job->block.GetBlockHeader();
+    header.hashMerkleRoot = GetMerkleRootFromBranch(hashCoinbase, job->vMerkleBranch);
+    header.nTime = nTime;
+    header.nNonce = nNonce;
+    const uint256 hash = header.GetHash();
+
+    const bool fBlock = CheckProofOfWork(hash, header.nBits, Params().GetConsensus());
+    if (!fBlock && UintToArith256(hash) > shareTarget) {
+        return StratumError(STRATUM_ERROR_LOW_DIFFICULTY, "Low difficulty share");
+    }
+    {
+        LOCK(cs);
+        if (!setShares.insert(hash).second) {
+            return StratumError(STRATUM_ERROR_DUPLICATE_SHARE, "Duplicate share");
+        }
+    }
+
+    if (fBlock) {
+        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>(job->block);
+        SetCoinbaseExtraNonce(pblock.get(), job->pindexPrev, vchExtraNonce);
+        assert(pblock->hashMerkleRoot == header.hashMerkleRoot);
+        pblock->nTime = nTime;
+        pblock->nNonce = nNonce;
+        LogPrintf("stratum: %s (%s) found block %s at height %d\n", client.strWorker, client.strAddress, hash.ToString(), job->pindexPrev->nHeight + 1);
+        if (!ProcessNewBlock(Params(), pblock, true, nullptr)) {
+            LogPrintf("stratum: Block %s not accepted\n", hash.ToString());
+        }
+    }
+    LogPrint(BCLog::STRATUM, "stratum: Accepted share %s from %s (%s)\n", hash.ToString(), client.strWorker, client.strAddress);
+    return NullUniValue;
+}
+
+/****** Thread ********/
+static struct event_base* stratumBase;
+static std::unique_ptr<CStratumServer> stratumServer;
+static boost::thread stratumThread;
+
+static void StratumThread()
+{
+    event_base_dispatch(stratumBase);
+}
+
+static void StratumMaintenance()
+{
+    if (stratumServer) {
+        stratumServer->DoMaintenance();
+    }
+}
+
+/** Free the server and its event base, the libevent thread must not be running */
+static void FreeStratumServer()
+{
+    stratumServer.reset();
+    if (stratumBase) {
+        event_base_free(stratumBase);
+        stratumBase = nullptr;
+    }
+}
+
+bool StartStratumServer(CScheduler& scheduler)
+{
+    assert(!stratumBase);
+    double dDifficulty = DEFAULT_STRATUM_DIFFICULTY;
+    if (gArgs.IsArgSet("-stratumdifficulty") && (!ParseDouble(gArgs.GetArg("-stratumdifficulty", ""), &dDifficulty) || dDifficulty <= 0)) {
+        LogPrintf("stratum: Invalid -stratumdifficulty '%s'\n", gArgs.GetArg("-stratumdifficulty", ""));
+        return false;
+    }
+    const CTxDestination dest = DecodeDestination(gArgs.GetArg("-stratumaddress", ""));
+    if (!IsValidDestination(dest)) {
+        LogPrintf("stratum: Invalid -stratumaddress '%s'\n", gArgs.GetArg("-stratumaddress", ""));
+        return false;
+    }
+    CService addrBind;
+    if (!Lookup(gArgs.GetArg("-stratumbind", DEFAULT_STRATUM_BIND).c_str(), addrBind, gArgs.GetArg("-stratumport", DEFAULT_STRATUM_PORT), false)) {
+        LogPrintf("stratum: Unable to resolve -stratumbind '%s'\n", gArgs.GetArg("-stratumbind", DEFAULT_STRATUM_BIND));
+        return false;
+    }
+
+#ifdef WIN32
+    evthread_use_windows_threads();
+#else
+    evthread_use_pthreads();
+#endif
+    stratumBase = event_base_new();
+    if (!stratumBase) {
+        LogPrintf("stratum: Unable to create event_base\n");
+        return false;
+    }
+    stratumServer.reset(new CStratumServer(stratumBase, GetScriptForDestination(dest), dDifficulty));
+    if (!stratumServer->Bind(addrBind)) {
+        LogPrintf("stratum: Unable to bind to %s\n", addrBind.ToString());
+        FreeStratumServer();
+        return false;
+    }
+    LogPrintf("stratum: Listening on %s\n", addrBind.ToString());
+
+    RegisterValidationInterface(stratumServer.get());
+    stratumServer->UpdateJob();
+    scheduler.scheduleEvery(boost::bind(&StratumMaintenance), 1000);
+
+    stratumThread = boost::thread(boost::bind(&TraceThread<void (*)()>, "stratum", &StratumThread));
+    return true;
+}
+
+void InterruptStratumServer()
+{
+    if (stratumBase) {
+        LogPrintf("stratum: Thread interrupt\n");
+        event_base_loopbreak(stratumBase);
+    }
+}
+
+void StopStratumServer()
+{
+    if (stratumBase) {
+        event_base_loopbreak(stratumBase);
+        stratumThread.join();
+        UnregisterValidationInterface(stratumServer.get());
+        FreeStratumServer();
+    }
+}
@@ -0,0 +1,151 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * Stratum work server for local miners.
+ */
+#ifndef BITCOIN_STRATUM_H
+#define BITCOIN_STRATUM_H
+
+#include <arith_uint256.h>
+#include <netaddress.h>
+#include <primitives/block.h>
+#include <scheduler.h>
+#include <script/script.h>
+#include <sync.h>
+#include <uint256.h>
+#include <validationinterface.h>
+
+#include <univalue.h>
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <event2/util.h>
+
+class CBlockIndex;
+struct bufferevent;
+struct event;
+struct event_base;
+struct evconnlistener;
+
+static const bool DEFAULT_STRATUM_ENABLE = false;
+extern const std::string DEFAULT_STRATUM_BIND;
+static const unsigned short DEFAULT_STRATUM_PORT = 3333;
+/** Default share difficulty, 1 corresponds to the target 0x00000000ffff0000... */
+static const double DEFAULT_STRATUM_DIFFICULTY = 1.0;
+
+/** The merkle branch that links the coinbase of block to its merkle root, in mining.notify order */
+std::vector<uint256> GetCoinbaseMerkleBranch(const CBlock& block);
+/** Fold the merkle branch of the first transaction into the merkle root */
+uint256 GetMerkleRootFromBranch(const uint256& hashLeaf, const std::vector<uint256>& vMerkleBranch);
+
+/** Work handed out to the miners */
+struct StratumJob
+{
+    std::string strId;
+    const CBlockIndex* pindexPrev;
+    /** Block template, its coinbase pushes zeroed extranonce bytes */
+    CBlock block;
+    /** Serialized coinbase before and after the extranonce */
+    std::vector<unsigned char> vchCoinbase1;
+    std::vector<unsigned char> vchCoinbase2;
+    std::vector<uint256> vMerkleBranch;
+};
+
+struct StratumClient
+{
+    struct bufferevent* bev;
+    std::string strAddress;
+    std::vector<unsigned char> vchExtraNonce1;
+    std::string strWorker;
+    bool fSubscribed{false};
+    bool fAuthorized{false};
+    /** Set once the client stopped reading its replies, it is disconnected by the caller of Send */
+    bool fDisconnect{false};
+};
+
+/**
+ * Stratum server. The connections live on the libevent thread, jobs are
+ * built on the scheduler thread from validation events and handed over
+ * through notify_ev.
+ *
+ * Jobs are only built while miners are subscribed. A new tip builds one
+ * right away, mempool changes at most every BLOCK_TEMPLATE_MAX_AGE seconds.
+ */
+class CStratumServer final : public CValidationInterface
+{
+public:
+    CStratumServer(struct event_base* base, const CScript& scriptPayout, double dDifficulty);
+    ~CStratumServer();
+
+    bool Bind(const CService& addrBind);
+
+    /** Build a new job from the current tip and mempool and push it to the miners */
+    void UpdateJob();
+
+    /** Rebuild the job if the tip or the mempool changed since it was built */
+    void DoMaintenance();
+
+protected:
+    void TransactionAddedToMempool(const CTransactionRef& ptx, int64_t nAcceptTime) override;
+    void TransactionRemovedFromMempool(const CTransactionRef& ptx) override;
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override;
+
+private:
+    /** Libevent handlers: internal */
+    static void accept_cb(struct evconnlistener* listener, evutil_socket_t fd, struct sockaddr* addr, int socklen, void* ctx);
+    static void read_cb(struct bufferevent* bev, void* ctx);
+    static void event_cb(struct bufferevent* bev, short what, void* ctx);
+    static void notify_cb(evutil_socket_t fd, short what, void* ctx);
+
+    void Disconnect(struct bufferevent* bev);
+    void Send(StratumClient& client, const UniValue& message);
+    void SendJob(StratumClient& client, const StratumJob& job, bool fClean);
+
+    /** Returns false if the line is not a stratum request */
+    bool HandleLine(StratumClient& client, const std::string& strLine);
+    UniValue HandleSubmit(StratumClient& client, const UniValue& params);
+
+    std::shared_ptr<const StratumJob> FindJob(const std::string& strId);
+
+    struct event_base* base;
+    struct evconnlistener* listener{nullptr};
+    struct event* notify_ev{nullptr};
+    const CScript scriptPayout;
+    const double dDifficulty;
+    const arith_uint256 shareTarget;
+
+    // only used on the libevent thread
+    std::map<struct bufferevent*, StratumClient> mapClients;
+    uint32_t nNextExtraNonce1;
+
+    CCriticalSection cs;
+    /** Jobs of the current tip, newest last */
+    std::deque<std::shared_ptr<const StratumJob>> jobs GUARDED_BY(cs);
+    /** PoW hashes of the shares accepted for the jobs above */
+    std::set<uint256> setShares GUARDED_BY(cs);
+    uint64_t nJobCounter GUARDED_BY(cs){0};
+    /** Whether the next mining.notify has to discard the previous jobs */
+    bool fNotifyClean GUARDED_BY(cs){false};
+
+    /** Number of subscribed clients, no jobs are built without them */
+    std::atomic<int> nSubscribed{0};
+    std::atomic<int64_t> nTimeJob{0};
+    std::atomic<bool> fDirty{false};
+    std::atomic<bool> fNewTip{false};
+
+    friend struct StratumServerTest;
+};
+
+bool StartStratumServer(CScheduler& scheduler);
+void InterruptStratumServer();
+void StopStratumServer();
+
+#endif /* BITCOIN_STRATUM_H */
@@ -0,0 +1,151 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <index/addressindex.h>
+#include <script/interpreter.h>
+#include <spentindex.h>
+#include <test/test_pigeon.h>
+#include <txdb.h>
+#include <utiltime.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(addressindex_tests)
+
+static void WaitForSync(BaseIndex& index)
+{
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+}
+
+/** Count the credits and debits of key in the address index and its unspent outputs */
+static void CheckAddressEntries(const CKey& key, size_t nCredits, size_t nDebits, size_t nUnspent)
+{
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    BOOST_CHECK(pblocktree->ReadAddressIndex(key.GetPubKey().GetID(), 1, addressIndex));
+    BOOST_CHECK(pblocktree->ReadAddressUnspentIndex(key.GetPubKey().GetID(), 1, unspentOutputs));
+
+    size_t nFoundCredits = 0;
+    size_t nFoundDebits = 0;
+    for (const auto& entry : addressIndex) {
+        if (entry.second > 0) {
+            nFoundCredits++;
+        } else {
+            nFoundDebits++;
+        }
+    }
+    BOOST_CHECK_EQUAL(nFoundCredits, nCredits);
+    BOOST_CHECK_EQUAL(nFoundDebits, nDebits);
+    BOOST_CHECK_EQUAL(unspentOutputs.size(), nUnspent);
+}
+
+static void InvalidateTip()
+{
+    CValidationState state;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(InvalidateBlock(state, Params(), chainActive.Tip()));
+    }
+    BOOST_CHECK(ActivateBestChain(state, Params()));
+}
+
+BOOST_FIXTURE_TEST_CASE(addressindex_sync_and_reorg, TestChain100Setup)
+{
+    AddressIndex address_index;
+
+    // Nothing is indexed before the index is started on the existing chain
+    BOOST_CHECK(!address_index.BlockUntilSyncedToCurrentChain());
+    CheckAddressEntries(coinbaseKey, 0, 0, 0);
+
+    // The sync thread catches up with the chain without a reindex
+    address_index.Start();
+    WaitForSync(address_index);
+    CheckAddressEntries(coinbaseKey, 100, 0, 100);
+
+    CMutableTransaction spend;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    spend.vout.resize(1);
+    spend.vout[0].nValue = coinbaseTxns[0].vout[0].nValue - 1000;
+    spend.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    std::vector<unsigned char> vchSig;
+    uint256 sighash = SignatureHash(coinbaseTxns[0].vout[0].scriptPubKey, spend, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    coinbaseKey.Sign(sighash, vchSig);
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+
+    // Blocks connected after the initial sync are indexed from notifications
+    CreateAndProcessBlock({spend}, coinbaseKey);
+    WaitForSync(address_index);
+    CheckAddressEntries(coinbaseKey, 101, 1, 100);
+
+    // A disconnected block is unindexed from notifications
+    InvalidateTip();
+    WaitForSync(address_index);
+    CheckAddressEntries(coinbaseKey, 100, 0, 100);
+
+    // The coinbase of this block pays to a script that is not indexed
+    CreateAndProcessBlock({spend}, CScript() << OP_TRUE);
+    WaitForSync(address_index);
+    CheckAddressEntries(coinbaseKey, 100, 1, 99);
+
+    address_index.Interrupt();
+    address_index.Stop();
+
+    // Reorg the spend away and extend the chain while the index is stopped
+    InvalidateTip();
+    CreateAndProcessBlock({}, coinbaseKey);
+    CreateAndProcessBlock({}, coinbaseKey);
+
+    // A restarted index rewinds the stale block and continues from its best block
+    AddressIndex restarted_index;
+    restarted_index.Start();
+    WaitForSync(restarted_index);
+    CheckAddressEntries(coinbaseKey, 102, 0, 102);
+
+    restarted_index.Interrupt();
+    restarted_index.Stop();
+}
+
+BOOST_FIXTURE_TEST_CASE(addressindex_legacy_flag, TestChain100Setup)
+{
+    // An index that was built while connecting blocks continues at the current tip
+    BOOST_CHECK(pblocktree->WriteFlag("addressindex", true));
+    BOOST_CHECK(UpgradeLegacyIndexFlag("addressindex"));
+
+    bool fLegacy = true;
+    BOOST_CHECK(pblocktree->ReadFlag("addressindex", fLegacy));
+    BOOST_CHECK(!fLegacy);
+
+    CBlockLocator locator;
+    BOOST_CHECK(pblocktree->ReadIndexBestBlock("addressindex", locator));
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(locator.vHave[0] == chainActive.Tip()->GetBlockHash());
+    }
+
+    // So it is in sync as soon as it starts and does not index the existing blocks again
+    AddressIndex address_index;
+    address_index.Start();
+    WaitForSync(address_index);
+    CheckAddressEntries(coinbaseKey, 0, 0, 0);
+
+    CreateAndProcessBlock({}, coinbaseKey);
+    WaitForSync(address_index);
+    CheckAddressEntries(coinbaseKey, 1, 0, 1);
+
+    address_index.Interrupt();
+    address_index.Stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
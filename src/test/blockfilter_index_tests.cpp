@@ -0,0 +1,123 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilter.h>
+#include <chainparams.h>
+#include <index/blockfilterindex.h>
+#include <script/interpreter.h>
+#include <test/test_pigeon.h>
+#include <undo.h>
+#include <utiltime.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockfilter_index_tests)
+
+static bool CheckFilterLookups(BlockFilterIndex& filter_index, const CBlockIndex* block_index,
+                               uint256& last_header)
+{
+    CBlock block;
+    if (!ReadBlockFromDisk(block, block_index, Params().GetConsensus())) {
+        return false;
+    }
+    CBlockUndo block_undo;
+    if (block_index->nHeight > 0 && !UndoReadFromDisk(block_undo, block_index)) {
+        return false;
+    }
+    BlockFilter expected_filter(BlockFilterType::BASIC_FILTER, block, block_undo);
+
+    BlockFilter filter;
+    uint256 filter_header;
+    std::vector<BlockFilter> filters;
+    std::vector<uint256> filter_hashes;
+
+    BOOST_CHECK(filter_index.LookupFilter(block_index, filter));
+    BOOST_CHECK(filter_index.LookupFilterHeader(block_index, filter_header));
+    BOOST_CHECK(filter_index.LookupFilterRange(block_index->nHeight, block_index, filters));
+    BOOST_CHECK(filter_index.LookupFilterHashRange(block_index->nHeight, block_index, filter_hashes));
+
+    BOOST_CHECK_EQUAL(filters.size(), 1);
+    BOOST_CHECK_EQUAL(filter_hashes.size(), 1);
+
+    BOOST_CHECK(filter.GetHash() == expected_filter.GetHash());
+    BOOST_CHECK(filter_header == expected_filter.ComputeHeader(last_header));
+    BOOST_CHECK(filters[0].GetHash() == expected_filter.GetHash());
+    BOOST_CHECK(filter_hashes[0] == expected_filter.GetHash());
+
+    last_header = filter_header;
+    return true;
+}
+
+BOOST_FIXTURE_TEST_CASE(blockfilter_index_initial_sync, TestChain100Setup)
+{
+    BlockFilterIndex filter_index(BlockFilterType::BASIC_FILTER, 1 << 20, true);
+
+    // Lookups fail before the index has seen any block
+    {
+        LOCK(cs_main);
+        BlockFilter filter;
+        uint256 filter_header;
+        BOOST_CHECK(!filter_index.LookupFilter(chainActive.Tip(), filter));
+        BOOST_CHECK(!filter_index.LookupFilterHeader(chainActive.Tip(), filter_header));
+    }
+
+    // BlockUntilSyncedToCurrentChain should return false before the index is started
+    BOOST_CHECK(!filter_index.BlockUntilSyncedToCurrentChain());
+
+    filter_index.Start();
+
+    // Allow the index to catch up with the block index
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!filter_index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+
+    // Check that the filters and headers of the whole chain are indexed
+    uint256 last_header;
+    {
+        LOCK(cs_main);
+        for (const CBlockIndex* block_index = chainActive.Genesis(); block_index; block_index = chainActive.Next(block_index)) {
+            BOOST_CHECK(CheckFilterLookups(filter_index, block_index, last_header));
+        }
+    }
+
+    // Connect a block that spends a coinbase, so its filter also contains a spent script
+    CMutableTransaction spend;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    spend.vout.resize(1);
+    spend.vout[0].nValue = coinbaseTxns[0].vout[0].nValue - 1000;
+    spend.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    std::vector<unsigned char> vchSig;
+    uint256 sighash = SignatureHash(coinbaseTxns[0].vout[0].scriptPubKey, spend, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    coinbaseKey.Sign(sighash, vchSig);
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+
+    CreateAndProcessBlock({spend}, coinbaseKey);
+    CreateAndProcessBlock({}, coinbaseKey);
+
+    // Blocks connected after the initial sync are indexed from notifications
+    SyncWithValidationInterfaceQueue();
+    {
+        LOCK(cs_main);
+        const CBlockIndex* tip = chainActive.Tip();
+        BOOST_CHECK(CheckFilterLookups(filter_index, tip->pprev, last_header));
+        BOOST_CHECK(CheckFilterLookups(filter_index, tip, last_header));
+
+        std::vector<BlockFilter> filters;
+        BOOST_CHECK(filter_index.LookupFilterRange(0, tip, filters));
+        BOOST_CHECK_EQUAL(filters.size(), (size_t)tip->nHeight + 1);
+        BOOST_CHECK(!filter_index.LookupFilterRange(tip->nHeight + 1, tip, filters));
+    }
+
+    filter_index.Interrupt();
+    filter_index.Stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
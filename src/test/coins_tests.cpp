@@ -8,6 +8,7 @@
 #include <undo.h>
 #include <utilstrencodings.h>
 #include <test/test_pigeon.h>
+#include <txdb.h>
 #include <validation.h>
 #include <consensus/validation.h>
 
@@ -855,4 +856,88 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_prefetch)
+{
+    CCoinsViewTest base;
+    CCoinsViewPrefetch prefetch(&base, 2);
+    CCoinsViewCache cache(&prefetch);
+
+    COutPoint outpoint(InsecureRand256(), 0);
+    cache.AddCoin(outpoint, Coin(CTxOut(1, CScript() << OP_TRUE), 1, false), false);
+    BOOST_CHECK(cache.Flush());
+
+    // prefetched coins are handed out once
+    prefetch.Prefetch(outpoint);
+    BOOST_CHECK_EQUAL(prefetch.GetStats().nSize, 1U);
+    Coin coin;
+    BOOST_CHECK(prefetch.GetCoin(outpoint, coin));
+    BOOST_CHECK_EQUAL(coin.out.nValue, 1);
+    BOOST_CHECK_EQUAL(prefetch.GetStats().nHits, 1U);
+    BOOST_CHECK(prefetch.GetCoin(outpoint, coin));
+    BOOST_CHECK_EQUAL(prefetch.GetStats().nMisses, 1U);
+
+    // writes drop everything that was prefetched before
+    prefetch.Prefetch(outpoint);
+    uint64_t nGeneration = prefetch.GetGeneration();
+    cache.SpendCoin(outpoint);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(prefetch.GetGeneration() != nGeneration);
+    BOOST_CHECK_EQUAL(prefetch.GetStats().nSize, 0U);
+    BOOST_CHECK(!prefetch.HaveCoin(outpoint));
+
+    // the buffer never grows beyond its limit
+    for (int i = 0; i < 5; i++) {
+        COutPoint prevout(InsecureRand256(), i);
+        cache.AddCoin(prevout, Coin(CTxOut(1, CScript() << OP_TRUE), 1, false), false);
+        BOOST_CHECK(cache.Flush());
+        prefetch.Prefetch(prevout);
+        BOOST_CHECK(prefetch.GetStats().nSize <= 2);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_write_behind)
+{
+    CCoinsViewDB db(1 << 20, true);
+    db.StartWriteBehind();
+    CCoinsViewCache cache(&db);
+
+    COutPoint outpoint(InsecureRand256(), 0);
+    uint256 hashBlock = InsecureRand256();
+    cache.AddCoin(outpoint, Coin(CTxOut(1, CScript() << OP_TRUE), 1, false), false);
+    cache.SetBestBlock(hashBlock);
+    BOOST_CHECK(cache.Flush());
+
+    // handed over coins can be read whether they are written yet or not
+    Coin coin;
+    BOOST_CHECK(db.GetCoin(outpoint, coin));
+    BOOST_CHECK_EQUAL(coin.out.nValue, 1);
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+    BOOST_CHECK(db.SyncWriteBehind());
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+    BOOST_CHECK(db.GetCoin(outpoint, coin));
+
+    // a flush waits for the previous one, spent coins are gone right away
+    cache.SpendCoin(outpoint);
+    cache.SetBestBlock(InsecureRand256());
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(!db.HaveCoin(outpoint));
+    BOOST_CHECK(!db.GetCoin(outpoint, coin));
+
+    COutPoint outpoint2(InsecureRand256(), 1);
+    uint256 hashBlock2 = InsecureRand256();
+    cache.AddCoin(outpoint2, Coin(CTxOut(2, CScript() << OP_TRUE), 2, false), false);
+    cache.SetBestBlock(hashBlock2);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(db.GetBestBlock() == hashBlock2);
+
+    // stopping finishes the pending write
+    db.StopWriteBehind();
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    BOOST_CHECK(db.GetBestBlock() == hashBlock2);
+    BOOST_CHECK(!db.HaveCoin(outpoint));
+    BOOST_CHECK(db.GetCoin(outpoint2, coin));
+    BOOST_CHECK_EQUAL(coin.out.nValue, 2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,74 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <chainparams.h>
+#include <mappedfile.h>
+#include <streams.h>
+#include <test/test_pigeon.h>
+#include <util.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(mappedfile_tests, TestChain100Setup)
+
+BOOST_AUTO_TEST_CASE(mapped_file)
+{
+    const fs::path path = GetDataDir() / "mappedfile_test";
+
+    // empty and missing files can not be mapped
+    FILE* file = fsbridge::fopen(path, "wb");
+    BOOST_REQUIRE(file);
+    fclose(file);
+    BOOST_CHECK(!CMappedFile::Open(path));
+    BOOST_CHECK(!CMappedFile::Open(GetDataDir() / "mappedfile_missing"));
+
+    file = fsbridge::fopen(path, "wb");
+    BOOST_REQUIRE(file);
+    const std::string data = "mapped file contents";
+    fwrite(data.data(), 1, data.size(), file);
+    fclose(file);
+
+    std::shared_ptr<const CMappedFile> mapped = CMappedFile::Open(path);
+    BOOST_REQUIRE(mapped);
+    BOOST_CHECK_EQUAL(mapped->size(), data.size());
+    BOOST_CHECK(std::string((const char*)mapped->data(), mapped->size()) == data);
+
+#ifndef WIN32
+    // the mapping stays readable after the file is removed
+    fs::remove(path);
+    BOOST_CHECK(std::string((const char*)mapped->data(), mapped->size()) == data);
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(read_raw_block)
+{
+    const CChainParams& chainparams = Params();
+    LOCK(cs_main);
+    for (const CBlockIndex* pindex = chainActive.Genesis(); pindex; pindex = chainActive.Next(pindex)) {
+        CBlock block;
+        BOOST_REQUIRE(ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()));
+        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+        ssBlock << block;
+
+        CRawBlock rawBlock;
+        BOOST_REQUIRE(ReadRawBlockFromDisk(rawBlock, pindex, chainparams.MessageStart()));
+        BOOST_CHECK_EQUAL(rawBlock.size(), ssBlock.size());
+        BOOST_CHECK(std::equal(rawBlock.begin(), rawBlock.end(), (const unsigned char*)ssBlock.data()));
+
+        // serializing a raw block writes the bytes as they are
+        CDataStream ssRaw(SER_NETWORK, PROTOCOL_VERSION);
+        ssRaw << rawBlock;
+        BOOST_CHECK(ssRaw.str() == ssBlock.str());
+    }
+
+    // a position that does not point at a block is rejected
+    CRawBlock rawBlock;
+    CDiskBlockPos pos = chainActive.Tip()->GetBlockPos();
+    pos.nPos += 1;
+    BOOST_CHECK(!ReadRawBlockFromDisk(rawBlock, pos, chainparams.MessageStart()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
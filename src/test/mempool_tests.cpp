@@ -570,4 +570,88 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     SetMockTime(0);
 }
 
+static CMutableTransaction ClusterTx(const std::vector<COutPoint>& vPrevouts, int nOutputs)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(vPrevouts.size());
+    for (size_t i = 0; i < vPrevouts.size(); i++) {
+        tx.vin[i].prevout = vPrevouts[i];
+        tx.vin[i].scriptSig = CScript() << OP_11;
+    }
+    tx.vout.resize(nOutputs);
+    for (int i = 0; i < nOutputs; i++) {
+        tx.vout[i].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx.vout[i].nValue = COIN;
+    }
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(MempoolClusterTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    LOCK(pool.cs);
+
+    // A -> B -> C, A -> D, and F spends C and the unrelated E
+    CMutableTransaction txA = ClusterTx({COutPoint(InsecureRand256(), 0)}, 2);
+    CMutableTransaction txB = ClusterTx({COutPoint(txA.GetHash(), 0)}, 1);
+    CMutableTransaction txC = ClusterTx({COutPoint(txB.GetHash(), 0)}, 1);
+    CMutableTransaction txD = ClusterTx({COutPoint(txA.GetHash(), 1)}, 1);
+    CMutableTransaction txE = ClusterTx({COutPoint(InsecureRand256(), 0)}, 1);
+    CMutableTransaction txF = ClusterTx({COutPoint(txC.GetHash(), 0), COutPoint(txE.GetHash(), 0)}, 1);
+    auto get = [&](const CMutableTransaction& tx) { return pool.mapTx.find(tx.GetHash()); };
+
+    for (const CMutableTransaction* tx : {&txA, &txB, &txC, &txD, &txE}) {
+        pool.addUnchecked(tx->GetHash(), entry.Fee(1000LL).FromTx(*tx));
+    }
+    BOOST_CHECK_EQUAL(get(txD)->GetCountWithCluster(), 4U);
+    BOOST_CHECK_EQUAL(get(txE)->GetCountWithCluster(), 1U);
+    pool.addUnchecked(txF.GetHash(), entry.Fee(1000LL).FromTx(txF));
+    BOOST_CHECK(get(txA)->cluster == get(txE)->cluster);
+    BOOST_CHECK_EQUAL(get(txE)->GetCountWithCluster(), 6U);
+    BOOST_CHECK_EQUAL(get(txE)->GetModFeesWithCluster(), 6000LL);
+    pool.PrioritiseTransaction(txD.GetHash(), 500LL);
+    BOOST_CHECK_EQUAL(get(txE)->GetModFeesWithCluster(), 6500LL);
+
+    // Confirming A splits off D
+    std::vector<CTransactionRef> vtx{MakeTransactionRef(txA)};
+    pool.removeForBlock(vtx, 1);
+    BOOST_CHECK_EQUAL(get(txD)->GetCountWithCluster(), 1U);
+    BOOST_CHECK_EQUAL(get(txD)->GetModFeesWithCluster(), 1500LL);
+    BOOST_CHECK_EQUAL(get(txF)->GetCountWithCluster(), 4U);
+    BOOST_CHECK_EQUAL(get(txF)->GetCountWithAncestors(), 4U);
+    BOOST_CHECK_EQUAL(get(txC)->GetCountWithAncestors(), 2U);
+    BOOST_CHECK_EQUAL(get(txB)->GetCountWithDescendants(), 3U);
+
+    // Disconnecting the block again links A to its children
+    pool.addUnchecked(txA.GetHash(), entry.Fee(1000LL).FromTx(txA));
+    pool.UpdateTransactionsFromBlock({txA.GetHash()});
+    BOOST_CHECK(get(txD)->cluster == get(txE)->cluster);
+    BOOST_CHECK_EQUAL(get(txD)->GetCountWithCluster(), 6U);
+    BOOST_CHECK_EQUAL(get(txA)->GetCountWithDescendants(), 5U);
+    BOOST_CHECK_EQUAL(get(txA)->GetModFeesWithDescendants(), 5500LL);
+    BOOST_CHECK_EQUAL(get(txF)->GetCountWithAncestors(), 5U);
+    BOOST_CHECK_EQUAL(get(txF)->GetModFeesWithAncestors(), 5000LL);
+    BOOST_CHECK_EQUAL(get(txD)->GetCountWithAncestors(), 2U);
+
+    // Removing B with its descendants leaves {A, D} and {E}
+    pool.removeRecursive(txB);
+    BOOST_CHECK_EQUAL(pool.size(), 3U);
+    BOOST_CHECK_EQUAL(get(txA)->GetCountWithCluster(), 2U);
+    BOOST_CHECK_EQUAL(get(txA)->GetCountWithDescendants(), 2U);
+    BOOST_CHECK_EQUAL(get(txA)->GetSizeWithDescendants(), get(txA)->GetTxSize() + get(txD)->GetTxSize());
+    BOOST_CHECK_EQUAL(get(txE)->GetCountWithCluster(), 1U);
+    BOOST_CHECK_EQUAL(get(txE)->GetCountWithDescendants(), 1U);
+
+    // G would join both clusters
+    CMutableTransaction txG = ClusterTx({COutPoint(txD.GetHash(), 0), COutPoint(txE.GetHash(), 0)}, 1);
+    CTxMemPool::setEntries setAncestors;
+    uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+    std::string errString;
+    BOOST_CHECK(pool.CalculateMemPoolAncestors(entry.FromTx(txG), setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, errString));
+    BOOST_CHECK_EQUAL(setAncestors.size(), 3U);
+    BOOST_CHECK(!pool.CheckClusterLimit(setAncestors, 3, errString));
+    BOOST_CHECK(pool.CheckClusterLimit(setAncestors, 4, errString));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
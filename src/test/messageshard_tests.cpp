@@ -0,0 +1,148 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <net.h>
+#include <net_processing.h>
+#include <netmessagemaker.h>
+#include <utiltime.h>
+
+#include <test/test_pigeon.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(messageshard_tests, TestingSetup)
+
+/** Append a received message to the process queue of node as the socket handler does */
+static void ReceiveMessage(CNode& node, CSerializedNetMsg&& msg)
+{
+    const CSharedNetMsg shared = CConnman::PrepareMessage(std::move(msg));
+    CNetMessage netmsg(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
+    BOOST_CHECK_EQUAL(netmsg.readHeader((const char*)shared.header->data(), shared.header->size()), (int)CMessageHeader::HEADER_SIZE);
+    BOOST_CHECK_EQUAL(netmsg.readData((const char*)shared.data->data(), shared.data->size()), (int)shared.data->size());
+    BOOST_CHECK(netmsg.complete());
+
+    LOCK(node.cs_vProcessMsg);
+    node.nProcessQueueSize += netmsg.vRecv.size() + CMessageHeader::HEADER_SIZE;
+    node.vProcessMsg.push_back(std::move(netmsg));
+}
+
+static size_t GetProcessQueueLength(CNode& node)
+{
+    LOCK(node.cs_vProcessMsg);
+    return node.vProcessMsg.size();
+}
+
+static void SetupNode(CNode& node, PeerLogicValidation& peerLogic)
+{
+    node.SetSendVersion(PROTOCOL_VERSION);
+    node.SetRecvVersion(PROTOCOL_VERSION);
+    peerLogic.InitializeNode(&node);
+    node.nVersion = PROTOCOL_VERSION;
+    node.fSuccessfullyConnected = true;
+    CConnmanTest::AddNode(node);
+}
+
+BOOST_AUTO_TEST_CASE(hold_back_behind_sharded_messages)
+{
+    CAddress addr(CService(CNetAddr(), 7777), NODE_NONE);
+    CNode node(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", /*fInboundIn=*/ true);
+    SetupNode(node, *peerLogic);
+    std::atomic<bool> interruptDummy(false);
+    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+
+    // A message of the peer is still on its shard
+    node.nShardedMessages++;
+    ReceiveMessage(node, msgMaker.Make(NetMsgType::ISLOCK));
+    ReceiveMessage(node, msgMaker.Make(NetMsgType::PING, (uint64_t)1));
+
+    // Sharded messages are taken in order, the ping has to wait for all of them
+    peerLogic->ProcessMessages(&node, interruptDummy);
+    BOOST_CHECK_EQUAL(GetProcessQueueLength(node), 1U);
+    BOOST_CHECK(!peerLogic->ProcessMessages(&node, interruptDummy));
+    BOOST_CHECK_EQUAL(GetProcessQueueLength(node), 1U);
+
+    node.nShardedMessages--;
+    peerLogic->ProcessMessages(&node, interruptDummy);
+    BOOST_CHECK_EQUAL(GetProcessQueueLength(node), 0U);
+    BOOST_CHECK_EQUAL(node.nProcessQueueSize, 0U);
+
+    bool dummy;
+    peerLogic->FinalizeNode(node.GetId(), dummy);
+    CConnmanTest::ClearNodes();
+}
+
+BOOST_AUTO_TEST_CASE(process_in_order_on_shards)
+{
+    StartMessageShards(2);
+
+    CAddress addr(CService(CNetAddr(), 7777), NODE_NONE);
+    CNode node(1, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", /*fInboundIn=*/ true);
+    SetupNode(node, *peerLogic);
+    std::atomic<bool> interruptDummy(false);
+    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+
+    const uint64_t nProcessedBefore = GetMessageShardStats().nProcessed;
+    ReceiveMessage(node, msgMaker.Make(NetMsgType::ISLOCK));
+    ReceiveMessage(node, msgMaker.Make(NetMsgType::PING, (uint64_t)1));
+
+    // The ping is only taken once the shard processed the message before it
+    const int64_t nDeadline = GetTimeMillis() + 10000;
+    while (GetProcessQueueLength(node) > 0 && GetTimeMillis() < nDeadline) {
+        peerLogic->ProcessMessages(&node, interruptDummy);
+        if (GetProcessQueueLength(node) == 0) {
+            BOOST_CHECK_EQUAL(GetMessageShardStats().nProcessed, nProcessedBefore + 1);
+        } else {
+            MilliSleep(1);
+        }
+    }
+    BOOST_CHECK_EQUAL(GetProcessQueueLength(node), 0U);
+    BOOST_CHECK_EQUAL(node.nShardedMessages.load(), 0);
+
+    StopMessageShards();
+    bool dummy;
+    peerLogic->FinalizeNode(node.GetId(), dummy);
+    CConnmanTest::ClearNodes();
+}
+
+BOOST_AUTO_TEST_CASE(stop_with_queued_messages)
+{
+    StartMessageShards(2);
+
+    CAddress addr(CService(CNetAddr(), 7777), NODE_NONE);
+    CNode node(2, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", /*fInboundIn=*/ true);
+    SetupNode(node, *peerLogic);
+    std::atomic<bool> interruptDummy(false);
+    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+
+    for (int i = 0; i < 500; i++) {
+        ReceiveMessage(node, msgMaker.Make(NetMsgType::ISLOCK));
+    }
+    // Sharded messages are never held back, all of them are queued on the shard of the peer
+    for (int i = 0; i < 500; i++) {
+        peerLogic->ProcessMessages(&node, interruptDummy);
+    }
+    BOOST_CHECK_EQUAL(GetProcessQueueLength(node), 0U);
+
+    // Messages that are dropped from the queues release the peer like processed ones
+    StopMessageShards();
+    const MessageShardStats stats = GetMessageShardStats();
+    BOOST_CHECK_EQUAL(stats.nThreads, 0);
+    BOOST_CHECK_EQUAL(stats.nQueued, 0U);
+    BOOST_CHECK_EQUAL(node.nShardedMessages.load(), 0);
+    BOOST_CHECK_EQUAL(node.GetRefCount(), 0);
+    BOOST_CHECK_EQUAL(node.nProcessQueueSize, 0U);
+
+    // Messages are processed inline once the shards are stopped
+    ReceiveMessage(node, msgMaker.Make(NetMsgType::ISLOCK));
+    peerLogic->ProcessMessages(&node, interruptDummy);
+    BOOST_CHECK_EQUAL(GetProcessQueueLength(node), 0U);
+    BOOST_CHECK_EQUAL(node.nShardedMessages.load(), 0);
+
+    bool dummy;
+    peerLogic->FinalizeNode(node.GetId(), dummy);
+    CConnmanTest::ClearNodes();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
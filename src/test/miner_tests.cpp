@@ -26,6 +26,22 @@
 
 #include <boost/test/unit_test.hpp>
 
+struct BlockTemplateManagerTest {
+    static std::shared_ptr<const CBlockTemplate> GetTemplate(CBlockTemplateManager& manager)
+    {
+        LOCK(manager.cs);
+        return manager.pblocktemplate;
+    }
+    static void Added(CBlockTemplateManager& manager, const CTransactionRef& ptx)
+    {
+        manager.TransactionAddedToMempool(ptx, GetTime());
+    }
+    static void Removed(CBlockTemplateManager& manager, const CTransactionRef& ptx)
+    {
+        manager.TransactionRemovedFromMempool(ptx);
+    }
+};
+
 BOOST_FIXTURE_TEST_SUITE(miner_tests, TestingSetup)
 
 // BOOST_CHECK_EXCEPTION predicates to check the specific validation error
@@ -546,4 +562,214 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;
 }
 
+BOOST_AUTO_TEST_CASE(ScanBlockNonces_lowest)
+{
+    // about one nonce in 256 satisfies this target
+    Consensus::Params consensusParams = Params().GetConsensus();
+    consensusParams.powLimit = uint256S("7fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+
+    CBlockHeader header;
+    header.nVersion = 4;
+    header.hashPrevBlock = InsecureRand256();
+    header.hashMerkleRoot = InsecureRand256();
+    header.nTime = 1568755000;
+    header.nBits = 0x2000ffff;
+    header.nNonce = 0;
+
+    uint64_t nMaxTries = 1000000;
+    CBlockHeader serial(header);
+    BOOST_CHECK(ScanBlockNonces(&serial, 0x4000, nMaxTries, 1, consensusParams));
+    BOOST_CHECK_EQUAL(nMaxTries, 1000000 - serial.nNonce - 1);
+    for (uint32_t nNonce = 0; nNonce < serial.nNonce; nNonce++) {
+        CBlockHeader check(header);
+        check.nNonce = nNonce;
+        BOOST_CHECK(!CheckProofOfWork(check.GetHash(), check.nBits, consensusParams));
+    }
+
+    // the threaded search must find the same, lowest, nonce
+    nMaxTries = 1000000;
+    CBlockHeader parallel(header);
+    BOOST_CHECK(ScanBlockNonces(&parallel, 0x4000, nMaxTries, 4, consensusParams));
+    BOOST_CHECK_EQUAL(parallel.nNonce, serial.nNonce);
+
+    // running out of tries ends the search without a solution
+    nMaxTries = serial.nNonce;
+    CBlockHeader limited(header);
+    BOOST_CHECK(!ScanBlockNonces(&limited, 0x4000, nMaxTries, 1, consensusParams));
+    BOOST_CHECK_EQUAL(nMaxTries, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(BlockTemplateManager_reuse)
+{
+    CBlockTemplateManager manager;
+    LOCK(cs_main);
+
+    unsigned int nTransactionsUpdated = 0;
+    std::unique_ptr<CBlockTemplate> pblocktemplate = manager.GetBlockTemplate(chainActive.Tip(), nTransactionsUpdated);
+    BOOST_CHECK(pblocktemplate);
+    BOOST_CHECK(pblocktemplate->block.hashPrevBlock == chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK_EQUAL(nTransactionsUpdated, mempool.GetTransactionsUpdated());
+
+    // callers get their own copy of the header
+    pblocktemplate->block.nNonce = 42;
+
+    // an unchanged mempool and tip reuse the template
+    std::unique_ptr<CBlockTemplate> pblocktemplate2 = manager.GetBlockTemplate(chainActive.Tip(), nTransactionsUpdated);
+    BOOST_CHECK(pblocktemplate2);
+    BOOST_CHECK_EQUAL(pblocktemplate2->block.nNonce, 0U);
+    BOOST_CHECK(pblocktemplate2->block.vtx[0] == pblocktemplate->block.vtx[0]);
+
+    const CBlockTemplateManager::Stats stats = manager.GetStats();
+    BOOST_CHECK_EQUAL(stats.nRequests, 2U);
+    BOOST_CHECK_EQUAL(stats.nBuilds, 1U);
+    BOOST_CHECK_EQUAL(stats.nRequestBuilds, 1U);
+
+    // a template for another tip is never handed out
+    BOOST_CHECK(!manager.GetBlockTemplate(chainActive.Tip()->pprev, nTransactionsUpdated));
+}
+
+BOOST_AUTO_TEST_CASE(BlockTemplateManager_idle)
+{
+    CBlockTemplateManager manager;
+    const int64_t nTime = GetTime();
+    SetMockTime(nTime);
+
+    // nothing is maintained before the first request
+    BOOST_CHECK(!manager.IsActive());
+    unsigned int nTransactionsUpdated = 0;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(manager.GetBlockTemplate(chainActive.Tip(), nTransactionsUpdated));
+    }
+    BOOST_CHECK(manager.IsActive());
+
+    // without requests the template is dropped and not built again in the background
+    SetMockTime(nTime + BLOCK_TEMPLATE_IDLE_TIMEOUT);
+    BOOST_CHECK(!manager.IsActive());
+    manager.DoMaintenance();
+    BOOST_CHECK_EQUAL(manager.GetStats().nBuilds, 1U);
+
+    // the next request builds a new one
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(manager.GetBlockTemplate(chainActive.Tip(), nTransactionsUpdated));
+    }
+    BOOST_CHECK(manager.IsActive());
+    const CBlockTemplateManager::Stats stats = manager.GetStats();
+    BOOST_CHECK_EQUAL(stats.nBuilds, 2U);
+    BOOST_CHECK_EQUAL(stats.nRequestBuilds, 2U);
+
+    SetMockTime(0);
+}
+
+static CTransactionRef AddToMempool(const COutPoint& prevout, CAmount nFee, size_t nPadding = 0)
+{
+    CMutableTransaction tx;
+    tx.vin.emplace_back(prevout, CScript() << OP_1);
+    tx.vout.emplace_back(COIN, CScript() << OP_RETURN << std::vector<unsigned char>(nPadding, 0));
+    TestMemPoolEntryHelper entry;
+    mempool.addUnchecked(tx.GetHash(), entry.Fee(nFee).Time(GetTime()).FromTx(tx));
+    return MakeTransactionRef(tx);
+}
+
+static std::vector<uint256> TemplateTxs(const CBlockTemplate& blocktemplate)
+{
+    std::vector<uint256> vHashes;
+    for (size_t i = 1; i < blocktemplate.block.vtx.size(); i++) {
+        vHashes.push_back(blocktemplate.block.vtx[i]->GetHash());
+    }
+    return vHashes;
+}
+
+BOOST_AUTO_TEST_CASE(BlockTemplateManager_incremental)
+{
+    CBlockTemplateManager manager;
+    unsigned int nTransactionsUpdated = 0;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(manager.GetBlockTemplate(chainActive.Tip(), nTransactionsUpdated));
+    }
+
+    // a new package is appended in a valid order and paid for in the coinbase
+    CTransactionRef parent = AddToMempool(COutPoint(InsecureRand256(), 0), 1000);
+    CTransactionRef child = AddToMempool(COutPoint(parent->GetHash(), 0), 50000);
+    BlockTemplateManagerTest::Added(manager, child);
+    std::shared_ptr<const CBlockTemplate> pblocktemplate = BlockTemplateManagerTest::GetTemplate(manager);
+    BOOST_REQUIRE(pblocktemplate);
+    BOOST_CHECK(TemplateTxs(*pblocktemplate) == std::vector<uint256>({parent->GetHash(), child->GetHash()}));
+    BOOST_CHECK_EQUAL(pblocktemplate->vTxFees[0], -51000);
+
+    // the notification of the parent comes late and changes nothing
+    BlockTemplateManagerTest::Added(manager, parent);
+    BOOST_CHECK(BlockTemplateManagerTest::GetTemplate(manager) == pblocktemplate);
+
+    // transactions below the minimum fee rate are left out
+    CTransactionRef free = AddToMempool(COutPoint(InsecureRand256(), 0), 0);
+    BlockTemplateManagerTest::Added(manager, free);
+    BOOST_CHECK(BlockTemplateManagerTest::GetTemplate(manager) == pblocktemplate);
+
+    // a removed transaction takes the transactions spending it along
+    CTransactionRef other = AddToMempool(COutPoint(InsecureRand256(), 0), 2000);
+    BlockTemplateManagerTest::Added(manager, other);
+    mempool.removeRecursive(*parent);
+    BlockTemplateManagerTest::Removed(manager, parent);
+    pblocktemplate = BlockTemplateManagerTest::GetTemplate(manager);
+    BOOST_REQUIRE(pblocktemplate);
+    BOOST_CHECK(TemplateTxs(*pblocktemplate) == std::vector<uint256>({other->GetHash()}));
+    BOOST_CHECK_EQUAL(pblocktemplate->vTxFees[0], -2000);
+    BlockTemplateManagerTest::Removed(manager, child);
+    BOOST_CHECK(BlockTemplateManagerTest::GetTemplate(manager) == pblocktemplate);
+
+    const CBlockTemplateManager::Stats stats = manager.GetStats();
+    BOOST_CHECK_EQUAL(stats.nBuilds, 1U);
+    BOOST_CHECK_EQUAL(stats.nUpdates, 3U);
+    BOOST_CHECK_EQUAL(stats.nTx, 1U);
+
+    // the handed out template is checked once more
+    {
+        LOCK(cs_main);
+        BOOST_CHECK_THROW(manager.GetBlockTemplate(chainActive.Tip(), nTransactionsUpdated), std::runtime_error);
+    }
+
+    mempool.clear();
+}
+
+BOOST_AUTO_TEST_CASE(BlockTemplateManager_full)
+{
+    // room for three transactions of about 1 kB next to the reserved coinbase space
+    gArgs.ForceSetArg("-blockmaxsize", "4000");
+    CBlockTemplateManager manager;
+    unsigned int nTransactionsUpdated = 0;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(manager.GetBlockTemplate(chainActive.Tip(), nTransactionsUpdated));
+    }
+
+    CTransactionRef low = AddToMempool(COutPoint(InsecureRand256(), 0), 2000, 1000);
+    CTransactionRef medium = AddToMempool(COutPoint(InsecureRand256(), 0), 3000, 1000);
+    BlockTemplateManagerTest::Added(manager, low);
+    BlockTemplateManagerTest::Added(manager, medium);
+    BOOST_CHECK(TemplateTxs(*BlockTemplateManagerTest::GetTemplate(manager)) == std::vector<uint256>({low->GetHash(), medium->GetHash()}));
+
+    // a package paying more evicts the lowest fee rate
+    CTransactionRef high = AddToMempool(COutPoint(InsecureRand256(), 0), 50000, 1000);
+    BlockTemplateManagerTest::Added(manager, high);
+    BOOST_CHECK(TemplateTxs(*BlockTemplateManagerTest::GetTemplate(manager)) == std::vector<uint256>({medium->GetHash(), high->GetHash()}));
+
+    // one paying less than everything in the template does not
+    CTransactionRef lowest = AddToMempool(COutPoint(InsecureRand256(), 0), 1500, 1000);
+    BlockTemplateManagerTest::Added(manager, lowest);
+    BOOST_CHECK(TemplateTxs(*BlockTemplateManagerTest::GetTemplate(manager)) == std::vector<uint256>({medium->GetHash(), high->GetHash()}));
+
+    // space freed by a removal goes to the best package left in the mempool
+    mempool.removeRecursive(*high);
+    BlockTemplateManagerTest::Removed(manager, high);
+    std::shared_ptr<const CBlockTemplate> pblocktemplate = BlockTemplateManagerTest::GetTemplate(manager);
+    BOOST_CHECK(TemplateTxs(*pblocktemplate) == std::vector<uint256>({medium->GetHash(), low->GetHash()}));
+    BOOST_CHECK_EQUAL(pblocktemplate->vTxFees[0], -5000);
+
+    mempool.clear();
+    gArgs.ForceSetArg("-blockmaxsize", std::to_string(DEFAULT_BLOCK_MAX_SIZE));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
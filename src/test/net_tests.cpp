@@ -9,6 +9,7 @@
 #include <serialize.h>
 #include <streams.h>
 #include <net.h>
+#include <netmessagemaker.h>
 #include <netbase.h>
 #include <chainparams.h>
 #include <util.h>
@@ -201,6 +202,100 @@ BOOST_AUTO_TEST_CASE(PoissonNextSend)
     g_mock_deterministic_tests = false;
 }
 
+BOOST_AUTO_TEST_CASE(prepare_shared_message)
+{
+    CSerializedNetMsg msg = CNetMsgMaker(PROTOCOL_VERSION).Make(NetMsgType::PING, (uint64_t)0x0123456789abcdef);
+    const std::vector<unsigned char> payload = msg.data;
+    const unsigned char* payloadData = msg.data.data();
+
+    const CSharedNetMsg shared = CConnman::PrepareMessage(std::move(msg));
+    // The payload is taken over without copying it
+    BOOST_CHECK(shared.data->data() == payloadData);
+    BOOST_CHECK(*shared.data == payload);
+    BOOST_CHECK_EQUAL(shared.command, NetMsgType::PING);
+
+    BOOST_CHECK_EQUAL(shared.header->size(), CMessageHeader::HEADER_SIZE);
+    CMessageHeader hdr(Params().MessageStart());
+    CDataStream ss(*shared.header, SER_NETWORK, INIT_PROTO_VERSION);
+    ss >> hdr;
+    BOOST_CHECK(hdr.IsValid(Params().MessageStart()));
+    BOOST_CHECK_EQUAL(hdr.GetCommand(), NetMsgType::PING);
+    BOOST_CHECK_EQUAL(hdr.nMessageSize, payload.size());
+    const uint256 hash = Hash(payload.begin(), payload.end());
+    BOOST_CHECK(memcmp(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE) == 0);
+}
+
+static void QueueSendMsg(CNode& node, SendPriority priority, const std::string& command, size_t nSize)
+{
+    AssertLockHeld(node.cs_vSend);
+    CSerializedNetMsg msg;
+    msg.command = command;
+    msg.data.resize(nSize);
+    const CSharedNetMsg shared = CConnman::PrepareMessage(std::move(msg));
+    node.vSendQueues[priority].msgs.push_back(CNode::CQueuedSendMsg{shared.header, shared.data, GetTimeMicros()});
+    node.vSendQueues[priority].nBytes += CMessageHeader::HEADER_SIZE + nSize;
+    node.nSendQueuedMsgs++;
+}
+
+static std::string ScheduledCommand(const std::shared_ptr<const std::vector<unsigned char>>& header)
+{
+    CMessageHeader hdr(Params().MessageStart());
+    CDataStream ss(*header, SER_NETWORK, INIT_PROTO_VERSION);
+    ss >> hdr;
+    return hdr.GetCommand();
+}
+
+BOOST_AUTO_TEST_CASE(send_priorities)
+{
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::CLSIG), SEND_PRIORITY_HIGH);
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::INV), SEND_PRIORITY_NORMAL);
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::MNGOVERNANCEOBJECTVOTE), SEND_PRIORITY_BULK);
+
+    CAddress addr(CService(CNetAddr(), 7777), NODE_NETWORK);
+    CNode node(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", false);
+    LOCK(node.cs_vSend);
+
+    // A governance sync is queued before a ChainLock, which is scheduled first anyway
+    for (int i = 0; i < 10; i++) {
+        QueueSendMsg(node, SEND_PRIORITY_BULK, NetMsgType::MNGOVERNANCEOBJECT, 100000);
+    }
+    QueueSendMsg(node, SEND_PRIORITY_HIGH, NetMsgType::CLSIG, 100);
+    node.ScheduleSendMsgs();
+    BOOST_CHECK_EQUAL(ScheduledCommand(node.vSendMsg.front()), NetMsgType::CLSIG);
+    // A governance object doesn't fit into the scheduled bytes behind it and stays queued
+    BOOST_CHECK_EQUAL(node.vSendMsg.size(), 2U);
+    BOOST_CHECK_EQUAL(node.nSendQueuedMsgs, 10U);
+    BOOST_CHECK_EQUAL(node.vSendQueues[SEND_PRIORITY_HIGH].nSent, 1U);
+
+    // So an ISLOCK that is queued while the ChainLock is sent still goes before the sync
+    QueueSendMsg(node, SEND_PRIORITY_HIGH, NetMsgType::ISLOCK, 200);
+    node.ScheduleSendMsgs();
+    BOOST_CHECK_EQUAL(node.vSendMsg.size(), 4U);
+    BOOST_CHECK_EQUAL(ScheduledCommand(*std::next(node.vSendMsg.begin(), 2)), NetMsgType::ISLOCK);
+
+    // Once these are sent, a governance object is scheduled on its own
+    node.vSendMsg.clear();
+    node.ScheduleSendMsgs();
+    BOOST_CHECK_EQUAL(node.vSendMsg.size(), 2U);
+    BOOST_CHECK_EQUAL(ScheduledCommand(node.vSendMsg.front()), NetMsgType::MNGOVERNANCEOBJECT);
+    BOOST_CHECK_EQUAL(node.nSendQueuedMsgs, 9U);
+
+    // The sync still progresses while high priority messages keep coming
+    size_t nSyncSent = 0;
+    for (int i = 0; i < 100 && node.nSendQueuedMsgs > 0; i++) {
+        node.vSendMsg.clear();
+        QueueSendMsg(node, SEND_PRIORITY_HIGH, NetMsgType::QSIGSHARE, 1000);
+        node.ScheduleSendMsgs();
+        for (const auto& data : node.vSendMsg) {
+            if (data->size() == CMessageHeader::HEADER_SIZE && ScheduledCommand(data) == NetMsgType::MNGOVERNANCEOBJECT) {
+                nSyncSent++;
+            }
+        }
+    }
+    BOOST_CHECK_EQUAL(nSyncSent, 9U);
+    BOOST_CHECK_EQUAL(node.vSendQueues[SEND_PRIORITY_BULK].nBytes, 0U);
+}
+
 // prior to PR #14728, this test triggers an undefined behavior
 BOOST_AUTO_TEST_CASE(ipv4_peer_with_ipv6_addrMe_test)
 {
@@ -239,4 +334,60 @@ BOOST_AUTO_TEST_CASE(ipv4_peer_with_ipv6_addrMe_test)
     BOOST_CHECK(1);
 }
 
+static CNetMessage& ReceiveMessage(CNetMessagePool& pool, std::list<CNetMessage>& msgs, const std::string& command, size_t nSize)
+{
+    CSerializedNetMsg msg;
+    msg.command = command;
+    msg.data.resize(nSize);
+    const CSharedNetMsg shared = CConnman::PrepareMessage(std::move(msg));
+
+    pool.Get(msgs, Params().MessageStart());
+    CNetMessage& received = msgs.back();
+    BOOST_CHECK_EQUAL(received.readHeader((const char*)shared.header->data(), shared.header->size()), (int)CMessageHeader::HEADER_SIZE);
+    BOOST_CHECK(received.in_data);
+    pool.ReserveData(received);
+    BOOST_CHECK_EQUAL(received.readData((const char*)shared.data->data(), shared.data->size()), (int)nSize);
+    BOOST_CHECK(received.complete());
+    BOOST_CHECK_EQUAL(received.hdr.GetCommand(), command);
+    BOOST_CHECK(received.GetMessageHash() == Hash(shared.data->begin(), shared.data->end()));
+    return received;
+}
+
+BOOST_AUTO_TEST_CASE(net_message_pool)
+{
+    CNetMessagePool pool;
+    std::list<CNetMessage> msgs;
+
+    // A message and its payload buffer are allocated for each message at first
+    const CNetMessage* pping = &ReceiveMessage(pool, msgs, NetMsgType::PING, 8);
+    ReceiveMessage(pool, msgs, NetMsgType::BLOCK, 100000);
+    pool.Put(msgs);
+    BOOST_CHECK(msgs.empty());
+    CNetMessagePool::Stats stats = pool.GetStats();
+    BOOST_CHECK_EQUAL(stats.nCached, 2U);
+    BOOST_CHECK(stats.nCachedBytes >= 100008);
+    BOOST_CHECK_EQUAL(stats.nAllocated, 4U);
+    BOOST_CHECK_EQUAL(stats.nReused, 0U);
+
+    // The next message reuses the small one and the large buffer is swapped into it
+    const CNetMessage& block = ReceiveMessage(pool, msgs, NetMsgType::BLOCK, 100000);
+    BOOST_CHECK(&block == pping);
+    BOOST_CHECK(block.vRecv.capacity() >= 100000);
+    BOOST_CHECK_EQUAL(block.nDataAllocs, 0U);
+    ReceiveMessage(pool, msgs, NetMsgType::PING, 8);
+    pool.Put(msgs);
+    stats = pool.GetStats();
+    BOOST_CHECK_EQUAL(stats.nCached, 2U);
+    BOOST_CHECK_EQUAL(stats.nAllocated, 4U);
+    BOOST_CHECK_EQUAL(stats.nReused, 3U);
+
+    // Messages that do not fit into the cache are freed
+    for (int i = 0; i < 600; i++) {
+        ReceiveMessage(pool, msgs, NetMsgType::PING, 8);
+    }
+    pool.Put(msgs);
+    stats = pool.GetStats();
+    BOOST_CHECK_EQUAL(stats.nCached, 512U + 1U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,125 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coins.h>
+#include <pooled_unordered_map.h>
+#include <test/test_pigeon.h>
+
+#include <string>
+#include <unordered_map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(pooled_unordered_map_tests, BasicTestingSetup)
+
+typedef pooled_unordered_map<uint64_t, std::string> test_map;
+
+static void CheckEqual(const test_map& m, const std::unordered_map<uint64_t, std::string>& ref)
+{
+    BOOST_CHECK_EQUAL(m.size(), ref.size());
+    size_t count = 0;
+    for (const auto& entry : m) {
+        auto it = ref.find(entry.first);
+        BOOST_CHECK(it != ref.end() && it->second == entry.second);
+        count++;
+    }
+    BOOST_CHECK_EQUAL(count, ref.size());
+}
+
+BOOST_AUTO_TEST_CASE(random_operations)
+{
+    for (int round = 0; round < 20; round++) {
+        test_map m;
+        std::unordered_map<uint64_t, std::string> ref;
+        const uint64_t range = 1 + InsecureRandRange(3000);
+        for (int i = 0; i < 10000; i++) {
+            const uint64_t key = InsecureRandRange(range);
+            switch (InsecureRandRange(5)) {
+            case 0:
+            case 1: {
+                auto inserted = m.emplace(key, std::to_string(i));
+                auto ref_inserted = ref.emplace(key, std::to_string(i));
+                BOOST_CHECK_EQUAL(inserted.second, ref_inserted.second);
+                BOOST_CHECK_EQUAL(inserted.first->second, ref_inserted.first->second);
+                break;
+            }
+            case 2:
+                BOOST_CHECK_EQUAL(m.erase(key), ref.erase(key));
+                break;
+            case 3: {
+                auto it = m.find(key);
+                BOOST_CHECK_EQUAL(it == m.end(), ref.count(key) == 0);
+                if (it != m.end()) {
+                    BOOST_CHECK_EQUAL(it->second, ref[key]);
+                }
+                break;
+            }
+            case 4:
+                m[key] += "x";
+                ref[key] += "x";
+                break;
+            }
+            BOOST_CHECK_EQUAL(m.size(), ref.size());
+        }
+        CheckEqual(m, ref);
+
+        // erase while iterating
+        for (auto it = m.begin(); it != m.end(); ) {
+            if (it->first % 3 == 0) {
+                ref.erase(it->first);
+                it = m.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        CheckEqual(m, ref);
+        for (const auto& entry : ref) {
+            BOOST_CHECK_EQUAL(m.count(entry.first), 1U);
+        }
+
+        test_map moved(std::move(m));
+        CheckEqual(moved, ref);
+        BOOST_CHECK(m.empty() && m.begin() == m.end());
+
+        moved.clear();
+        BOOST_CHECK(moved.empty() && moved.begin() == moved.end());
+        BOOST_CHECK_EQUAL(moved.DynamicMemoryUsage(), 0U);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(stable_references)
+{
+    test_map m;
+    std::string* first = &m.emplace(0, "first").first->second;
+    for (uint64_t i = 1; i < 10000; i++) {
+        m.emplace(i, std::to_string(i));
+    }
+    BOOST_CHECK(first == &m.find(0)->second);
+    BOOST_CHECK_EQUAL(*first, "first");
+
+    // erased entries are reused
+    const size_t usage = m.DynamicMemoryUsage();
+    for (uint64_t i = 1; i < 1000; i++) {
+        m.erase(i);
+    }
+    for (uint64_t i = 10000; i < 10999; i++) {
+        m.emplace(i, std::to_string(i));
+    }
+    BOOST_CHECK_EQUAL(m.DynamicMemoryUsage(), usage);
+}
+
+BOOST_AUTO_TEST_CASE(coins_memory_usage)
+{
+    // The same coins take less memory than in a node based map
+    CCoinsMap coins;
+    std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> unordered;
+    for (int i = 0; i < 10000; i++) {
+        COutPoint outpoint(InsecureRand256(), i);
+        coins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::tuple<>());
+        unordered.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::tuple<>());
+    }
+    BOOST_CHECK(memusage::DynamicUsage(coins) < memusage::DynamicUsage(unordered));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -201,4 +201,60 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+/* The memoized header hash must follow in-place mutation of the header fields */
+BOOST_AUTO_TEST_CASE(header_hash_cache)
+{
+    CBlockHeader header;
+    header.nVersion = 0x20000000;
+    header.hashPrevBlock = uint256S("0x00000000000000a1d2e4c9f36bd7f5ae98c201345678908e7d6c5b4a39281706");
+    header.hashMerkleRoot = uint256S("0x2b1c97e6ab90f3b9dca0cc5c0c8b5e6f1a7a3b5c9d0e1f2a3b4c5d6e7f809112");
+    header.nTime = 1600000000;
+    header.nBits = 0x1b0fed89;
+    header.nNonce = 42;
+
+    const uint256 hash = header.GetHash();
+    BOOST_CHECK(hash == header.GetHash());
+
+    // copies carry the cached hash along and stay consistent
+    CBlockHeader copy(header);
+    BOOST_CHECK(copy.GetHash() == hash);
+    CBlock block(header);
+    BOOST_CHECK(block.GetHash() == hash);
+    BOOST_CHECK(block.GetBlockHeader().GetHash() == hash);
+
+    // every header field invalidates the cached hash
+    std::vector<uint256> hashes{hash};
+    copy.nNonce++;
+    hashes.push_back(copy.GetHash());
+    copy.nTime++;
+    hashes.push_back(copy.GetHash());
+    copy.nBits++;
+    hashes.push_back(copy.GetHash());
+    copy.nVersion++;
+    hashes.push_back(copy.GetHash());
+    copy.hashMerkleRoot = uint256();
+    hashes.push_back(copy.GetHash());
+    copy.hashPrevBlock = uint256();
+    hashes.push_back(copy.GetHash());
+    for (size_t i = 0; i < hashes.size(); i++) {
+        for (size_t j = i + 1; j < hashes.size(); j++) {
+            BOOST_CHECK(hashes[i] != hashes[j]);
+        }
+    }
+
+    // a freshly built header with the same fields hashes identically
+    CBlockHeader fresh;
+    fresh.nVersion = copy.nVersion;
+    fresh.hashPrevBlock = copy.hashPrevBlock;
+    fresh.hashMerkleRoot = copy.hashMerkleRoot;
+    fresh.nTime = copy.nTime;
+    fresh.nBits = copy.nBits;
+    fresh.nNonce = copy.nNonce;
+    BOOST_CHECK(fresh.GetHash() == copy.GetHash());
+
+    // assignment overwrites the cache together with the fields
+    copy = header;
+    BOOST_CHECK(copy.GetHash() == hash);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,218 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <chainparams.h>
+#include <consensus/merkle.h>
+#include <consensus/validation.h>
+#include <hash.h>
+#include <miner.h>
+#include <pow.h>
+#include <script/interpreter.h>
+#include <stratum.h>
+#include <streams.h>
+#include <test/test_pigeon.h>
+#include <txmempool.h>
+#include <utilstrencodings.h>
+#include <validation.h>
+
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/event.h>
+
+#include <boost/test/unit_test.hpp>
+
+struct StratumServerTest {
+    static std::shared_ptr<const StratumJob> GetJob(CStratumServer& server)
+    {
+        LOCK(server.cs);
+        return server.jobs.empty() ? nullptr : server.jobs.back();
+    }
+    static UniValue Submit(CStratumServer& server, StratumClient& client, const UniValue& params)
+    {
+        return server.HandleSubmit(client, params);
+    }
+    static void Send(CStratumServer& server, StratumClient& client, const UniValue& message)
+    {
+        server.Send(client, message);
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(stratum_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(coinbase_merkle_branch)
+{
+    for (int nTx = 1; nTx <= 33; nTx++) {
+        CBlock block;
+        block.vtx.resize(nTx);
+        for (int i = 0; i < nTx; i++) {
+            CMutableTransaction mtx;
+            mtx.nLockTime = i;
+            block.vtx[i] = MakeTransactionRef(std::move(mtx));
+        }
+
+        const std::vector<uint256> vMerkleBranch = GetCoinbaseMerkleBranch(block);
+        BOOST_CHECK(GetMerkleRootFromBranch(block.vtx[0]->GetHash(), vMerkleBranch) == BlockMerkleRoot(block));
+
+        // a miner only changes the coinbase, the branch stays valid
+        CMutableTransaction coinbase;
+        coinbase.nLockTime = 1000;
+        block.vtx[0] = MakeTransactionRef(std::move(coinbase));
+        BOOST_CHECK(GetMerkleRootFromBranch(block.vtx[0]->GetHash(), vMerkleBranch) == BlockMerkleRoot(block));
+        BOOST_CHECK(GetCoinbaseMerkleBranch(block) == vMerkleBranch);
+    }
+}
+
+/** Serialized coinbase as the miner assembles it from the job */
+static std::vector<unsigned char> AssembleCoinbase(const StratumJob& job, const std::vector<unsigned char>& vchExtraNonce)
+{
+    std::vector<unsigned char> vchCoinbase(job.vchCoinbase1);
+    vchCoinbase.insert(vchCoinbase.end(), vchExtraNonce.begin(), vchExtraNonce.end());
+    vchCoinbase.insert(vchCoinbase.end(), job.vchCoinbase2.begin(), job.vchCoinbase2.end());
+    return vchCoinbase;
+}
+
+static uint256 GetShareHash(const StratumJob& job, const std::vector<unsigned char>& vchExtraNonce, uint32_t nNonce)
+{
+    const std::vector<unsigned char> vchCoinbase = AssembleCoinbase(job, vchExtraNonce);
+    CBlockHeader header = job.block.GetBlockHeader();
+    header.hashMerkleRoot = GetMerkleRootFromBranch(Hash(vchCoinbase.begin(), vchCoinbase.end()), job.vMerkleBranch);
+    header.nNonce = nNonce;
+    return header.GetHash();
+}
+
+static UniValue SubmitParams(const StratumJob& job, const std::string& strExtraNonce2, const std::string& strNonce)
+{
+    UniValue params(UniValue::VARR);
+    params.push_back("worker");
+    params.push_back(job.strId);
+    params.push_back(strExtraNonce2);
+    params.push_back(strprintf("%08x", job.block.nTime));
+    params.push_back(strNonce);
+    return params;
+}
+
+static int GetErrorCode(const UniValue& error)
+{
+    return error.isNull() ? 0 : error[0].get_int();
+}
+
+BOOST_FIXTURE_TEST_CASE(job_and_submit, TestChain100Setup)
+{
+    // a mempool transaction so that the coinbase has a merkle branch
+    CMutableTransaction spend;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    spend.vout.resize(1);
+    spend.vout[0].nValue = coinbaseTxns[0].vout[0].nValue - 10000;
+    spend.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    std::vector<unsigned char> vchSig;
+    uint256 sighash = SignatureHash(coinbaseTxns[0].vout[0].scriptPubKey, spend, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    BOOST_CHECK(coinbaseKey.Sign(sighash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(AcceptToMemoryPool(mempool, state, MakeTransactionRef(spend), nullptr, true, 0));
+    }
+
+    struct event_base* base = event_base_new();
+    BOOST_REQUIRE(base);
+    {
+        // every hash that is not a block misses the share target
+        CStratumServer server(base, CScript() << OP_TRUE, 1e9);
+        server.UpdateJob();
+        std::shared_ptr<const StratumJob> job = StratumServerTest::GetJob(server);
+        BOOST_REQUIRE(job);
+        BOOST_CHECK_EQUAL(job->block.vtx.size(), 2U);
+        BOOST_CHECK_EQUAL(job->vMerkleBranch.size(), 1U);
+
+        // coinb1 + extranonce + coinb2 is the coinbase with the extranonce pushed after the height
+        const std::vector<unsigned char> vchExtraNonce1 = ParseHex("00000001");
+        const std::vector<unsigned char> vchExtraNonce = ParseHex("0000000102030405");
+        CMutableTransaction coinbase;
+        CDataStream ss(AssembleCoinbase(*job, vchExtraNonce), SER_NETWORK, PROTOCOL_VERSION);
+        ss >> coinbase;
+        BOOST_CHECK(ss.empty());
+        CBlock block(job->block);
+        SetCoinbaseExtraNonce(&block, job->pindexPrev, vchExtraNonce);
+        BOOST_CHECK(coinbase.GetHash() == block.vtx[0]->GetHash());
+        BOOST_CHECK(GetMerkleRootFromBranch(coinbase.GetHash(), job->vMerkleBranch) == block.hashMerkleRoot);
+
+        StratumClient client;
+        client.bev = nullptr;
+        client.vchExtraNonce1 = vchExtraNonce1;
+
+        // only subscribed and authorized workers submit shares
+        BOOST_CHECK_EQUAL(GetErrorCode(StratumServerTest::Submit(server, client, SubmitParams(*job, "02030405", "00000000"))), 25);
+        client.fSubscribed = true;
+        BOOST_CHECK_EQUAL(GetErrorCode(StratumServerTest::Submit(server, client, SubmitParams(*job, "02030405", "00000000"))), 24);
+        client.fAuthorized = true;
+
+        // malformed extranonce2 and nonce
+        BOOST_CHECK_EQUAL(GetErrorCode(StratumServerTest::Submit(server, client, SubmitParams(*job, "0203", "00000000"))), 20);
+        BOOST_CHECK_EQUAL(GetErrorCode(StratumServerTest::Submit(server, client, SubmitParams(*job, "02030405", "xyz"))), 20);
+
+        uint32_t nBadNonce = 0;
+        while (CheckProofOfWork(GetShareHash(*job, vchExtraNonce, nBadNonce), job->block.nBits, Params().GetConsensus())) {
+            nBadNonce++;
+        }
+        uint32_t nGoodNonce = 0;
+        while (!CheckProofOfWork(GetShareHash(*job, vchExtraNonce, nGoodNonce), job->block.nBits, Params().GetConsensus())) {
+            nGoodNonce++;
+        }
+
+        // a nonce that misses the share target
+        BOOST_CHECK_EQUAL(GetErrorCode(StratumServerTest::Submit(server, client, SubmitParams(*job, "02030405", strprintf("%08x", nBadNonce)))), 23);
+
+        // a nonce that solves the block is accepted and submitted
+        const UniValue params = SubmitParams(*job, "02030405", strprintf("%08x", nGoodNonce));
+        BOOST_CHECK(StratumServerTest::Submit(server, client, params).isNull());
+        {
+            LOCK(cs_main);
+            BOOST_CHECK_EQUAL(chainActive.Height(), 101);
+            BOOST_CHECK(chainActive.Tip()->GetBlockHash() == GetShareHash(*job, vchExtraNonce, nGoodNonce));
+        }
+
+        // the same share again
+        BOOST_CHECK_EQUAL(GetErrorCode(StratumServerTest::Submit(server, client, params)), 22);
+
+        // jobs of the previous tip are gone once the job for the new tip is built
+        server.UpdateJob();
+        BOOST_CHECK(StratumServerTest::GetJob(server)->pindexPrev->nHeight == 101);
+        BOOST_CHECK_EQUAL(GetErrorCode(StratumServerTest::Submit(server, client, params)), 21);
+    }
+    event_base_free(base);
+}
+
+BOOST_AUTO_TEST_CASE(send_buffer_limit)
+{
+    struct event_base* base = event_base_new();
+    BOOST_REQUIRE(base);
+    {
+        CStratumServer server(base, CScript() << OP_TRUE, 1.0);
+
+        // without a socket nothing is ever sent, the replies pile up
+        StratumClient client;
+        client.bev = bufferevent_socket_new(base, -1, BEV_OPT_CLOSE_ON_FREE);
+        BOOST_REQUIRE(client.bev);
+        const UniValue message(std::string(100 * 1024, 'a'));
+        for (int i = 0; i < 10; i++) {
+            StratumServerTest::Send(server, client, message);
+            BOOST_CHECK(!client.fDisconnect);
+        }
+        StratumServerTest::Send(server, client, message);
+        BOOST_CHECK(client.fDisconnect);
+
+        // a client that is being disconnected gets nothing more
+        const size_t nBuffered = evbuffer_get_length(bufferevent_get_output(client.bev));
+        StratumServerTest::Send(server, client, message);
+        BOOST_CHECK_EQUAL(evbuffer_get_length(bufferevent_get_output(client.bev)), nBuffered);
+        bufferevent_free(client.bev);
+    }
+    event_base_free(base);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
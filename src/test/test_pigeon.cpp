@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <test/test_pigeon.h>
+#include <algo/x16r_multi.h>
 
 #include <chainparams.h>
 #include <consensus/consensus.h>
@@ -54,6 +55,7 @@ extern void noui_connect();
 BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
 {
         SHA256AutoDetect();
+        X16RMultiAutoDetect();
         RandomInit();
         ECC_Start();
         BLSInit();
@@ -110,8 +112,10 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
             }
         }
         nScriptCheckThreads = 3;
-        for (int i=0; i < nScriptCheckThreads-1; i++)
+        for (int i=0; i < nScriptCheckThreads-1; i++) {
             threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(&ThreadHeaderCheck);
+        }
         peerLogic.reset(new PeerLogicValidation(connman, scheduler));
 }
 
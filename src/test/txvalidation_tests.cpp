@@ -6,10 +6,17 @@
 #include <txmempool.h>
 #include <amount.h>
 #include <consensus/validation.h>
+#include <key.h>
 #include <primitives/transaction.h>
+#include <script/interpreter.h>
 #include <script/script.h>
 #include <test/test_pigeon.h>
 
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+
 #include <boost/test/unit_test.hpp>
 
 
@@ -57,4 +64,92 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_reject_coinbase, TestChain100Setup)
     BOOST_CHECK_EQUAL(nDoS, 100);
 }
 
+static CTransactionRef SignedSpend(const CKey& key, const CScript& scriptPubKey, const std::vector<COutPoint>& vPrevouts, const std::vector<CAmount>& vValues)
+{
+    CMutableTransaction tx;
+    tx.nVersion = 1;
+    for (const COutPoint& prevout : vPrevouts) {
+        tx.vin.emplace_back(prevout);
+    }
+    for (CAmount nValue : vValues) {
+        tx.vout.emplace_back(nValue, scriptPubKey);
+    }
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, tx, i, SIGHASH_ALL, 0, SigVersion::BASE);
+        BOOST_CHECK(key.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        tx.vin[i].scriptSig = CScript() << vchSig;
+    }
+    return MakeTransactionRef(tx);
+}
+
+/**
+ * Admit conflicting transactions from several threads at once, which only hold
+ * cs_main around their script checks.
+ */
+BOOST_FIXTURE_TEST_CASE(tx_mempool_accept_concurrent, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const int nOutputs = 10;
+    const CAmount nValue = coinbaseTxns[0].vout[0].nValue / (nOutputs + 2);
+
+    // one more output for the spend with an invalid signature
+    CTransactionRef fanout = SignedSpend(coinbaseKey, scriptPubKey, {COutPoint(coinbaseTxns[0].GetHash(), 0)}, std::vector<CAmount>(nOutputs + 1, nValue));
+    CValidationState state;
+    BOOST_CHECK(AcceptToMemoryPoolConcurrent(mempool, state, fanout, nullptr /* pfMissingInputs */,
+                                             false /* bypass_limits */, 0 /* nAbsurdFee */));
+
+    // every output is spent twice, only one of each pair can make it
+    std::vector<CTransactionRef> vSpends;
+    for (int i = 0; i < nOutputs; i++) {
+        for (int j = 0; j < 2; j++) {
+            vSpends.push_back(SignedSpend(coinbaseKey, scriptPubKey, {COutPoint(fanout->GetHash(), i)}, {nValue - (j + 1) * CENT}));
+        }
+    }
+    CKey otherKey;
+    otherKey.MakeNewKey(true);
+    CTransactionRef badSig = SignedSpend(otherKey, scriptPubKey, {COutPoint(fanout->GetHash(), nOutputs)}, {nValue - CENT});
+    vSpends.push_back(badSig);
+
+    // Boost.Test assertions are not thread safe, so the results are checked afterwards
+    std::mutex cs_results;
+    std::map<uint256, CValidationState> mapResults;
+    std::atomic<int> nMissingInputs{0};
+    std::vector<std::thread> vThreads;
+    for (int t = 0; t < 4; t++) {
+        vThreads.emplace_back([&, t] {
+            for (size_t i = t; i < vSpends.size(); i += 4) {
+                CValidationState txState;
+                bool fMissingInputs = false;
+                AcceptToMemoryPoolConcurrent(mempool, txState, vSpends[i], &fMissingInputs,
+                                             false /* bypass_limits */, 0 /* nAbsurdFee */);
+                if (fMissingInputs) nMissingInputs++;
+                std::lock_guard<std::mutex> lock(cs_results);
+                mapResults.emplace(vSpends[i]->GetHash(), txState);
+            }
+        });
+    }
+    for (std::thread& thread : vThreads) {
+        thread.join();
+    }
+
+    BOOST_CHECK_EQUAL(nMissingInputs, 0);
+    LOCK(cs_main);
+    BOOST_CHECK_EQUAL(mempool.size(), 1U + nOutputs);
+    for (int i = 0; i < nOutputs; i++) {
+        const CTransactionRef& first = vSpends[2 * i];
+        const CTransactionRef& second = vSpends[2 * i + 1];
+        BOOST_CHECK(mempool.exists(first->GetHash()) != mempool.exists(second->GetHash()));
+        const CValidationState& rejected = mapResults[mempool.exists(first->GetHash()) ? second->GetHash() : first->GetHash()];
+        BOOST_CHECK_EQUAL(rejected.GetRejectReason(), "txn-mempool-conflict");
+    }
+
+    BOOST_CHECK(!mempool.exists(badSig->GetHash()));
+    int nDoS;
+    BOOST_CHECK(mapResults[badSig->GetHash()].IsInvalid(nDoS));
+    BOOST_CHECK_EQUAL(nDoS, 100);
+    BOOST_CHECK_EQUAL(mapResults[badSig->GetHash()].GetRejectReason().substr(0, 35), "mandatory-script-verify-flag-failed");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
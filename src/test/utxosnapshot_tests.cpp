@@ -0,0 +1,52 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <streams.h>
+#include <test/test_pigeon.h>
+#include <utxosnapshot.h>
+
+#include <limits>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(utxosnapshot_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(snapshot_metadata)
+{
+    SnapshotMetadata metadata;
+    metadata.hashBaseBlock = InsecureRand256();
+    metadata.nBaseHeight = 1000;
+    metadata.nCoins = 12345;
+    metadata.nEvoEntries = 67;
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << metadata;
+    const size_t nSize = ss.size();
+
+    SnapshotMetadata metadata2;
+    ss >> metadata2;
+    BOOST_CHECK(metadata2.hashBaseBlock == metadata.hashBaseBlock);
+    BOOST_CHECK_EQUAL(metadata2.nBaseHeight, metadata.nBaseHeight);
+    BOOST_CHECK_EQUAL(metadata2.nCoins, metadata.nCoins);
+    BOOST_CHECK_EQUAL(metadata2.nEvoEntries, metadata.nEvoEntries);
+
+    // dumptxoutset rewrites the header in place, its size must not depend on the counts
+    metadata.nCoins = std::numeric_limits<uint64_t>::max();
+    ss << metadata;
+    BOOST_CHECK_EQUAL(ss.size(), nSize);
+    ss.clear();
+
+    // bad magic
+    ss << metadata;
+    ss[0] = 'x';
+    BOOST_CHECK_THROW(ss >> metadata2, std::ios_base::failure);
+    ss.clear();
+
+    // unknown version
+    ss << metadata;
+    ss[5] = SnapshotMetadata::CURRENT_VERSION + 1;
+    BOOST_CHECK_THROW(ss >> metadata2, std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
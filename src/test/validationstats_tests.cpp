@@ -0,0 +1,73 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <test/test_pigeon.h>
+#include <validationstats.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(validationstats_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(latency_histogram_percentiles)
+{
+    CLatencyHistogram histogram(100);
+
+    CLatencyHistogram::Summary summary = histogram.GetSummary();
+    BOOST_CHECK_EQUAL(summary.nCount, 0);
+    BOOST_CHECK_EQUAL(summary.nWindow, 0);
+    BOOST_CHECK_EQUAL(summary.nMax, 0);
+
+    // add 1..100 in reverse order, percentiles must not depend on the order
+    for (int i = 100; i > 0; i--) {
+        histogram.Add(i);
+    }
+    summary = histogram.GetSummary();
+    BOOST_CHECK_EQUAL(summary.nCount, 100);
+    BOOST_CHECK_EQUAL(summary.nTotal, 5050);
+    BOOST_CHECK_EQUAL(summary.nWindow, 100);
+    BOOST_CHECK_EQUAL(summary.nP50, 50);
+    BOOST_CHECK_EQUAL(summary.nP90, 90);
+    BOOST_CHECK_EQUAL(summary.nP99, 99);
+    BOOST_CHECK_EQUAL(summary.nMax, 100);
+
+    // a single sample is every percentile
+    CLatencyHistogram single(100);
+    single.Add(7);
+    summary = single.GetSummary();
+    BOOST_CHECK_EQUAL(summary.nP50, 7);
+    BOOST_CHECK_EQUAL(summary.nP99, 7);
+    BOOST_CHECK_EQUAL(summary.nMax, 7);
+}
+
+BOOST_AUTO_TEST_CASE(latency_histogram_window)
+{
+    CLatencyHistogram histogram(10);
+    for (int i = 0; i < 10; i++) {
+        histogram.Add(1000);
+    }
+    // the old samples roll out of the window but stay in the totals
+    for (int i = 1; i <= 10; i++) {
+        histogram.Add(i);
+    }
+    CLatencyHistogram::Summary summary = histogram.GetSummary();
+    BOOST_CHECK_EQUAL(summary.nCount, 20);
+    BOOST_CHECK_EQUAL(summary.nTotal, 10055);
+    BOOST_CHECK_EQUAL(summary.nWindow, 10);
+    BOOST_CHECK_EQUAL(summary.nP50, 5);
+    BOOST_CHECK_EQUAL(summary.nP90, 9);
+    BOOST_CHECK_EQUAL(summary.nMax, 10);
+}
+
+BOOST_AUTO_TEST_CASE(validation_stage_names)
+{
+    for (int i = 0; i < (int)ValidationStage::COUNT; i++) {
+        BOOST_CHECK(GetValidationStageName((ValidationStage)i)[0] != '\0');
+    }
+    BOOST_CHECK_EQUAL(GetValidationStageGroup(ValidationStage::CALLBACKS), std::string("connectblock"));
+    BOOST_CHECK_EQUAL(GetValidationStageGroup(ValidationStage::READ_FROM_DISK), std::string("connecttip"));
+    BOOST_CHECK_EQUAL(GetValidationStageGroup(ValidationStage::TOTAL), std::string("connecttip"));
+    BOOST_CHECK_EQUAL(GetValidationStageGroup(ValidationStage::COINS_FLUSH), std::string("flushstatetodisk"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,169 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <algo/hashx21s.h>
+#include <algo/x21s_hasher.h>
+#include <primitives/block.h>
+#include <utilstrencodings.h>
+#include <test/test_pigeon.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(x21s_hasher_tests, BasicTestingSetup)
+
+static const std::string HEADER_HEX = "000000200617283a4b5c6d7e8e90785634120c298aaef5d76bf3c9e4d2a100000000000012910f7e6d5c4b3a2f1e0d9c5b3a7a1a6f5e8b0c5ccca0dcb9f390abe6971c2b00f15e5f89ed0f1b2a000000";
+
+BOOST_AUTO_TEST_CASE(x21s_hasher_vectors)
+{
+    const std::vector<unsigned char> header = ParseHex(HEADER_HEX);
+    BOOST_CHECK_EQUAL(header.size(), 80U);
+
+    CX21SHasher hasher;
+    BOOST_CHECK_EQUAL(hasher.HashX21S(header.data(), header.size(), uint256S("00000000000000a1d2e4c9f36bd7f5ae98c201345678908e7d6c5b4a39281706")).GetHex(),
+                      "c2f35dc9b3a10760f8b07c4a3f20b8e158591e9e63b4215866459a964dffa2c2");
+    BOOST_CHECK_EQUAL(hasher.HashX16R(header.data(), header.size(), uint256S("00000000000000a1d2e4c9f36bd7f5ae98c201345678908e7d6c5b4a39281706")).GetHex(),
+                      "1b57501fb5647fa9531b644b098eb90244269465cd02aaedc3f602c0d2fd9eab");
+    BOOST_CHECK_EQUAL(hasher.HashX21S(header.data(), header.size(), uint256S("000000000000000000000000000000000000000000000000fedcba9876543210")).GetHex(),
+                      "5294f74ab045573d40c6ff26cc1bd4843013e7a8078300720f06f891cabeca18");
+}
+
+BOOST_AUTO_TEST_CASE(x21s_hasher_order)
+{
+    // identity shuffle input: every nibble moves the algorithm at its offset to the front
+    uint8_t order[X16_ALGO_COUNT];
+    CX21SHasher::GetAlgoOrder(uint256S("0000000000000000000000000000000000000000000000000000000000000000"), order);
+    for (int i = 0; i < X16_ALGO_COUNT; i++) {
+        BOOST_CHECK_EQUAL(order[i], i);
+    }
+
+    // the shuffled order must match the selection of the reference implementation
+    for (int n = 0; n < 100; n++) {
+        const uint256 hashPrevBlock = InsecureRand256();
+        CX21SHasher::GetAlgoOrder(hashPrevBlock, order);
+
+        std::string hashString = hashPrevBlock.GetHex();
+        std::string list = "0123456789abcdef";
+        std::string ref = list;
+        for (int i = 0; i < 16; i++) {
+            int offset = list.find(hashString[48 + i]);
+            ref.insert(0, 1, ref[offset]);
+            ref.erase(offset + 1, 1);
+        }
+        const uint256 scrambleHash = uint256S(hashString.substr(0, 48) + ref);
+
+        for (int i = 0; i < X16_ALGO_COUNT; i++) {
+            BOOST_CHECK_EQUAL(order[i], GetX21sSelection(scrambleHash, i));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(x21s_hasher_matches_reference)
+{
+    CX21SHasher& hasher = GetThreadX21SHasher();
+    uint256 hashPrevBlock = InsecureRand256();
+
+    for (int n = 0; n < 200; n++) {
+        std::vector<unsigned char> data(n % 4 == 0 ? 80 : InsecureRandRange(160));
+        for (auto& c : data) {
+            c = InsecureRandBits(8);
+        }
+        // reuse the same previous block hash now and then to exercise the memoized order
+        if (InsecureRandBool()) {
+            hashPrevBlock = InsecureRand256();
+        }
+
+        const unsigned char* pbegin = data.data();
+        const unsigned char* pend = data.data() + data.size();
+        BOOST_CHECK(hasher.HashX21S(pbegin, data.size(), hashPrevBlock) == HashX21S(pbegin, pend, hashPrevBlock));
+        BOOST_CHECK(hasher.HashX16R(pbegin, data.size(), hashPrevBlock) == HashX16R(pbegin, pend, hashPrevBlock));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(x21s_hasher_multi_lane)
+{
+    CX21SHasher hasher;
+
+    for (int n = 0; n < 50; n++) {
+        // lane counts around the kernel width and the batch size
+        const size_t nLanes = 1 + InsecureRandRange(2 * X16R_MAX_LANES + 2);
+        const size_t len = n % 2 == 0 ? 80 : InsecureRandRange(160);
+
+        std::vector<std::vector<unsigned char>> data(nLanes, std::vector<unsigned char>(len));
+        std::vector<const unsigned char*> pdata(nLanes);
+        std::vector<uint256> hashPrevBlock(nLanes), hashX16R(nLanes), hashX21S(nLanes);
+        for (size_t l = 0; l < nLanes; l++) {
+            for (auto& c : data[l]) {
+                c = InsecureRandBits(8);
+            }
+            pdata[l] = data[l].data();
+            // share the previous block hash between some lanes so that the
+            // same algorithm runs on several lanes at every step
+            hashPrevBlock[l] = (l > 0 && InsecureRandBool()) ? hashPrevBlock[l - 1] : InsecureRand256();
+        }
+
+        hasher.HashX16RMulti(pdata.data(), len, hashPrevBlock.data(), hashX16R.data(), nLanes);
+        hasher.HashX21SMulti(pdata.data(), len, hashPrevBlock.data(), hashX21S.data(), nLanes);
+        for (size_t l = 0; l < nLanes; l++) {
+            BOOST_CHECK(hashX16R[l] == hasher.HashX16R(pdata[l], len, hashPrevBlock[l]));
+            BOOST_CHECK(hashX21S[l] == hasher.HashX21S(pdata[l], len, hashPrevBlock[l]));
+        }
+    }
+}
+
+static CBlockHeader RandomHeader()
+{
+    CBlockHeader header;
+    header.nVersion = InsecureRand32();
+    header.hashPrevBlock = InsecureRand256();
+    header.hashMerkleRoot = InsecureRand256();
+    // on either side of the X21S activation
+    header.nTime = InsecureRandBool() ? InsecureRandRange(1000) : 0xffffffff - InsecureRandRange(1000);
+    header.nBits = InsecureRand32();
+    header.nNonce = InsecureRand32();
+    return header;
+}
+
+BOOST_AUTO_TEST_CASE(block_header_hashes)
+{
+    for (int n = 0; n < 10; n++) {
+        const size_t nHeaders = 1 + InsecureRandRange(3 * X16R_MAX_LANES);
+        std::vector<CBlockHeader> vHeaders(nHeaders);
+        std::vector<CBlockHeader> vExpected(nHeaders);
+        std::vector<const CBlockHeader*> headers(nHeaders);
+        for (size_t i = 0; i < nHeaders; i++) {
+            vHeaders[i] = RandomHeader();
+            headers[i] = &vHeaders[i];
+            // a hash computed with GetHash() first is taken from the cache
+            if (InsecureRandBool()) {
+                vHeaders[i].GetHash();
+            }
+        }
+        for (size_t i = 0; i < nHeaders; i++) {
+            vExpected[i].nVersion = vHeaders[i].nVersion;
+            vExpected[i].hashPrevBlock = vHeaders[i].hashPrevBlock;
+            vExpected[i].hashMerkleRoot = vHeaders[i].hashMerkleRoot;
+            vExpected[i].nTime = vHeaders[i].nTime;
+            vExpected[i].nBits = vHeaders[i].nBits;
+            vExpected[i].nNonce = vHeaders[i].nNonce;
+        }
+
+        std::vector<uint256> hashes(nHeaders);
+        CBlockHeader::GetHashes(headers.data(), hashes.data(), nHeaders);
+        for (size_t i = 0; i < nHeaders; i++) {
+            BOOST_CHECK(hashes[i] == vExpected[i].GetHash());
+            BOOST_CHECK(vHeaders[i].GetHash() == hashes[i]);
+        }
+
+        // a changed header is hashed again
+        vHeaders[0].nNonce++;
+        vExpected[0].nNonce++;
+        CBlockHeader::GetHashes(headers.data(), hashes.data(), 1);
+        BOOST_CHECK(hashes[0] == vExpected[0].GetHash());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -16,6 +16,9 @@
 
 #include <stdint.h>
 
+#include <atomic>
+#include <thread>
+
 #include <boost/thread.hpp>
 
 static const char DB_COIN = 'C';
@@ -27,6 +30,7 @@ static const char DB_ADDRESSUNSPENTINDEX = 'u';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
 static const char DB_BLOCK_INDEX = 'b';
+static const char DB_INDEX_BEST_BLOCK = 'i';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_HEAD_BLOCKS = 'H';
@@ -62,15 +66,49 @@ CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(Get
 {
 }
 
+CCoinsViewDB::~CCoinsViewDB()
+{
+    StopWriteBehind();
+}
+
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    if (fWriteBehind) {
+        WaitableLock lock(cs_pending);
+        if (pcoinsPending) {
+            CCoinsMap::const_iterator it = pcoinsPending->find(outpoint);
+            if (it != pcoinsPending->end()) {
+                if (it->second.coin.IsSpent())
+                    return false;
+                coin = it->second.coin;
+                return true;
+            }
+        }
+    }
     return db.Read(CoinEntry(&outpoint), coin);
 }
 
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
+    if (fWriteBehind) {
+        WaitableLock lock(cs_pending);
+        if (pcoinsPending) {
+            CCoinsMap::const_iterator it = pcoinsPending->find(outpoint);
+            if (it != pcoinsPending->end())
+                return !it->second.coin.IsSpent();
+        }
+    }
     return db.Exists(CoinEntry(&outpoint));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
+    if (fWriteBehind) {
+        WaitableLock lock(cs_pending);
+        if (!hashPendingBlock.IsNull())
+            return hashPendingBlock;
+    }
+    return ReadBestBlock();
+}
+
+uint256 CCoinsViewDB::ReadBestBlock() const {
     uint256 hashBestChain;
     if (!db.Read(DB_BEST_BLOCK, hashBestChain))
         return uint256();
@@ -85,15 +123,8 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
     return vhashHeadBlocks;
 }
 
-bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
-    CDBBatch batch(db);
-    size_t count = 0;
-    size_t changed = 0;
-    size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
-    int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
-    assert(!hashBlock.IsNull());
-
-    uint256 old_tip = GetBestBlock();
+uint256 CCoinsViewDB::GetTransitionBase(const uint256 &hashBlock) const {
+    uint256 old_tip = ReadBestBlock();
     if (old_tip.IsNull()) {
         // We may be in the middle of replaying.
         std::vector<uint256> old_heads = GetHeadBlocks();
@@ -102,6 +133,42 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             old_tip = old_heads[1];
         }
     }
+    return old_tip;
+}
+
+bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    if (!fWriteBehind)
+        return WriteCoins(mapCoins, hashBlock, true);
+
+    WaitableLock lock(cs_pending);
+    condPending.wait(lock, [this] { return hashPendingBlock.IsNull() || fWriteFailed; });
+    if (fWriteFailed)
+        return false;
+
+    // Mark the database as being in transition before returning, so that nothing
+    // written after this call (like the evo database) can get ahead of it.
+    assert(!hashBlock.IsNull());
+    CDBBatch batch(db);
+    batch.Erase(DB_BEST_BLOCK);
+    batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, GetTransitionBase(hashBlock)});
+    db.WriteBatch(batch);
+
+    pcoinsPending.reset(new CCoinsMap(std::move(mapCoins)));
+    mapCoins.clear();
+    hashPendingBlock = hashBlock;
+    condPending.notify_all();
+    return true;
+}
+
+bool CCoinsViewDB::WriteCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase) {
+    CDBBatch batch(db);
+    size_t count = 0;
+    size_t changed = 0;
+    size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
+    int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
+    assert(!hashBlock.IsNull());
+
+    uint256 old_tip = GetTransitionBase(hashBlock);
 
     // In the first batch, mark the database as being in the middle of a
     // transition from old_tip to hashBlock.
@@ -120,8 +187,13 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        if (fErase) {
+            CCoinsMap::iterator itOld = it++;
+            mapCoins.erase(itOld);
+        } else {
+            // Entries handed over to the writer thread stay readable until everything is written
+            ++it;
+        }
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -146,6 +218,73 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     return ret;
 }
 
+void CCoinsViewDB::ThreadWriteBehind()
+{
+    WaitableLock lock(cs_pending);
+    while (true) {
+        condPending.wait(lock, [this] { return !hashPendingBlock.IsNull() || fStopWriter; });
+        if (hashPendingBlock.IsNull())
+            return;
+
+        const uint256 hashBlock = hashPendingBlock;
+        lock.unlock();
+        int64_t nStart = GetTimeMicros();
+        bool fOk = false;
+        try {
+            fOk = WriteCoins(*pcoinsPending, hashBlock, false);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: Error writing coins database: %s\n", __func__, e.what());
+        }
+        LogPrint(BCLog::COINDB, "Wrote %u coins for block %s in the background in %.2fms\n",
+                 pcoinsPending->size(), hashBlock.ToString(), (GetTimeMicros() - nStart) * 0.001);
+        lock.lock();
+
+        if (!fOk) {
+            // Keep serving the pending coins, the next flush reports the failure
+            fWriteFailed = true;
+            condPending.notify_all();
+            return;
+        }
+        pcoinsPending.reset();
+        hashPendingBlock.SetNull();
+        condPending.notify_all();
+    }
+}
+
+void CCoinsViewDB::StartWriteBehind()
+{
+    if (fWriteBehind)
+        return;
+    fStopWriter = false;
+    fWriteBehind = true;
+    threadWriter = std::thread(&TraceThread<std::function<void()>>, "coinswriter",
+                               std::bind(&CCoinsViewDB::ThreadWriteBehind, this));
+}
+
+void CCoinsViewDB::StopWriteBehind()
+{
+    if (!fWriteBehind)
+        return;
+    {
+        WaitableLock lock(cs_pending);
+        fStopWriter = true;
+        condPending.notify_all();
+    }
+    if (threadWriter.joinable())
+        threadWriter.join();
+    if (!fWriteFailed)
+        fWriteBehind = false;
+}
+
+bool CCoinsViewDB::SyncWriteBehind()
+{
+    if (!fWriteBehind)
+        return true;
+    WaitableLock lock(cs_pending);
+    condPending.wait(lock, [this] { return hashPendingBlock.IsNull() || fWriteFailed; });
+    return !fWriteFailed;
+}
+
 size_t CCoinsViewDB::EstimateSize() const
 {
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
@@ -176,7 +315,7 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
 {
-    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), GetBestBlock());
+    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), ReadBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
@@ -381,6 +520,12 @@ bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex)
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::EraseTimestampIndex(const CTimestampIndexKey &timestampIndex) {
+    CDBBatch batch(*this);
+    batch.Erase(std::make_pair(DB_TIMESTAMPINDEX, timestampIndex));
+    return WriteBatch(batch);
+}
+
 bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes) {
 
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
@@ -413,46 +558,111 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
+bool CBlockTreeDB::WriteIndexBestBlock(const std::string &name, const CBlockLocator &locator) {
+    return Write(std::make_pair(DB_INDEX_BEST_BLOCK, name), locator);
+}
+
+bool CBlockTreeDB::ReadIndexBestBlock(const std::string &name, CBlockLocator &locator) {
+    return Read(std::make_pair(DB_INDEX_BEST_BLOCK, name), locator);
+}
+
+/** Number of block index entries read from the database before they are handed to the workers */
+static const size_t BLOCK_INDEX_LOAD_CHUNK = 50000;
+/** Maximum number of threads deserializing and verifying block index entries */
+static const int MAX_BLOCK_INDEX_LOAD_THREADS = 16;
+
 bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
 {
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
 
-    // Load mapBlockIndex
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
-            CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight        = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->nVersion       = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->nBits          = diskindex.nBits;
-                pindexNew->nNonce         = diskindex.nNonce;
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nTx            = diskindex.nTx;
-
-                if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits, consensusParams))
-                    return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
-
-                pcursor->Next();
-            } else {
-                return error("%s: failed to read value", __func__);
+    const int nThreads = std::max(1, std::min(GetNumCores(), MAX_BLOCK_INDEX_LOAD_THREADS));
+    int64_t nTimeRead = 0, nTimeDeserialize = 0, nTimeLink = 0;
+    size_t nEntries = 0;
+
+    std::vector<CDataStream> vValues;
+    std::vector<CDiskBlockIndex> vIndexes;
+    vValues.reserve(BLOCK_INDEX_LOAD_CHUNK);
+
+    // Load mapBlockIndex. The index is streamed in chunks: the raw entries of a
+    // chunk are read from the database, deserialized and checked by several
+    // threads, and then linked into mapBlockIndex in a single pass.
+    bool fDone = false;
+    while (!fDone) {
+        int64_t nTimeStart = GetTimeMicros();
+        vValues.clear();
+        while (vValues.size() < BLOCK_INDEX_LOAD_CHUNK) {
+            boost::this_thread::interruption_point();
+            std::pair<char, uint256> key;
+            if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX) {
+                fDone = true;
+                break;
             }
-        } else {
-            break;
+            vValues.emplace_back(pcursor->GetValue());
+            pcursor->Next();
+        }
+        int64_t nTime1 = GetTimeMicros(); nTimeRead += nTime1 - nTimeStart;
+
+        vIndexes.clear();
+        vIndexes.resize(vValues.size());
+        std::atomic<bool> fReadFailed(false);
+        std::atomic<bool> fPoWFailed(false);
+        std::atomic<size_t> nFailedPos(0);
+        auto deserialize = [&](size_t nBegin, size_t nEnd) {
+            for (size_t i = nBegin; i < nEnd && !fReadFailed && !fPoWFailed; i++) {
+                try {
+                    vValues[i] >> vIndexes[i];
+                } catch (const std::exception&) {
+                    fReadFailed = true;
+                    return;
+                }
+                // Only compares the stored hash against nBits, no hashing involved
+                if (!CheckProofOfWork(vIndexes[i].GetBlockHash(), vIndexes[i].nBits, consensusParams)) {
+                    nFailedPos = i;
+                    fPoWFailed = true;
+                    return;
+                }
+            }
+        };
+        const size_t nPerThread = (vValues.size() + nThreads - 1) / nThreads;
+        std::vector<std::thread> vThreads;
+        for (size_t nBegin = nPerThread; nBegin < vValues.size(); nBegin += nPerThread) {
+            vThreads.emplace_back(deserialize, nBegin, std::min(nBegin + nPerThread, vValues.size()));
+        }
+        deserialize(0, std::min(nPerThread, vValues.size()));
+        for (std::thread& thread : vThreads) {
+            thread.join();
         }
+        if (fReadFailed)
+            return error("%s: failed to read value", __func__);
+        if (fPoWFailed)
+            return error("%s: CheckProofOfWork failed: %s", __func__, vIndexes[nFailedPos].ToString());
+        int64_t nTime2 = GetTimeMicros(); nTimeDeserialize += nTime2 - nTime1;
+
+        for (const CDiskBlockIndex& diskindex : vIndexes) {
+            // Construct block index object
+            CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
+            pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
+            pindexNew->nHeight        = diskindex.nHeight;
+            pindexNew->nFile          = diskindex.nFile;
+            pindexNew->nDataPos       = diskindex.nDataPos;
+            pindexNew->nUndoPos       = diskindex.nUndoPos;
+            pindexNew->nVersion       = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->nTime          = diskindex.nTime;
+            pindexNew->nBits          = diskindex.nBits;
+            pindexNew->nNonce         = diskindex.nNonce;
+            pindexNew->nStatus        = diskindex.nStatus;
+            pindexNew->nTx            = diskindex.nTx;
+        }
+        nEntries += vIndexes.size();
+        nTimeLink += GetTimeMicros() - nTime2;
     }
 
+    LogPrintf("%s: loaded %u block index entries: db read %.2fms, deserialize %.2fms (%d threads), link %.2fms\n", __func__,
+              nEntries, nTimeRead * 0.001, nTimeDeserialize * 0.001, nThreads, nTimeLink * 0.001);
+
     return true;
 }
 
@@ -13,9 +13,11 @@
 #include <spentindex.h>
 #include <sync.h>
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -39,8 +41,12 @@ static const int64_t nMaxBlockDBCache = 2;
 // Unlike for the UTXO database, for the txindex scenario the leveldb cache make
 // a meaningful difference: https://github.com/bitcoin/bitcoin/pull/8273#issuecomment-229601991
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
+//! Max memory allocated to the block filter index DB specific cache (MiB)
+static const int64_t nMaxBlockFilterIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! -coinswritebehind default
+static const bool DEFAULT_COINS_WRITE_BEHIND = false;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -67,14 +73,43 @@ struct CDiskTxPos : public CDiskBlockPos
     }
 };
 
-/** CCoinsView backed by the coin database (chainstate/) */
+/**
+ * CCoinsView backed by the coin database (chainstate/)
+ *
+ * In write-behind mode, BatchWrite only marks the database as being in transition
+ * to the new best block (see GetHeadBlocks) and hands the coins over to a background
+ * thread, which writes them in batches of -dbbatchsize. Until that finishes, the
+ * handed over coins are served from memory and the best block is the new one. A
+ * further BatchWrite waits for the previous one to finish. After a crash in between,
+ * the head blocks marker makes ReplayBlocks roll the database forward as usual. The
+ * evo database may already be committed at the new best block by then, ReplayBlocks
+ * does not process the special transactions of the blocks it contains again.
+ */
 class CCoinsViewDB final : public CCoinsView
 {
 protected:
     CDBWrapper db;
+
+private:
+    std::atomic<bool> fWriteBehind{false};
+    mutable CWaitableCriticalSection cs_pending;
+    CConditionVariable condPending;
+    //! Coins handed over to the writer thread, not modified until they are on disk
+    std::unique_ptr<CCoinsMap> pcoinsPending;
+    //! Best block of pcoinsPending, null when there is nothing to write
+    uint256 hashPendingBlock;
+    bool fWriteFailed{false};
+    bool fStopWriter{false};
+    std::thread threadWriter;
+
+    uint256 ReadBestBlock() const;
+    uint256 GetTransitionBase(const uint256 &hashBlock) const;
+    bool WriteCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase);
+    void ThreadWriteBehind();
+
 public:
     explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
-
+    ~CCoinsViewDB();
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
@@ -86,6 +121,13 @@ public:
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+
+    //! Make BatchWrite return before the coins are written, see above
+    void StartWriteBehind();
+    //! Finish writing the pending coins and write synchronously again
+    void StopWriteBehind();
+    //! Wait until the pending coins are on disk. Returns false if writing them failed.
+    bool SyncWriteBehind();
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -142,9 +184,13 @@ public:
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0);
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
+    bool EraseTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
+    //! Best block of a background index, see BaseIndex
+    bool WriteIndexBestBlock(const std::string &name, const CBlockLocator &locator);
+    bool ReadIndexBestBlock(const std::string &name, CBlockLocator &locator);
     bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
 };
 
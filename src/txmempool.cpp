@@ -57,46 +57,80 @@ void CTxMemPoolEntry::UpdateLockPoints(const LockPoints& lp)
     lockPoints = lp;
 }
 
+CTxMemPool::EpochGuard::EpochGuard(const CTxMemPool& in) : pool(in)
+{
+    assert(!pool.fHasEpochGuard);
+    ++pool.nEpoch;
+    pool.fHasEpochGuard = true;
+}
+
+CTxMemPool::EpochGuard::~EpochGuard()
+{
+    pool.fHasEpochGuard = false;
+}
+
+bool CTxMemPool::visited(txiter it) const
+{
+    assert(fHasEpochGuard);
+    if (it->nEpoch == nEpoch) {
+        return true;
+    }
+    it->nEpoch = nEpoch;
+    return false;
+}
+
 // Update the given tx for any in-mempool descendants.
 // Assumes that setMemPoolChildren is correct for the given tx and all
 // descendants.
-void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap &cachedDescendants, const std::set<uint256> &setExclude)
+void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap &cachedDescendants, const std::set<uint256> &setExclude, stateDeltaMap &ancestorDeltas)
 {
-    setEntries stageEntries, setAllDescendants;
-    stageEntries = GetMemPoolChildren(updateIt);
+    const EpochGuard epoch(*this);
+    std::vector<txiter> vStage, vAllDescendants;
+    for (txiter childEntry : GetMemPoolChildren(updateIt)) {
+        visited(childEntry);
+        vStage.push_back(childEntry);
+    }
 
-    while (!stageEntries.empty()) {
-        const txiter cit = *stageEntries.begin();
-        setAllDescendants.insert(cit);
-        stageEntries.erase(cit);
+    while (!vStage.empty()) {
+        const txiter cit = vStage.back();
+        vStage.pop_back();
+        vAllDescendants.push_back(cit);
         const setEntries &setChildren = GetMemPoolChildren(cit);
         for (txiter childEntry : setChildren) {
             cacheMap::iterator cacheIt = cachedDescendants.find(childEntry);
             if (cacheIt != cachedDescendants.end()) {
                 // We've already calculated this one, just add the entries for this set
-                // but don't traverse again.
+                // but don't traverse again. The cached entries include all
+                // non-excluded descendants of anything in it.
                 for (txiter cacheEntry : cacheIt->second) {
-                    setAllDescendants.insert(cacheEntry);
+                    if (!visited(cacheEntry)) {
+                        vAllDescendants.push_back(cacheEntry);
+                    }
                 }
-            } else if (!setAllDescendants.count(childEntry)) {
+            } else if (!visited(childEntry)) {
                 // Schedule for later processing
-                stageEntries.insert(childEntry);
+                vStage.push_back(childEntry);
             }
         }
     }
-    // setAllDescendants now contains all in-mempool descendants of updateIt.
+    // vAllDescendants now contains all in-mempool descendants of updateIt.
     // Update and add to cached descendant map
     int64_t modifySize = 0;
     CAmount modifyFee = 0;
     int64_t modifyCount = 0;
-    for (txiter cit : setAllDescendants) {
+    std::vector<txiter> &vCached = cachedDescendants[updateIt];
+    for (txiter cit : vAllDescendants) {
         if (!setExclude.count(cit->GetTx().GetHash())) {
             modifySize += cit->GetTxSize();
             modifyFee += cit->GetModifiedFee();
             modifyCount++;
-            cachedDescendants[updateIt].insert(cit);
+            vCached.push_back(cit);
             // Update ancestor state for each descendant
-            mapTx.modify(cit, update_ancestor_state(updateIt->GetTxSize(), updateIt->GetModifiedFee(), 1, updateIt->GetSigOpCount()));
+            StateDelta &delta = ancestorDeltas[cit];
+            delta.nSize += updateIt->GetTxSize();
+            delta.nModFee += updateIt->GetModifiedFee();
+            delta.nCount++;
+            delta.nSigOps += updateIt->GetSigOpCount();
         }
     }
     mapTx.modify(updateIt, update_descendant_state(modifySize, modifyFee, modifyCount));
@@ -119,6 +153,10 @@ void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashes
     // accounted for in the state of their ancestors)
     std::set<uint256> setAlreadyIncluded(vHashesToUpdate.begin(), vHashesToUpdate.end());
 
+    // A descendant of several entries gets their ancestor state changes
+    // summed up and is modified once at the end.
+    stateDeltaMap mapAncestorDeltas;
+
     // Iterate in reverse, so that whenever we are looking at a transaction
     // we are sure that all in-mempool descendants have already been processed.
     // This maximizes the benefit of the descendant cache and guarantees that
@@ -144,17 +182,23 @@ void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashes
             if (setChildren.insert(childIter).second && !setAlreadyIncluded.count(childHash)) {
                 UpdateChild(it, childIter, true);
                 UpdateParent(childIter, it, true);
+                MergeClusters(it, childIter);
             }
         }
-        UpdateForDescendants(it, mapMemPoolDescendantsToUpdate, setAlreadyIncluded);
+        UpdateForDescendants(it, mapMemPoolDescendantsToUpdate, setAlreadyIncluded, mapAncestorDeltas);
+    }
+    for (const auto& delta : mapAncestorDeltas) {
+        mapTx.modify(delta.first, update_ancestor_state(delta.second.nSize, delta.second.nModFee, delta.second.nCount, delta.second.nSigOps));
     }
 }
 
 bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntries &setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string &errString, bool fSearchForParents /* = true */) const
 {
     LOCK(cs);
+    const EpochGuard epoch(*this);
 
-    setEntries parentHashes;
+    // Ancestors that have been found but not been processed yet
+    std::vector<txiter> vStage;
     const CTransaction &tx = entry.GetTx();
 
     if (fSearchForParents) {
@@ -163,9 +207,9 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         // iterate mapTx to find parents.
         for (unsigned int i = 0; i < tx.vin.size(); i++) {
             txiter piter = mapTx.find(tx.vin[i].prevout.hash);
-            if (piter != mapTx.end()) {
-                parentHashes.insert(piter);
-                if (parentHashes.size() + 1 > limitAncestorCount) {
+            if (piter != mapTx.end() && !visited(piter)) {
+                vStage.push_back(piter);
+                if (vStage.size() + 1 > limitAncestorCount) {
                     errString = strprintf("too many unconfirmed parents [limit: %u]", limitAncestorCount);
                     return false;
                 }
@@ -175,16 +219,19 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         // If we're not searching for parents, we require this to be an
         // entry in the mempool already.
         txiter it = mapTx.iterator_to(entry);
-        parentHashes = GetMemPoolParents(it);
+        for (txiter piter : GetMemPoolParents(it)) {
+            visited(piter);
+            vStage.push_back(piter);
+        }
     }
 
     size_t totalSizeWithAncestors = entry.GetTxSize();
 
-    while (!parentHashes.empty()) {
-        txiter stageit = *parentHashes.begin();
+    while (!vStage.empty()) {
+        txiter stageit = vStage.back();
+        vStage.pop_back();
 
         setAncestors.insert(stageit);
-        parentHashes.erase(stageit);
         totalSizeWithAncestors += stageit->GetTxSize();
 
         if (stageit->GetSizeWithDescendants() + entry.GetTxSize() > limitDescendantSize) {
@@ -201,10 +248,10 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         const setEntries & setMemPoolParents = GetMemPoolParents(stageit);
         for (const txiter &phash : setMemPoolParents) {
             // If this is a new ancestor, add it.
-            if (setAncestors.count(phash) == 0) {
-                parentHashes.insert(phash);
+            if (!visited(phash)) {
+                vStage.push_back(phash);
             }
-            if (parentHashes.size() + setAncestors.size() + 1 > limitAncestorCount) {
+            if (vStage.size() + setAncestors.size() + 1 > limitAncestorCount) {
                 errString = strprintf("too many unconfirmed ancestors [limit: %u]", limitAncestorCount);
                 return false;
             }
@@ -214,6 +261,25 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
     return true;
 }
 
+bool CTxMemPool::CheckClusterLimit(const setEntries &setAncestors, uint64_t limitClusterCount, std::string &errString) const
+{
+    LOCK(cs);
+    // All ancestors are in the clusters of the parents, which the new
+    // transaction would join.
+    std::set<const CTxMemPoolCluster*> setClusters;
+    uint64_t nClusterCount = 1;
+    for (txiter ancestorIt : setAncestors) {
+        if (setClusters.insert(ancestorIt->cluster.get()).second) {
+            nClusterCount += ancestorIt->GetCountWithCluster();
+        }
+    }
+    if (nClusterCount > limitClusterCount) {
+        errString = strprintf("too many transactions in cluster [limit: %u]", limitClusterCount);
+        return false;
+    }
+    return true;
+}
+
 void CTxMemPool::UpdateAncestorsOf(bool add, txiter it, setEntries &setAncestors)
 {
     setEntries parentIters = GetMemPoolParents(it);
@@ -253,53 +319,124 @@ void CTxMemPool::UpdateChildrenForRemoval(txiter it)
 
 void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, bool updateDescendants)
 {
-    // For each entry, walk back all ancestors and decrement size associated with this
-    // transaction
-    const uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+    // The state changes are summed up per remaining ancestor or descendant and
+    // applied with a single mapTx.modify each. Relatives that are removed as
+    // well are not updated at all, so removing a package does not touch its
+    // entries once for every removed ancestor or descendant.
+    stateDeltaMap mapAncestorDeltas, mapDescendantDeltas;
+    std::vector<txiter> vStage;
+
+    // Find the removed transactions that have a remaining descendant (or
+    // ancestor), walking from the remaining ones through the removed ones. The
+    // walks of the other removed transactions would only find removed ones, so
+    // they are skipped, which keeps removing a whole chain linear.
+    auto withRemainingRelatives = [&](bool fDescendants) {
+        const EpochGuard epoch(*this);
+        setEntries setResult;
+        for (txiter removeIt : entriesToRemove) {
+            for (txiter relative : fDescendants ? GetMemPoolChildren(removeIt) : GetMemPoolParents(removeIt)) {
+                if (!entriesToRemove.count(relative) && !visited(removeIt)) {
+                    vStage.push_back(removeIt);
+                }
+            }
+        }
+        while (!vStage.empty()) {
+            txiter it = vStage.back();
+            vStage.pop_back();
+            setResult.insert(it);
+            for (txiter relative : fDescendants ? GetMemPoolParents(it) : GetMemPoolChildren(it)) {
+                if (entriesToRemove.count(relative) && !visited(relative)) {
+                    vStage.push_back(relative);
+                }
+            }
+        }
+        return setResult;
+    };
+    // Whether a walk from a removed transaction needs to pass through it
+    auto needsWalk = [&](txiter it, const setEntries& setRemaining) {
+        return !entriesToRemove.count(it) || setRemaining.count(it);
+    };
+
     if (updateDescendants) {
+        const setEntries setWithRemainingDescendants = withRemainingRelatives(true);
         // updateDescendants should be true whenever we're not recursively
         // removing a tx and all its descendants, eg when a transaction is
         // confirmed in a block.
         // Here we only update statistics and not data in mapLinks (which
         // we need to preserve until we're finished with all operations that
         // need to traverse the mempool).
-        for (txiter removeIt : entriesToRemove) {
-            setEntries setDescendants;
-            CalculateDescendants(removeIt, setDescendants);
-            setDescendants.erase(removeIt); // don't update state for self
-            int64_t modifySize = -((int64_t)removeIt->GetTxSize());
-            CAmount modifyFee = -removeIt->GetModifiedFee();
-            int modifySigOps = -removeIt->GetSigOpCount();
-            for (txiter dit : setDescendants) {
-                mapTx.modify(dit, update_ancestor_state(modifySize, modifyFee, -1, modifySigOps));
+        for (txiter removeIt : setWithRemainingDescendants) {
+            const EpochGuard epoch(*this);
+            for (txiter childIt : GetMemPoolChildren(removeIt)) {
+                if (needsWalk(childIt, setWithRemainingDescendants)) {
+                    visited(childIt);
+                    vStage.push_back(childIt);
+                }
+            }
+            while (!vStage.empty()) {
+                txiter dit = vStage.back();
+                vStage.pop_back();
+                if (!entriesToRemove.count(dit)) {
+                    StateDelta &delta = mapAncestorDeltas[dit];
+                    delta.nSize -= removeIt->GetTxSize();
+                    delta.nModFee -= removeIt->GetModifiedFee();
+                    delta.nCount--;
+                    delta.nSigOps -= removeIt->GetSigOpCount();
+                }
+                for (txiter childIt : GetMemPoolChildren(dit)) {
+                    if (needsWalk(childIt, setWithRemainingDescendants) && !visited(childIt)) {
+                        vStage.push_back(childIt);
+                    }
+                }
             }
         }
     }
+    const setEntries setWithRemainingAncestors = withRemainingRelatives(false);
     for (txiter removeIt : entriesToRemove) {
-        setEntries setAncestors;
-        const CTxMemPoolEntry &entry = *removeIt;
-        std::string dummy;
-        // Since this is a tx that is already in the mempool, we can call CMPA
-        // with fSearchForParents = false.  If the mempool is in a consistent
-        // state, then using true or false should both be correct, though false
-        // should be a bit faster.
-        // However, if we happen to be in the middle of processing a reorg, then
-        // the mempool can be in an inconsistent state.  In this case, the set
-        // of ancestors reachable via mapLinks will be the same as the set of
-        // ancestors whose packages include this transaction, because when we
-        // add a new transaction to the mempool in addUnchecked(), we assume it
-        // has no children, and in the case of a reorg where that assumption is
-        // false, the in-mempool children aren't linked to the in-block tx's
-        // until UpdateTransactionsFromBlock() is called.
-        // So if we're being called during a reorg, ie before
-        // UpdateTransactionsFromBlock() has been called, then mapLinks[] will
-        // differ from the set of mempool parents we'd calculate by searching,
-        // and it's important that we use the mapLinks[] notion of ancestor
-        // transactions as the set of things to update for removal.
-        CalculateMemPoolAncestors(entry, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
-        // Note that UpdateAncestorsOf severs the child links that point to
-        // removeIt in the entries for the parents of removeIt.
-        UpdateAncestorsOf(false, removeIt, setAncestors);
+        // For each entry, walk back all ancestors and decrement size associated
+        // with this transaction.
+        // The ancestors are walked through mapLinks rather than by searching
+        // the inputs of each transaction. If the mempool is in a consistent
+        // state, both give the same result. However, if we happen to be in the
+        // middle of processing a reorg, then the mempool can be in an
+        // inconsistent state: when we add a new transaction to the mempool in
+        // addUnchecked(), we assume it has no children, and in the case of a
+        // reorg where that assumption is false, the in-mempool children aren't
+        // linked to the in-block tx's until UpdateTransactionsFromBlock() is
+        // called. It's important that we use the mapLinks[] notion of ancestor
+        // transactions as the set of things to update for removal, as these
+        // are the ancestors whose packages include this transaction.
+        const EpochGuard epoch(*this);
+        const bool fWalk = setWithRemainingAncestors.count(removeIt);
+        for (txiter parentIt : GetMemPoolParents(removeIt)) {
+            if (fWalk && needsWalk(parentIt, setWithRemainingAncestors)) {
+                visited(parentIt);
+                vStage.push_back(parentIt);
+            }
+            // Sever the child link that points to removeIt in the parent
+            UpdateChild(parentIt, removeIt, false);
+        }
+        while (!vStage.empty()) {
+            txiter ait = vStage.back();
+            vStage.pop_back();
+            if (!entriesToRemove.count(ait)) {
+                StateDelta &delta = mapDescendantDeltas[ait];
+                delta.nSize -= removeIt->GetTxSize();
+                delta.nModFee -= removeIt->GetModifiedFee();
+                delta.nCount--;
+            }
+            for (txiter parentIt : GetMemPoolParents(ait)) {
+                if (needsWalk(parentIt, setWithRemainingAncestors) && !visited(parentIt)) {
+                    vStage.push_back(parentIt);
+                }
+            }
+        }
+    }
+    for (const auto& delta : mapAncestorDeltas) {
+        mapTx.modify(delta.first, update_ancestor_state(delta.second.nSize, delta.second.nModFee, delta.second.nCount, delta.second.nSigOps));
+    }
+    for (const auto& delta : mapDescendantDeltas) {
+        mapTx.modify(delta.first, update_descendant_state(delta.second.nSize, delta.second.nModFee, delta.second.nCount));
     }
     // After updating all the ancestor sizes, we can now sever the link between each
     // transaction being removed and any mempool children (ie, update setMemPoolParents
@@ -330,7 +467,7 @@ void CTxMemPoolEntry::UpdateAncestorState(int64_t modifySize, CAmount modifyFee,
 }
 
 CTxMemPool::CTxMemPool(CBlockPolicyEstimator* estimator) :
-    nTransactionsUpdated(0), minerPolicyEstimator(estimator)
+    nTransactionsUpdated(0), minerPolicyEstimator(estimator), nEpoch(0), fHasEpochGuard(false)
 {
     _clear(); //lock free clear
 
@@ -407,6 +544,16 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     UpdateAncestorsOf(true, newit, setAncestors);
     UpdateEntryForAncestors(newit, setAncestors);
 
+    // Start a cluster of its own and join the clusters of the parents
+    newit->cluster = std::make_shared<CTxMemPoolCluster>();
+    newit->cluster->nTxCount = 1;
+    newit->cluster->nTxSize = newit->GetTxSize();
+    newit->cluster->nModFees = newit->GetModifiedFee();
+    nClusters++;
+    for (txiter pit : GetMemPoolParents(newit)) {
+        MergeClusters(newit, pit);
+    }
+
     nTransactionsUpdated++;
     totalTxSize += entry.GetTxSize();
     if (minerPolicyEstimator) {minerPolicyEstimator->processTransaction(entry, validFeeEstimate);}
@@ -700,22 +847,21 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 // can save time by not iterating over those entries.
 void CTxMemPool::CalculateDescendants(txiter entryit, setEntries &setDescendants)
 {
-    setEntries stage;
-    if (setDescendants.count(entryit) == 0) {
-        stage.insert(entryit);
+    std::vector<txiter> vStage;
+    if (setDescendants.insert(entryit).second) {
+        vStage.push_back(entryit);
     }
     // Traverse down the children of entry, only adding children that are not
     // accounted for in setDescendants already (because those children have either
     // already been walked, or will be walked in this iteration).
-    while (!stage.empty()) {
-        txiter it = *stage.begin();
-        setDescendants.insert(it);
-        stage.erase(it);
+    while (!vStage.empty()) {
+        txiter it = vStage.back();
+        vStage.pop_back();
 
         const setEntries &setChildren = GetMemPoolChildren(it);
         for (const txiter &childiter : setChildren) {
-            if (!setDescendants.count(childiter)) {
-                stage.insert(childiter);
+            if (setDescendants.insert(childiter).second) {
+                vStage.push_back(childiter);
             }
         }
     }
@@ -963,14 +1109,20 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
     }
     // Before the txs in the new block have been removed from the mempool, update policy estimates
     if (minerPolicyEstimator) {minerPolicyEstimator->processBlock(nBlockHeight, entries);}
+    // Remove all transactions of the block at once, so that in-mempool
+    // descendants of a chain in the block are updated once instead of once
+    // per confirmed ancestor.
+    setEntries stage;
     for (const auto& tx : vtx)
     {
         txiter it = mapTx.find(tx->GetHash());
         if (it != mapTx.end()) {
-            setEntries stage;
             stage.insert(it);
-            RemoveStaged(stage, true, MemPoolRemovalReason::BLOCK);
         }
+    }
+    RemoveStaged(stage, true, MemPoolRemovalReason::BLOCK);
+    for (const auto& tx : vtx)
+    {
         removeConflicts(*tx);
         removeProTxConflicts(*tx);
         ClearPrioritisation(tx->GetHash());
@@ -988,6 +1140,7 @@ void CTxMemPool::_clear()
     mapProTxPubKeyIDs.clear();
     totalTxSize = 0;
     cachedInnerUsage = 0;
+    nClusters = 0;
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = false;
     rollingMinimumFeeRate = 0;
@@ -1027,6 +1180,8 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
     const int64_t spendheight = GetSpendHeight(mempoolDuplicate);
 
     std::list<const CTxMemPoolEntry*> waitingOnDependants;
+    std::map<const CTxMemPoolCluster*, CTxMemPoolCluster> mapClusterCheck;
+    std::map<const CTxMemPoolCluster*, txiter> mapClusterMember;
     for (indexed_transaction_set::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
         unsigned int i = 0;
         checkTotal += it->GetTxSize();
@@ -1062,6 +1217,16 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
             i++;
         }
         assert(setParentCheck == GetMemPoolParents(it));
+        // Verify that linked transactions share a cluster, and tally the clusters.
+        assert(it->cluster);
+        for (txiter parentIt : setParentCheck) {
+            assert(parentIt->cluster == it->cluster);
+        }
+        CTxMemPoolCluster &clusterCheck = mapClusterCheck[it->cluster.get()];
+        clusterCheck.nTxCount++;
+        clusterCheck.nTxSize += it->GetTxSize();
+        clusterCheck.nModFees += it->GetModifiedFee();
+        mapClusterMember.emplace(it->cluster.get(), it);
         // Verify ancestor state is correct.
         setEntries setAncestors;
         uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
@@ -1129,6 +1294,26 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
 
     assert(totalTxSize == checkTotal);
     assert(innerUsage == cachedInnerUsage);
+    assert(mapClusterCheck.size() == nClusters);
+    for (const auto& cluster : mapClusterCheck) {
+        assert(cluster.first->nTxCount == cluster.second.nTxCount);
+        assert(cluster.first->nTxSize == cluster.second.nTxSize);
+        assert(cluster.first->nModFees == cluster.second.nModFees);
+        // A cluster must be connected, i.e. not have been left unsplit by a removal
+        setEntries setConnected;
+        std::vector<txiter> vStage{mapClusterMember.at(cluster.first)};
+        setConnected.insert(vStage.back());
+        while (!vStage.empty()) {
+            txiter memberIt = vStage.back();
+            vStage.pop_back();
+            for (const setEntries* relatives : {&GetMemPoolParents(memberIt), &GetMemPoolChildren(memberIt)}) {
+                for (txiter relative : *relatives) {
+                    if (setConnected.insert(relative).second) vStage.push_back(relative);
+                }
+            }
+        }
+        assert(setConnected.size() == cluster.second.nTxCount);
+    }
 }
 
 bool CTxMemPool::CompareDepthAndScore(const uint256& hasha, const uint256& hashb)
@@ -1322,6 +1507,7 @@ void CTxMemPool::PrioritiseTransaction(const uint256& hash, const CAmount& nFeeD
         txiter it = mapTx.find(hash);
         if (it != mapTx.end()) {
             mapTx.modify(it, update_fee_delta(delta));
+            it->cluster->nModFees += nFeeDelta;
             // Now update all ancestors' modified fees with descendants
             setEntries setAncestors;
             uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
@@ -1388,15 +1574,30 @@ bool CCoinsViewMemPool::GetCoin(const COutPoint &outpoint, Coin &coin) const {
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
     // Estimate the overhead of mapTx to be 12 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage +
+           nClusters * (memusage::MallocUsage(sizeof(CTxMemPoolCluster)) + memusage::MallocUsage(sizeof(memusage::stl_shared_counter)));
 }
 
 void CTxMemPool::RemoveStaged(setEntries &stage, bool updateDescendants, MemPoolRemovalReason reason) {
     AssertLockHeld(cs);
+    // Remember the remaining transactions linked to removed ones, the clusters
+    // of the removed transactions are rebuilt from them afterwards.
+    std::vector<txiter> vNeighbors;
+    std::set<std::shared_ptr<CTxMemPoolCluster>> setOldClusters;
+    for (const txiter& it : stage) {
+        setOldClusters.insert(it->cluster);
+        for (const txiter& parentIt : GetMemPoolParents(it)) {
+            if (!stage.count(parentIt)) vNeighbors.push_back(parentIt);
+        }
+        for (const txiter& childIt : GetMemPoolChildren(it)) {
+            if (!stage.count(childIt)) vNeighbors.push_back(childIt);
+        }
+    }
     UpdateForRemoveFromMempool(stage, updateDescendants);
     for (const txiter& it : stage) {
         removeUnchecked(it, reason);
     }
+    UpdateClustersForRemoval(vNeighbors, setOldClusters);
 }
 
 int CTxMemPool::Expire(int64_t time) {
@@ -1450,6 +1651,57 @@ void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add)
     }
 }
 
+void CTxMemPool::MergeClusters(txiter entry, txiter other)
+{
+    if (entry->cluster == other->cluster) {
+        return;
+    }
+    if (entry->cluster->nTxCount > other->cluster->nTxCount) {
+        std::swap(entry, other);
+    }
+    RelabelCluster(entry, other->cluster);
+    nClusters--;
+}
+
+void CTxMemPool::RelabelCluster(txiter entry, const std::shared_ptr<CTxMemPoolCluster>& cluster)
+{
+    // The old label marks the entries that have not been visited yet
+    const std::shared_ptr<CTxMemPoolCluster> old = entry->cluster;
+    std::vector<txiter> vStage{entry};
+    entry->cluster = cluster;
+    while (!vStage.empty()) {
+        txiter it = vStage.back();
+        vStage.pop_back();
+        cluster->nTxCount++;
+        cluster->nTxSize += it->GetTxSize();
+        cluster->nModFees += it->GetModifiedFee();
+        const TxLinks &links = mapLinks[it];
+        for (const setEntries* relatives : {&links.parents, &links.children}) {
+            for (txiter relative : *relatives) {
+                if (relative->cluster == old) {
+                    relative->cluster = cluster;
+                    vStage.push_back(relative);
+                }
+            }
+        }
+    }
+}
+
+void CTxMemPool::UpdateClustersForRemoval(const std::vector<txiter>& vNeighbors, const std::set<std::shared_ptr<CTxMemPoolCluster>>& setOldClusters)
+{
+    // Every remaining transaction of an old cluster is connected to one of the
+    // neighbors, so relabeling their components replaces all old clusters.
+    // setOldClusters keeps them alive until then, so a new cluster can not
+    // reuse the address of an old one.
+    nClusters -= setOldClusters.size();
+    for (txiter it : vNeighbors) {
+        if (setOldClusters.count(it->cluster)) {
+            RelabelCluster(it, std::make_shared<CTxMemPoolCluster>());
+            nClusters++;
+        }
+    }
+}
+
 const CTxMemPool::setEntries & CTxMemPool::GetMemPoolParents(txiter entry) const
 {
     assert (entry != mapTx.end());
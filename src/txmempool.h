@@ -54,6 +54,21 @@ struct LockPoints
 
 class CTxMemPool;
 
+/** A connected component of the mempool's dependency graph, i.e. the set of
+ *  transactions that are linked to each other by in-mempool parent/child
+ *  relations, together with its aggregate size and modified fees.
+ *
+ *  Every ancestor and descendant of a transaction is part of its cluster, so
+ *  the cluster size bounds the work of any package walk. Clusters are merged
+ *  when a transaction links them and recomputed when transactions are removed.
+ */
+struct CTxMemPoolCluster
+{
+    uint64_t nTxCount{0};
+    uint64_t nTxSize{0};
+    CAmount nModFees{0};
+};
+
 /** \class CTxMemPoolEntry
  *
  * CTxMemPoolEntry stores data about the corresponding transaction, as well
@@ -131,7 +146,14 @@ public:
     CAmount GetModFeesWithAncestors() const { return nModFeesWithAncestors; }
     unsigned int GetSigOpCountWithAncestors() const { return nSigOpCountWithAncestors; }
 
+    // Statistics of the cluster, only valid for entries in the mempool
+    uint64_t GetCountWithCluster() const { return cluster->nTxCount; }
+    uint64_t GetSizeWithCluster() const { return cluster->nTxSize; }
+    CAmount GetModFeesWithCluster() const { return cluster->nModFees; }
+
     mutable size_t vTxHashesIdx; //!< Index in mempool's vTxHashes
+    mutable std::shared_ptr<CTxMemPoolCluster> cluster; //!< Cluster this entry belongs to
+    mutable uint64_t nEpoch{0}; //!< Last package walk of the mempool that visited this entry
 
     // If this is a proTx, this will be the hash of the key for which this ProTx was valid
     mutable uint256 validForProTxKey;
@@ -442,6 +464,14 @@ public:
  * CalculateMemPoolAncestors() takes configurable limits that are designed to
  * prevent these calculations from being too CPU intensive.
  *
+ * The ancestor and descendant limits do not bound how many transactions are
+ * connected to each other, so each entry also tracks its cluster (see
+ * CTxMemPoolCluster), which CheckClusterLimit() bounds. All package walks stay
+ * within one cluster, and RemoveStaged() splits the clusters that a removal
+ * disconnected. When a set of transactions is removed, the state changes
+ * are summed up per remaining ancestor or descendant and applied once, so that
+ * removing a chain of n transactions does not modify O(n^2) entries.
+ *
  */
 class CTxMemPool
 {
@@ -452,6 +482,10 @@ private:
 
     uint64_t totalTxSize;      //!< sum of all mempool tx' byte sizes
     uint64_t cachedInnerUsage; //!< sum of dynamic memory usage of all the map elements (NOT the maps themselves)
+    uint64_t nClusters;        //!< number of clusters the mempool transactions form
+
+    mutable uint64_t nEpoch;       //!< Current package walk, see EpochGuard
+    mutable bool fHasEpochGuard;
 
     mutable int64_t lastRollingFeeUpdate;
     mutable bool blockSinceLastRollingFeeBump;
@@ -505,7 +539,29 @@ public:
     const setEntries & GetMemPoolParents(txiter entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
     const setEntries & GetMemPoolChildren(txiter entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 private:
-    typedef std::map<txiter, setEntries, CompareIteratorByHash> cacheMap;
+    typedef std::map<txiter, std::vector<txiter>, CompareIteratorByHash> cacheMap;
+
+    /** Accumulated change of the ancestor or descendant state of one entry */
+    struct StateDelta {
+        int64_t nSize{0};
+        CAmount nModFee{0};
+        int64_t nCount{0};
+        int64_t nSigOps{0};
+    };
+    typedef std::map<txiter, StateDelta, CompareIteratorByHash> stateDeltaMap;
+
+    /** Starts a new package walk. Entries are marked as visited by stamping
+     *  them with the epoch of the walk, which saves the std::set lookups and
+     *  allocations of a staging set. Walks cannot be nested.
+     */
+    class EpochGuard {
+        const CTxMemPool& pool;
+    public:
+        explicit EpochGuard(const CTxMemPool& in);
+        ~EpochGuard();
+    };
+    /** Returns whether the current walk visited the entry before and marks it as visited */
+    bool visited(txiter it) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     struct TxLinks {
         setEntries parents;
@@ -536,6 +592,16 @@ private:
     void UpdateParent(txiter entry, txiter parent, bool add);
     void UpdateChild(txiter entry, txiter child, bool add);
 
+    /** Move the cluster of entry, which is linked to other's cluster, into the other cluster.
+     *  The smaller cluster is relabeled, so merging is O(size of the smaller cluster). */
+    void MergeClusters(txiter entry, txiter other) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Move all entries that are connected to entry and share its cluster into cluster */
+    void RelabelCluster(txiter entry, const std::shared_ptr<CTxMemPoolCluster>& cluster) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Split the clusters that lost transactions into their remaining connected
+     *  components. vNeighbors are the remaining transactions that were linked to
+     *  removed ones, setOldClusters the clusters the removed transactions were in. */
+    void UpdateClustersForRemoval(const std::vector<txiter>& vNeighbors, const std::set<std::shared_ptr<CTxMemPoolCluster>>& setOldClusters) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
     std::vector<indexed_transaction_set::const_iterator> GetSortedDepthAndScore() const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
 public:
@@ -641,6 +707,13 @@ public:
      *  already in it.  */
     void CalculateDescendants(txiter it, setEntries &setDescendants) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    /** Check that a transaction with the in-mempool ancestors setAncestors (as
+     *  calculated by CalculateMemPoolAncestors) would not join the clusters of
+     *  its parents into a cluster of more than limitClusterCount transactions.
+     *  errString = populated with error reason if the limit is hit
+     */
+    bool CheckClusterLimit(const setEntries &setAncestors, uint64_t limitClusterCount, std::string &errString) const;
+
     /** The minimum fee to get into the mempool, which may itself not be enough
       *  for larger-sized transactions.
       *  The incrementalRelayFee policy variable is used to bound the time it
@@ -703,10 +776,14 @@ private:
      *  cachedDescendants will be updated with the descendants of the transaction
      *  being updated, so that future invocations don't need to walk the
      *  same transaction again, if encountered in another transaction chain.
+     *
+     *  The ancestor state changes of the descendants are added to
+     *  ancestorDeltas, so that each descendant is modified only once.
      */
     void UpdateForDescendants(txiter updateIt,
             cacheMap &cachedDescendants,
-            const std::set<uint256> &setExclude) EXCLUSIVE_LOCKS_REQUIRED(cs);
+            const std::set<uint256> &setExclude,
+            stateDeltaMap &ancestorDeltas) EXCLUSIVE_LOCKS_REQUIRED(cs);
     /** Update ancestors of hash to add/remove it as a descendant transaction. */
     void UpdateAncestorsOf(bool add, txiter hash, setEntries &setAncestors) EXCLUSIVE_LOCKS_REQUIRED(cs);
     /** Set ancestor state for an entry */
@@ -0,0 +1,60 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTXOSNAPSHOT_H
+#define BITCOIN_UTXOSNAPSHOT_H
+
+#include <serialize.h>
+#include <uint256.h>
+
+#include <ios>
+#include <string.h>
+
+/**
+ * Header of a UTXO snapshot file as written by dumptxoutset.
+ *
+ * The header is followed by nCoins (COutPoint, Coin) pairs and nEvoEntries
+ * raw (key, value) pairs of the evo database at the same block. The snapshot
+ * hash commits to the base block hash and all entries, but not to the counts,
+ * so the header can be rewritten once the entries are streamed out.
+ */
+class SnapshotMetadata
+{
+public:
+    static const uint16_t CURRENT_VERSION = 1;
+
+    uint256 hashBaseBlock;
+    int nBaseHeight{0};
+    uint64_t nCoins{0};
+    uint64_t nEvoEntries{0};
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        static const unsigned char SNAPSHOT_MAGIC[5] = {'u', 't', 'x', 'o', 0xff};
+        unsigned char magic[sizeof(SNAPSHOT_MAGIC)];
+        uint16_t nVersion = CURRENT_VERSION;
+        if (!ser_action.ForRead()) {
+            memcpy(magic, SNAPSHOT_MAGIC, sizeof(magic));
+        }
+        READWRITE(FLATDATA(magic));
+        READWRITE(nVersion);
+        if (ser_action.ForRead()) {
+            if (memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0) {
+                throw std::ios_base::failure("Invalid UTXO snapshot magic bytes");
+            }
+            if (nVersion != CURRENT_VERSION) {
+                throw std::ios_base::failure("Unsupported UTXO snapshot version");
+            }
+        }
+        READWRITE(hashBaseBlock);
+        READWRITE(nBaseHeight);
+        READWRITE(nCoins);
+        READWRITE(nEvoEntries);
+    }
+};
+
+#endif // BITCOIN_UTXOSNAPSHOT_H
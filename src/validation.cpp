@@ -16,15 +16,21 @@
 #include <consensus/merkle.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <ctpl.h>
 #include <cuckoocache.h>
 #include <hash.h>
+#include <index/addressindex.h>
+#include <index/spentindex.h>
+#include <index/timestampindex.h>
 #include <init.h>
+#include <mappedfile.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <pow.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <reverse_iterator.h>
+#include <saltedhasher.h>
 #include <script/script.h>
 #include <script/sigcache.h>
 #include <script/standard.h>
@@ -34,11 +40,14 @@
 #include <txmempool.h>
 #include <ui_interface.h>
 #include <undo.h>
+#include <unordered_lru_cache.h>
 #include <util.h>
+#include <utxosnapshot.h>
 #include <spork.h>
 #include <utilmoneystr.h>
 #include <utilstrencodings.h>
 #include <validationinterface.h>
+#include <validationstats.h>
 #include <warnings.h>
 
 #include <masternode/masternode-payments.h>
@@ -46,6 +55,7 @@
 #include <evo/specialtx.h>
 #include <evo/providertx.h>
 #include <evo/deterministicmns.h>
+#include <evo/evodb.h>
 #include <evo/cbtx.h>
 
 #include <llmq/quorums_instantsend.h>
@@ -53,6 +63,7 @@
 
 #include <future>
 #include <sstream>
+#include <unordered_set>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
@@ -189,6 +200,7 @@ public:
     bool RewindBlockIndex(const CChainParams& params);
     bool LoadGenesisBlock(const CChainParams& chainparams);
     bool AddGenesisBlock(const CChainParams& chainparams, const CBlock& block, CValidationState& state);
+    bool ActivateSnapshot(CAutoFile& file, const SnapshotMetadata& metadata, const SnapshotData& snapshotData, const CChainParams& chainparams, std::string& strError) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     void PruneBlockIndexCandidates();
 
@@ -213,7 +225,7 @@ private:
     void ReceivedBlockTransactions(const CBlock& block, CBlockIndex* pindexNew, const CDiskBlockPos& pos) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
 
-    bool RollforwardBlock(const CBlockIndex* pindex, CCoinsViewCache& inputs, const CChainParams& params) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    bool RollforwardBlock(const CBlockIndex* pindex, CCoinsViewCache& inputs, const CChainParams& params, bool fSpecialTxs) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 } g_chainstate;
 
 
@@ -235,6 +247,7 @@ bool fAddressIndex = false;
 bool fTimestampIndex = false;
 bool fSpentIndex = false;
 bool fHavePruned = false;
+bool fLoadedSnapshot = false;
 bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
@@ -307,6 +320,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 
 std::unique_ptr<CCoinsViewDB> pcoinsdbview;
 std::unique_ptr<CCoinsViewCache> pcoinsTip;
+std::unique_ptr<CCoinsViewPrefetch> pcoinsPrefetch;
 std::unique_ptr<CBlockTreeDB> pblocktree;
 
 enum class FlushStateMode {
@@ -321,6 +335,8 @@ static bool FlushStateToDisk(const CChainParams& chainParams, CValidationState &
 static void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPruneHeight);
 static void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight);
 bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks = nullptr);
+static bool CheckInputScripts(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, unsigned int flags, bool cacheSigStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks);
+static void CacheScriptExecution(const CTransaction& tx, unsigned int flags);
 static FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 
 bool CheckFinalTx(const CTransaction &tx, int flags)
@@ -626,14 +642,38 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationSt
     return CheckInputs(tx, state, view, true, flags, cacheSigStore, true, txdata);
 }
 
-static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx,
-                                     bool* pfMissingInputs, int64_t nAcceptTime, bool bypass_limits,
-                                     const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache, bool fDryRun)
+namespace {
+
+/** The state of a transaction's admission that is carried from its checks to its insertion */
+struct MemPoolAcceptWorkspace
+{
+    explicit MemPoolAcceptWorkspace(const CTransactionRef& ptxIn) : ptx(ptxIn), view(&dummy), txdata(*ptxIn) {}
+
+    const CTransactionRef ptx;
+    //! Holds the coins spent by ptx, detached from the chainstate and the mempool
+    CCoinsView dummy;
+    CCoinsViewCache view;
+    std::unique_ptr<CTxMemPoolEntry> entry;
+    CTxMemPool::setEntries setAncestors;
+    CAmount nFees{0};
+    PrecomputedTransactionData txdata;
+};
+
+} // namespace
+
+/**
+ * Run all checks of a new mempool transaction that do not verify scripts, and
+ * fetch its inputs into ws.view.
+ */
+static bool PreChecks(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, MemPoolAcceptWorkspace& ws,
+                      bool* pfMissingInputs, int64_t nAcceptTime, bool bypass_limits,
+                      const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache) EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs)
 {
+    const CTransactionRef& ptx = ws.ptx;
     const CTransaction& tx = *ptx;
     const uint256 hash = tx.GetHash();
     AssertLockHeld(cs_main);
-    LOCK(pool.cs); // mempool "read lock" (held through GetMainSignals().TransactionAddedToMempool())
+    AssertLockHeld(pool.cs);
     if (pfMissingInputs) {
         *pfMissingInputs = false;
     }
@@ -687,192 +727,274 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         auto itConflicting = pool.mapNextTx.find(txin.prevout);
         if (itConflicting != pool.mapNextTx.end())
         {
-            const CTransaction *ptxConflicting = itConflicting->second;
-
             // Transaction conflicts with mempool and RBF doesn't exist in Pigeon
             return state.Invalid(false, REJECT_DUPLICATE, "txn-mempool-conflict");
         }
     }
 
-    {
-        CCoinsView dummy;
-        CCoinsViewCache view(&dummy);
+    CCoinsViewCache& view = ws.view;
 
-        LockPoints lp;
-        CCoinsViewMemPool viewMemPool(pcoinsTip.get(), pool);
-        view.SetBackend(viewMemPool);
+    LockPoints lp;
+    CCoinsViewMemPool viewMemPool(pcoinsTip.get(), pool);
+    view.SetBackend(viewMemPool);
 
-        // do all inputs exist?
-        for (const CTxIn& txin : tx.vin) {
-            if (!pcoinsTip->HaveCoinInCache(txin.prevout)) {
-                coins_to_uncache.push_back(txin.prevout);
-            }
-            if (!view.HaveCoin(txin.prevout)) {
-                // Are inputs missing because we already have the tx?
-                for (size_t out = 0; out < tx.vout.size(); out++) {
-                    // Optimistically just do efficient check of cache for outputs
-                    if (pcoinsTip->HaveCoinInCache(COutPoint(hash, out))) {
-                        return state.Invalid(false, REJECT_DUPLICATE, "txn-already-known");
-                    }
-                }
-                // Otherwise assume this might be an orphan tx for which we just haven't seen parents yet
-                if (pfMissingInputs) {
-                    *pfMissingInputs = true;
+    // do all inputs exist?
+    for (const CTxIn& txin : tx.vin) {
+        if (!pcoinsTip->HaveCoinInCache(txin.prevout)) {
+            coins_to_uncache.push_back(txin.prevout);
+        }
+        if (!view.HaveCoin(txin.prevout)) {
+            // Are inputs missing because we already have the tx?
+            for (size_t out = 0; out < tx.vout.size(); out++) {
+                // Optimistically just do efficient check of cache for outputs
+                if (pcoinsTip->HaveCoinInCache(COutPoint(hash, out))) {
+                    return state.Invalid(false, REJECT_DUPLICATE, "txn-already-known");
                 }
-                return false; // fMissingInputs and !state.IsInvalid() is used to detect this condition, don't set state.Invalid()
             }
+            // Otherwise assume this might be an orphan tx for which we just haven't seen parents yet
+            if (pfMissingInputs) {
+                *pfMissingInputs = true;
+            }
+            return false; // fMissingInputs and !state.IsInvalid() is used to detect this condition, don't set state.Invalid()
         }
+    }
 
-        // Bring the best block into scope
-        view.GetBestBlock();
+    // Bring the best block into scope
+    view.GetBestBlock();
 
-        // we have all inputs cached now, so switch back to dummy, so we don't need to keep lock on mempool
-        view.SetBackend(dummy);
+    // we have all inputs cached now, so switch back to dummy, so we don't need to keep lock on mempool
+    view.SetBackend(ws.dummy);
 
-        // Only accept BIP68 sequence locked transactions that can be mined in the next
-        // block; we don't want our mempool filled up with transactions that can't
-        // be mined yet.
-        // Must keep pool.cs for this unless we change CheckSequenceLocks to take a
-        // CoinsViewCache instead of create its own
-        if (!CheckSequenceLocks(tx, STANDARD_LOCKTIME_VERIFY_FLAGS, &lp))
-            return state.DoS(0, false, REJECT_NONSTANDARD, "non-BIP68-final");
+    // Only accept BIP68 sequence locked transactions that can be mined in the next
+    // block; we don't want our mempool filled up with transactions that can't
+    // be mined yet.
+    // Must keep pool.cs for this unless we change CheckSequenceLocks to take a
+    // CoinsViewCache instead of create its own
+    if (!CheckSequenceLocks(tx, STANDARD_LOCKTIME_VERIFY_FLAGS, &lp))
+        return state.DoS(0, false, REJECT_NONSTANDARD, "non-BIP68-final");
 
-        CAmount nFees = 0;
-        if (!Consensus::CheckTxInputs(tx, state, view, GetSpendHeight(view), nFees)) {
-            return error("%s: Consensus::CheckTxInputs: %s, %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
-        }
+    CAmount& nFees = ws.nFees;
+    if (!Consensus::CheckTxInputs(tx, state, view, GetSpendHeight(view), nFees)) {
+        return error("%s: Consensus::CheckTxInputs: %s, %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
+    }
 
-        // Check for non-standard pay-to-script-hash in inputs
-        if (fRequireStandard && !AreInputsStandard(tx, view))
-            return state.Invalid(false, REJECT_NONSTANDARD, "bad-txns-nonstandard-inputs");
+    // Check for non-standard pay-to-script-hash in inputs
+    if (fRequireStandard && !AreInputsStandard(tx, view))
+        return state.Invalid(false, REJECT_NONSTANDARD, "bad-txns-nonstandard-inputs");
 
-        unsigned int nSigOps = GetTransactionSigOpCount(tx, view, STANDARD_SCRIPT_VERIFY_FLAGS);
+    unsigned int nSigOps = GetTransactionSigOpCount(tx, view, STANDARD_SCRIPT_VERIFY_FLAGS);
 
-        // nModifiedFees includes any fee deltas from PrioritiseTransaction
-        CAmount nModifiedFees = nFees;
-        pool.ApplyDelta(hash, nModifiedFees);
+    // nModifiedFees includes any fee deltas from PrioritiseTransaction
+    CAmount nModifiedFees = nFees;
+    pool.ApplyDelta(hash, nModifiedFees);
 
-        // Keep track of transactions that spend a coinbase, which we re-scan
-        // during reorgs to ensure COINBASE_MATURITY is still met.
-        bool fSpendsCoinbase = false;
-        for (const CTxIn &txin : tx.vin) {
-            const Coin &coin = view.AccessCoin(txin.prevout);
-            if (coin.IsCoinBase()) {
-                fSpendsCoinbase = true;
-                break;
-            }
+    // Keep track of transactions that spend a coinbase, which we re-scan
+    // during reorgs to ensure COINBASE_MATURITY is still met.
+    bool fSpendsCoinbase = false;
+    for (const CTxIn &txin : tx.vin) {
+        const Coin &coin = view.AccessCoin(txin.prevout);
+        if (coin.IsCoinBase()) {
+            fSpendsCoinbase = true;
+            break;
         }
+    }
 
-        CTxMemPoolEntry entry(ptx, nFees, nAcceptTime, chainActive.Height(),
-                              fSpendsCoinbase, nSigOps, lp);
-        unsigned int nSize = entry.GetTxSize();
+    ws.entry.reset(new CTxMemPoolEntry(ptx, nFees, nAcceptTime, chainActive.Height(),
+                                       fSpendsCoinbase, nSigOps, lp));
+    const CTxMemPoolEntry& entry = *ws.entry;
+    unsigned int nSize = entry.GetTxSize();
 
-        // Check that the transaction doesn't have an excessive number of
-        // sigops, making it impossible to mine. Since the coinbase transaction
-        // itself can contain sigops MAX_STANDARD_TX_SIGOPS is less than
-        // MAX_BLOCK_SIGOPS; we still consider this an invalid rather than
-        // merely non-standard transaction.
-        if ((nSigOps > MAX_STANDARD_TX_SIGOPS) || (nBytesPerSigOp && nSigOps > nSize / nBytesPerSigOp))
-            return state.DoS(0, false, REJECT_NONSTANDARD, "bad-txns-too-many-sigops", false,
-                strprintf("%d", nSigOps));
+    // Check that the transaction doesn't have an excessive number of
+    // sigops, making it impossible to mine. Since the coinbase transaction
+    // itself can contain sigops MAX_STANDARD_TX_SIGOPS is less than
+    // MAX_BLOCK_SIGOPS; we still consider this an invalid rather than
+    // merely non-standard transaction.
+    if ((nSigOps > MAX_STANDARD_TX_SIGOPS) || (nBytesPerSigOp && nSigOps > nSize / nBytesPerSigOp))
+        return state.DoS(0, false, REJECT_NONSTANDARD, "bad-txns-too-many-sigops", false,
+            strprintf("%d", nSigOps));
 
-        CAmount mempoolRejectFee = pool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
-        if (!bypass_limits && mempoolRejectFee > 0 && nModifiedFees < mempoolRejectFee) {
-            return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool min fee not met", false, strprintf("%d < %d", nModifiedFees, mempoolRejectFee));
-        }
+    CAmount mempoolRejectFee = pool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
+    if (!bypass_limits && mempoolRejectFee > 0 && nModifiedFees < mempoolRejectFee) {
+        return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool min fee not met", false, strprintf("%d < %d", nModifiedFees, mempoolRejectFee));
+    }
 
-        // No transactions are allowed below minRelayTxFee except from disconnected blocks
-        if (!bypass_limits && nModifiedFees < ::minRelayTxFee.GetFee(nSize)) {
-            return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "min relay fee not met");
-        }
+    // No transactions are allowed below minRelayTxFee except from disconnected blocks
+    if (!bypass_limits && nModifiedFees < ::minRelayTxFee.GetFee(nSize)) {
+        return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "min relay fee not met");
+    }
 
-        if (nAbsurdFee && nFees > nAbsurdFee)
-            return state.Invalid(false,
-                REJECT_HIGHFEE, "absurdly-high-fee",
-                strprintf("%d > %d", nFees, nAbsurdFee));
+    if (nAbsurdFee && nFees > nAbsurdFee)
+        return state.Invalid(false,
+            REJECT_HIGHFEE, "absurdly-high-fee",
+            strprintf("%d > %d", nFees, nAbsurdFee));
 
-        // Calculate in-mempool ancestors, up to a limit.
-        CTxMemPool::setEntries setAncestors;
-        size_t nLimitAncestors = gArgs.GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT);
-        size_t nLimitAncestorSize = gArgs.GetArg("-limitancestorsize", DEFAULT_ANCESTOR_SIZE_LIMIT)*1000;
-        size_t nLimitDescendants = gArgs.GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT);
-        size_t nLimitDescendantSize = gArgs.GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT)*1000;
-        std::string errString;
-        if (!pool.CalculateMemPoolAncestors(entry, setAncestors, nLimitAncestors, nLimitAncestorSize, nLimitDescendants, nLimitDescendantSize, errString)) {
-            return state.DoS(0, false, REJECT_NONSTANDARD, "too-long-mempool-chain", false, errString);
-        }
+    // Calculate in-mempool ancestors, up to a limit.
+    size_t nLimitAncestors = gArgs.GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT);
+    size_t nLimitAncestorSize = gArgs.GetArg("-limitancestorsize", DEFAULT_ANCESTOR_SIZE_LIMIT)*1000;
+    size_t nLimitDescendants = gArgs.GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT);
+    size_t nLimitDescendantSize = gArgs.GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT)*1000;
+    std::string errString;
+    if (!pool.CalculateMemPoolAncestors(entry, ws.setAncestors, nLimitAncestors, nLimitAncestorSize, nLimitDescendants, nLimitDescendantSize, errString)) {
+        return state.DoS(0, false, REJECT_NONSTANDARD, "too-long-mempool-chain", false, errString);
+    }
+    size_t nLimitCluster = gArgs.GetArg("-limitclustercount", DEFAULT_CLUSTER_LIMIT);
+    if (!pool.CheckClusterLimit(ws.setAncestors, nLimitCluster, errString)) {
+        return state.DoS(0, false, REJECT_NONSTANDARD, "too-long-mempool-chain", false, errString);
+    }
 
-        // check special TXs after all the other checks. If we'd do this before the other checks, we might end up
-        // DoS scoring a node for non-critical errors, e.g. duplicate keys because a TX is received that was already
-        // mined
-        if (!CheckSpecialTx(tx, chainActive.Tip(), state))
-            return false;
+    // check special TXs after all the other checks. If we'd do this before the other checks, we might end up
+    // DoS scoring a node for non-critical errors, e.g. duplicate keys because a TX is received that was already
+    // mined
+    if (!CheckSpecialTx(tx, chainActive.Tip(), state))
+        return false;
 
-        if (pool.existsProviderTxConflict(tx)) {
-            return state.DoS(0, false, REJECT_DUPLICATE, "protx-dup");
-        }
-
-        // If we aren't going to actually accept it but just were verifying it, we are fine already
-        if(fDryRun) return true;
-
-        constexpr unsigned int scriptVerifyFlags = STANDARD_SCRIPT_VERIFY_FLAGS;
-
-        // Check against previous transactions
-        // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-        PrecomputedTransactionData txdata(tx);
-        if (!CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true, false, txdata))
-            return false; // state filled in by CheckInputs
-
-        // Check again against the current block tip's script verification
-        // flags to cache our script execution flags. This is, of course,
-        // useless if the next block has different script flags from the
-        // previous one, but because the cache tracks script flags for us it
-        // will auto-invalidate and we'll just have a few blocks of extra
-        // misses on soft-fork activation.
-        //
-        // This is also useful in case of bugs in the standard flags that cause
-        // transactions to pass as valid when they're actually invalid. For
-        // instance the STRICTENC flag was incorrectly allowing certain
-        // CHECKSIG NOT scripts to pass, even though they were invalid.
-        //
-        // There is a similar check in CreateNewBlock() to prevent creating
-        // invalid blocks (using TestBlockValidity), however allowing such
-        // transactions into the mempool can be exploited as a DoS attack.
-        unsigned int currentBlockScriptVerifyFlags = GetBlockScriptFlags(chainActive.Tip(), chainparams.GetConsensus());
-        if (!CheckInputsFromMempoolAndCache(tx, state, view, pool, currentBlockScriptVerifyFlags, true, txdata)) {
-            return error("%s: BUG! PLEASE REPORT THIS! CheckInputs failed against latest-block but not STANDARD flags %s, %s",
-                    __func__, hash.ToString(), FormatStateMessage(state));
-        }
+    if (pool.existsProviderTxConflict(tx)) {
+        return state.DoS(0, false, REJECT_DUPLICATE, "protx-dup");
+    }
+
+    return true;
+}
+
+/** Add a transaction that passed PreChecks and script verification to the mempool */
+static bool Finalize(CTxMemPool& pool, CValidationState& state, MemPoolAcceptWorkspace& ws, bool bypass_limits) EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs)
+{
+    const CTransaction& tx = *ws.ptx;
+    const uint256 hash = tx.GetHash();
+    AssertLockHeld(cs_main);
+    AssertLockHeld(pool.cs);
 
-        // This transaction should only count for fee estimation if:
-        // - it's not being re-added during a reorg which bypasses typical mempool fee limits
-        // - the node is not behind
-        // - the transaction is not dependent on any other transactions in the mempool
-        // - the transaction is not a zero fee transaction
-        bool validForFeeEstimation = (nFees !=0) && !bypass_limits && IsCurrentForFeeEstimation() && pool.HasNoInputsOf(tx);
+    // This transaction should only count for fee estimation if:
+    // - it's not being re-added during a reorg which bypasses typical mempool fee limits
+    // - the node is not behind
+    // - the transaction is not dependent on any other transactions in the mempool
+    // - the transaction is not a zero fee transaction
+    bool validForFeeEstimation = (ws.nFees != 0) && !bypass_limits && IsCurrentForFeeEstimation() && pool.HasNoInputsOf(tx);
 
-        // Store transaction in memory
-        pool.addUnchecked(hash, entry, setAncestors, validForFeeEstimation);
+    // Store transaction in memory
+    pool.addUnchecked(hash, *ws.entry, ws.setAncestors, validForFeeEstimation);
 
-        // Add memory address index
-        if (fAddressIndex) {
-            pool.addAddressIndex(entry, view);
-        }
+    // Add memory address index
+    if (fAddressIndex) {
+        pool.addAddressIndex(*ws.entry, ws.view);
+    }
+
+    // Add memory spent index
+    if (fSpentIndex) {
+        pool.addSpentIndex(*ws.entry, ws.view);
+    }
+
+    if (!bypass_limits) {
+        LimitMempoolSize(pool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+        if (!pool.exists(hash))
+            return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
+    }
+    return true;
+}
+
+static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx,
+                                     bool* pfMissingInputs, int64_t nAcceptTime, bool bypass_limits,
+                                     const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache, bool fDryRun)
+{
+    const CTransaction& tx = *ptx;
+    const uint256 hash = tx.GetHash();
+    AssertLockHeld(cs_main);
+    LOCK(pool.cs); // mempool "read lock" (held through GetMainSignals().TransactionAddedToMempool())
+
+    MemPoolAcceptWorkspace ws(ptx);
+    if (!PreChecks(chainparams, pool, state, ws, pfMissingInputs, nAcceptTime, bypass_limits, nAbsurdFee, coins_to_uncache))
+        return false;
 
-        // Add memory spent index
-        if (fSpentIndex) {
-            pool.addSpentIndex(entry, view);
+    // If we aren't going to actually accept it but just were verifying it, we are fine already
+    if(fDryRun) return true;
+
+    // Check against previous transactions
+    // This is done last to help prevent CPU exhaustion denial-of-service attacks.
+    if (!CheckInputs(tx, state, ws.view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true, false, ws.txdata))
+        return false; // state filled in by CheckInputs
+
+    // Check again against the current block tip's script verification
+    // flags to cache our script execution flags. This is, of course,
+    // useless if the next block has different script flags from the
+    // previous one, but because the cache tracks script flags for us it
+    // will auto-invalidate and we'll just have a few blocks of extra
+    // misses on soft-fork activation.
+    //
+    // This is also useful in case of bugs in the standard flags that cause
+    // transactions to pass as valid when they're actually invalid. For
+    // instance the STRICTENC flag was incorrectly allowing certain
+    // CHECKSIG NOT scripts to pass, even though they were invalid.
+    //
+    // There is a similar check in CreateNewBlock() to prevent creating
+    // invalid blocks (using TestBlockValidity), however allowing such
+    // transactions into the mempool can be exploited as a DoS attack.
+    unsigned int currentBlockScriptVerifyFlags = GetBlockScriptFlags(chainActive.Tip(), chainparams.GetConsensus());
+    if (!CheckInputsFromMempoolAndCache(tx, state, ws.view, pool, currentBlockScriptVerifyFlags, true, ws.txdata)) {
+        return error("%s: BUG! PLEASE REPORT THIS! CheckInputs failed against latest-block but not STANDARD flags %s, %s",
+                __func__, hash.ToString(), FormatStateMessage(state));
+    }
+
+    if (!Finalize(pool, state, ws, bypass_limits))
+        return false;
+
+    GetMainSignals().TransactionAddedToMempool(ptx, nAcceptTime);
+
+    return true;
+}
+
+/**
+ * Like AcceptToMemoryPoolWorker, but verifies the scripts without holding cs_main.
+ *
+ * The first PreChecks fetch the inputs into a view of their own, which the scripts are
+ * then verified against. An outpoint commits to the output it spends, so that result
+ * holds whatever happens to the chain or the mempool meanwhile. Everything else may be
+ * stale by then: PreChecks are repeated under the lock that inserts the transaction,
+ * where the script checks are answered from the script execution cache.
+ */
+static bool AcceptToMemoryPoolConcurrentWorker(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx,
+                                               bool* pfMissingInputs, int64_t nAcceptTime, bool bypass_limits,
+                                               const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache)
+{
+    const CTransaction& tx = *ptx;
+    const uint256 hash = tx.GetHash();
+    AssertLockNotHeld(cs_main);
+
+    unsigned int nScriptFlags;
+    {
+        MemPoolAcceptWorkspace ws(ptx);
+        {
+            LOCK2(cs_main, pool.cs);
+            if (!PreChecks(chainparams, pool, state, ws, pfMissingInputs, nAcceptTime, bypass_limits, nAbsurdFee, coins_to_uncache))
+                return false;
+            nScriptFlags = GetBlockScriptFlags(chainActive.Tip(), chainparams.GetConsensus());
         }
 
-        if (!bypass_limits) {
-            LimitMempoolSize(pool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
-            if (!pool.exists(hash))
-                return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
+        if (!CheckInputScripts(tx, state, ws.view, STANDARD_SCRIPT_VERIFY_FLAGS, true, ws.txdata, nullptr))
+            return false;
+        if (!CheckInputScripts(tx, state, ws.view, nScriptFlags, true, ws.txdata, nullptr)) {
+            return error("%s: BUG! PLEASE REPORT THIS! CheckInputs failed against latest-block but not STANDARD flags %s, %s",
+                    __func__, hash.ToString(), FormatStateMessage(state));
         }
     }
 
-    if(!fDryRun)
-        GetMainSignals().TransactionAddedToMempool(ptx, nAcceptTime);
+    LOCK2(cs_main, pool.cs);
+    MemPoolAcceptWorkspace ws(ptx);
+    if (!PreChecks(chainparams, pool, state, ws, pfMissingInputs, nAcceptTime, bypass_limits, nAbsurdFee, coins_to_uncache))
+        return false;
+
+    // A new tip may have changed the script flags, then the scripts are verified once more here
+    unsigned int currentBlockScriptVerifyFlags = GetBlockScriptFlags(chainActive.Tip(), chainparams.GetConsensus());
+    if (currentBlockScriptVerifyFlags == nScriptFlags) {
+        CacheScriptExecution(tx, nScriptFlags);
+    }
+    if (!CheckInputsFromMempoolAndCache(tx, state, ws.view, pool, currentBlockScriptVerifyFlags, true, ws.txdata)) {
+        return error("%s: BUG! PLEASE REPORT THIS! CheckInputs failed against latest-block but not STANDARD flags %s, %s",
+                __func__, hash.ToString(), FormatStateMessage(state));
+    }
+
+    if (!Finalize(pool, state, ws, bypass_limits))
+        return false;
+
+    GetMainSignals().TransactionAddedToMempool(ptx, nAcceptTime);
 
     return true;
 }
@@ -902,11 +1024,33 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, pfMissingInputs, GetTime(), bypass_limits, nAbsurdFee, fDryRun);
 }
 
+bool AcceptToMemoryPoolConcurrent(CTxMemPool& pool, CValidationState &state, const CTransactionRef &tx,
+                                  bool* pfMissingInputs, bool bypass_limits, const CAmount nAbsurdFee)
+{
+    const CChainParams& chainparams = Params();
+    std::vector<COutPoint> coins_to_uncache;
+    bool res = AcceptToMemoryPoolConcurrentWorker(chainparams, pool, state, tx, pfMissingInputs, GetTime(), bypass_limits, nAbsurdFee, coins_to_uncache);
+
+    LOCK(cs_main);
+    if (!res) {
+        LogPrint(BCLog::MEMPOOL, "%s: %s %s (%s)\n", __func__, tx->GetHash().ToString(), state.GetRejectReason(), state.GetDebugMessage());
+        for (const COutPoint& hashTx : coins_to_uncache)
+            pcoinsTip->Uncache(hashTx);
+    }
+    CValidationState stateDummy;
+    FlushStateToDisk(chainparams, stateDummy, FlushStateMode::PERIODIC);
+    return res;
+}
+
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes)
 {
-    if (!fTimestampIndex)
+    if (!g_timestampindex)
         return error("Timestamp index not enabled");
 
+    // Entries of a catching up index end somewhere before the tip
+    if (!g_timestampindex->IsSynced())
+        return error("Timestamp index is still being built");
+
     if (!pblocktree->ReadTimestampIndex(high, low, hashes))
         return error("Unable to get hashes for timestamps");
 
@@ -915,7 +1059,7 @@ bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::v
 
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 {
-    if (!fSpentIndex)
+    if (!g_spentindex || !g_spentindex->IsSynced())
         return false;
 
     if (mempool.getSpentIndex(key, value))
@@ -930,9 +1074,12 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 bool GetAddressIndex(uint160 addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end)
 {
-    if (!fAddressIndex)
+    if (!g_addressindex)
         return error("address index not enabled");
 
+    if (!g_addressindex->IsSynced())
+        return error("address index is still being built");
+
     if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
         return error("unable to get txids for address");
 
@@ -942,9 +1089,12 @@ bool GetAddressIndex(uint160 addressHash, int type,
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
 {
-    if (!fAddressIndex)
+    if (!g_addressindex)
         return error("address index not enabled");
 
+    if (!g_addressindex->IsSynced())
+        return error("address index is still being built");
+
     if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
         return error("unable to get txids for address");
 
@@ -1088,6 +1238,119 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+/** Maximum number of block files that are kept mapped for ReadRawBlockFromDisk */
+static const size_t MAX_MAPPED_BLOCK_FILES = sizeof(void*) > 4 ? 256 : 4;
+
+struct CMappedBlockFile {
+    std::shared_ptr<const CMappedFile> file;
+    uint64_t nLastUsed;
+};
+
+static CCriticalSection cs_mapped_block_files;
+static std::map<int, CMappedBlockFile> mapMappedBlockFiles GUARDED_BY(cs_mapped_block_files);
+static uint64_t nMappedBlockFilesUsed GUARDED_BY(cs_mapped_block_files) = 0;
+
+/** Get a mapping of block file nFile that covers at least its first nMinSize bytes */
+static std::shared_ptr<const CMappedFile> GetMappedBlockFile(int nFile, uint64_t nMinSize)
+{
+    LOCK(cs_mapped_block_files);
+    auto it = mapMappedBlockFiles.find(nFile);
+    if (it == mapMappedBlockFiles.end() || it->second.file->size() < nMinSize) {
+        // Not mapped yet, or the file grew since. Readers of a previous mapping keep it alive.
+        std::shared_ptr<const CMappedFile> file = CMappedFile::Open(GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk"));
+        if (!file || file->size() < nMinSize) {
+            return nullptr;
+        }
+        if (it == mapMappedBlockFiles.end()) {
+            if (mapMappedBlockFiles.size() >= MAX_MAPPED_BLOCK_FILES) {
+                auto itLRU = std::min_element(mapMappedBlockFiles.begin(), mapMappedBlockFiles.end(),
+                    [](const std::pair<const int, CMappedBlockFile>& a, const std::pair<const int, CMappedBlockFile>& b) {
+                        return a.second.nLastUsed < b.second.nLastUsed;
+                    });
+                mapMappedBlockFiles.erase(itLRU);
+            }
+            it = mapMappedBlockFiles.emplace(nFile, CMappedBlockFile()).first;
+        }
+        it->second.file = std::move(file);
+    }
+    it->second.nLastUsed = ++nMappedBlockFilesUsed;
+    return it->second.file;
+}
+
+static void UnmapBlockFile(int nFile)
+{
+    LOCK(cs_mapped_block_files);
+    mapMappedBlockFiles.erase(nFile);
+}
+
+bool ReadRawBlockFromDisk(CRawBlock& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start)
+{
+    // The block is preceded by the network magic and its serialized size, see WriteBlockToDisk
+    static const unsigned int HEADER_SIZE = CMessageHeader::MESSAGE_START_SIZE + sizeof(uint32_t);
+    if (pos.IsNull() || pos.nPos < HEADER_SIZE) {
+        return error("%s: Invalid block position %s", __func__, pos.ToString());
+    }
+    const unsigned int nHeaderPos = pos.nPos - HEADER_SIZE;
+
+    std::shared_ptr<const CMappedFile> file = GetMappedBlockFile(pos.nFile, pos.nPos);
+    if (file) {
+        const unsigned char* pheader = file->data() + nHeaderPos;
+        if (memcmp(pheader, message_start, CMessageHeader::MESSAGE_START_SIZE) != 0) {
+            return error("%s: Block magic mismatch at %s", __func__, pos.ToString());
+        }
+        const uint32_t nSize = ReadLE32(pheader + CMessageHeader::MESSAGE_START_SIZE);
+        if (nSize > MAX_SIZE) {
+            return error("%s: Invalid block size %u at %s", __func__, nSize, pos.ToString());
+        }
+        if (file->size() < (uint64_t)pos.nPos + nSize) {
+            file = GetMappedBlockFile(pos.nFile, (uint64_t)pos.nPos + nSize);
+            if (!file) {
+                return error("%s: Block at %s exceeds its block file", __func__, pos.ToString());
+            }
+        }
+        block.pbegin = file->data() + pos.nPos;
+        block.nSize = nSize;
+        block.owner = std::move(file);
+        return true;
+    }
+
+    // Fall back to reading the block into memory if the block file can not be mapped
+    CAutoFile filein(OpenBlockFile(CDiskBlockPos(pos.nFile, nHeaderPos), true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+    }
+    try {
+        CMessageHeader::MessageStartChars blk_start;
+        uint32_t nSize;
+        filein >> FLATDATA(blk_start) >> nSize;
+        if (memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE) != 0) {
+            return error("%s: Block magic mismatch at %s", __func__, pos.ToString());
+        }
+        if (nSize > MAX_SIZE) {
+            return error("%s: Invalid block size %u at %s", __func__, nSize, pos.ToString());
+        }
+        std::shared_ptr<std::vector<unsigned char>> data = std::make_shared<std::vector<unsigned char>>(nSize);
+        filein.read((char*)data->data(), nSize);
+        block.pbegin = data->data();
+        block.nSize = nSize;
+        block.owner = std::move(data);
+    } catch (const std::exception& e) {
+        return error("%s: Read from block file failed: %s for %s", __func__, e.what(), pos.ToString());
+    }
+    return true;
+}
+
+bool ReadRawBlockFromDisk(CRawBlock& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start)
+{
+    CDiskBlockPos blockPos;
+    {
+        LOCK(cs_main);
+        blockPos = pindex->GetBlockPos();
+    }
+
+    return ReadRawBlockFromDisk(block, blockPos, message_start);
+}
+
 double ConvertBitsToDouble(unsigned int nBits)
 {
     int nShift = (nBits >> 24) & 0xff;
@@ -1345,6 +1608,71 @@ void InitScriptExecutionCache() {
  *
  * Non-static (and re-declared) in src/test/txvalidationcache_tests.cpp
  */
+static uint256 GetScriptExecutionCacheEntry(const CTransaction& tx, unsigned int flags)
+{
+    uint256 hashCacheEntry;
+    // We only use the first 19 bytes of nonce to avoid a second SHA
+    // round - giving us 19 + 32 + 4 = 55 bytes (+ 8 + 1 = 64)
+    static_assert(55 - sizeof(flags) - 32 >= 128/8, "Want at least 128 bits of nonce for script execution cache");
+    CSHA256().Write(scriptExecutionCacheNonce.begin(), 55 - sizeof(flags) - 32).Write(tx.GetHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
+    return hashCacheEntry;
+}
+
+static void CacheScriptExecution(const CTransaction& tx, unsigned int flags)
+{
+    AssertLockHeld(cs_main); //TODO: Remove this requirement by making CuckooCache not require external locks
+    scriptExecutionCache.insert(GetScriptExecutionCacheEntry(tx, flags));
+}
+
+/**
+ * Verify the scripts of all inputs of tx, without consulting or updating the
+ * script execution cache. Does not need cs_main, so it can run while other
+ * threads connect blocks or accept transactions.
+ */
+static bool CheckInputScripts(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, unsigned int flags, bool cacheSigStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks)
+{
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        const COutPoint &prevout = tx.vin[i].prevout;
+        const Coin& coin = inputs.AccessCoin(prevout);
+        assert(!coin.IsSpent());
+
+        // We very carefully only pass in things to CScriptCheck which
+        // are clearly committed to by tx' witness hash. This provides
+        // a sanity check that our caching is not introducing consensus
+        // failures through additional data in, eg, the coins being
+        // spent being checked as a part of CScriptCheck.
+
+        // Verify signature
+        CScriptCheck check(coin.out, tx, i, flags, cacheSigStore, &txdata);
+        if (pvChecks) {
+            pvChecks->push_back(CScriptCheck());
+            check.swap(pvChecks->back());
+        } else if (!check()) {
+            if (flags & STANDARD_NOT_MANDATORY_VERIFY_FLAGS) {
+                // Check whether the failure was caused by a
+                // non-mandatory script verification check, such as
+                // non-standard DER encodings or non-null dummy
+                // arguments; if so, don't trigger DoS protection to
+                // avoid splitting the network between upgraded and
+                // non-upgraded nodes.
+                CScriptCheck check2(coin.out, tx, i,
+                        flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheSigStore, &txdata);
+                if (check2())
+                    return state.Invalid(false, REJECT_NONSTANDARD, strprintf("non-mandatory-script-verify-flag (%s)", ScriptErrorString(check.GetScriptError())));
+            }
+            // Failures of other flags indicate a transaction that is
+            // invalid in new blocks, e.g. an invalid P2SH. We DoS ban
+            // such nodes as they are not following the protocol. That
+            // said during an upgrade careful thought should be taken
+            // as to the correct behavior - we may want to continue
+            // peering with non-upgraded nodes even after soft-fork
+            // super-majority signaling has occurred.
+            return state.DoS(100,false, REJECT_INVALID, strprintf("mandatory-script-verify-flag-failed (%s)", ScriptErrorString(check.GetScriptError())));
+        }
+    }
+    return true;
+}
+
 bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks)
 {
     if (!tx.IsCoinBase())
@@ -1367,54 +1695,14 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
             // correct (ie that the transaction hash which is in tx's prevouts
             // properly commits to the scriptPubKey in the inputs view of that
             // transaction).
-            uint256 hashCacheEntry;
-            // We only use the first 19 bytes of nonce to avoid a second SHA
-            // round - giving us 19 + 32 + 4 = 55 bytes (+ 8 + 1 = 64)
-            static_assert(55 - sizeof(flags) - 32 >= 128/8, "Want at least 128 bits of nonce for script execution cache");
-            CSHA256().Write(scriptExecutionCacheNonce.begin(), 55 - sizeof(flags) - 32).Write(tx.GetHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
+            uint256 hashCacheEntry = GetScriptExecutionCacheEntry(tx, flags);
             AssertLockHeld(cs_main); //TODO: Remove this requirement by making CuckooCache not require external locks
             if (scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore)) {
                 return true;
             }
 
-            for (unsigned int i = 0; i < tx.vin.size(); i++) {
-                const COutPoint &prevout = tx.vin[i].prevout;
-                const Coin& coin = inputs.AccessCoin(prevout);
-                assert(!coin.IsSpent());
-
-                // We very carefully only pass in things to CScriptCheck which
-                // are clearly committed to by tx' witness hash. This provides
-                // a sanity check that our caching is not introducing consensus
-                // failures through additional data in, eg, the coins being
-                // spent being checked as a part of CScriptCheck.
-
-                // Verify signature
-                CScriptCheck check(coin.out, tx, i, flags, cacheSigStore, &txdata);
-                if (pvChecks) {
-                    pvChecks->push_back(CScriptCheck());
-                    check.swap(pvChecks->back());
-                } else if (!check()) {
-                    if (flags & STANDARD_NOT_MANDATORY_VERIFY_FLAGS) {
-                        // Check whether the failure was caused by a
-                        // non-mandatory script verification check, such as
-                        // non-standard DER encodings or non-null dummy
-                        // arguments; if so, don't trigger DoS protection to
-                        // avoid splitting the network between upgraded and
-                        // non-upgraded nodes.
-                        CScriptCheck check2(coin.out, tx, i,
-                                flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheSigStore, &txdata);
-                        if (check2())
-                            return state.Invalid(false, REJECT_NONSTANDARD, strprintf("non-mandatory-script-verify-flag (%s)", ScriptErrorString(check.GetScriptError())));
-                    }
-                    // Failures of other flags indicate a transaction that is
-                    // invalid in new blocks, e.g. an invalid P2SH. We DoS ban
-                    // such nodes as they are not following the protocol. That
-                    // said during an upgrade careful thought should be taken
-                    // as to the correct behavior - we may want to continue
-                    // peering with non-upgraded nodes even after soft-fork
-                    // super-majority signaling has occurred.
-                    return state.DoS(100,false, REJECT_INVALID, strprintf("mandatory-script-verify-flag-failed (%s)", ScriptErrorString(check.GetScriptError())));
-                }
+            if (!CheckInputScripts(tx, state, inputs, flags, cacheSigStore, txdata, pvChecks)) {
+                return false;
             }
 
             if (cacheFullScriptStore && !pvChecks) {
@@ -1457,7 +1745,27 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
-static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
+/** Abort with a message */
+bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
+{
+    SetMiscWarning(strMessage);
+    LogPrintf("*** %s\n", strMessage);
+    uiInterface.ThreadSafeMessageBox(
+        userMessage.empty() ? _("Error: A fatal internal error occurred, see debug.log for details") : userMessage,
+        "", CClientUIInterface::MSG_ERROR);
+    StartShutdown();
+    return false;
+}
+
+bool AbortNode(CValidationState& state, const std::string& strMessage, const std::string& userMessage="")
+{
+    AbortNode(strMessage, userMessage);
+    return state.Error(strMessage);
+}
+
+} // namespace
+
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
 {
     CDiskBlockPos pos = pindex->GetUndoPos();
     if (pos.IsNull()) {
@@ -1488,26 +1796,6 @@ static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
     return true;
 }
 
-/** Abort with a message */
-bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
-{
-    SetMiscWarning(strMessage);
-    LogPrintf("*** %s\n", strMessage);
-    uiInterface.ThreadSafeMessageBox(
-        userMessage.empty() ? _("Error: A fatal internal error occurred, see debug.log for details") : userMessage,
-        "", CClientUIInterface::MSG_ERROR);
-    StartShutdown();
-    return false;
-}
-
-bool AbortNode(CValidationState& state, const std::string& strMessage, const std::string& userMessage="")
-{
-    AbortNode(strMessage, userMessage);
-    return state.Error(strMessage);
-}
-
-} // namespace
-
 /**
  * Restore the UTXO in a Coin at a given COutPoint
  * @param undo The Coin to be restored.
@@ -1568,10 +1856,6 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
         return DISCONNECT_FAILED;
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
-
     if (!UndoSpecialTxsInBlock(block, pindex)) {
         return DISCONNECT_FAILED;
     }
@@ -1582,41 +1866,6 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
         uint256 hash = tx.GetHash();
         bool is_coinbase = tx.IsCoinBase();
 
-        if (fAddressIndex) {
-
-            for (unsigned int k = tx.vout.size(); k-- > 0;) {
-                const CTxOut &out = tx.vout[k];
-
-                if (out.scriptPubKey.IsPayToScriptHash()) {
-                    std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
-
-                    // undo receiving activity
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(2, uint160(hashBytes), pindex->nHeight, i, hash, k, false), out.nValue));
-
-                    // undo unspent index
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(2, uint160(hashBytes), hash, k), CAddressUnspentValue()));
-
-                } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
-                    std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
-
-                    // undo receiving activity
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(1, uint160(hashBytes), pindex->nHeight, i, hash, k, false), out.nValue));
-
-                    // undo unspent index
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, uint160(hashBytes), hash, k), CAddressUnspentValue()));
-
-                } else if (out.scriptPubKey.IsPayToPublicKey()) {
-                    uint160 hashBytes(Hash160(out.scriptPubKey.begin()+1, out.scriptPubKey.end()-1));
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(1, hashBytes, pindex->nHeight, i, hash, k, false), out.nValue));
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, hashBytes, hash, k), CAddressUnspentValue()));
-                } else {
-                    continue;
-                }
-
-            }
-
-        }
-
         // Check that all outputs are available and match the outputs in the block itself
         // exactly.
         for (size_t o = 0; o < tx.vout.size(); o++) {
@@ -1639,73 +1888,14 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
             }
             for (unsigned int j = tx.vin.size(); j-- > 0;) {
                 const COutPoint &out = tx.vin[j].prevout;
-                int undoHeight = txundo.vprevout[j].nHeight;
                 int res = ApplyTxInUndo(std::move(txundo.vprevout[j]), view, out);
                 if (res == DISCONNECT_FAILED) return DISCONNECT_FAILED;
                 fClean = fClean && res != DISCONNECT_UNCLEAN;
-
-                const CTxIn input = tx.vin[j];
-
-                if (fSpentIndex) {
-                    // undo and delete the spent index
-                    spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue()));
-                }
-
-                if (fAddressIndex) {
-                    const Coin &coin = view.AccessCoin(tx.vin[j].prevout);
-                    const CTxOut &prevout = coin.out;
-                    if (prevout.scriptPubKey.IsPayToScriptHash()) {
-                        std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22);
-
-                        // undo spending activity
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(2, uint160(hashBytes), pindex->nHeight, i, hash, j, true), prevout.nValue * -1));
-
-                        // restore unspent index
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(2, uint160(hashBytes), input.prevout.hash, input.prevout.n), CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, undoHeight)));
-
-
-                    } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
-                        std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23);
-
-                        // undo spending activity
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(1, uint160(hashBytes), pindex->nHeight, i, hash, j, true), prevout.nValue * -1));
-
-                        // restore unspent index
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, uint160(hashBytes), input.prevout.hash, input.prevout.n), CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, undoHeight)));
-
-                    } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
-                        uint160 hashBytes(Hash160(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.end()-1));
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(1, hashBytes, pindex->nHeight, i, hash, j, false), prevout.nValue));
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, hashBytes, hash, j), CAddressUnspentValue()));
-                    } else {
-                        continue;
-                    }
-                }
-
             }
             // At this point, all of txundo.vprevout should have been moved out.
         }
     }
 
-
-    if (fSpentIndex) {
-        if (!pblocktree->UpdateSpentIndex(spentIndex)) {
-            AbortNode("Failed to delete spent index");
-            return DISCONNECT_FAILED;
-        }
-    }
-
-    if (fAddressIndex) {
-        if (!pblocktree->EraseAddressIndex(addressIndex)) {
-            AbortNode("Failed to delete address index");
-            return DISCONNECT_FAILED;
-        }
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            AbortNode("Failed to write address unspent index");
-            return DISCONNECT_FAILED;
-        }
-    }
-
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
     evoDb->WriteBestBlock(pindex->pprev->GetBlockHash());
@@ -1784,6 +1974,162 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/**
+ * Closure representing the proof of work check of one block header. Running
+ * it also memoizes the header hash, so AcceptBlockHeader() gets it for free.
+ */
+class CHeaderPoWCheck
+{
+private:
+    const CBlockHeader* pheader;
+    const Consensus::Params* pconsensusParams;
+
+public:
+    CHeaderPoWCheck() : pheader(nullptr), pconsensusParams(nullptr) {}
+    CHeaderPoWCheck(const CBlockHeader& header, const Consensus::Params& consensusParams) :
+        pheader(&header), pconsensusParams(&consensusParams) {}
+
+    bool operator()()
+    {
+        return CheckProofOfWork(pheader->GetHash(), pheader->nBits, *pconsensusParams);
+    }
+
+    void swap(CHeaderPoWCheck& check)
+    {
+        std::swap(pheader, check.pheader);
+        std::swap(pconsensusParams, check.pconsensusParams);
+    }
+};
+
+// Every check is a full X16R/X21S hash, so keep the batches small
+static CCheckQueue<CHeaderPoWCheck> headercheckqueue(8);
+
+void ThreadHeaderCheck() {
+    RenameThread("pigeon-headerch");
+    headercheckqueue.Thread();
+}
+
+/** Number of outpoints read by one prefetch task */
+static const size_t PREFETCH_BATCH_SIZE = 64;
+/** Number of blocks remembered as prefetched */
+static const size_t MAX_PREFETCHED_BLOCKS = 256;
+
+static ctpl::thread_pool prefetchPool;
+static std::atomic<bool> fPrefetchRunning(false);
+static CCriticalSection cs_prefetch;
+// block hash -> generation of pcoinsPrefetch when its inputs were prefetched
+static unordered_lru_cache<uint256, uint64_t, StaticSaltedHasher> prefetchedBlocks GUARDED_BY(cs_prefetch) (MAX_PREFETCHED_BLOCKS);
+
+/** Returns false if the inputs of the block are already prefetched */
+static bool MarkBlockPrefetched(const uint256& hash)
+{
+    const uint64_t nGeneration = pcoinsPrefetch->GetGeneration();
+    LOCK(cs_prefetch);
+    uint64_t nPrefetchedGeneration;
+    if (prefetchedBlocks.get(hash, nPrefetchedGeneration) && nPrefetchedGeneration == nGeneration) {
+        return false;
+    }
+    prefetchedBlocks.insert(hash, nGeneration);
+    return true;
+}
+
+static void PrefetchInputs(const CBlock& block)
+{
+    // outputs created in the block itself are not in the database yet
+    std::unordered_set<uint256, StaticSaltedHasher> setBlockTxids;
+    for (const auto& tx : block.vtx) {
+        setBlockTxids.emplace(tx->GetHash());
+    }
+    std::vector<COutPoint> vOutpoints;
+    for (const auto& tx : block.vtx) {
+        if (tx->IsCoinBase()) {
+            continue;
+        }
+        for (const CTxIn& txin : tx->vin) {
+            if (!setBlockTxids.count(txin.prevout.hash)) {
+                vOutpoints.emplace_back(txin.prevout);
+            }
+        }
+    }
+
+    // spread the rest over the pool and read the first batch right here
+    for (size_t i = PREFETCH_BATCH_SIZE; i < vOutpoints.size(); i += PREFETCH_BATCH_SIZE) {
+        std::vector<COutPoint> vBatch(vOutpoints.begin() + i, vOutpoints.begin() + std::min(i + PREFETCH_BATCH_SIZE, vOutpoints.size()));
+        prefetchPool.push([vBatch](int) {
+            for (const COutPoint& outpoint : vBatch) {
+                pcoinsPrefetch->Prefetch(outpoint);
+            }
+        });
+    }
+    for (size_t i = 0; i < std::min(PREFETCH_BATCH_SIZE, vOutpoints.size()); i++) {
+        pcoinsPrefetch->Prefetch(vOutpoints[i]);
+    }
+}
+
+void PrefetchBlockInputs(const std::shared_ptr<const CBlock>& pblock)
+{
+    if (!fPrefetchRunning || !MarkBlockPrefetched(pblock->GetHash())) {
+        return;
+    }
+    prefetchPool.push([pblock](int) {
+        PrefetchInputs(*pblock);
+    });
+}
+
+/**
+ * Read a block that is about to be connected on the prefetch threads and prefetch its inputs
+ * from there. ConnectTip takes the block from the returned future instead of reading it again.
+ * The future is invalid if prefetching is not running.
+ */
+static std::future<std::shared_ptr<const CBlock>> ReadBlockForConnect(const CBlockIndex* pindex, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (!fPrefetchRunning || !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+        return {};
+    }
+    const CDiskBlockPos pos = pindex->GetBlockPos();
+    const uint256 hash = pindex->GetBlockHash();
+    const bool fPrefetchInputs = MarkBlockPrefetched(hash);
+    return prefetchPool.push([pos, hash, fPrefetchInputs, &consensusParams](int) {
+        auto pblock = std::make_shared<CBlock>();
+        if (!ReadBlockFromDisk(*pblock, pos, consensusParams) || pblock->GetHash() != hash) {
+            return std::shared_ptr<const CBlock>();
+        }
+        if (fPrefetchInputs) {
+            PrefetchInputs(*pblock);
+        }
+        return std::shared_ptr<const CBlock>(std::move(pblock));
+    });
+}
+
+/** Get the block read by ReadBlockForConnect, or nullptr if reading failed or the task was dropped by StopCoinsPrefetch */
+static std::shared_ptr<const CBlock> GetBlockForConnect(std::future<std::shared_ptr<const CBlock>>& future)
+{
+    try {
+        return future.get();
+    } catch (const std::future_error&) {
+        return nullptr;
+    }
+}
+
+void StartCoinsPrefetch(int nThreads)
+{
+    assert(pcoinsPrefetch);
+    if (nThreads <= 0) {
+        return;
+    }
+    prefetchPool.resize(nThreads);
+    RenameThreadPool(prefetchPool, "pigeon-prefetch");
+    fPrefetchRunning = true;
+}
+
+void StopCoinsPrefetch()
+{
+    if (fPrefetchRunning.exchange(false)) {
+        prefetchPool.clear_queue();
+        prefetchPool.stop(true);
+    }
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -1995,6 +2341,9 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     }
 
     int64_t nTime1 = GetTimeMicros(); nTimeCheck += nTime1 - nTimeStart;
+    // Block template checks of the miner would swamp the stages of connected blocks
+    if (!fJustCheck)
+        RecordValidationStage(ValidationStage::CHECK, nTime1 - nTimeStart);
     LogPrint(BCLog::BENCHMARK, "    - Sanity checks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime1 - nTimeStart), nTimeCheck * MICRO, nTimeCheck * MILLI / nBlocksTotal);
 
     // Do not allow blocks that contain transactions which 'overwrite' older transactions,
@@ -2056,6 +2405,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     unsigned int flags = GetBlockScriptFlags(pindex, chainparams.GetConsensus());
 
     int64_t nTime2 = GetTimeMicros(); nTimeForks += nTime2 - nTime1;
+    if (!fJustCheck)
+        RecordValidationStage(ValidationStage::FORKS, nTime2 - nTime1);
     LogPrint(BCLog::BENCHMARK, "    - Fork checks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime2 - nTime1), nTimeForks * MICRO, nTimeForks * MILLI / nBlocksTotal);
 
     CBlockUndo blockundo;
@@ -2067,9 +2418,6 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     int nInputs = 0;
     unsigned int nSigOps = 0;
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
 
     std::vector<PrecomputedTransactionData> txdata;
     txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
@@ -2079,7 +2427,6 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = *(block.vtx[i]);
-        const uint256 txhash = tx.GetHash();
 
         nInputs += tx.vin.size();
 
@@ -2107,47 +2454,6 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
                 return state.DoS(100, error("%s: contains a non-BIP68-final transaction", __func__),
                                  REJECT_INVALID, "bad-txns-nonfinal");
             }
-
-            if (fAddressIndex || fSpentIndex)
-            {
-                for (size_t j = 0; j < tx.vin.size(); j++) {
-                    const CTxIn input = tx.vin[j];
-                    const Coin& coin = view.AccessCoin(tx.vin[j].prevout);
-                    const CTxOut &prevout = coin.out;
-                    uint160 hashBytes;
-                    int addressType;
-
-                    if (prevout.scriptPubKey.IsPayToScriptHash()) {
-                        hashBytes = uint160(std::vector<unsigned char>(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22));
-                        addressType = 2;
-                    } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
-                        hashBytes = uint160(std::vector<unsigned char>(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23));
-                        addressType = 1;
-                    } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
-                        hashBytes = Hash160(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.end()-1);
-                        addressType = 1;
-                    } else {
-                        hashBytes.SetNull();
-                        addressType = 0;
-                    }
-
-                    if (fAddressIndex && addressType > 0) {
-                        // record spending activity
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, j, true), prevout.nValue * -1));
-
-                        // remove address from unspent index
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, hashBytes, input.prevout.hash, input.prevout.n), CAddressUnspentValue()));
-                    }
-
-                    if (fSpentIndex) {
-                        // add the spent index to determine the txid and input that spent an output
-                        // and to find the amount and address from an input
-                        spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue(txhash, j, pindex->nHeight, prevout.nValue, addressType, hashBytes)));
-                    }
-                }
-
-            }
-
         }
 
         // GetTransactionSigOpCount counts 2 types of sigops:
@@ -2170,39 +2476,6 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             control.Add(vChecks);
         }
 
-        if (fAddressIndex) {
-            for (unsigned int k = 0; k < tx.vout.size(); k++) {
-                const CTxOut &out = tx.vout[k];
-
-                if (out.scriptPubKey.IsPayToScriptHash()) {
-                    std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
-
-                    // record receiving activity
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(2, uint160(hashBytes), pindex->nHeight, i, txhash, k, false), out.nValue));
-
-                    // record unspent output
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(2, uint160(hashBytes), txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
-
-                } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
-                    std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
-
-                    // record receiving activity
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(1, uint160(hashBytes), pindex->nHeight, i, txhash, k, false), out.nValue));
-
-                    // record unspent output
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, uint160(hashBytes), txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
-
-                } else if (out.scriptPubKey.IsPayToPublicKey()) {
-                    uint160 hashBytes(Hash160(out.scriptPubKey.begin()+1, out.scriptPubKey.end()-1));
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(1, hashBytes, pindex->nHeight, i, txhash, k, false), out.nValue));
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, hashBytes, txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
-                } else {
-                    continue;
-                }
-
-            }
-        }
-
         CTxUndo undoDummy;
         if (i > 0) {
             blockundo.vtxundo.push_back(CTxUndo());
@@ -2210,11 +2483,15 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
     }
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
+    if (!fJustCheck)
+        RecordValidationStage(ValidationStage::CONNECT_TXS, nTime3 - nTime2);
     LogPrint(BCLog::BENCHMARK, "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs (%.2fms/blk)]\n", (unsigned)block.vtx.size(), MILLI * (nTime3 - nTime2), MILLI * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : MILLI * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * MICRO, nTimeConnect * MILLI / nBlocksTotal);
 
     if (!control.Wait())
         return state.DoS(100, error("%s: CheckQueue failed", __func__), REJECT_INVALID, "block-validation-failed");
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
+    if (!fJustCheck)
+        RecordValidationStage(ValidationStage::VERIFY, nTime4 - nTime2);
     LogPrint(BCLog::BENCHMARK, "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs (%.2fms/blk)]\n", nInputs - 1, MILLI * (nTime4 - nTime2), nInputs <= 1 ? 0 : MILLI * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * MICRO, nTimeVerify * MILLI / nBlocksTotal);
 
 
@@ -2253,6 +2530,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     }
 
     int64_t nTime5_1 = GetTimeMicros(); nTimeISFilter += nTime5_1 - nTime4;
+    if (!fJustCheck)
+        RecordValidationStage(ValidationStage::IS_FILTER, nTime5_1 - nTime4);
     LogPrint(BCLog::BENCHMARK, "      - IS filter: %.2fms [%.2fs (%.2fms/blk)]\n", MICRO * (nTime5_1 - nTime4), nTimeISFilter * MICRO, nTimeISFilter * MILLI / nBlocksTotal);
 
     // PGN : MODIFIED TO CHECK MASTERNODE PAYMENTS AND SUPERBLOCKS
@@ -2262,6 +2541,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     std::string strError = "";
 
     int64_t nTime5_2 = GetTimeMicros(); nTimeSubsidy += nTime5_2 - nTime5_1;
+    if (!fJustCheck)
+        RecordValidationStage(ValidationStage::SUBSIDY, nTime5_2 - nTime5_1);
     LogPrint(BCLog::BENCHMARK, "      - GetBlockSubsidy: %.2fms [%.2fs (%.2fms/blk)]\n", MICRO * (nTime5_2 - nTime5_1), nTimeSubsidy * MICRO, nTimeSubsidy * MILLI / nBlocksTotal);
 
     if (!IsBlockValueValid(block, pindex->nHeight, blockReward, strError)) {
@@ -2269,6 +2550,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     }
 
     int64_t nTime5_3 = GetTimeMicros(); nTimeValueValid += nTime5_3 - nTime5_2;
+    if (!fJustCheck)
+        RecordValidationStage(ValidationStage::VALUE_VALID, nTime5_3 - nTime5_2);
     LogPrint(BCLog::BENCHMARK, "      - IsBlockValueValid: %.2fms [%.2fs (%.2fms/blk)]\n", MICRO * (nTime5_3 - nTime5_2), nTimeValueValid * MICRO, nTimeValueValid * MILLI / nBlocksTotal);
 
     if (pindex->nHeight > Params().GetConsensus().nMasternodePaymentsStartBlock &&  !IsBlockPayeeValid(*block.vtx[0], pindex->nHeight, blockReward)) {
@@ -2277,6 +2560,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     }
 
     int64_t nTime5_4 = GetTimeMicros(); nTimePayeeValid += nTime5_4 - nTime5_3;
+    if (!fJustCheck)
+        RecordValidationStage(ValidationStage::PAYEE_VALID, nTime5_4 - nTime5_3);
     LogPrint(BCLog::BENCHMARK, "      - IsBlockPayeeValid: %.2fms [%.2fs (%.2fms/blk)]\n", MICRO * (nTime5_4 - nTime5_3), nTimePayeeValid * MICRO, nTimePayeeValid * MILLI / nBlocksTotal);
 
     if (!ProcessSpecialTxsInBlock(block, pindex, state, fJustCheck, fScriptChecks)) {
@@ -2285,17 +2570,23 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     }
 
     int64_t nTime5_5 = GetTimeMicros(); nTimeProcessSpecial += nTime5_5 - nTime5_4;
+    if (!fJustCheck)
+        RecordValidationStage(ValidationStage::PROCESS_SPECIAL, nTime5_5 - nTime5_4);
     LogPrint(BCLog::BENCHMARK, "      - ProcessSpecialTxsInBlock: %.2fms [%.2fs (%.2fms/blk)]\n", MICRO * (nTime5_5 - nTime5_4), nTimeProcessSpecial * MICRO, nTimeProcessSpecial * MILLI / nBlocksTotal);
 
     int64_t nTime5 = GetTimeMicros(); nTimePigeonSpecific += nTime5 - nTime4;
+    if (!fJustCheck)
+        RecordValidationStage(ValidationStage::PIGEON_SPECIFIC, nTime5 - nTime4);
     LogPrint(BCLog::BENCHMARK, "    - Pigeon specific: %.2fms [%.2fs (%.2fms/blk)]\n", MICRO * (nTime5 - nTime4), nTimePigeonSpecific * MICRO, nTimePigeonSpecific * MILLI / nBlocksTotal);
-    int64_t nTime6_1 = GetTimeMicros(); nTimeFounderCheck += nTime6_1 - nTime5;
-
 
     //Check founder payments now
     if(!IsFounderPaymentValid(*block.vtx[0],chainparams.GetConsensus(),pindex->nHeight)){
         return state.DoS(10, error("CheckBlock(PGN): Block at height %d does not contain founder payment output",pindex->nHeight), REJECT_INVALID, "founderpayment-not-found");
     }
+
+    int64_t nTime6_1 = GetTimeMicros(); nTimeFounderCheck += nTime6_1 - nTime5;
+    if (!fJustCheck)
+        RecordValidationStage(ValidationStage::FOUNDER_CHECK, nTime6_1 - nTime5);
     LogPrint(BCLog::BENCHMARK, "    - Founder specific: %.2fms [%.2fs (%.2fms/blk)]\n", MICRO * (nTime6_1 - nTime5), nTimeFounderCheck * MICRO, nTimeFounderCheck * MILLI / nBlocksTotal);
 
     // END PGN
@@ -2314,34 +2605,18 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     if (!WriteTxIndexDataForBlock(block, state, pindex))
         return false;
 
-    if (fAddressIndex) {
-        if (!pblocktree->WriteAddressIndex(addressIndex)) {
-            return AbortNode(state, "Failed to write address index");
-        }
-
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            return AbortNode(state, "Failed to write address unspent index");
-        }
-    }
-
-    if (fSpentIndex)
-        if (!pblocktree->UpdateSpentIndex(spentIndex))
-            return AbortNode(state, "Failed to write transaction index");
-
-    if (fTimestampIndex)
-        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
-            return AbortNode(state, "Failed to write timestamp index");
-
     assert(pindex->phashBlock);
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
-    int64_t nTime6 = GetTimeMicros(); nTimeIndex += nTime6 - nTime5;
-    LogPrint(BCLog::BENCHMARK, "    - Index writing: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime6 - nTime5), nTimeIndex * MICRO, nTimeIndex * MILLI / nBlocksTotal);
+    int64_t nTime6 = GetTimeMicros(); nTimeIndex += nTime6 - nTime6_1;
+    RecordValidationStage(ValidationStage::INDEX, nTime6 - nTime6_1);
+    LogPrint(BCLog::BENCHMARK, "    - Index writing: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime6 - nTime6_1), nTimeIndex * MICRO, nTimeIndex * MILLI / nBlocksTotal);
 
     evoDb->WriteBestBlock(pindex->GetBlockHash());
 
     int64_t nTime7 = GetTimeMicros(); nTimeCallbacks += nTime7 - nTime6;
+    RecordValidationStage(ValidationStage::CALLBACKS, nTime7 - nTime6);
     LogPrint(BCLog::BENCHMARK, "    - Callbacks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime7 - nTime6), nTimeCallbacks * MICRO, nTimeCallbacks * MILLI / nBlocksTotal);
 
     return true;
@@ -2431,9 +2706,13 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
                     return AbortNode(state, "Failed to write to block index database");
                 }
             }
-            // Finally remove any pruned files
-            if (fFlushForPrune)
+            // Finally remove any pruned files. A background write of the coins cache
+            // may still need the blocks since its start to be replayed after a crash.
+            if (fFlushForPrune) {
+                if (!pcoinsdbview->SyncWriteBehind())
+                    return AbortNode(state, "Failed to write to coin database");
                 UnlinkPrunedFiles(setFilesToPrune);
+            }
             nLastWrite = nNow;
         }
         // Flush best chain related state. This can only be done if the blocks / block index write was also done.
@@ -2446,8 +2725,17 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
             // Flush the chainstate (which may refer to block index entries).
-            if (!pcoinsTip->Flush())
+            // With -coinswritebehind this only hands the coins over to the writer thread.
+            // A write that is interrupted by a crash can only be rolled forward, so wait
+            // for it if the coins database is not on the active chain anymore.
+            int64_t nFlushStart = GetTimeMicros();
+            BlockMap::const_iterator itFlushed = mapBlockIndex.find(pcoinsdbview->GetBestBlock());
+            bool fSync = mode == FlushStateMode::ALWAYS || fFlushForPrune ||
+                (itFlushed != mapBlockIndex.end() && !chainActive.Contains(itFlushed->second));
+            if (!pcoinsTip->Flush() || (fSync && !pcoinsdbview->SyncWriteBehind()))
                 return AbortNode(state, "Failed to write to coin database");
+            RecordValidationStage(ValidationStage::COINS_FLUSH, GetTimeMicros() - nFlushStart);
+        // This can get ahead of a background coins write, ReplayBlocks then only rolls the coins forward.
         if (!evoDb->CommitRootTransaction()) {
             return AbortNode(state, "Failed to commit EvoDB");
         }
@@ -2704,6 +2992,7 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     const CBlock& blockConnecting = *pthisBlock;
     // Apply the block atomically to the chain state.
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
+    RecordValidationStage(ValidationStage::READ_FROM_DISK, nTime2 - nTime1);
     int64_t nTime3;
     LogPrint(BCLog::BENCHMARK, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
     {
@@ -2718,17 +3007,20 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
             return error("ConnectTip(): ConnectBlock %s failed with %s", pindexNew->GetBlockHash().ToString(), FormatStateMessage(state));
         }
         nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
+        RecordValidationStage(ValidationStage::CONNECT_TOTAL, nTime3 - nTime2);
         LogPrint(BCLog::BENCHMARK, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTime2) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
         bool flushed = view.Flush();
         assert(flushed);
         dbTx->Commit();
     }
     int64_t nTime4 = GetTimeMicros(); nTimeFlush += nTime4 - nTime3;
+    RecordValidationStage(ValidationStage::FLUSH, nTime4 - nTime3);
     LogPrint(BCLog::BENCHMARK, "  - Flush: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime4 - nTime3) * MILLI, nTimeFlush * MICRO, nTimeFlush * MILLI / nBlocksTotal);
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(chainparams, state, FlushStateMode::IF_NEEDED))
         return false;
     int64_t nTime5 = GetTimeMicros(); nTimeChainState += nTime5 - nTime4;
+    RecordValidationStage(ValidationStage::CHAINSTATE, nTime5 - nTime4);
     LogPrint(BCLog::BENCHMARK, "  - Writing chainstate: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime5 - nTime4) * MILLI, nTimeChainState * MICRO, nTimeChainState * MILLI / nBlocksTotal);
     // Remove conflicting transactions from the mempool.;
     mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight);
@@ -2738,6 +3030,8 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     UpdateTip(pindexNew, chainparams);
 
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
+    RecordValidationStage(ValidationStage::POST_CONNECT, nTime6 - nTime5);
+    RecordValidationStage(ValidationStage::TOTAL, nTime6 - nTime1);
     LogPrint(BCLog::BENCHMARK, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
     LogPrint(BCLog::BENCHMARK, "- Connect block: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime1) * MILLI, nTimeTotal * MICRO, nTimeTotal * MILLI / nBlocksTotal);
 
@@ -2855,9 +3149,31 @@ bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainPar
         }
         nHeight = nTargetHeight;
 
+        // Read the blocks we are about to connect and their inputs in the background
+        std::map<const CBlockIndex*, std::future<std::shared_ptr<const CBlock>>> mapBlockReads;
+        for (CBlockIndex *pindexConnect : reverse_iterate(vpindexToConnect)) {
+            if (pindexConnect == pindexMostWork && pblock) {
+                PrefetchBlockInputs(pblock);
+            } else {
+                auto future = ReadBlockForConnect(pindexConnect, chainparams.GetConsensus());
+                if (future.valid()) {
+                    mapBlockReads.emplace(pindexConnect, std::move(future));
+                }
+            }
+        }
+
         // Connect new blocks.
         for (CBlockIndex *pindexConnect : reverse_iterate(vpindexToConnect)) {
-            if (!ConnectTip(state, chainparams, pindexConnect, pindexConnect == pindexMostWork ? pblock : std::shared_ptr<const CBlock>(), connectTrace, disconnectpool)) {
+            std::shared_ptr<const CBlock> pblockConnect;
+            if (pindexConnect == pindexMostWork) {
+                pblockConnect = pblock;
+            }
+            auto itRead = mapBlockReads.find(pindexConnect);
+            if (itRead != mapBlockReads.end()) {
+                // ConnectTip reads the block itself if this failed
+                pblockConnect = GetBlockForConnect(itRead->second);
+            }
+            if (!ConnectTip(state, chainparams, pindexConnect, pblockConnect, connectTrace, disconnectpool)) {
                 if (state.IsInvalid()) {
                     // The block violates a consensus rule.
                     if (!state.CorruptionPossible()) {
@@ -3627,18 +3943,57 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
 
     CheckBlockIndex(chainparams.GetConsensus());
 
-    // Notify external listeners about accepted block header
-    GetMainSignals().AcceptedBlockHeader(pindex);
+    // Notify external listeners about accepted block header
+    GetMainSignals().AcceptedBlockHeader(pindex);
+
+    return true;
+}
+
+/**
+ * Compute and check the proof of work of a batch of headers on the header
+ * check queue, without holding cs_main. This does not replace the checks in
+ * AcceptBlockHeader(), which still decide about (and DoS score) invalid
+ * headers in order, but leaves them with memoized hashes to look at.
+ */
+static bool CheckBlockHeadersPoW(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams)
+{
+    if (!nScriptCheckThreads || headers.size() < 2)
+        return true;
+
+    std::vector<CHeaderPoWCheck> vChecks;
+    vChecks.reserve(headers.size());
+    for (const CBlockHeader& header : headers) {
+        vChecks.emplace_back(header, consensusParams);
+    }
 
-    return true;
+    CCheckQueueControl<CHeaderPoWCheck> control(&headercheckqueue);
+    control.Add(vChecks);
+    return control.Wait();
 }
 
+// Protected by cs_main
+static int64_t nTimeHeadersPoW = 0;
+static int64_t nTimeHeadersAccept = 0;
+static int64_t nHeadersTotal = 0;
+
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
 {
     if (first_invalid != nullptr) first_invalid->SetNull();
+
+    // Hash the whole batch in parallel before taking cs_main
+    int64_t nTimeStart = GetTimeMicros();
+    bool fPoWValid = CheckBlockHeadersPoW(headers, chainparams.GetConsensus());
+    int64_t nTime1 = GetTimeMicros();
+
     {
         LOCK(cs_main);
+        nHeadersTotal += headers.size();
+        nTimeHeadersPoW += nTime1 - nTimeStart;
+        LogPrint(BCLog::BENCHMARK, "  - PoW of %u headers (%s): %.2fms (%.3fms/header) [%.2fs (%.2fms/header)]\n", (unsigned)headers.size(), fPoWValid ? "valid" : "invalid",
+                 MILLI * (nTime1 - nTimeStart), headers.empty() ? 0 : MILLI * (nTime1 - nTimeStart) / headers.size(),
+                 nTimeHeadersPoW * MICRO, nHeadersTotal ? nTimeHeadersPoW * MILLI / nHeadersTotal : 0);
+
         for (const CBlockHeader& header : headers) {
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
             if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex)) {
@@ -3649,6 +4004,10 @@ bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidatio
                 *ppindex = pindex;
             }
         }
+
+        int64_t nTime2 = GetTimeMicros(); nTimeHeadersAccept += nTime2 - nTime1;
+        LogPrint(BCLog::BENCHMARK, "  - Accept %u headers: %.2fms [%.2fs (%.2fms/header)]\n", (unsigned)headers.size(), MILLI * (nTime2 - nTime1),
+                 nTimeHeadersAccept * MICRO, nHeadersTotal ? nTimeHeadersAccept * MILLI / nHeadersTotal : 0);
     }
     NotifyHeaderTip();
     return true;
@@ -3758,6 +4117,11 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
 {
     AssertLockNotHeld(cs_main);
 
+    // Blocks received during initial block download are prefetched when they are about to be connected
+    if (!IsInitialBlockDownload()) {
+        PrefetchBlockInputs(pblock);
+    }
+
     {
         CBlockIndex *pindex = nullptr;
         if (fNewBlock) *fNewBlock = false;
@@ -3877,6 +4241,7 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        UnmapBlockFile(*it);
         fs::remove(GetBlockPosFilename(pos, "blk"));
         fs::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -4058,6 +4423,7 @@ bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlo
     boost::this_thread::interruption_point();
 
     // Calculate nChainWork
+    int64_t nTimeStart = GetTimeMicros();
     std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
     vSortedByHeight.reserve(mapBlockIndex.size());
     for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex)
@@ -4094,15 +4460,25 @@ bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlo
             pindex->nStatus |= BLOCK_FAILED_CHILD;
             setDirtyBlockIndex.insert(pindex);
         }
+        if (pindex->pprev)
+            pindex->BuildSkip();
+    }
+    int64_t nTime1 = GetTimeMicros();
+
+    // Only needs the chain work of the entry itself, so this can run as a separate pass
+    for (const std::pair<int, CBlockIndex*>& item : vSortedByHeight)
+    {
+        CBlockIndex* pindex = item.second;
         if (pindex->IsValid(BLOCK_VALID_TRANSACTIONS) && (pindex->nChainTx || pindex->pprev == nullptr))
             setBlockIndexCandidates.insert(pindex);
         if (pindex->nStatus & BLOCK_FAILED_MASK && (!pindexBestInvalid || pindex->nChainWork > pindexBestInvalid->nChainWork))
             pindexBestInvalid = pindex;
-        if (pindex->pprev)
-            pindex->BuildSkip();
         if (pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == nullptr || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
             pindexBestHeader = pindex;
     }
+    int64_t nTime2 = GetTimeMicros();
+
+    LogPrintf("%s: chain work %.2fms, candidate set %.2fms\n", __func__, MILLI * (nTime1 - nTimeStart), MILLI * (nTime2 - nTime1));
 
     return true;
 }
@@ -4152,6 +4528,16 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams) EXCLUSIVE_LOCKS_RE
     if (fHavePruned)
         LogPrintf("LoadBlockIndexDB(): Block files have previously been pruned\n");
 
+    // Check whether loading a UTXO snapshot was interrupted, the chainstate is incomplete then
+    bool fLoadingSnapshot = false;
+    pblocktree->ReadFlag("loadingsnapshot", fLoadingSnapshot);
+    if (fLoadingSnapshot) {
+        return error("%s: loading a UTXO snapshot did not finish, the chainstate needs to be rebuilt", __func__);
+    }
+    pblocktree->ReadFlag("loadedsnapshot", fLoadedSnapshot);
+    if (fLoadedSnapshot)
+        LogPrintf("LoadBlockIndexDB(): The chainstate was loaded from a UTXO snapshot\n");
+
     // Check whether we need to continue reindexing
     bool fReindexing = false;
     pblocktree->ReadReindexing(fReindexing);
@@ -4161,18 +4547,6 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams) EXCLUSIVE_LOCKS_RE
     pblocktree->ReadFlag("txindex", fTxIndex);
     LogPrintf("%s: transaction index %s\n", __func__, fTxIndex ? "enabled" : "disabled");
 
-    // Check whether we have an address index
-    pblocktree->ReadFlag("addressindex", fAddressIndex);
-    LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
-
-    // Check whether we have a timestamp index
-    pblocktree->ReadFlag("timestampindex", fTimestampIndex);
-    LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
-
-    // Check whether we have a spent index
-    pblocktree->ReadFlag("spentindex", fSpentIndex);
-    LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
-
     return true;
 }
 
@@ -4252,6 +4626,11 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
             LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
             break;
         }
+        if (fLoadedSnapshot && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+            // Blocks up to the base of a UTXO snapshot were never downloaded
+            LogPrintf("VerifyDB(): block verification stopping at height %d (UTXO snapshot, no data)\n", pindex->nHeight);
+            break;
+        }
         CBlock block;
         // check level 0: read from disk
         if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
@@ -4313,7 +4692,7 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
 }
 
 /** Apply the effects of a block on the utxo cache, ignoring that it may already have been applied. */
-bool CChainState::RollforwardBlock(const CBlockIndex* pindex, CCoinsViewCache& inputs, const CChainParams& params)
+bool CChainState::RollforwardBlock(const CBlockIndex* pindex, CCoinsViewCache& inputs, const CChainParams& params, bool fSpecialTxs)
 {
     // TODO: merge with ConnectBlock
     CBlock block;
@@ -4331,6 +4710,10 @@ bool CChainState::RollforwardBlock(const CBlockIndex* pindex, CCoinsViewCache& i
         AddCoins(inputs, *tx, pindex->nHeight, true);
     }
 
+    if (!fSpecialTxs) {
+        return true;
+    }
+
     CValidationState state;
     if (!ProcessSpecialTxsInBlock(block, pindex, state, false /*fJustCheck*/, false /*fScriptChecks*/)) {
         return error("RollforwardBlock(PGN): ProcessSpecialTxsInBlock for block %s failed with %s",
@@ -4396,12 +4779,24 @@ bool CChainState::ReplayBlocks(const CChainParams& params, CCoinsView* view)
         pindexOld = pindexOld->pprev;
     }
 
+    // With -coinswritebehind the evo database is committed while the coins are
+    // still being written, so it can already contain the blocks to roll forward.
+    // Their special transactions must not be processed twice.
+    int nEvoHeight = -1;
+    uint256 hashEvoBest;
+    if (evoDb->Read(EVODB_BEST_BLOCK, hashEvoBest)) {
+        BlockMap::const_iterator it = mapBlockIndex.find(hashEvoBest);
+        if (it != mapBlockIndex.end() && pindexNew->GetAncestor(it->second->nHeight) == it->second) {
+            nEvoHeight = it->second->nHeight;
+        }
+    }
+
     // Roll forward from the forking point to the new tip.
     int nForkHeight = pindexFork ? pindexFork->nHeight : 0;
     for (int nHeight = nForkHeight + 1; nHeight <= pindexNew->nHeight; ++nHeight) {
         const CBlockIndex* pindex = pindexNew->GetAncestor(nHeight);
-        LogPrintf("Rolling forward %s (%i)\n", pindex->GetBlockHash().ToString(), nHeight);
-        if (!RollforwardBlock(pindex, cache, params)) return false;
+        LogPrintf("Rolling forward %s (%i)%s\n", pindex->GetBlockHash().ToString(), nHeight, nHeight <= nEvoHeight ? ", evodb already up to date" : "");
+        if (!RollforwardBlock(pindex, cache, params, nHeight > nEvoHeight)) return false;
     }
 
     cache.SetBestBlock(pindexNew->GetBlockHash());
@@ -4448,6 +4843,7 @@ void UnloadBlockIndex()
     }
     mapBlockIndex.clear();
     fHavePruned = false;
+    fLoadedSnapshot = false;
 
     g_chainstate.UnloadBlockIndex();
 }
@@ -4473,18 +4869,6 @@ bool LoadBlockIndex(const CChainParams& chainparams)
         // Use the provided setting for -txindex in the new database
         fTxIndex = gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX);
         pblocktree->WriteFlag("txindex", fTxIndex);
-
-        // Use the provided setting for -addressindex in the new database
-        fAddressIndex = gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
-        pblocktree->WriteFlag("addressindex", fAddressIndex);
-
-        // Use the provided setting for -timestampindex in the new database
-        fTimestampIndex = gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
-        pblocktree->WriteFlag("timestampindex", fTimestampIndex);
-
-        // Use the provided setting for -spentindex in the new database
-        fSpentIndex = gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
-        pblocktree->WriteFlag("spentindex", fSpentIndex);
     }
     return true;
 }
@@ -4537,13 +4921,162 @@ bool LoadGenesisBlock(const CChainParams& chainparams)
     return g_chainstate.LoadGenesisBlock(chainparams);
 }
 
-bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
+bool CChainState::ActivateSnapshot(CAutoFile& file, const SnapshotMetadata& metadata, const SnapshotData& snapshotData, const CChainParams& chainparams, std::string& strError)
 {
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
-    int64_t nStart = GetTimeMillis();
+    AssertLockHeld(cs_main);
 
-    int nLoaded = 0;
+    if (fAddressIndex || fSpentIndex || fTimestampIndex) {
+        strError = "UTXO snapshots can not be loaded with -addressindex, -spentindex or -timestampindex enabled";
+        return false;
+    }
+    if (chainActive.Height() != 0 || pcoinsTip->GetBestBlock() != chainparams.GetConsensus().hashGenesisBlock) {
+        strError = "UTXO snapshots can only be loaded before any blocks are connected";
+        return false;
+    }
+    BlockMap::iterator mi = mapBlockIndex.find(metadata.hashBaseBlock);
+    if (mi == mapBlockIndex.end() || !mi->second->IsValid(BLOCK_VALID_TREE)) {
+        strError = strprintf("Header of block %s is not known yet, wait for headers to sync", metadata.hashBaseBlock.ToString());
+        return false;
+    }
+    CBlockIndex* pindexBase = mi->second;
+    if (pindexBase->nHeight != metadata.nBaseHeight || (pindexBase->nStatus & BLOCK_FAILED_MASK)) {
+        strError = strprintf("Block %s can not be used as snapshot base", metadata.hashBaseBlock.ToString());
+        return false;
+    }
+
+    // From here on a failure leaves a partial chainstate behind, LoadBlockIndexDB refuses to start on it
+    if (!pblocktree->WriteFlag("loadingsnapshot", true)) {
+        strError = "Failed to write to the block index database";
+        return false;
+    }
+
+    try {
+        COutPoint outpoint;
+        Coin coin;
+        for (uint64_t i = 0; i < metadata.nCoins; i++) {
+            file >> outpoint;
+            file >> coin;
+            pcoinsTip->AddCoin(outpoint, std::move(coin), false);
+            if (pcoinsTip->DynamicMemoryUsage() > nCoinCacheUsage && !pcoinsTip->Flush()) {
+                strError = "Failed to write the UTXO set";
+                return false;
+            }
+        }
+        pcoinsTip->SetBestBlock(metadata.hashBaseBlock);
+        if (!pcoinsTip->Flush()) {
+            strError = "Failed to write the UTXO set";
+            return false;
+        }
+
+        // The evo database entries are written as is, this includes its best block
+        LOCK(evoDb->cs);
+        CDBWrapper& evoRawDB = evoDb->GetRawDB();
+        CDBBatch batch(evoRawDB);
+        std::vector<unsigned char> vchKey, vchValue;
+        for (uint64_t i = 0; i < metadata.nEvoEntries; i++) {
+            file >> vchKey;
+            file >> vchValue;
+            batch.Write(CDataStream(vchKey, SER_DISK, CLIENT_VERSION), CDataStream(vchValue, SER_DISK, CLIENT_VERSION));
+            if (batch.SizeEstimate() > nDefaultDbBatchSize) {
+                evoRawDB.WriteBatch(batch);
+                batch.Clear();
+            }
+        }
+        evoRawDB.WriteBatch(batch, true);
+    } catch (const std::exception& e) {
+        strError = strprintf("Failed to load UTXO snapshot: %s", e.what());
+        return false;
+    }
+
+    // Blocks before the base stay without data, like on a pruned node. Those that were never
+    // downloaded count as one transaction each, so that nTx and nChainTx are set along the
+    // chain as if it had been connected, and the base gets the committed nChainTx.
+    chainActive.SetTip(pindexBase);
+    for (int nHeight = 1; nHeight <= pindexBase->nHeight; nHeight++) {
+        CBlockIndex* pindex = chainActive[nHeight];
+        if (pindex->nTx == 0) {
+            pindex->nTx = pindex == pindexBase ? std::max(1u, snapshotData.nChainTx - std::min(snapshotData.nChainTx, pindex->pprev->nChainTx)) : 1;
+        }
+        pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
+        pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
+        setDirtyBlockIndex.insert(pindex);
+    }
+    setBlockIndexCandidates.insert(pindexBase);
+
+    // Blocks downloaded before the snapshot was loaded are linked now that their parents are
+    std::deque<CBlockIndex*> queue;
+    for (auto it = mapBlocksUnlinked.begin(); it != mapBlocksUnlinked.end();) {
+        if (it->first->nChainTx == 0) {
+            ++it;
+            continue;
+        }
+        if (!chainActive.Contains(it->second)) {
+            queue.push_back(it->second);
+        }
+        it = mapBlocksUnlinked.erase(it);
+    }
+    while (!queue.empty()) {
+        CBlockIndex* pindex = queue.front();
+        queue.pop_front();
+        pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
+        {
+            LOCK(cs_nBlockSequenceId);
+            pindex->nSequenceId = nBlockSequenceId++;
+        }
+        if (!setBlockIndexCandidates.value_comp()(pindex, chainActive.Tip())) {
+            setBlockIndexCandidates.insert(pindex);
+        }
+        std::pair<std::multimap<CBlockIndex*, CBlockIndex*>::iterator, std::multimap<CBlockIndex*, CBlockIndex*>::iterator> range = mapBlocksUnlinked.equal_range(pindex);
+        while (range.first != range.second) {
+            queue.push_back(range.first->second);
+            range.first = mapBlocksUnlinked.erase(range.first);
+        }
+    }
+    PruneBlockIndexCandidates();
+
+    fLoadedSnapshot = true;
+    CValidationState state;
+    if (!FlushStateToDisk(chainparams, state, FlushStateMode::ALWAYS) || !pblocktree->WriteFlag("loadedsnapshot", true) ||
+        !pblocktree->WriteFlag("loadingsnapshot", false)) {
+        strError = "Failed to write to the block index database";
+        return false;
+    }
+
+    mempool.clear();
+    UpdateTip(pindexBase, chainparams);
+    GetMainSignals().UpdatedBlockTip(pindexBase, chainActive.Genesis(), IsInitialBlockDownload());
+    uiInterface.NotifyBlockTip(IsInitialBlockDownload(), pindexBase);
+
+    return true;
+}
+
+namespace {
+/** A block found in a block file, with its position in the file */
+struct CExternalBlock
+{
+    std::shared_ptr<CBlock> pblock;
+    CDiskBlockPos pos;
+};
+
+/** The blocks of one blk?????.dat file, scanned ahead of the loader thread during -reindex */
+struct CScannedBlockFile
+{
+    bool fOpened{false};
+    std::vector<CExternalBlock> vBlocks;
+};
+
+// Map of disk positions for blocks with unknown parent (only used for reindex)
+std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
+} // namespace
+
+/**
+ * Find and deserialize the blocks in fileIn, calling fn with each block and the
+ * position of its data in the file. The block hash is computed (and cached in the
+ * block) before fn is called, so that this can run ahead of the loader thread.
+ * Scanning stops early when fn returns false.
+ */
+static void ScanExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, const std::function<bool(const std::shared_ptr<CBlock>&, uint64_t)>& fn)
+{
     try {
         unsigned int nMaxBlockSize = MaxBlockSize(true);
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
@@ -4575,74 +5108,15 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
             try {
                 // read block
                 uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
                 blkdat.SetLimit(nBlockPos + nSize);
                 blkdat.SetPos(nBlockPos);
                 std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-                CBlock& block = *pblock;
-                blkdat >> block;
+                blkdat >> *pblock;
                 nRewind = blkdat.GetPos();
 
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                            block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                    continue;
-                }
-
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    LOCK(cs_main);
-                    CValidationState state;
-                    if (g_chainstate.AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr))
-                        nLoaded++;
-                    if (state.IsError())
-                        break;
-                } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
-                }
-
-                // Activate the genesis block so normal node progress can continue
-                if (hash == chainparams.GetConsensus().hashGenesisBlock) {
-                    CValidationState state;
-                    if (!ActivateBestChain(state, chainparams)) {
-                        break;
-                    }
-                }
-
-                NotifyHeaderTip();
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus()))
-                        {
-                            LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            CValidationState dummy;
-                            if (g_chainstate.AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr))
-                            {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip();
-                    }
-                }
+                pblock->GetHash();
+                if (!fn(pblock, nBlockPos))
+                    break;
             } catch (const std::exception& e) {
                 LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
@@ -4650,11 +5124,203 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
+}
+
+/**
+ * Accept a block found in an external file, or remember it for later if its parent
+ * is not known yet. dbp is its position if the file is one of our block files.
+ * Returns false if loading the rest of the file should be given up.
+ */
+static bool ProcessExternalBlock(const CChainParams& chainparams, const std::shared_ptr<CBlock>& pblock, CDiskBlockPos* dbp, int& nLoaded)
+{
+    const CBlock& block = *pblock;
+
+    // detect out of order blocks, and store them for later
+    uint256 hash = block.GetHash();
+    if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
+        LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                block.hashPrevBlock.ToString());
+        if (dbp)
+            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+        return true;
+    }
+
+    // process in case the block isn't known yet
+    if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+        LOCK(cs_main);
+        CValidationState state;
+        if (g_chainstate.AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr))
+            nLoaded++;
+        if (state.IsError())
+            return false;
+    } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
+        LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+    }
+
+    // Activate the genesis block so normal node progress can continue
+    if (hash == chainparams.GetConsensus().hashGenesisBlock) {
+        CValidationState state;
+        if (!ActivateBestChain(state, chainparams)) {
+            return false;
+        }
+    }
+
+    NotifyHeaderTip();
+
+    // Recursively process earlier encountered successors of this block
+    std::deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+            std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
+            if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus()))
+            {
+                LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
+                        head.ToString());
+                LOCK(cs_main);
+                CValidationState dummy;
+                if (g_chainstate.AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr))
+                {
+                    nLoaded++;
+                    queue.push_back(pblockrecursive->GetHash());
+                }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+            NotifyHeaderTip();
+        }
+    }
+    return true;
+}
+
+bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
+{
+    int64_t nStart = GetTimeMillis();
+
+    int nLoaded = 0;
+    ScanExternalBlockFile(chainparams, fileIn, [&](const std::shared_ptr<CBlock>& pblock, uint64_t nBlockPos) {
+        if (dbp)
+            dbp->nPos = nBlockPos;
+        return ProcessExternalBlock(chainparams, pblock, dbp, nLoaded);
+    });
     if (nLoaded > 0)
         LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
     return nLoaded > 0;
 }
 
+static CScannedBlockFile ScanBlockFile(const CChainParams& chainparams, int nFile, const std::atomic<bool>& fAbort)
+{
+    CScannedBlockFile scanned;
+    CDiskBlockPos pos(nFile, 0);
+    FILE* file = OpenBlockFile(pos, true);
+    if (!file)
+        return scanned; // This error is logged in OpenBlockFile
+    scanned.fOpened = true;
+    ScanExternalBlockFile(chainparams, file, [&](const std::shared_ptr<CBlock>& pblock, uint64_t nBlockPos) {
+        pos.nPos = nBlockPos;
+        scanned.vBlocks.push_back(CExternalBlock{pblock, pos});
+        return !fAbort;
+    });
+    return scanned;
+}
+
+void ReindexBlockFiles(const CChainParams& chainparams, int nThreads)
+{
+    int64_t nStart = GetTimeMillis();
+    int nTotalLoaded = 0;
+
+    if (nThreads <= 0) {
+        for (int nFile = 0; ; nFile++) {
+            CDiskBlockPos pos(nFile, 0);
+            if (!fs::exists(GetBlockPosFilename(pos, "blk")))
+                break; // No block files left to reindex
+            FILE *file = OpenBlockFile(pos, true);
+            if (!file)
+                break; // This error is logged in OpenBlockFile
+            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
+            LoadExternalBlockFile(chainparams, file, &pos);
+        }
+        return;
+    }
+
+    // Block files are scanned, deserialized and hashed by the pool while the loader
+    // thread accepts the blocks of earlier files in order. At most nThreads scanned
+    // files, and no more than MAX_REINDEX_READAHEAD bytes of them (but always the
+    // next one), are held in memory at a time.
+    std::atomic<bool> fAbort(false);
+    ctpl::thread_pool pool(nThreads);
+    RenameThreadPool(pool, "pigeon-reindex");
+    std::deque<std::pair<std::future<CScannedBlockFile>, uint64_t>> vScanning;
+    uint64_t nReadAhead = 0;
+    int nNextFile = 0;
+    bool fLastFile = false;
+
+    try {
+        for (int nFile = 0; ; nFile++) {
+            while (!fLastFile && (int)vScanning.size() < nThreads) {
+                const fs::path path = GetBlockPosFilename(CDiskBlockPos(nNextFile, 0), "blk");
+                if (!fs::exists(path)) {
+                    fLastFile = true; // No block files left to reindex
+                    break;
+                }
+                boost::system::error_code ec;
+                uint64_t nFileSize = fs::file_size(path, ec);
+                if (ec) {
+                    nFileSize = MAX_BLOCKFILE_SIZE;
+                }
+                if (!vScanning.empty() && nReadAhead + nFileSize > MAX_REINDEX_READAHEAD)
+                    break;
+                nReadAhead += nFileSize;
+                vScanning.emplace_back(pool.push([&chainparams, &fAbort](int, int nScanFile) {
+                    return ScanBlockFile(chainparams, nScanFile, fAbort);
+                }, nNextFile++), nFileSize);
+            }
+            if (vScanning.empty())
+                break;
+
+            CScannedBlockFile scanned = vScanning.front().first.get();
+            nReadAhead -= vScanning.front().second;
+            vScanning.pop_front();
+            boost::this_thread::interruption_point();
+            if (!scanned.fOpened)
+                break;
+
+            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
+            int64_t nFileStart = GetTimeMillis();
+            int nLoaded = 0;
+            for (CExternalBlock& block : scanned.vBlocks) {
+                boost::this_thread::interruption_point();
+                try {
+                    if (!ProcessExternalBlock(chainparams, block.pblock, &block.pos, nLoaded))
+                        break;
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+                }
+                block.pblock.reset();
+            }
+            nTotalLoaded += nLoaded;
+
+            int64_t nNow = GetTimeMillis();
+            LogPrintf("Loaded %i blocks from blk%05u.dat in %dms (%.1f blocks/s, %.1f blocks/s since start)\n",
+                      nLoaded, (unsigned int)nFile, nNow - nFileStart,
+                      1000.0 * nLoaded / std::max<int64_t>(nNow - nFileStart, 1),
+                      1000.0 * nTotalLoaded / std::max<int64_t>(nNow - nStart, 1));
+        }
+    } catch (...) {
+        fAbort = true;
+        pool.stop(false);
+        throw;
+    }
+    fAbort = true;
+    pool.stop(false);
+
+    LogPrintf("Reindexed %i blocks in %dms using %d scanning threads\n", nTotalLoaded, GetTimeMillis() - nStart, nThreads);
+}
+
 void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
 {
     if (!fCheckBlockIndex) {
@@ -4715,12 +5381,12 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
         if (pindex->nChainTx == 0) assert(pindex->nSequenceId <= 0);  // nSequenceId can't be set positive for blocks that aren't linked (negative is used for preciousblock)
         // VALID_TRANSACTIONS is equivalent to nTx > 0 for all nodes (whether or not pruning has occurred).
         // HAVE_DATA is only equivalent to nTx > 0 (or VALID_TRANSACTIONS) if no pruning has occurred.
-        if (!fHavePruned) {
+        if (!fHavePruned && !fLoadedSnapshot) {
             // If we've never pruned, then HAVE_DATA should be equivalent to nTx > 0
             assert(!(pindex->nStatus & BLOCK_HAVE_DATA) == (pindex->nTx == 0));
             assert(pindexFirstMissing == pindexFirstNeverProcessed);
         } else {
-            // If we have pruned, then we can only say that HAVE_DATA implies nTx > 0
+            // If we have pruned or loaded a UTXO snapshot, then we can only say that HAVE_DATA implies nTx > 0
             if (pindex->nStatus & BLOCK_HAVE_DATA) assert(pindex->nTx > 0);
         }
         if (pindex->nStatus & BLOCK_HAVE_UNDO) assert(pindex->nStatus & BLOCK_HAVE_DATA);
@@ -4774,7 +5440,7 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
         if (pindexFirstMissing == nullptr) assert(!foundInUnlinked); // We aren't missing data for any parent -- cannot be in mapBlocksUnlinked.
         if (pindex->pprev && (pindex->nStatus & BLOCK_HAVE_DATA) && pindexFirstNeverProcessed == nullptr && pindexFirstMissing != nullptr) {
             // We HAVE_DATA for this block, have received data for all parents at some point, but we're currently missing data for some parent.
-            assert(fHavePruned); // We must have pruned.
+            assert(fHavePruned || fLoadedSnapshot); // We must have pruned or loaded a UTXO snapshot.
             // This block may have entered mapBlocksUnlinked if:
             //  - it has a descendant that at some point had more work than the
             //    tip, and
@@ -4995,6 +5661,162 @@ bool DumpMempool(void)
     return true;
 }
 
+/** Stream the coins and evo database entries of the cursors to file behind the snapshot header */
+static bool WriteUTXOSnapshot(CAutoFile& file, CCoinsViewCursor* pcursor, CDBIterator* pevoCursor, SnapshotMetadata& metadata, uint256& hashSnapshot, std::string& strError)
+{
+    CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+    file << metadata;
+    hasher << metadata.hashBaseBlock;
+
+    COutPoint outpoint;
+    Coin coin;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        if (!pcursor->GetKey(outpoint) || !pcursor->GetValue(coin)) {
+            strError = "Unable to read the UTXO set";
+            return false;
+        }
+        file << outpoint << coin;
+        hasher << outpoint << coin;
+        metadata.nCoins++;
+    }
+
+    for (pevoCursor->SeekToFirst(); pevoCursor->Valid(); pevoCursor->Next()) {
+        CDataStream ssKey = pevoCursor->GetKey();
+        CDataStream ssValue = pevoCursor->GetValue();
+        std::vector<unsigned char> vchKey(ssKey.begin(), ssKey.end());
+        std::vector<unsigned char> vchValue(ssValue.begin(), ssValue.end());
+        file << vchKey << vchValue;
+        hasher << vchKey << vchValue;
+        metadata.nEvoEntries++;
+    }
+
+    // The counts are not part of the snapshot hash, fill them in now
+    if (fseek(file.Get(), 0, SEEK_SET) != 0) {
+        strError = "Unable to rewind the snapshot file";
+        return false;
+    }
+    file << metadata;
+    FileCommit(file.Get());
+    hashSnapshot = hasher.GetHash();
+    return true;
+}
+
+bool DumpUTXOSnapshot(const fs::path& path, SnapshotMetadata& metadata, uint256& hashSnapshot, std::string& strError)
+{
+    int64_t nStart = GetTimeMicros();
+
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    std::unique_ptr<CDBIterator> pevoCursor;
+    {
+        LOCK(cs_main);
+        // The coins and evo databases are flushed together, the cursors see the same block
+        FlushStateToDisk();
+        pcursor.reset(pcoinsdbview->Cursor());
+        pevoCursor.reset(evoDb->GetRawDB().NewIterator());
+        BlockMap::const_iterator mi = mapBlockIndex.find(pcursor->GetBestBlock());
+        assert(mi != mapBlockIndex.end());
+        metadata.hashBaseBlock = mi->first;
+        metadata.nBaseHeight = mi->second->nHeight;
+    }
+    metadata.nCoins = 0;
+    metadata.nEvoEntries = 0;
+
+    fs::path pathTmp = path.string() + ".incomplete";
+    FILE* filestr = fsbridge::fopen(pathTmp, "wb");
+    if (!filestr) {
+        strError = strprintf("Unable to open %s for writing", pathTmp.string());
+        return false;
+    }
+
+    bool fWritten = false;
+    try {
+        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+        fWritten = WriteUTXOSnapshot(file, pcursor.get(), pevoCursor.get(), metadata, hashSnapshot, strError);
+    } catch (const std::exception& e) {
+        strError = strprintf("Failed to dump UTXO snapshot: %s", e.what());
+    } catch (...) {
+        // Interrupted by shutdown
+        boost::system::error_code ec;
+        fs::remove(pathTmp, ec);
+        throw;
+    }
+    if (fWritten && !RenameOver(pathTmp, path)) {
+        strError = strprintf("Unable to rename %s to %s", pathTmp.string(), path.string());
+        fWritten = false;
+    }
+    if (!fWritten) {
+        boost::system::error_code ec;
+        fs::remove(pathTmp, ec);
+        return false;
+    }
+
+    LogPrintf("Dumped UTXO snapshot at block %s: %u coins, %u evodb entries, %gs\n", metadata.hashBaseBlock.ToString(),
+              metadata.nCoins, metadata.nEvoEntries, (GetTimeMicros() - nStart) * MICRO);
+    return true;
+}
+
+bool LoadUTXOSnapshot(const fs::path& path, const CChainParams& chainparams, SnapshotMetadata& metadata, std::string& strError)
+{
+    int64_t nStart = GetTimeMicros();
+
+    FILE* filestr = fsbridge::fopen(path, "rb");
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        strError = strprintf("Unable to open %s", path.string());
+        return false;
+    }
+
+    MapSnapshotData::const_iterator it;
+    try {
+        file >> metadata;
+        it = chainparams.Snapshots().find(metadata.hashBaseBlock);
+        if (it == chainparams.Snapshots().end()) {
+            strError = strprintf("No snapshot at block %s is known to this chain", metadata.hashBaseBlock.ToString());
+            return false;
+        }
+
+        // Check the whole file against the commitment before touching the chainstate
+        CHashVerifier<CAutoFile> verifier(&file);
+        verifier << metadata.hashBaseBlock;
+        COutPoint outpoint;
+        Coin coin;
+        for (uint64_t i = 0; i < metadata.nCoins; i++) {
+            boost::this_thread::interruption_point();
+            verifier >> outpoint >> coin;
+        }
+        std::vector<unsigned char> vchKey, vchValue;
+        for (uint64_t i = 0; i < metadata.nEvoEntries; i++) {
+            verifier >> vchKey >> vchValue;
+        }
+        uint256 hashSnapshot = verifier.GetHash();
+        if (hashSnapshot != it->second.hashSnapshot) {
+            strError = strprintf("Snapshot hash %s does not match the expected %s", hashSnapshot.ToString(), it->second.hashSnapshot.ToString());
+            return false;
+        }
+
+        if (fseek(file.Get(), 0, SEEK_SET) != 0) {
+            strError = "Unable to rewind the snapshot file";
+            return false;
+        }
+        file >> metadata;
+    } catch (const std::exception& e) {
+        strError = strprintf("Failed to read UTXO snapshot: %s", e.what());
+        return false;
+    }
+
+    {
+        LOCK(cs_main);
+        if (!g_chainstate.ActivateSnapshot(file, metadata, it->second, chainparams, strError)) {
+            return false;
+        }
+    }
+
+    LogPrintf("Loaded UTXO snapshot at block %s: %u coins, %u evodb entries, %gs\n", metadata.hashBaseBlock.ToString(),
+              metadata.nCoins, metadata.nEvoEntries, (GetTimeMicros() - nStart) * MICRO);
+    return true;
+}
+
 //! Guess how far we are in the verification process at the given block index
 //! require cs_main if pindex has not been validated yet (because nChainTx might be unset)
 double GuessVerificationProgress(const ChainTxData& data, const CBlockIndex *pindex) {
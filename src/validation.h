@@ -35,6 +35,7 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
 class CChainParams;
 class CCoinsViewDB;
 class CInv;
@@ -44,6 +45,7 @@ class CBlockPolicyEstimator;
 class CTxMemPool;
 class CValidationState;
 class PrecomputedTransactionData;
+class SnapshotMetadata;
 struct ChainTxData;
 
 struct LockPoints;
@@ -68,6 +70,8 @@ static const unsigned int DEFAULT_ANCESTOR_SIZE_LIMIT = 101;
 static const unsigned int DEFAULT_DESCENDANT_LIMIT = 25;
 /** Default for -limitdescendantsize, maximum kilobytes of in-mempool descendants */
 static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
+/** Default for -limitclustercount, max number of transactions in a cluster of connected in-mempool transactions */
+static const unsigned int DEFAULT_CLUSTER_LIMIT = 100;
 /** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 336;
 /** Maximum kilobytes for transactions to store for processing during reorg */
@@ -83,6 +87,18 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of coins prefetch threads allowed */
+static const int MAX_PREFETCH_THREADS = 16;
+/** -prefetchthreads default (number of threads reading block inputs ahead of ConnectBlock, 0 = off) */
+static const int DEFAULT_PREFETCH_THREADS = 4;
+/** Maximum number of reindex threads allowed */
+static const int MAX_REINDEX_THREADS = 16;
+/** -reindexthreads default (number of threads scanning block files ahead of the loader during -reindex, 0 = off) */
+static const int DEFAULT_REINDEX_THREADS = 2;
+/** Maximum size of the block files scanned ahead of the loader during -reindex, they are held deserialized in memory */
+static const uint64_t MAX_REINDEX_READAHEAD = 2 * MAX_BLOCKFILE_SIZE;
+/** Maximum number of prefetched coins waiting to be connected */
+static const size_t MAX_PREFETCH_COINS = 100000;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -128,6 +144,8 @@ static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
 /** Default for -syncmempool */
 static const bool DEFAULT_SYNC_MEMPOOL = true;
+/** Default for -trustsnapshot */
+static const bool DEFAULT_TRUST_SNAPSHOT = false;
 
 /** Maximum number of headers to announce when relaying blocks with headers message.*/
 static const unsigned int MAX_BLOCKS_TO_ANNOUNCE = 8;
@@ -199,6 +217,8 @@ static const uint64_t nMinDiskSpace = 52428800;
 /** Pruning-related variables and constants */
 /** True if any block files have ever been pruned. */
 extern bool fHavePruned;
+/** True if the chainstate was loaded from a UTXO snapshot, the blocks before its base have no data. */
+extern bool fLoadedSnapshot;
 /** True if we're running in -prune mode. */
 extern bool fPruneMode;
 /** Number of MiB of block files that we're trying to stay below. */
@@ -265,6 +285,8 @@ FILE* OpenBlockFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 fs::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp = nullptr);
+/** Import the blocks of all blk?????.dat files for -reindex, scanning up to nThreads files ahead in parallel */
+void ReindexBlockFiles(const CChainParams& chainparams, int nThreads);
 /** Ensures we have a genesis block in the block tree, possibly writing one to disk. */
 bool LoadGenesisBlock(const CChainParams& chainparams);
 /** Load the block tree and coins database from disk,
@@ -276,6 +298,8 @@ bool LoadChainTip(const CChainParams& chainparams);
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the header proof of work checking thread */
+void ThreadHeaderCheck();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
@@ -319,6 +343,13 @@ void PruneBlockFilesManual(int nManualPruneHeight);
 bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransactionRef &tx,
                         bool* pfMissingInputs, bool bypass_limits,
                         const CAmount nAbsurdFee, bool fDryRun=false);
+/**
+ * (try to) add transaction to memory pool, verifying its scripts without holding cs_main.
+ * cs_main is only taken for the checks against the chain and the mempool before and
+ * again for the insertion. Must not be called with cs_main held.
+ */
+bool AcceptToMemoryPoolConcurrent(CTxMemPool& pool, CValidationState &state, const CTransactionRef &tx,
+                                  bool* pfMissingInputs, bool bypass_limits, const CAmount nAbsurdFee);
 static bool AcceptToMemoryPoolWithTime(const CChainParams& chainparams, CTxMemPool& pool, CValidationState &state, const CTransactionRef &tx,
                                        bool* pfMissingInputs, int64_t nAcceptTime, bool bypass_limits,
                                        const CAmount nAbsurdFee, bool fDryRun = false);
@@ -421,6 +452,35 @@ void InitScriptExecutionCache();
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
 
+/** The serialized bytes of a block as stored in its block file, see ReadRawBlockFromDisk */
+class CRawBlock
+{
+public:
+    //! Keeps the bytes alive, usually a memory mapping of the block file
+    std::shared_ptr<const void> owner;
+    const unsigned char* pbegin{nullptr};
+    size_t nSize{0};
+
+    const unsigned char* begin() const { return pbegin; }
+    const unsigned char* end() const { return pbegin + nSize; }
+    size_t size() const { return nSize; }
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s.write((const char*)pbegin, nSize);
+    }
+};
+
+/**
+ * Get the serialized bytes of a block without deserializing it, for serving it as is.
+ * The bytes are taken from a memory mapping of the block file when possible. Unlike
+ * ReadBlockFromDisk, neither the proof of work nor the block hash are checked.
+ */
+bool ReadRawBlockFromDisk(CRawBlock& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start);
+bool ReadRawBlockFromDisk(CRawBlock& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
+
 /** Functions for validating blocks and updating the block tree */
 
 /** Context-independent validity checks */
@@ -465,6 +525,16 @@ extern std::unique_ptr<CCoinsViewDB> pcoinsdbview;
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern std::unique_ptr<CCoinsViewCache> pcoinsTip;
 
+/** Global variable that points to the coins prefetched for pcoinsTip, between pcoinsTip and pcoinsdbview */
+extern std::unique_ptr<CCoinsViewPrefetch> pcoinsPrefetch;
+
+/** Start reading block inputs into pcoinsPrefetch on nThreads threads */
+void StartCoinsPrefetch(int nThreads);
+void StopCoinsPrefetch();
+
+/** Read the inputs of a block that is about to be connected in the background */
+void PrefetchBlockInputs(const std::shared_ptr<const CBlock>& pblock);
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern std::unique_ptr<CBlockTreeDB> pblocktree;
 
@@ -505,10 +575,19 @@ bool DumpMempool();
 /** Load the mempool from disk. */
 bool LoadMempool();
 
+/** Write the UTXO set and evo database at the current tip to path, filling metadata and the snapshot hash. */
+bool DumpUTXOSnapshot(const fs::path& path, SnapshotMetadata& metadata, uint256& hashSnapshot, std::string& strError);
+
+/**
+ * Replace the chainstate of a node that is still at genesis with the UTXO snapshot at path.
+ * The snapshot must be committed to in chainparams and its base block header must be known.
+ */
+bool LoadUTXOSnapshot(const fs::path& path, const CChainParams& chainparams, SnapshotMetadata& metadata, std::string& strError);
+
 //! Check whether the block associated with this index entry is pruned or not.
 inline bool IsBlockPruned(const CBlockIndex* pblockindex)
 {
-    return (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0);
+    return ((fHavePruned || fLoadedSnapshot) && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0);
 }
 
 #endif // BITCOIN_VALIDATION_H
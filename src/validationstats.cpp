@@ -0,0 +1,110 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <validationstats.h>
+
+#include <algorithm>
+#include <assert.h>
+
+CLatencyHistogram::CLatencyHistogram(size_t nWindowIn) : nWindowSize(std::max<size_t>(nWindowIn, 1))
+{
+    vSamples.reserve(nWindowSize);
+}
+
+void CLatencyHistogram::Add(int64_t nMicros)
+{
+    LOCK(cs);
+    if (vSamples.size() < nWindowSize) {
+        vSamples.push_back(nMicros);
+    } else {
+        vSamples[nNext] = nMicros;
+    }
+    nNext = (nNext + 1) % nWindowSize;
+    nCount++;
+    nTotal += nMicros;
+}
+
+CLatencyHistogram::Summary CLatencyHistogram::GetSummary() const
+{
+    std::vector<int64_t> vSorted;
+    Summary summary;
+    {
+        LOCK(cs);
+        vSorted = vSamples;
+        summary.nCount = nCount;
+        summary.nTotal = nTotal;
+    }
+
+    summary.nWindow = vSorted.size();
+    if (vSorted.empty()) {
+        return summary;
+    }
+
+    // Nearest-rank percentiles
+    std::sort(vSorted.begin(), vSorted.end());
+    auto percentile = [&vSorted](int p) {
+        size_t nRank = (p * vSorted.size() + 99) / 100;
+        return vSorted[std::max<size_t>(nRank, 1) - 1];
+    };
+    summary.nP50 = percentile(50);
+    summary.nP90 = percentile(90);
+    summary.nP99 = percentile(99);
+    summary.nMax = vSorted.back();
+    return summary;
+}
+
+static CLatencyHistogram validationStageHistograms[(size_t)ValidationStage::COUNT];
+
+const char* GetValidationStageGroup(ValidationStage stage)
+{
+    assert(stage < ValidationStage::COUNT);
+    if (stage < ValidationStage::READ_FROM_DISK) {
+        return "connectblock";
+    }
+    if (stage < ValidationStage::COINS_FLUSH) {
+        return "connecttip";
+    }
+    return "flushstatetodisk";
+}
+
+const char* GetValidationStageName(ValidationStage stage)
+{
+    switch (stage) {
+    case ValidationStage::CHECK: return "check";
+    case ValidationStage::FORKS: return "forks";
+    case ValidationStage::CONNECT_TXS: return "connect_txs";
+    case ValidationStage::VERIFY: return "verify";
+    case ValidationStage::IS_FILTER: return "is_filter";
+    case ValidationStage::SUBSIDY: return "subsidy";
+    case ValidationStage::VALUE_VALID: return "value_valid";
+    case ValidationStage::PAYEE_VALID: return "payee_valid";
+    case ValidationStage::PROCESS_SPECIAL: return "process_special";
+    case ValidationStage::PIGEON_SPECIFIC: return "pigeon_specific";
+    case ValidationStage::FOUNDER_CHECK: return "founder_check";
+    case ValidationStage::INDEX: return "index";
+    case ValidationStage::CALLBACKS: return "callbacks";
+    case ValidationStage::READ_FROM_DISK: return "read_from_disk";
+    case ValidationStage::CONNECT_TOTAL: return "connect_total";
+    case ValidationStage::FLUSH: return "flush";
+    case ValidationStage::CHAINSTATE: return "chainstate";
+    case ValidationStage::POST_CONNECT: return "post_connect";
+    case ValidationStage::TOTAL: return "total";
+    case ValidationStage::COINS_FLUSH: return "coins_flush";
+    case ValidationStage::COUNT: break;
+    }
+    assert(false);
+    return "";
+}
+
+void RecordValidationStage(ValidationStage stage, int64_t nMicros)
+{
+    assert(stage < ValidationStage::COUNT);
+    validationStageHistograms[(size_t)stage].Add(nMicros);
+}
+
+CLatencyHistogram::Summary GetValidationStageSummary(ValidationStage stage)
+{
+    assert(stage < ValidationStage::COUNT);
+    return validationStageHistograms[(size_t)stage].GetSummary();
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2019 The Pigeon Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_VALIDATIONSTATS_H
+#define BITCOIN_VALIDATIONSTATS_H
+
+#include <sync.h>
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Latency samples of a single stage over a rolling window. The percentiles are
+ * computed over the last nWindow samples when a summary is requested, while
+ * the count and total cover every sample since startup.
+ */
+class CLatencyHistogram
+{
+public:
+    static const size_t DEFAULT_WINDOW = 1000;
+
+    struct Summary {
+        uint64_t nCount{0};   //!< samples since startup
+        int64_t nTotal{0};    //!< sum of all samples since startup, in microseconds
+        size_t nWindow{0};    //!< samples the percentiles below are computed from
+        int64_t nP50{0};
+        int64_t nP90{0};
+        int64_t nP99{0};
+        int64_t nMax{0};
+    };
+
+    explicit CLatencyHistogram(size_t nWindowIn = DEFAULT_WINDOW);
+
+    void Add(int64_t nMicros);
+    Summary GetSummary() const;
+
+private:
+    mutable CCriticalSection cs;
+    const size_t nWindowSize;
+    std::vector<int64_t> vSamples;
+    size_t nNext{0};
+    uint64_t nCount{0};
+    int64_t nTotal{0};
+};
+
+/**
+ * Stages of ConnectBlock and ConnectTip that are timed, see the BENCHMARK log category,
+ * and the time FlushStateToDisk holds up block processing to write the coins cache
+ */
+enum class ValidationStage {
+    // ConnectBlock
+    CHECK,
+    FORKS,
+    CONNECT_TXS,
+    VERIFY,
+    IS_FILTER,
+    SUBSIDY,
+    VALUE_VALID,
+    PAYEE_VALID,
+    PROCESS_SPECIAL,
+    PIGEON_SPECIFIC,
+    FOUNDER_CHECK,
+    INDEX,
+    CALLBACKS,
+    // ConnectTip
+    READ_FROM_DISK,
+    CONNECT_TOTAL,
+    FLUSH,
+    CHAINSTATE,
+    POST_CONNECT,
+    TOTAL,
+    // FlushStateToDisk
+    COINS_FLUSH,
+
+    COUNT
+};
+
+/** Name of the group of a stage as reported by getvalidationstats. Stages of a group are listed together. */
+const char* GetValidationStageGroup(ValidationStage stage);
+
+/** Name of a stage as reported by getvalidationstats */
+const char* GetValidationStageName(ValidationStage stage);
+
+/** Add a sample to the histogram of a stage */
+void RecordValidationStage(ValidationStage stage, int64_t nMicros);
+
+/** Get the latency summary of a stage */
+CLatencyHistogram::Summary GetValidationStageSummary(ValidationStage stage);
+
+#endif // BITCOIN_VALIDATIONSTATS_H
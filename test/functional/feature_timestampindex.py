@@ -33,15 +33,13 @@ class TimestampIndexTest(BitcoinTestFramework):
         self.sync_all()
 
     def run_test(self):
-        self.log.info("Test that settings can't be changed without -reindex...")
+        self.log.info("Test that the index can be disabled and enabled without -reindex...")
         self.stop_node(1)
-        self.assert_start_raises_init_error(1, ["-timestampindex=0"], 'You need to rebuild the database using -reindex to change -timestampindex')
-        self.start_node(1, ["-timestampindex=0", "-reindex"])
+        self.start_node(1, ["-timestampindex=0"])
         connect_nodes(self.nodes[0], 1)
         self.sync_all()
         self.stop_node(1)
-        self.assert_start_raises_init_error(1, ["-timestampindex"], 'You need to rebuild the database using -reindex to change -timestampindex')
-        self.start_node(1, ["-timestampindex", "-reindex"])
+        self.start_node(1, ["-timestampindex"])
         connect_nodes(self.nodes[0], 1)
         self.sync_all()
 
@@ -54,6 +52,33 @@ class TimestampIndexTest(BitcoinTestFramework):
         hashes = self.nodes[1].getblockhashes(high, low)
         assert_equal(len(hashes), 5)
         assert_equal(sorted(blockhashes), sorted(hashes))
+        assert_raises_rpc_error(-1, "Timestamp index is not enabled", self.nodes[2].getblockhashes, high, low)
+
+        self.log.info("Checking that an index enabled on an existing chain catches up...")
+        self.stop_node(2)
+        self.start_node(2, ["-timestampindex"])
+        connect_nodes(self.nodes[0], 2)
+        self.sync_all()
+        wait_until(lambda: len(self.nodes[2].getblockhashes(high, low)) == 5, allow_exception=True)
+        assert_equal(sorted(blockhashes), sorted(self.nodes[2].getblockhashes(high, low)))
+
+        self.log.info("Checking that a reorg updates the timestamp index...")
+        for node in self.nodes:
+            node.invalidateblock(blockhashes[4])
+        assert_equal(sorted(blockhashes[:4]), sorted(self.nodes[1].getblockhashes(high, low)))
+        for node in self.nodes:
+            node.reconsiderblock(blockhashes[4])
+        self.sync_all()
+        assert_equal(sorted(blockhashes), sorted(self.nodes[1].getblockhashes(high, low)))
+
+        self.log.info("Checking that a restarted index rewinds blocks that were reorged away...")
+        self.stop_node(3)
+        self.start_node(3, ["-timestampindex=0"])
+        self.nodes[3].invalidateblock(blockhashes[4])
+        self.stop_node(3)
+        self.start_node(3, ["-timestampindex"])
+        wait_until(lambda: len(self.nodes[3].getblockhashes(high, low)) == 4, allow_exception=True)
+        assert_equal(sorted(blockhashes[:4]), sorted(self.nodes[3].getblockhashes(high, low)))
         self.log.info("Passed")
 
 
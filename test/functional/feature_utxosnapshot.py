@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Pigeon Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test dumping a UTXO snapshot and loading it into a fresh node.
+
+- node0 mines a chain and dumps a snapshot at its tip.
+- node1 only gets the headers of that chain and loads the snapshot, which
+  is committed to with -snapshotdata. Loading it requires -trustsnapshot.
+- node1 continues from the snapshot block, stops offering NODE_NETWORK and
+  keeps its chainstate across a restart, as long as -trustsnapshot is set.
+"""
+import os
+
+from test_framework.messages import CBlockHeader, FromHex, msg_headers
+from test_framework.mininode import P2PInterface, network_thread_start
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_raises_rpc_error, connect_nodes, sync_blocks, wait_until
+
+NODE_NETWORK = 1
+
+class UTXOSnapshotTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+
+    def setup_network(self):
+        # node1 must not download the blocks of node0
+        self.setup_nodes()
+
+    def run_test(self):
+        node0, node1 = self.nodes
+
+        self.log.info("Dumping a snapshot...")
+        node0.generate(110)
+        res = node0.dumptxoutset("utxo.dat")
+        path = res["path"]
+        base_hash = res["base_hash"]
+        assert_equal(res["base_height"], 110)
+        assert_equal(res["base_hash"], node0.getbestblockhash())
+        assert os.path.exists(path)
+        assert not os.path.exists(path + ".incomplete")
+        assert_raises_rpc_error(-8, "already exists", node0.dumptxoutset, "utxo.dat")
+
+        txoutset = node0.gettxoutsetinfo()
+        assert_equal(res["coins_written"], txoutset["txouts"])
+        chain_tx = node0.getchaintxstats()["txcount"]
+
+        self.log.info("Sending the headers of the snapshot chain to node1...")
+        node1.add_p2p_connection(P2PInterface())
+        network_thread_start()
+        node1.p2p.wait_for_verack()
+        headers = msg_headers()
+        for height in range(1, 111):
+            header_hex = node0.getblockheader(node0.getblockhash(height), False)
+            headers.headers.append(FromHex(CBlockHeader(), header_hex))
+        node1.p2p.send_message(headers)
+        wait_until(lambda: node1.getblockchaininfo()["headers"] == 110)
+        assert_equal(node1.getblockcount(), 0)
+
+        self.log.info("Checking that loading a snapshot has to be opted in to...")
+        assert_raises_rpc_error(-1, "requires -trustsnapshot", node1.loadtxoutset, path)
+
+        self.log.info("Checking that a snapshot has to be committed to...")
+        self.stop_node(1)
+        self.start_node(1, ["-trustsnapshot"])
+        assert_raises_rpc_error(-1, "No snapshot at block", node1.loadtxoutset, path)
+
+        self.log.info("Loading the snapshot into node1...")
+        self.stop_node(1)
+        snapshot_args = ["-snapshotdata={}:{}:{}".format(base_hash, res["snapshot_hash"], chain_tx), "-trustsnapshot"]
+        self.start_node(1, snapshot_args)
+        assert int(node1.getnetworkinfo()["localservices"], 16) & NODE_NETWORK
+        loaded = node1.loadtxoutset(path)
+        assert_equal(loaded["coins_loaded"], res["coins_written"])
+        assert_equal(loaded["evodb_entries"], res["evodb_entries"])
+        assert_equal(loaded["base_hash"], base_hash)
+        assert_equal(node1.getbestblockhash(), base_hash)
+        assert_equal(node1.getblockcount(), 110)
+        assert_equal(node1.getchaintxstats()["txcount"], chain_tx)
+        txoutset1 = node1.gettxoutsetinfo()
+        for key in ["bestblock", "txouts", "total_amount"]:
+            assert_equal(txoutset1[key], txoutset[key])
+        assert not int(node1.getnetworkinfo()["localservices"], 16) & NODE_NETWORK
+        assert_raises_rpc_error(-1, "before any blocks are connected", node1.loadtxoutset, path)
+
+        self.log.info("Syncing the blocks after the snapshot...")
+        connect_nodes(node1, 0)
+        node0.generate(10)
+        sync_blocks(self.nodes)
+        assert_equal(node1.getblockcount(), 120)
+
+        self.log.info("Restarting node1 on the snapshot chainstate...")
+        self.stop_node(1)
+        self.assert_start_raises_init_error(1, snapshot_args[:1], "Restart with -trustsnapshot")
+        self.start_node(1, snapshot_args)
+        assert_equal(node1.getblockcount(), 120)
+        assert_equal(node1.getbestblockhash(), node0.getbestblockhash())
+        assert not int(node1.getnetworkinfo()["localservices"], 16) & NODE_NETWORK
+
+if __name__ == '__main__':
+    UTXOSnapshotTest().main()
@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Pigeon Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test recovery from a crash during a background write of the coins cache.
+
+- node1 runs with -coinswritebehind and a small -dbcache, and crashes with
+  -dbcrashratio while the coins of a flush are written in the background.
+- A quorum commitment is mined after node1's last complete flush. The evo
+  database is committed when the coins are handed to the writer thread, so
+  after the crash it already contains the commitment and replaying the
+  blocks must not process it again.
+- node1 restarts without -dbcrashratio and has to end up with the same
+  UTXO set and quorums as node0.
+"""
+import os
+
+from test_framework.messages import COIN, COutPoint, CTransaction, CTxIn, CTxOut, ToHex
+from test_framework.script import CScript, OP_EQUAL, OP_HASH160, OP_TRUE, hash160
+from test_framework.test_framework import MASTERNODE_COLLATERAL, PigeonTestFramework
+from test_framework.util import assert_equal, connect_nodes, sync_blocks, sync_mempools
+
+# Enough new coins for the block connecting them to exceed node1's coins cache
+NUM_TXS = 10
+OUTPUTS_PER_TX = 2500
+
+class WriteBehindCrashTest(PigeonTestFramework):
+    def set_test_params(self):
+        self.set_pigeon_test_params(5, 3, fast_dip3_enforcement=True)
+        self.crash_args = ["-coinswritebehind", "-dbcache=4", "-dbbatchsize=1", "-dbcrashratio=1000"]
+
+    def run_test(self):
+        node0, node1 = self.nodes[0], self.nodes[1]
+
+        self.nodes[0].spork("SPORK_17_QUORUM_DKG_ENABLED", 0)
+        self.wait_for_sporks_same()
+
+        self.log.info("Restarting node1 with background coins writes...")
+        # The shutdown flushes the coins, so everything from here on is only in node1's caches
+        self.restart_node(1, self.extra_args[1] + self.crash_args)
+        connect_nodes(node1, 0)
+
+        self.mine_quorum()
+        sync_blocks([node0, node1])
+        quorums = node0.quorum("list")
+        assert_equal(node1.quorum("list"), quorums)
+
+        self.log.info("Creating %d coins..." % (NUM_TXS * OUTPUTS_PER_TX))
+        script = CScript([OP_HASH160, hash160(CScript([OP_TRUE])), OP_EQUAL])
+        # Spend separate confirmed coins, a chain of these transactions would exceed the ancestor limits
+        utxos = [u for u in node0.listunspent() if u["amount"] >= 1 and u["amount"] != MASTERNODE_COLLATERAL]
+        assert len(utxos) >= NUM_TXS
+        for utxo in utxos[:NUM_TXS]:
+            tx = CTransaction()
+            tx.vin = [CTxIn(COutPoint(int(utxo["txid"], 16), utxo["vout"]))]
+            tx.vout = [CTxOut(COIN // 10000, script) for _ in range(OUTPUTS_PER_TX)]
+            funded = node0.fundrawtransaction(ToHex(tx))["hex"]
+            node0.sendrawtransaction(node0.signrawtransaction(funded)["hex"])
+        sync_mempools([node0, node1])
+
+        self.log.info("Crashing node1 during the background write...")
+        self.bump_mocktime(1)
+        node0.generate(1)
+        self.wait_for_node_exit(1, timeout=120)
+        node1.running = False
+        node1.process = None
+
+        self.log.info("Restarting node1 and replaying the blocks...")
+        self.start_node(1, self.extra_args[1])
+        connect_nodes(node1, 0)
+        sync_blocks([node0, node1])
+        with open(os.path.join(node1.datadir, "regtest", "debug.log"), encoding="utf-8") as log:
+            assert "Replaying blocks" in log.read()
+        assert_equal(node1.getbestblockhash(), node0.getbestblockhash())
+        assert_equal(node1.quorum("list"), quorums)
+        assert_equal(node1.gettxoutsetinfo()["hash_serialized_2"], node0.gettxoutsetinfo()["hash_serialized_2"])
+
+if __name__ == '__main__':
+    WriteBehindCrashTest().main()
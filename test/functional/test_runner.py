@@ -83,6 +83,7 @@ BASE_SCRIPTS= [
     'feature_llmq_is_retroactive.py', # NOTE: needs pigeon_hash to pass
     'feature_llmq_dkgerrors.py', # NOTE: needs pigeon_hash to pass
     'feature_dip4_coinbasemerkleroots.py', # NOTE: needs pigeon_hash to pass
+    'feature_writebehind_crash.py', # NOTE: needs pigeon_hash to pass
     # vv Tests less than 60s vv
     'p2p_sendheaders.py', # NOTE: needs pigeon_hash to pass
     'wallet_zapwallettxes.py',
@@ -115,6 +116,7 @@ BASE_SCRIPTS= [
     'feature_addressindex.py',
     'feature_timestampindex.py',
     'feature_spentindex.py',
+    'feature_utxosnapshot.py',
     'rpc_decodescript.py',
     'rpc_blockchain.py',
     'rpc_deprecated.py',